@@ -0,0 +1,411 @@
+/*
+ * Copyright (c) 2011 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "fw_image.h"
+
+#define LZ_MIN_MATCH    4
+#define LZ_MAX_OFFSET   65535
+#define LZ_HASH_BITS    12
+
+uint64_t fw_image_hash(const void *buf, uint32_t size)
+{
+    const uint8_t *p = (const uint8_t *)buf;
+    uint64_t h = 0xcbf29ce484222325ull;
+    uint32_t i;
+
+    for (i = 0; i < size; i++) {
+        h ^= p[i];
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+/*
+ * LZ stream: a run of sequences, each
+ *   token         literal count (high nibble), match length - 4 (low nibble),
+ *                 a nibble of 15 is continued by bytes of 255... until < 255
+ *   literals
+ *   offset        16 bit, back from the current output position
+ *   match length continuation bytes
+ * The last sequence carries literals only and ends the stream.
+ */
+static uint8_t *lz_put_length(uint8_t *op, uint8_t *oend, uint32_t len)
+{
+    for (; len >= 255; len -= 255) {
+        if (op >= oend)
+            return NULL;
+        *op++ = 255;
+    }
+    if (op >= oend)
+        return NULL;
+    *op++ = (uint8_t)len;
+    return op;
+}
+
+static uint8_t *lz_put_sequence(uint8_t *op, uint8_t *oend, const uint8_t *lit, uint32_t lit_len,
+                                uint32_t offset, uint32_t match_len)
+{
+    uint32_t ml = match_len ? match_len - LZ_MIN_MATCH : 0;
+    uint8_t *token = op++;
+
+    if (op > oend)
+        return NULL;
+    *token = (uint8_t)(((lit_len < 15 ? lit_len : 15) << 4) | (ml < 15 ? ml : 15));
+    if (lit_len >= 15 && (op = lz_put_length(op, oend, lit_len - 15)) == NULL)
+        return NULL;
+    if ((uint32_t)(oend - op) < lit_len)
+        return NULL;
+    memcpy(op, lit, lit_len);
+    op += lit_len;
+
+    if (match_len == 0)         /* last sequence */
+        return op;
+
+    if (oend - op < 2)
+        return NULL;
+    *op++ = (uint8_t)(offset & 0xff);
+    *op++ = (uint8_t)(offset >> 8);
+    if (ml >= 15 && (op = lz_put_length(op, oend, ml - 15)) == NULL)
+        return NULL;
+    return op;
+}
+
+static uint32_t lz_read32(const uint8_t *p)
+{
+    uint32_t v;
+
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+uint32_t fw_image_lz_compress(const uint8_t *src, uint32_t size, uint8_t *dst, uint32_t dst_size)
+{
+    uint32_t table[1 << LZ_HASH_BITS];  /* position + 1, 0 is empty */
+    uint8_t *op = dst, *oend = dst + (dst_size < size ? dst_size : size);
+    uint32_t ip = 0, anchor = 0;
+
+    memset(table, 0, sizeof(table));
+
+    while (ip + LZ_MIN_MATCH <= size) {
+        uint32_t seq = lz_read32(src + ip);
+        uint32_t h = (seq * 2654435761u) >> (32 - LZ_HASH_BITS);
+        uint32_t ref = table[h];
+        uint32_t len;
+
+        table[h] = ip + 1;
+        if (ref == 0 || ip - (ref - 1) > LZ_MAX_OFFSET || lz_read32(src + ref - 1) != seq) {
+            ip++;
+            continue;
+        }
+        ref--;
+
+        len = LZ_MIN_MATCH;
+        while (ip + len < size && src[ref + len] == src[ip + len])
+            len++;
+
+        op = lz_put_sequence(op, oend, src + anchor, ip - anchor, ip - ref, len);
+        if (op == NULL)
+            return 0;
+        ip += len;
+        anchor = ip;
+    }
+
+    op = lz_put_sequence(op, oend, src + anchor, size - anchor, 0, 0);
+    if (op == NULL || op >= oend)
+        return 0;
+    return (uint32_t)(op - dst);
+}
+
+static int lz_get_length(const uint8_t **ip, const uint8_t *iend, uint32_t *len)
+{
+    uint8_t b;
+
+    do {
+        if (*ip >= iend)
+            return -1;
+        b = *(*ip)++;
+        *len += b;
+    } while (b == 255);
+    return 0;
+}
+
+int fw_image_lz_decompress(const uint8_t *src, uint32_t size, uint8_t *dst, uint32_t dst_size)
+{
+    const uint8_t *ip = src, *iend = src + size;
+    uint8_t *op = dst, *oend = dst + dst_size;
+
+    while (ip < iend) {
+        uint8_t token = *ip++;
+        uint32_t lit_len = token >> 4;
+        uint32_t match_len = token & 0xf;
+        uint32_t offset;
+
+        if (lit_len == 15 && lz_get_length(&ip, iend, &lit_len))
+            return -1;
+        if ((uint32_t)(iend - ip) < lit_len || (uint32_t)(oend - op) < lit_len)
+            return -1;
+        memcpy(op, ip, lit_len);
+        ip += lit_len;
+        op += lit_len;
+
+        if (ip == iend)         /* last sequence */
+            break;
+
+        if (iend - ip < 2)
+            return -1;
+        offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (match_len == 15 && lz_get_length(&ip, iend, &match_len))
+            return -1;
+        match_len += LZ_MIN_MATCH;
+
+        if (offset == 0 || offset > (uint32_t)(op - dst) || (uint32_t)(oend - op) < match_len)
+            return -1;
+        /* overlapping copy, byte by byte */
+        for (; match_len; match_len--, op++)
+            *op = *(op - offset);
+    }
+
+    return (op == oend) ? 0 : -1;
+}
+
+/* Find or add a section, returns its index */
+static uint32_t fw_image_add_section(fw_image_section_t *sections, const uint8_t **payload,
+                                     uint32_t *count, const void *buf, uint32_t size)
+{
+    uint64_t hash = fw_image_hash(buf, size);
+    uint32_t i;
+
+    for (i = 0; i < *count; i++) {
+        if (sections[i].hash == hash && sections[i].size == size &&
+            memcmp(payload[i], buf, size) == 0)
+            return i;
+    }
+
+    memset(&sections[i], 0, sizeof(sections[i]));
+    sections[i].size = size;
+    sections[i].hash = hash;
+    payload[i] = (const uint8_t *)buf;
+    (*count)++;
+    return i;
+}
+
+static int fw_image_pad(FILE *fp, uint32_t *pos)
+{
+    static const uint8_t zero[FW_IMAGE_ALIGN];
+    uint32_t pad = (FW_IMAGE_ALIGN - (*pos & (FW_IMAGE_ALIGN - 1))) & (FW_IMAGE_ALIGN - 1);
+
+    if (pad && fwrite(zero, 1, pad, fp) != pad)
+        return -1;
+    *pos += pad;
+    return 0;
+}
+
+int fw_image_write(FILE *fp, uint32_t fw_ver, const fw_image_input_t *input, unsigned int count, int compress)
+{
+    fw_image_header_t header;
+    fw_image_entry_t *entries;
+    fw_image_section_t *sections;
+    const uint8_t **payload;
+    uint8_t **packed;
+    uint32_t section_count = 0, entry_count = 0, pos, raw = 0, i;
+    int ret = -1;
+
+    for (i = 0; i < count; i++) {
+        if (input[i].codec + 1 > entry_count)
+            entry_count = input[i].codec + 1;
+    }
+
+    entries = (fw_image_entry_t *)calloc(entry_count, sizeof(*entries));
+    sections = (fw_image_section_t *)calloc(count * 2, sizeof(*sections));
+    payload = (const uint8_t **)calloc(count * 2, sizeof(*payload));
+    packed = (uint8_t **)calloc(count * 2, sizeof(*packed));
+    if (!entries || !sections || !payload || !packed)
+        goto out;
+
+    for (i = 0; i < entry_count; i++) {
+        entries[i].codec = i;
+        entries[i].text_section = FW_IMAGE_NO_SECTION;
+        entries[i].data_section = FW_IMAGE_NO_SECTION;
+    }
+
+    for (i = 0; i < count; i++) {
+        fw_image_entry_t *entry = &entries[input[i].codec];
+
+        strncpy(entry->name, input[i].name, FW_IMAGE_NAME_LEN - 1);
+        entry->flags = FW_IMAGE_ENTRY_PRESENT;
+        entry->data_location = input[i].data_location;
+        entry->text_section = fw_image_add_section(sections, payload, &section_count,
+                                                   input[i].text, input[i].text_size);
+        entry->data_section = fw_image_add_section(sections, payload, &section_count,
+                                                   input[i].data, input[i].data_size);
+        raw += input[i].text_size + input[i].data_size;
+    }
+
+    /* lay out the payloads after the tables */
+    pos = sizeof(header) + entry_count * sizeof(*entries);
+    pos = (pos + 7) & ~7;
+    pos += section_count * sizeof(*sections);
+    for (i = 0; i < section_count; i++) {
+        uint32_t stored = sections[i].size;
+
+        if (compress && stored) {
+            packed[i] = (uint8_t *)malloc(stored);
+            if (packed[i] == NULL)
+                goto out;
+            stored = fw_image_lz_compress(payload[i], sections[i].size, packed[i], sections[i].size);
+            if (stored) {
+                sections[i].flags |= FW_IMAGE_SECTION_LZ;
+            } else {
+                free(packed[i]);
+                packed[i] = NULL;
+                stored = sections[i].size;
+            }
+        }
+
+        pos = (pos + FW_IMAGE_ALIGN - 1) & ~(FW_IMAGE_ALIGN - 1);
+        sections[i].offset = pos;
+        sections[i].stored_size = stored;
+        pos += stored;
+    }
+
+    memset(&header, 0, sizeof(header));
+    header.magic = FW_IMAGE_MAGIC;
+    header.version = FW_IMAGE_VERSION;
+    header.entry_count = entry_count;
+    header.section_count = section_count;
+    header.fw_ver = fw_ver;
+    header.entry_offset = sizeof(header);
+    header.section_offset = (sizeof(header) + entry_count * sizeof(*entries) + 7) & ~7;
+    header.image_size = pos;
+
+    pos = 0;
+    if (fwrite(&header, sizeof(header), 1, fp) != 1 ||
+        fwrite(entries, sizeof(*entries), entry_count, fp) != entry_count)
+        goto out;
+    pos = sizeof(header) + entry_count * sizeof(*entries);
+    while (pos < header.section_offset) {
+        if (fputc(0, fp) == EOF)
+            goto out;
+        pos++;
+    }
+    if (fwrite(sections, sizeof(*sections), section_count, fp) != section_count)
+        goto out;
+    pos += section_count * sizeof(*sections);
+
+    for (i = 0; i < section_count; i++) {
+        const uint8_t *buf = packed[i] ? packed[i] : payload[i];
+
+        if (fw_image_pad(fp, &pos) ||
+            fwrite(buf, 1, sections[i].stored_size, fp) != sections[i].stored_size)
+            goto out;
+        pos += sections[i].stored_size;
+    }
+
+    printf("fw image: %d entries, %d unique sections, %d bytes of firmware in %d bytes\n",
+           count, section_count, raw, header.image_size);
+    ret = 0;
+out:
+    if (packed) {
+        for (i = 0; i < section_count; i++)
+            free(packed[i]);
+    }
+    free(packed);
+    free(payload);
+    free(sections);
+    free(entries);
+    return ret;
+}
+
+int fw_image_validate(const uint8_t *image, size_t size)
+{
+    const fw_image_header_t *header = (const fw_image_header_t *)image;
+    const fw_image_entry_t *entries;
+    const fw_image_section_t *sections;
+    uint32_t i;
+
+    if (size < sizeof(*header) || header->magic != FW_IMAGE_MAGIC)
+        return -1;
+    if (header->version != FW_IMAGE_VERSION || header->image_size != size)
+        return -1;
+    if (header->entry_offset > size ||
+        header->entry_count > (size - header->entry_offset) / sizeof(*entries) ||
+        header->section_offset > size ||
+        header->section_count > (size - header->section_offset) / sizeof(*sections))
+        return -1;
+
+    entries = (const fw_image_entry_t *)(image + header->entry_offset);
+    sections = (const fw_image_section_t *)(image + header->section_offset);
+
+    for (i = 0; i < header->section_count; i++) {
+        if (sections[i].offset > size || sections[i].stored_size > size - sections[i].offset)
+            return -1;
+        if (!(sections[i].flags & FW_IMAGE_SECTION_LZ) && sections[i].stored_size != sections[i].size)
+            return -1;
+    }
+    for (i = 0; i < header->entry_count; i++) {
+        if (!(entries[i].flags & FW_IMAGE_ENTRY_PRESENT))
+            continue;
+        if (memchr(entries[i].name, '\0', FW_IMAGE_NAME_LEN) == NULL)
+            return -1;
+        if (entries[i].text_section >= header->section_count ||
+            entries[i].data_section >= header->section_count)
+            return -1;
+    }
+
+    return 0;
+}
+
+const fw_image_entry_t *fw_image_lookup(const uint8_t *image, unsigned int codec)
+{
+    const fw_image_header_t *header = (const fw_image_header_t *)image;
+    const fw_image_entry_t *entry;
+
+    if (codec >= header->entry_count)
+        return NULL;
+    entry = (const fw_image_entry_t *)(image + header->entry_offset) + codec;
+    return (entry->flags & FW_IMAGE_ENTRY_PRESENT) ? entry : NULL;
+}
+
+int fw_image_extract(const uint8_t *image, uint32_t section, uint8_t *dst)
+{
+    const fw_image_header_t *header = (const fw_image_header_t *)image;
+    const fw_image_section_t *sec;
+
+    if (section >= header->section_count)
+        return -1;
+    sec = (const fw_image_section_t *)(image + header->section_offset) + section;
+
+    if (sec->flags & FW_IMAGE_SECTION_LZ) {
+        if (fw_image_lz_decompress(image + sec->offset, sec->stored_size, dst, sec->size))
+            return -1;
+    } else {
+        memcpy(dst, image + sec->offset, sec->size);
+    }
+
+    return (fw_image_hash(dst, sec->size) == sec->hash) ? 0 : -1;
+}
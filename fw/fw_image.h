@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2011 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _FW_IMAGE_H_
+#define _FW_IMAGE_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Indexed firmware image
+ *
+ *   fw_image_header_t
+ *   fw_image_entry_t   entries[entry_count]     indexed by codec id
+ *   fw_image_section_t sections[section_count]
+ *   section payloads, each FW_IMAGE_ALIGN aligned
+ *
+ * An entry refers to one text and one data section. Identical sections are
+ * stored once, so CBR/VBR/VCM variants sharing code cost nothing extra.
+ * A section may be stored compressed (FW_IMAGE_SECTION_LZ), see
+ * fw_image_lz_decompress(). All fields are little endian.
+ */
+
+#define FW_IMAGE_MAGIC          0x4d495746      /* "FWIM" */
+#define FW_IMAGE_VERSION        1
+#define FW_IMAGE_ALIGN          64
+#define FW_IMAGE_NAME_LEN       16
+#define FW_IMAGE_NO_SECTION     0xffffffff
+
+#define FW_IMAGE_ENTRY_PRESENT  0x1
+#define FW_IMAGE_SECTION_LZ     0x1
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t entry_count;
+    uint32_t section_count;
+    uint32_t fw_ver;
+    uint32_t entry_offset;
+    uint32_t section_offset;
+    uint32_t image_size;
+    uint32_t reserved;
+} fw_image_header_t;
+
+typedef struct {
+    char name[FW_IMAGE_NAME_LEN];
+    uint16_t codec;
+    uint16_t flags;
+    uint32_t text_section;
+    uint32_t data_section;
+    uint32_t data_location;
+} fw_image_entry_t;
+
+typedef struct {
+    uint32_t offset;            /* from the start of the image */
+    uint32_t stored_size;       /* bytes in the image */
+    uint32_t size;              /* bytes once decompressed */
+    uint32_t flags;
+    uint64_t hash;              /* FNV-1a of the decompressed bytes */
+} fw_image_section_t;
+
+/* one firmware variant handed to fw_image_write() */
+typedef struct {
+    const char *name;
+    unsigned int codec;
+    const void *text;
+    uint32_t text_size;         /* bytes */
+    const void *data;
+    uint32_t data_size;         /* bytes */
+    uint32_t data_location;
+} fw_image_input_t;
+
+uint64_t fw_image_hash(const void *buf, uint32_t size);
+
+/* Returns the compressed size, or 0 when the result would not be smaller */
+uint32_t fw_image_lz_compress(const uint8_t *src, uint32_t size, uint8_t *dst, uint32_t dst_size);
+/* Returns 0 when exactly dst_size bytes were produced from a well formed stream */
+int fw_image_lz_decompress(const uint8_t *src, uint32_t size, uint8_t *dst, uint32_t dst_size);
+
+/* Write an image holding count variants, compressing sections if asked */
+int fw_image_write(FILE *fp, uint32_t fw_ver, const fw_image_input_t *input, unsigned int count, int compress);
+
+/* Check header and table bounds of an image mapped at image */
+int fw_image_validate(const uint8_t *image, size_t size);
+/* O(1) lookup of a validated image, NULL if codec is not in it */
+const fw_image_entry_t *fw_image_lookup(const uint8_t *image, unsigned int codec);
+/* Decompress (or copy) a section and verify its hash, dst holds section->size bytes */
+int fw_image_extract(const uint8_t *image, uint32_t section, uint8_t *dst);
+
+#endif /* _FW_IMAGE_H_ */
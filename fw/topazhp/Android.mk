@@ -29,6 +29,7 @@ include $(CLEAR_VARS)
 
 LOCAL_SRC_FILES := \
     topazhp_bin.c \
+    ../fw_image.c \
     JPEGMasterFirmware_bin.c \
     H264MasterFirmware_bin.c \
     H264MasterFirmwareCBR_bin.c \
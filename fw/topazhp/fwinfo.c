@@ -34,6 +34,15 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../fw_image.h"
+
 #define TOPAZ_FW_FILE_NAME_ANDROID "/etc/firmware/topaz_fw.bin"
 #define MSVDX_FW_FILE_NAME_ANDROID "/etc/firmware/msvdx_fw.bin"
 
@@ -112,7 +121,109 @@ static char *codec_to_string(int codec)
     return "";
 }
 
-int main()
+static int fw_image_save(const char *prefix, const char *suffix, const uint8_t *image, uint32_t section)
+{
+    const fw_image_header_t *header = (const fw_image_header_t *)image;
+    const fw_image_section_t *sec = (const fw_image_section_t *)(image + header->section_offset) + section;
+    char fn[256];
+    uint8_t *buf;
+    FILE *fp;
+    int ret = -1;
+
+    buf = (uint8_t *)malloc(sec->size + 1);
+    if (buf == NULL)
+        return -1;
+
+    if (fw_image_extract(image, section, buf)) {
+        printf("section %d is corrupted\n", section);
+        goto out;
+    }
+
+    snprintf(fn, sizeof(fn), "%s.%s", prefix, suffix);
+    fp = fopen(fn, "w");
+    if (fp == NULL)
+        goto out;
+    if (fwrite(buf, 1, sec->size, fp) == sec->size)
+        ret = 0;
+    fclose(fp);
+    printf("%s: %d bytes\n", fn, sec->size);
+out:
+    free(buf);
+    return ret;
+}
+
+/*
+ * imginfo -i <indexed image> [<codec> <output prefix>]
+ * Validate and list an image from the topaz packers, or extract the text
+ * and data sections of one codec.
+ */
+static int fw_image_info(int argc, char *argv[])
+{
+    const fw_image_header_t *header;
+    const fw_image_entry_t *entry;
+    const fw_image_section_t *sections;
+    struct stat st;
+    uint8_t *image;
+    unsigned int i;
+    int fd, ret = 0;
+
+    fd = open(argv[2], O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) < 0 || st.st_size == 0) {
+        printf("Can't open %s\n", argv[2]);
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+    image = (uint8_t *)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (image == MAP_FAILED)
+        return -1;
+
+    if (fw_image_validate(image, st.st_size)) {
+        printf("%s is not a valid firmware image\n", argv[2]);
+        munmap(image, st.st_size);
+        return -1;
+    }
+    header = (const fw_image_header_t *)image;
+    sections = (const fw_image_section_t *)(image + header->section_offset);
+
+    if (argc >= 5) {
+        entry = fw_image_lookup(image, atoi(argv[3]));
+        if (entry == NULL) {
+            printf("codec %s is not in the image\n", argv[3]);
+            ret = -1;
+        } else {
+            printf("codec %d %s data_location 0x%08x\n", entry->codec, entry->name, entry->data_location);
+            if (fw_image_save(argv[4], "text", image, entry->text_section) ||
+                fw_image_save(argv[4], "data", image, entry->data_section))
+                ret = -1;
+        }
+        munmap(image, st.st_size);
+        return ret;
+    }
+
+    printf("image ver 0x%04x, %d entries, %d sections, %d bytes\n\n",
+           header->fw_ver, header->entry_count, header->section_count, header->image_size);
+    for (i = 0; i < header->entry_count; i++) {
+        entry = fw_image_lookup(image, i);
+        if (entry == NULL)
+            continue;
+        printf("codec %2d %-16s text #%-2d %6d bytes, data #%-2d %6d bytes, data_location 0x%08x\n",
+               i, entry->name, entry->text_section, sections[entry->text_section].size,
+               entry->data_section, sections[entry->data_section].size, entry->data_location);
+    }
+    printf("\n");
+    for (i = 0; i < header->section_count; i++) {
+        printf("section %2d: offset 0x%08x, %6d bytes stored as %6d%s\n", i,
+               sections[i].offset, sections[i].size, sections[i].stored_size,
+               (sections[i].flags & FW_IMAGE_SECTION_LZ) ? " (lz)" : "");
+    }
+
+    munmap(image, st.st_size);
+    return ret;
+}
+
+int main(int argc, char *argv[])
 {
     FILE *fp = NULL;
     topaz_fw_codec_t iter = FW_H264_NO_RC;
@@ -122,6 +233,8 @@ int main()
     fw_table_t topaz_fw_table[FW_NUM + 1];
     struct msvdx_fw fw;
 
+    if (argc >= 3 && strcmp(argv[1], "-i") == 0)
+        return fw_image_info(argc, argv);
 
     /* open file
      * RRRdetermine Android or Meego
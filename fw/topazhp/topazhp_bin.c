@@ -29,6 +29,9 @@
  */
 
 #include <stdio.h>
+#include <string.h>
+
+#include "../fw_image.h"
 
 #include "JPEGMasterFirmware_bin.h"
 
@@ -67,6 +70,7 @@
 #define FW_VER 0x5D
 #define FW_FILE_NAME_A0 "topazhp_fw.bin"
 #define FW_FILE_NAME_B0 "topazhp_fw_b0.bin"
+#define FW_IMAGE_FILE_NAME "topazhp_fw.idx"
 
 static const unsigned char pad_val = 0x0;
 
@@ -79,7 +83,8 @@ static const unsigned char pad_val = 0x0;
             ui32##prefix##_MasterMTXTOPAZFWDataSize,\
             ui32##prefix##_MasterMTXTOPAZFWDataOrigin\
           },\
-          aui32##prefix##_MasterMTXTOPAZFWText, aui32##prefix##_MasterMTXTOPAZFWData \
+          aui32##prefix##_MasterMTXTOPAZFWText, aui32##prefix##_MasterMTXTOPAZFWData, \
+          #codec \
         }
 
 #define FW_SLAVE_INFO(codec,prefix) \
@@ -90,7 +95,8 @@ static const unsigned char pad_val = 0x0;
             ui32##prefix##_SlaveMTXTOPAZFWDataSize,\
             ui32##prefix##_SlaveMTXTOPAZFWDataOrigin\
           },\
-          aui32##prefix##_SlaveMTXTOPAZFWText, aui32##prefix##_SlaveMTXTOPAZFWData \
+          aui32##prefix##_SlaveMTXTOPAZFWText, aui32##prefix##_SlaveMTXTOPAZFWData, \
+          "S " #codec \
         }
 
 struct topaz_fw_info_item_s {
@@ -136,6 +142,7 @@ struct fw_table_s {
     topaz_fw_info_item_t header;
     unsigned int *fw_text;
     unsigned int *fw_data;
+    const char *name;
 };
 
 typedef struct fw_table_s fw_table_t;
@@ -302,10 +309,37 @@ static void create_firmware_B0(fw_table_t *tng_fw_table, FILE *fp)
     return ;
 }
 
+/* Indexed image of the same firmware, sections compressed with -z */
+static int create_firmware_image(fw_table_t *tng_fw_table, int compress)
+{
+    fw_image_input_t input[FW_NUM];
+    FILE *fp;
+    int i, ret;
+
+    for (i = 0; i < FW_NUM; i++) {
+        input[i].name = tng_fw_table[i].name;
+        input[i].codec = tng_fw_table[i].index;
+        input[i].text = tng_fw_table[i].fw_text;
+        input[i].text_size = tng_fw_table[i].header.text_size * 4;
+        input[i].data = tng_fw_table[i].fw_data;
+        input[i].data_size = tng_fw_table[i].header.data_size * 4;
+        input[i].data_location = tng_fw_table[i].header.data_location;
+    }
+
+    fp = fopen(FW_IMAGE_FILE_NAME, "w");
+    if (NULL == fp)
+        return -1;
+
+    ret = fw_image_write(fp, FW_VER, input, FW_NUM, compress);
+    fclose(fp);
+
+    return ret;
+}
 
-int main()
+int main(int argc, char *argv[])
 {
     FILE *fp = NULL;
+    int compress = (argc > 1 && strcmp(argv[1], "-z") == 0);
 
     fw_table_t topaz_fw_table[] = {
         FW_MASTER_INFO(JPEG, JPEG),	//FW_MASTER_JPEG = 0,                         //!< JPEG
@@ -365,5 +399,5 @@ int main()
     /* close file */
     fclose(fp);
 
-    return 0;
+    return create_firmware_image(topaz_fw_table, compress);
 }
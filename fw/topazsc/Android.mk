@@ -50,7 +50,7 @@ include $(BUILD_EXECUTABLE)
 # =====================================================
 include $(CLEAR_VARS)
 
-LOCAL_SRC_FILES := fwinfo.c
+LOCAL_SRC_FILES := fwinfo.c ../fw_image.c
 LOCAL_CFLAGS := -Wall -Werror
 LOCAL_MODULE_TAGS := optional
 LOCAL_MODULE := imginfo
@@ -62,6 +62,7 @@ include $(BUILD_EXECUTABLE)
 include $(CLEAR_VARS)
 
 LOCAL_SRC_FILES := topazsc_bin.c \
+    ../fw_image.c \
     H263MasterFirmware_bin.c \
     H263MasterFirmwareCBR_bin.c \
     H263MasterFirmwareVBR_bin.c \
@@ -28,6 +28,9 @@
  */
 
 #include <stdio.h>
+#include <string.h>
+
+#include "../fw_image.h"
 
 #include "JPEGMasterFirmware_bin.h"
 #include "JPEGSlaveFirmware_bin.h"
@@ -57,6 +60,7 @@
 
 #define FW_VER 0x60
 #define FW_FILE_NAME "topazsc_fw.bin"
+#define FW_IMAGE_FILE_NAME "topazsc_fw.idx"
 
 #define FW_MASTER_INFO(codec,prefix) \
         { FW_MASTER_##codec,\
@@ -66,7 +70,8 @@
             ui32##prefix##_MasterMTXTOPAZFWDataSize,\
             ui32##prefix##_MasterMTXTOPAZFWDataOrigin\
           },\
-          aui32##prefix##_MasterMTXTOPAZFWText, aui32##prefix##_MasterMTXTOPAZFWData \
+          aui32##prefix##_MasterMTXTOPAZFWText, aui32##prefix##_MasterMTXTOPAZFWData, \
+          "M " #codec \
         }
 
 #define FW_SLAVE_INFO(codec,prefix) \
@@ -77,7 +82,8 @@
             ui32##prefix##_SlaveMTXTOPAZFWDataSize,\
             ui32##prefix##_SlaveMTXTOPAZFWDataOrigin\
           },\
-          aui32##prefix##_SlaveMTXTOPAZFWText, aui32##prefix##_SlaveMTXTOPAZFWData \
+          aui32##prefix##_SlaveMTXTOPAZFWText, aui32##prefix##_SlaveMTXTOPAZFWData, \
+          "S " #codec \
         }
 
 
@@ -124,14 +130,43 @@ struct fw_table_s {
     topaz_fw_info_item_t header;
     unsigned int *fw_text;
     unsigned int *fw_data;
+    const char *name;
 };
 typedef struct fw_table_s fw_table_t;
 
-int main()
+/* Also write the indexed image, sections compressed with -z */
+static int create_firmware_image(fw_table_t *topaz_fw_table, int compress)
+{
+    fw_image_input_t input[FW_NUM];
+    FILE *fp;
+    int i, ret;
+
+    for (i = 0; i < FW_NUM; i++) {
+        input[i].name = topaz_fw_table[i].name;
+        input[i].codec = topaz_fw_table[i].index;
+        input[i].text = topaz_fw_table[i].fw_text;
+        input[i].text_size = topaz_fw_table[i].header.text_size;   /* already in bytes */
+        input[i].data = topaz_fw_table[i].fw_data;
+        input[i].data_size = topaz_fw_table[i].header.data_size;
+        input[i].data_location = topaz_fw_table[i].header.data_location;
+    }
+
+    fp = fopen(FW_IMAGE_FILE_NAME, "w");
+    if (NULL == fp)
+        return -1;
+
+    ret = fw_image_write(fp, FW_VER, input, FW_NUM, compress);
+    fclose(fp);
+
+    return ret;
+}
+
+int main(int argc, char *argv[])
 {
     FILE *fp = NULL;
     topaz_fw_codec_t iter = FW_MASTER_JPEG;
     unsigned int size = 0;
+    int compress = (argc > 1 && strcmp(argv[1], "-z") == 0);
 
     fw_table_t topaz_fw_table[] = {
         /* index   header
@@ -194,5 +229,5 @@ int main()
     /* close file */
     fclose(fp);
 
-    return 0;
+    return create_firmware_image(topaz_fw_table, compress);
 }
@@ -41,7 +41,7 @@ LOCAL_CLANG_CFLAGS += \
 
 LOCAL_CFLAGS := \
     -DLINUX -DANDROID -g -Wall -Wno-unused \
-    -DPSBVIDEO_LOG_ENABLE -DPSBVIDEO_VXD392 \
+    -DPSBVIDEO_LOG_ENABLE -DPSBVIDEO_TRACE_RING -DPSBVIDEO_VXD392 \
     -DPSBVIDEO_MSVDX_DEC_TILING -DPSBVIDEO_MSVDX_EC
 
 LOCAL_C_INCLUDES := \
@@ -68,8 +68,14 @@ LOCAL_SRC_FILES := \
     psb_cmdbuf.c \
     psb_drv_video.c \
     psb_drv_debug.c \
+    psb_stats.c \
+    psb_trace_ring.c \
+    psb_record.c \
     psb_surface_attrib.c \
     psb_output.c \
+    psb_unpack.c \
+    psb_image_convert.c \
+    psb_vlc_cache.c \
     android/psb_output_android.c \
     android/psb_android_glue.cpp \
     android/psb_surface_gralloc.c \
@@ -99,6 +105,7 @@ LOCAL_SRC_FILES += \
     pnw_hostjpeg.c \
     pnw_jpeg.c \
     tng_ved_scaling.c \
+    tng_scaler_coeff.c \
     tng_cmdbuf.c \
     tng_hostheader.c \
     tng_hostcode.c \
@@ -178,4 +185,12 @@ LOCAL_MODULE := pvr_drv_video
 
 include $(BUILD_SHARED_LIBRARY)
 
+# trace ring decoder, see psb_trace_ring.h
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := tools/psb_trace_dump.c
+LOCAL_CFLAGS := -Wall -Werror
+LOCAL_MODULE_TAGS := optional
+LOCAL_MODULE := psb_trace_dump
+include $(BUILD_HOST_EXECUTABLE)
+
 endif # ($(ENABLE_IMG_GRAPHICS),true)
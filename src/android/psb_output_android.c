@@ -200,6 +200,7 @@ VAStatus psb_putsurface_coverlay(
     unsigned int flags /* de-interlacing flags */
 )
 {
+    INIT_DRIVER_DATA;
     INIT_OUTPUT_PRIV;
     VAStatus vaStatus = VA_STATUS_SUCCESS;
 
@@ -229,10 +230,12 @@ VAStatus psb_putsurface_coverlay(
     drv_debug_msg(VIDEO_DEBUG_GENERAL, "psb_putsurface_overlay: src (%d, %d, %d, %d), destx (%d, %d, %d, %d).\n",
                              srcx, srcy, srcw, srch, destx, desty, destw, desth);
     /* display by overlay */
+    pthread_mutex_lock(&driver_data->output_mutex);
     vaStatus = psb_putsurface_overlay(
                    ctx, surface, srcx, srcy, srcw, srch,
                    destx, desty, destw, desth, /* screen coordinate */
                    flags, OVERLAY_A, PIPEA);
+    pthread_mutex_unlock(&driver_data->output_mutex);
 
     return vaStatus;
 }
@@ -530,10 +533,12 @@ VAStatus psb_PutSurface(
 
     drv_debug_msg(VIDEO_DEBUG_GENERAL, "Overlay position = (%d,%d,%d,%d)\n", output->destx, output->desty, output->destw, output->desth);
     srcw = srcw <= 2047? srcw : 2047;
+    pthread_mutex_lock(&driver_data->output_mutex);
     vaStatus = psb_putsurface_overlay(ctx, surface,
                                       srcx, srcy, srcw, srch,
                                       output->destx, output->desty, output->destw, output->desth,
                                       flags, OVERLAY_A, PIPEA);
+    pthread_mutex_unlock(&driver_data->output_mutex);
 
     driver_data->frame_count++;
 #endif
@@ -134,6 +134,10 @@ struct context_MPEG2MC_s {
     uint32_t blk_size;/* buffer elements size */
 
     uint32_t fstmb_slice;
+
+    /* Per picture counters, MB rows emitted vs cmdbufs submitted */
+    uint32_t pic_slices;
+    uint32_t pic_flushes;
 };
 
 typedef struct context_MPEG2MC_s *context_MPEG2MC_p;
@@ -581,6 +585,33 @@ static void psb__MPEG2MC_check_segment_residDMA(
 }
 
 
+/*
+ * Called after each MB row has been queued. Rows are batched into the
+ * current cmdbuf and only flushed when another row of the same size may
+ * not fit; the residual DMA offset keeps running across the batched rows.
+ */
+static void psb__MPEG2MC_check_cmdbuf_space(
+    context_MPEG2MC_p   const   ctx,
+    uint32_t slice_size
+)
+{
+    psb_cmdbuf_p cmdbuf = ctx->obj_context->cmdbuf;
+
+    ctx->pic_slices++;
+
+    if (NULL == cmdbuf) {
+        /* psb_context_submit_cmdbuf already flushed on a full region */
+        ctx->pic_flushes++;
+        return;
+    }
+
+    if ((uint32_t)(cmdbuf->lldma_base - (unsigned char *) cmdbuf->cmd_idx) < slice_size) {
+        psb_context_flush_cmdbuf(ctx->obj_context);
+        ctx->pic_flushes++;
+    }
+}
+
+
 /* Send residual difference data to MSVDX. */
 static void     psb__MPEG2MC_send_residual(
     context_MPEG2MC_p   ctx,
@@ -862,6 +893,7 @@ static VAStatus psb__MPEG2MC_process_mbs_interPB(
         uint32_t mb_in_buffer = (ctx->picture_width_mb);
         psb_cmdbuf_p cmdbuf;
         unsigned char *cmd_start;
+        uint32_t slice_size;
 
         ctx->fstmb_slice = IMG_TRUE;
 
@@ -922,11 +954,11 @@ static VAStatus psb__MPEG2MC_process_mbs_interPB(
         ctx->obj_context->flags = (mb_pending == 0) && (skip_count == 0) && (ctx->size_mb == mb_last) ? FW_VA_RENDER_IS_LAST_SLICE : 0;
         ctx->obj_context->first_mb = 0;
         ctx->obj_context->last_mb = 0;
+        slice_size = (unsigned char *) cmdbuf->cmd_idx - cmd_start;
         psb_context_submit_cmdbuf(ctx->obj_context);
 
         /* check if the remained cmdbuf size can fill the commands of next slice */
-        if (1 || (cmdbuf->lldma_base - (unsigned char *) cmdbuf->cmd_idx) < ((unsigned char *) cmdbuf->cmd_idx - cmd_start))
-            psb_context_flush_cmdbuf(ctx->obj_context);
+        psb__MPEG2MC_check_cmdbuf_space(ctx, slice_size);
     }
 
     return VA_STATUS_SUCCESS;
@@ -1058,6 +1090,7 @@ static VAStatus psb__MPEG2MC_process_mbs_intra(
         uint32_t mb_in_buffer =  min(mb_pending, ctx->picture_width_mb);
         psb_cmdbuf_p cmdbuf;
         unsigned char *cmd_start;
+        uint32_t slice_size;
 
         mb_pending -= mb_in_buffer;
 
@@ -1101,11 +1134,11 @@ static VAStatus psb__MPEG2MC_process_mbs_intra(
         ctx->obj_context->flags = (mb_pending == 0) && (ctx->size_mb == mb_last) ? FW_VA_RENDER_IS_LAST_SLICE : 0;
         ctx->obj_context->first_mb = 0;
         ctx->obj_context->last_mb = 0;
+        slice_size = (unsigned char *) cmdbuf->cmd_idx - cmd_start;
         psb_context_submit_cmdbuf(ctx->obj_context);
 
         /* check if the remained cmdbuf size can fill the commands of next slice */
-        if (1 || (cmdbuf->lldma_base - (unsigned char *) cmdbuf->cmd_idx) < ((unsigned char *) cmdbuf->cmd_idx - cmd_start))
-            psb_context_flush_cmdbuf(ctx->obj_context);
+        psb__MPEG2MC_check_cmdbuf_space(ctx, slice_size);
     }
 
     //ASSERT(ctx->residual_bytes == 0); /* There should be no more data left */
@@ -1378,6 +1411,9 @@ out:
         ctx->pic_params = NULL;
     }
 
+    ctx->pic_slices = 0;
+    ctx->pic_flushes = 0;
+
     /* TODO: others */
     return VA_STATUS_SUCCESS;
 }
@@ -1451,10 +1487,16 @@ static VAStatus psb_MPEG2MC_EndPicture(
 
     drv_debug_msg(VIDEO_DEBUG_GENERAL, "psb_MPEG2MC_EndPicture\n");
 
+    if (ctx->obj_context->cmdbuf)
+        ctx->pic_flushes++;
+
     if (psb_context_flush_cmdbuf(ctx->obj_context)) {
         vaStatus = VA_STATUS_ERROR_UNKNOWN;
     }
 
+    drv_debug_msg(VIDEO_DEBUG_GENERAL, "psb_MPEG2MC_EndPicture: %d MB rows in %d cmdbuf submissions\n",
+                  ctx->pic_slices, ctx->pic_flushes);
+
     return vaStatus;
 }
 
@@ -33,6 +33,7 @@
 #include "psb_surface.h"
 #include "psb_cmdbuf.h"
 #include "psb_drv_debug.h"
+#include "psb_vlc_cache.h"
 
 #include "vc1_header.h"
 #include "vc1_defs.h"
@@ -358,6 +359,11 @@ static void psb__VC1_pack_index_table_info(uint32_t *packed_index_table,
     }
 }
 
+static void psb__VC1_fill_vlc_table(unsigned char *dst, unsigned int __maybe_unused size)
+{
+    psb__VC1_pack_vlc_tables((unsigned short *)dst, gaui16vc1VlcTableData, gui16vc1VlcTableSize);
+}
+
 static VAStatus psb__VC1_check_legal_picture(object_context_p obj_context, object_config_p obj_config)
 {
     VAStatus vaStatus = VA_STATUS_SUCCESS;
@@ -494,23 +500,17 @@ static VAStatus psb_VC1_CreateContext(
     }
 
     if (vaStatus == VA_STATUS_SUCCESS) {
-        vaStatus = psb_buffer_create(obj_context->driver_data,
-                                     gui16vc1VlcTableSize * sizeof(IMG_UINT16),
-                                     psb_bt_cpu_vpu,
-                                     &ctx->vlc_packed_table);
-        DEBUG_FAILURE;
-    }
-    if (vaStatus == VA_STATUS_SUCCESS) {
-        void *vlc_packed_data_address;
-        if (0 ==  psb_buffer_map(&ctx->vlc_packed_table, (unsigned char **)&vlc_packed_data_address)) {
-            psb__VC1_pack_vlc_tables((unsigned short *)vlc_packed_data_address, gaui16vc1VlcTableData, gui16vc1VlcTableSize);
-            psb_buffer_unmap(&ctx->vlc_packed_table);
-            psb__VC1_pack_index_table_info(ctx->vlc_packed_index_table, gaui16vc1VlcIndexData);
-        } else {
+        ctx->vlc_packed_table = psb_vlc_table_get(obj_context->driver_data, PSB_VLC_TABLE_VC1,
+                                                  gui16vc1VlcTableSize * sizeof(IMG_UINT16),
+                                                  NULL, psb__VC1_fill_vlc_table);
+        if (NULL == ctx->vlc_packed_table) {
             vaStatus = VA_STATUS_ERROR_ALLOCATION_FAILED;
             DEBUG_FAILURE;
         }
     }
+    if (vaStatus == VA_STATUS_SUCCESS) {
+        psb__VC1_pack_index_table_info(ctx->vlc_packed_index_table, gaui16vc1VlcIndexData);
+    }
 
     if (vaStatus != VA_STATUS_SUCCESS) {
         psb_VC1_DestroyContext(obj_context);
@@ -525,7 +525,10 @@ static void psb_VC1_DestroyContext(
     INIT_CONTEXT_VC1
     int i;
 
-    psb_buffer_destroy(&ctx->vlc_packed_table);
+    if (ctx->vlc_packed_table) {
+        psb_vlc_table_put(obj_context->driver_data, PSB_VLC_TABLE_VC1, ctx->vlc_packed_table);
+        ctx->vlc_packed_table = NULL;
+    }
     psb_buffer_destroy(&ctx->aux_msb_buffer);
     psb_buffer_destroy(&ctx->preload_buffer);
 
@@ -1711,7 +1714,7 @@ static void psb__VC1_build_VLC_tables(context_VC1_p ctx)
         /* VLC Table */
         /* Write a LLDMA Cmd to transfer VLD Table data */
 
-        psb_cmdbuf_lldma_write_cmdbuf(cmdbuf, &ctx->vlc_packed_table,
+        psb_cmdbuf_lldma_write_cmdbuf(cmdbuf, ctx->vlc_packed_table,
                                       ctx->sTableInfo[i].aui16StartLocation * sizeof(IMG_UINT16), /* origin */
                                       ctx->sTableInfo[i].aui16VLCTableLength * sizeof(IMG_UINT16), /* size */
                                       RAM_location * sizeof(IMG_UINT32), /* destination */
@@ -2574,7 +2577,7 @@ static VAStatus psb__VC1_process_slice(context_VC1_p ctx,
         if (psb_video_trace_fp && (psb_video_trace_level & AUXBUF_TRACE)) {
             psb__debug_schedule_hexdump("Preload buffer", &ctx->preload_buffer, 0, PRELOAD_BUFFER_SIZE);
             psb__debug_schedule_hexdump("AUXMSB buffer", &ctx->aux_msb_buffer, 0, 0x8000 /* AUXMSB_BUFFER_SIZE */);
-            psb__debug_schedule_hexdump("VLC Table", &ctx->vlc_packed_table, 0, gui16vc1VlcTableSize * sizeof(IMG_UINT16));
+            psb__debug_schedule_hexdump("VLC Table", ctx->vlc_packed_table, 0, gui16vc1VlcTableSize * sizeof(IMG_UINT16));
         }
 
         if (psb_context_submit_cmdbuf(ctx->obj_context)) {
@@ -159,38 +159,95 @@ static  uint32_t        ColBlockMap[] = {
     2, 3, 0, 1
 };
 
-void
-h264_above1InterBlockSequence(psb_cmdbuf_p cmdbuf, uint8_t* MbData)
+#define H264_BLOCKSIZE_CLAMP(x) (((x) > H264_BLOCKSIZE_4X4) ? H264_BLOCKSIZE_4X4 : (x))
+
+/* Source of a 4x4 sub-block motion vector: COMP_?_COL entry or, with this flag, COMP_?_ABOVE entry */
+#define H264_MV_SRC_ABOVE       0x10
+
+/*
+ * Command words that only depend on the MB or block type. They are built
+ * once per second pass and the per-MB fields are OR'ed in while emitting.
+ */
+typedef struct {
+    uint32_t    MbNumberCmd[4];         /* MB_CODE_TYPE, indexed by MBTYPE */
+    uint32_t    IntraCmdY[2];           /* indexed by bMbIsIPCM */
+    uint32_t    IntraCmdC[2];
+    uint32_t    Above1IntraCmdY[2];
+    uint32_t    InterBlockCmd[H264_BLOCKSIZE_4X4 + 1];  /* block size + REF_INDEX_A_VALID */
+    uint8_t     CurrentMvSrc[16];       /* inverse of CurrentAboveTileMap/CurrentColTileMap */
+    uint8_t     Above1MvSrc[16];        /* inverse of Above1AboveTileMap */
+} h264_sCmdTemplates;
+
+static void
+h264_initCmdTemplates(h264_sCmdTemplates *Templates)
+{
+    uint32_t    i, bMbIsIPCM;
+
+    memset(Templates, 0, sizeof(*Templates));
+
+    for (i = 0; i < 4; i++) {
+        /* IPCM is sent as I */
+        REGIO_WRITE_FIELD(Templates->MbNumberCmd[i], MSVDX_CMDS, MACROBLOCK_NUMBER, MB_CODE_TYPE, (3 == i) ? 0 : i);
+    }
+
+    for (bMbIsIPCM = 0; bMbIsIPCM < 2; bMbIsIPCM++) {
+        /* I_PCM or I_16x16 for luma, I_PCM or I_8x8 for chroma */
+        REGIO_WRITE_FIELD(Templates->IntraCmdY[bMbIsIPCM], MSVDX_CMDS, INTRA_BLOCK_PREDICTION,
+                          INTRA_PRED_BLOCK_SIZE, bMbIsIPCM ? 3 : 0);
+        REGIO_WRITE_FIELD(Templates->IntraCmdC[bMbIsIPCM], MSVDX_CMDS, INTRA_BLOCK_PREDICTION,
+                          INTRA_PRED_BLOCK_SIZE, bMbIsIPCM ? 3 : 1);
+        REGIO_WRITE_FIELD(Templates->Above1IntraCmdY[bMbIsIPCM], MSVDX_CMDS, INTRA_BLOCK_PREDICTION_ABOVE1,
+                          INTRA_PRED_BLOCK_SIZE_ABOVE1, bMbIsIPCM ? 3 : 0);
+    }
+
+    for (i = 0; i <= H264_BLOCKSIZE_4X4; i++) {
+        REGIO_WRITE_FIELD(Templates->InterBlockCmd[i], MSVDX_CMDS, INTER_BLOCK_PREDICTION, INTER_PRED_BLOCK_SIZE, i);
+        REGIO_WRITE_FIELD(Templates->InterBlockCmd[i], MSVDX_CMDS, INTER_BLOCK_PREDICTION, REF_INDEX_A_VALID, 1);
+    }
+
+    /* so that only the motion vectors actually sent get unpacked */
+    for (i = 0; i < 14; i++)
+        Templates->CurrentMvSrc[CurrentColTileMap[i]] = i;
+    for (i = 1; i < 3; i++)
+        Templates->CurrentMvSrc[CurrentAboveTileMap[i]] = H264_MV_SRC_ABOVE | i;
+    for (i = 0; i < 4; i++)
+        Templates->Above1MvSrc[Above1AboveTileMap[i]] = H264_MV_SRC_ABOVE | i;
+}
+
+static uint32_t
+h264_getMotionVectorCmd(uint8_t * MbData, uint32_t Src)
+{
+    uint32_t    Value, Cmd = 0;
+    uint32_t    i = Src & ~H264_MV_SRC_ABOVE;
+
+    if (Src & H264_MV_SRC_ABOVE) {
+        Value = MEMIO_READ_TABLE_FIELD(MbData, MSVDX_VEC_ENTDEC_VLRIF_H264_MB_UNIT_COMP_X_ABOVE, i);
+        REGIO_WRITE_FIELD(Cmd, MSVDX_CMDS, MOTION_VECTOR, MV_X, Value);
+        Value = MEMIO_READ_TABLE_FIELD(MbData, MSVDX_VEC_ENTDEC_VLRIF_H264_MB_UNIT_COMP_Y_ABOVE, i);
+        REGIO_WRITE_FIELD(Cmd, MSVDX_CMDS, MOTION_VECTOR, MV_Y, Value);
+    } else {
+        Value = MEMIO_READ_TABLE_FIELD(MbData, MSVDX_VEC_ENTDEC_VLRIF_H264_MB_UNIT_COMP_X_COL, i);
+        REGIO_WRITE_FIELD(Cmd, MSVDX_CMDS, MOTION_VECTOR, MV_X, Value);
+        Value = MEMIO_READ_TABLE_FIELD(MbData, MSVDX_VEC_ENTDEC_VLRIF_H264_MB_UNIT_COMP_Y_COL, i);
+        REGIO_WRITE_FIELD(Cmd, MSVDX_CMDS, MOTION_VECTOR, MV_Y, Value);
+    }
+    return Cmd;
+}
+
+static void
+h264_above1InterBlockSequence(psb_cmdbuf_p cmdbuf, const h264_sCmdTemplates *Templates, uint8_t* MbData)
 {
     uint32_t    i, BlockNum, Mv, MvAddr, Value;
     uint32_t    Block8x8, blockType;
     uint32_t    InterBlockCmd;
-    uint32_t    MotionVecCmd[16];
     uint32_t    BlockType[4] = {0};
     uint32_t    DpbIdx[4];
 
-    /* set MV vars to 0 */
-    for (i = 0; i < 16; i++) {
-        MotionVecCmd[i] = 0;
-    }
-
     /* Read the size of blocks 2 and 3 and resize them so they are all ?x8 */
     Value = MEMIO_READ_FIELD(MbData, MSVDX_VEC_ENTDEC_VLRIF_H264_MB_UNIT_ASO_BLOCK2_PREDICTION_SIZE);
-    if (Value > (sizeof(BlockDownsizeMap) / sizeof(uint32_t) - 1))
-        Value = sizeof(BlockDownsizeMap) / sizeof(uint32_t) - 1;
-    BlockType[2] = BlockDownsizeMap[Value];
+    BlockType[2] = BlockDownsizeMap[H264_BLOCKSIZE_CLAMP(Value)];
     Value = MEMIO_READ_FIELD(MbData, MSVDX_VEC_ENTDEC_VLRIF_H264_MB_UNIT_ASO_BLOCK3_PREDICTION_SIZE);
-    if (Value > (sizeof(BlockDownsizeMap) / sizeof(uint32_t) - 1))
-        Value = sizeof(BlockDownsizeMap) / sizeof(uint32_t) - 1;
-    BlockType[3] = BlockDownsizeMap[Value];
-
-    /* read motion vectors for the bottom row, but store them in the correct locn. for ?x8 blocks */
-    for (i = 0; i < 4; i++) {
-        Value = MEMIO_READ_TABLE_FIELD(MbData, MSVDX_VEC_ENTDEC_VLRIF_H264_MB_UNIT_COMP_X_ABOVE, i);
-        REGIO_WRITE_FIELD(MotionVecCmd[Above1AboveTileMap[i]], MSVDX_CMDS, MOTION_VECTOR, MV_X, Value);
-        Value = MEMIO_READ_TABLE_FIELD(MbData, MSVDX_VEC_ENTDEC_VLRIF_H264_MB_UNIT_COMP_Y_ABOVE, i);
-        REGIO_WRITE_FIELD(MotionVecCmd[Above1AboveTileMap[i]], MSVDX_CMDS, MOTION_VECTOR, MV_Y, Value);
-    }
+    BlockType[3] = BlockDownsizeMap[H264_BLOCKSIZE_CLAMP(Value)];
 
     /* read DPB index for blocks 2 and 3 */
     for (i = 0; i < 2; i++) {
@@ -206,9 +263,7 @@ h264_above1InterBlockSequence(psb_cmdbuf_p cmdbuf, uint8_t* MbData)
         /* block type */
         blockType = BlockType[Block8x8];
 
-        InterBlockCmd = 0;
-        REGIO_WRITE_FIELD(InterBlockCmd, MSVDX_CMDS, INTER_BLOCK_PREDICTION, INTER_PRED_BLOCK_SIZE, blockType);
-        REGIO_WRITE_FIELD(InterBlockCmd, MSVDX_CMDS, INTER_BLOCK_PREDICTION, REF_INDEX_A_VALID, 1);
+        InterBlockCmd = Templates->InterBlockCmd[blockType];
         REGIO_WRITE_FIELD(InterBlockCmd, MSVDX_CMDS, INTER_BLOCK_PREDICTION, REF_INDEX_A, DpbIdx[Block8x8]);
 
         /* send commands */
@@ -219,45 +274,31 @@ h264_above1InterBlockSequence(psb_cmdbuf_p cmdbuf, uint8_t* MbData)
             /* only send forward MVs in baseline */
             MvAddr = (2 * 4 * Block8x8) + VectorOffsetMap[blockType][i];
             Mv = (4 * Block8x8) + VectorOffsetMap[blockType][i];
-            psb_deblock_reg_table_set(MSVDX_CMDS, MOTION_VECTOR_ABOVE1, MvAddr, MotionVecCmd[Mv]);
+            /* motion vectors of the bottom row, in the correct locn. for ?x8 blocks */
+            Value = h264_getMotionVectorCmd(MbData, Templates->Above1MvSrc[Mv]);
+            psb_deblock_reg_table_set(MSVDX_CMDS, MOTION_VECTOR_ABOVE1, MvAddr, Value);
         }
     }
 }
 
-void
-h264_currentInterBlockSequence(psb_cmdbuf_p cmdbuf, uint8_t * MbData)
+static void
+h264_currentInterBlockSequence(psb_cmdbuf_p cmdbuf, const h264_sCmdTemplates *Templates, uint8_t * MbData)
 {
     uint32_t    i, BlockNum, Mv, MvAddr, Value;
     uint32_t    Block8x8, blockType;
     uint32_t    InterBlockCmd;
-    uint32_t    MotionVecCmd[16];
     uint32_t    BlockType[4];
     uint32_t    DpbIdx[4];
 
-    /* set MV vars to 0 */
-    for (i = 0; i < 16; i++) {
-        MotionVecCmd[i] = 0;
-    }
-
     /* read block size */
-    BlockType[0] = MEMIO_READ_FIELD(MbData, MSVDX_VEC_ENTDEC_VLRIF_H264_MB_UNIT_ASO_BLOCK0_PREDICTION_SIZE);
-    BlockType[1] = MEMIO_READ_FIELD(MbData, MSVDX_VEC_ENTDEC_VLRIF_H264_MB_UNIT_ASO_BLOCK1_PREDICTION_SIZE);
-    BlockType[2] = MEMIO_READ_FIELD(MbData, MSVDX_VEC_ENTDEC_VLRIF_H264_MB_UNIT_ASO_BLOCK2_PREDICTION_SIZE);
-    BlockType[3] = MEMIO_READ_FIELD(MbData, MSVDX_VEC_ENTDEC_VLRIF_H264_MB_UNIT_ASO_BLOCK3_PREDICTION_SIZE);
-
-    /* read motion vectors in all 16 4x4 sub-blocks*/
-    for (i = 1; i < 3; i++) {   /* get blocks 11 and 14 */
-        Value = MEMIO_READ_TABLE_FIELD(MbData, MSVDX_VEC_ENTDEC_VLRIF_H264_MB_UNIT_COMP_X_ABOVE, i);
-        REGIO_WRITE_FIELD(MotionVecCmd[CurrentAboveTileMap[i]], MSVDX_CMDS, MOTION_VECTOR, MV_X, Value);
-        Value = MEMIO_READ_TABLE_FIELD(MbData, MSVDX_VEC_ENTDEC_VLRIF_H264_MB_UNIT_COMP_Y_ABOVE, i);
-        REGIO_WRITE_FIELD(MotionVecCmd[CurrentAboveTileMap[i]], MSVDX_CMDS, MOTION_VECTOR, MV_Y, Value);
-    }
-    for (i = 0; i < 14; i++) {
-        Value = MEMIO_READ_TABLE_FIELD(MbData, MSVDX_VEC_ENTDEC_VLRIF_H264_MB_UNIT_COMP_X_COL, i);
-        REGIO_WRITE_FIELD(MotionVecCmd[CurrentColTileMap[i]], MSVDX_CMDS, MOTION_VECTOR, MV_X, Value);
-        Value = MEMIO_READ_TABLE_FIELD(MbData, MSVDX_VEC_ENTDEC_VLRIF_H264_MB_UNIT_COMP_Y_COL, i);
-        REGIO_WRITE_FIELD(MotionVecCmd[CurrentColTileMap[i]], MSVDX_CMDS, MOTION_VECTOR, MV_Y, Value);
-    }
+    Value = MEMIO_READ_FIELD(MbData, MSVDX_VEC_ENTDEC_VLRIF_H264_MB_UNIT_ASO_BLOCK0_PREDICTION_SIZE);
+    BlockType[0] = H264_BLOCKSIZE_CLAMP(Value);
+    Value = MEMIO_READ_FIELD(MbData, MSVDX_VEC_ENTDEC_VLRIF_H264_MB_UNIT_ASO_BLOCK1_PREDICTION_SIZE);
+    BlockType[1] = H264_BLOCKSIZE_CLAMP(Value);
+    Value = MEMIO_READ_FIELD(MbData, MSVDX_VEC_ENTDEC_VLRIF_H264_MB_UNIT_ASO_BLOCK2_PREDICTION_SIZE);
+    BlockType[2] = H264_BLOCKSIZE_CLAMP(Value);
+    Value = MEMIO_READ_FIELD(MbData, MSVDX_VEC_ENTDEC_VLRIF_H264_MB_UNIT_ASO_BLOCK3_PREDICTION_SIZE);
+    BlockType[3] = H264_BLOCKSIZE_CLAMP(Value);
 
     /* read DPB index for all 4 blocks */
     for (i = 0; i < 4; i++) {
@@ -273,9 +314,7 @@ h264_currentInterBlockSequence(psb_cmdbuf_p cmdbuf, uint8_t * MbData)
         /* block type */
         blockType = BlockType[Block8x8];
 
-        InterBlockCmd = 0;
-        REGIO_WRITE_FIELD(InterBlockCmd, MSVDX_CMDS, INTER_BLOCK_PREDICTION, INTER_PRED_BLOCK_SIZE, blockType);
-        REGIO_WRITE_FIELD(InterBlockCmd, MSVDX_CMDS, INTER_BLOCK_PREDICTION, REF_INDEX_A_VALID, 1);
+        InterBlockCmd = Templates->InterBlockCmd[blockType];
         REGIO_WRITE_FIELD(InterBlockCmd, MSVDX_CMDS, INTER_BLOCK_PREDICTION, REF_INDEX_A, DpbIdx[Block8x8]);
 
         /* send commands */
@@ -286,62 +325,16 @@ h264_currentInterBlockSequence(psb_cmdbuf_p cmdbuf, uint8_t * MbData)
             /* only send forward MVs in baseline */
             MvAddr = (2 * 4 * Block8x8) + VectorOffsetMap[blockType][i];
             Mv = (4 * Block8x8) + VectorOffsetMap[blockType][i];
-            psb_deblock_reg_table_set(MSVDX_CMDS, MOTION_VECTOR, MvAddr, MotionVecCmd[Mv]);
+            /* blocks 11 and 14 come from the above MVs, all others from the colocated ones */
+            Value = h264_getMotionVectorCmd(MbData, Templates->CurrentMvSrc[Mv]);
+            psb_deblock_reg_table_set(MSVDX_CMDS, MOTION_VECTOR, MvAddr, Value);
         }
     }
 }
 
-void
-h264_currentIntraBlockPrediction(psb_cmdbuf_p cmdbuf, uint8_t * MbData, int bMbIsIPCM)
-{
-    uint32_t    BlockSizeY, BlockSizeC;
-    uint32_t    IntraCmdY, IntraCmdC;
-
-    /* select block size I_PCM or I_16x16 */
-    BlockSizeY = (1 == bMbIsIPCM) ? 3 : 0;
-    /* select block size I_PCM or I_8x8 */
-    BlockSizeC = (1 == bMbIsIPCM) ? 3 : 1;
-
-    IntraCmdY = IntraCmdC = 0;
-
-    REGIO_WRITE_FIELD(
-        IntraCmdY,
-        MSVDX_CMDS, INTRA_BLOCK_PREDICTION,
-        INTRA_PRED_BLOCK_SIZE,
-        BlockSizeY);
-    REGIO_WRITE_FIELD(
-        IntraCmdC,
-        MSVDX_CMDS, INTRA_BLOCK_PREDICTION,
-        INTRA_PRED_BLOCK_SIZE,
-        BlockSizeC);
-
-    h264_pollForSpaceForNCommands(2);
-    psb_deblock_reg_table_set(MSVDX_CMDS, INTRA_BLOCK_PREDICTION, 0, IntraCmdY);
-    psb_deblock_reg_table_set(MSVDX_CMDS, INTRA_BLOCK_PREDICTION, 4, IntraCmdC);
-}
-
-void
-h264_above1IntraBlockPrediction(psb_cmdbuf_p cmdbuf, uint8_t * MbData, int bMbIsIPCM)
-{
-    uint32_t    BlockSizeY;
-    uint32_t    IntraCmdY;
-
-    /* select block size I_PCM or I_16x16 */
-    BlockSizeY = (1 == bMbIsIPCM) ? 3 : 0;
-    IntraCmdY = 0;
-
-    REGIO_WRITE_FIELD(
-        IntraCmdY,
-        MSVDX_CMDS, INTRA_BLOCK_PREDICTION_ABOVE1,
-        INTRA_PRED_BLOCK_SIZE_ABOVE1,
-        BlockSizeY);
-
-    h264_pollForSpaceForNCommands(1);
-    psb_deblock_reg_table_set(MSVDX_CMDS, INTRA_BLOCK_PREDICTION_ABOVE1, 0, IntraCmdY);
-}
-
-void
-h264_macroblockCmdSequence(psb_cmdbuf_p cmdbuf, uint8_t * MbData, uint32_t X, uint32_t  Y, int bCurrent)
+static void
+h264_macroblockCmdSequence(psb_cmdbuf_p cmdbuf, const h264_sCmdTemplates *Templates,
+                           uint8_t * MbData, uint32_t X, uint32_t  Y, int bCurrent)
 {
     int bMbIsIPCM;
     uint32_t    MbType;
@@ -354,11 +347,7 @@ h264_macroblockCmdSequence(psb_cmdbuf_p cmdbuf, uint8_t * MbData, uint32_t X, ui
     /* Macroblock Number */
     /* no need for MB_ERROR_FLAG as error info is not stored */
     /* no need for MB_FIELD_CODE as basline is always frame based */
-    MbNumberCmd = 0;
-
-    Value = (3 == MbType) ? 0 : MbType;
-    REGIO_WRITE_FIELD(MbNumberCmd, MSVDX_CMDS, MACROBLOCK_NUMBER, MB_CODE_TYPE, Value);
-
+    MbNumberCmd = Templates->MbNumberCmd[MbType];
     REGIO_WRITE_FIELD(MbNumberCmd, MSVDX_CMDS, MACROBLOCK_NUMBER, MB_NO_Y, Y);
     REGIO_WRITE_FIELD(MbNumberCmd, MSVDX_CMDS, MACROBLOCK_NUMBER, MB_NO_X, X);
 
@@ -395,23 +384,24 @@ h264_macroblockCmdSequence(psb_cmdbuf_p cmdbuf, uint8_t * MbData, uint32_t X, ui
     }
 
     /* Prediction Block Sequence */
-    bMbIsIPCM = 0;
     switch (MbType) {
-    case 3:             /* IPCM */
-        bMbIsIPCM = 1;
-        /* deliberate drop through */
     case 0:             /* I */
+    case 3:             /* IPCM */
+        bMbIsIPCM = (3 == MbType);
         if (1 == bCurrent) {
-            h264_currentIntraBlockPrediction(cmdbuf, MbData, bMbIsIPCM);
+            h264_pollForSpaceForNCommands(2);
+            psb_deblock_reg_table_set(MSVDX_CMDS, INTRA_BLOCK_PREDICTION, 0, Templates->IntraCmdY[bMbIsIPCM]);
+            psb_deblock_reg_table_set(MSVDX_CMDS, INTRA_BLOCK_PREDICTION, 4, Templates->IntraCmdC[bMbIsIPCM]);
         } else {
-            h264_above1IntraBlockPrediction(cmdbuf, MbData, bMbIsIPCM);
+            h264_pollForSpaceForNCommands(1);
+            psb_deblock_reg_table_set(MSVDX_CMDS, INTRA_BLOCK_PREDICTION_ABOVE1, 0, Templates->Above1IntraCmdY[bMbIsIPCM]);
         }
         break;
     case 1:             /* P */
         if (1 == bCurrent) {
-            h264_currentInterBlockSequence(cmdbuf, MbData);
+            h264_currentInterBlockSequence(cmdbuf, Templates, MbData);
         } else {
-            h264_above1InterBlockSequence(cmdbuf, MbData);
+            h264_above1InterBlockSequence(cmdbuf, Templates, MbData);
         }
         break;
     case 2:             /* B */
@@ -462,6 +452,33 @@ h264_getCurrentSliceCmd(uint8_t* MbData)
     return Cmd;
 }
 
+/*
+ * Emits one MB row: for each MB the slice params (only when they change),
+ * the above1 sequence of the MB above it and the current sequence.
+ */
+static void
+h264_rowCmdSequence(psb_cmdbuf_p cmdbuf, const h264_sCmdTemplates *Templates,
+                    uint8_t * CurrMb, uint32_t Width, uint32_t Y,
+                    uint32_t * SliceCmd, uint32_t EndOfSliceCmd)
+{
+    uint8_t     * Above1Mb = CurrMb - Width * H264_MACROBLOCK_DATA_SIZE;
+    uint32_t    X, Cmd;
+
+    for (X = 0; X < Width; X++, CurrMb += H264_MACROBLOCK_DATA_SIZE, Above1Mb += H264_MACROBLOCK_DATA_SIZE) {
+        Cmd = h264_getCurrentSliceCmd(CurrMb);
+        if (*SliceCmd != Cmd) {
+            *SliceCmd = Cmd;
+            h264_pollForSpaceForNCommands(2);
+            psb_deblock_reg_set(MSVDX_CMDS, END_SLICE_PICTURE, EndOfSliceCmd);
+            psb_deblock_reg_set(MSVDX_CMDS, SLICE_PARAMS, Cmd);
+        }
+
+        if (Y > 0)
+            h264_macroblockCmdSequence(cmdbuf, Templates, Above1Mb, X, Y - 1, 0);
+        h264_macroblockCmdSequence(cmdbuf, Templates, CurrMb, X, Y, 1);
+    }
+}
+
 int h264_secondPass(
     psb_cmdbuf_p cmdbuf,
     uint8_t     * MbData,
@@ -470,16 +487,15 @@ int h264_secondPass(
     uint32_t    Height
 )
 {
-    uint32_t    i, PicSize;
+    uint32_t    Y;
     uint32_t    EndOfPictureCmd;
     uint32_t    EndOfSliceCmd;
-    uint32_t    SliceCmd, OldSliceCmd;
+    uint32_t    SliceCmd;
     uint32_t    EnableReg;
-    uint8_t     * CurrMb;
-    uint8_t     * Above1Mb;
+    h264_sCmdTemplates Templates;
     int bRetCode = 0;
 
-    PicSize = Width * Height;
+    h264_initCmdTemplates(&Templates);
 
     /* End of Slice command */
     EndOfSliceCmd = 0;
@@ -500,35 +516,11 @@ int h264_secondPass(
     h264_pollForSpaceForNCommands(2);
     psb_deblock_reg_set(MSVDX_CMDS, SLICE_PARAMS, SliceCmd);
     psb_deblock_reg_set(MSVDX_CMDS, SLICE_PARAMS_ABOVE1, SliceCmd);
-    /* process top row */
-    for (i = 0, CurrMb = MbData;
-         i < Width;
-         i++, CurrMb += H264_MACROBLOCK_DATA_SIZE) {
-        OldSliceCmd = SliceCmd;
-        SliceCmd = h264_getCurrentSliceCmd(CurrMb);
-        if (OldSliceCmd != SliceCmd) {
-            h264_pollForSpaceForNCommands(2);
-            psb_deblock_reg_set(MSVDX_CMDS, END_SLICE_PICTURE, EndOfSliceCmd);
-            psb_deblock_reg_set(MSVDX_CMDS, SLICE_PARAMS, SliceCmd);
-        }
-
-        h264_macroblockCmdSequence(cmdbuf, CurrMb, i, 0, 1);
-    }
-
-    /* process rest of picture */
-    for (Above1Mb = MbData;
-         i < PicSize;
-         i++, CurrMb += H264_MACROBLOCK_DATA_SIZE, Above1Mb += H264_MACROBLOCK_DATA_SIZE) {
-        OldSliceCmd = SliceCmd;
-        SliceCmd = h264_getCurrentSliceCmd(CurrMb);
-        if (OldSliceCmd != SliceCmd) {
-            h264_pollForSpaceForNCommands(2);
-            psb_deblock_reg_set(MSVDX_CMDS, END_SLICE_PICTURE, EndOfSliceCmd);
-            psb_deblock_reg_set(MSVDX_CMDS, SLICE_PARAMS, SliceCmd);
-        }
 
-        h264_macroblockCmdSequence(cmdbuf, Above1Mb, (i % Width), (i / Width) - 1, 0);
-        h264_macroblockCmdSequence(cmdbuf, CurrMb, (i % Width), (i / Width), 1);
+    /* process the picture a row at a time */
+    for (Y = 0; Y < Height; Y++) {
+        h264_rowCmdSequence(cmdbuf, &Templates, MbData + Y * Width * H264_MACROBLOCK_DATA_SIZE,
+                            Width, Y, &SliceCmd, EndOfSliceCmd);
     }
 
     /* send end of pic + restart back end */
@@ -38,48 +38,81 @@
 #define ALLOCATED    -2
 #define SUSPENDED    -3
 
+/* The free list head packs the first free index with an ABA tag */
+#define FREE_HEAD_MAKE(index, tag)      (((uint64_t)(tag) << 32) | (uint32_t)(index))
+#define FREE_HEAD_INDEX(head)           ((int)(uint32_t)(head))
+#define FREE_HEAD_TAG(head)             ((uint32_t)((head) >> 32))
+
+/*
+ * Returns the object stored at the given index
+ */
+static inline object_base_p object_heap_obj(object_heap_p heap, int index)
+{
+    unsigned char *slab = heap->slabs[index >> OBJECT_HEAP_SLAB_SHIFT];
+
+    return (object_base_p)(slab + (index & (OBJECT_HEAP_SLAB_SIZE - 1)) * heap->object_size);
+}
+
 /*
- * Expands the heap
+ * Pushes the chain first..last onto the free list
+ */
+static void object_heap_push_free(object_heap_p heap, int first, object_base_p last)
+{
+    uint64_t old_head, new_head;
+
+    old_head = __atomic_load_n(&heap->free_head, __ATOMIC_ACQUIRE);
+    do {
+        __atomic_store_n(&last->next_free, FREE_HEAD_INDEX(old_head), __ATOMIC_RELAXED);
+        new_head = FREE_HEAD_MAKE(first, FREE_HEAD_TAG(old_head) + 1);
+    } while (!__atomic_compare_exchange_n(&heap->free_head, &old_head, new_head, 1,
+                                          __ATOMIC_RELEASE, __ATOMIC_ACQUIRE));
+}
+
+/*
+ * Expands the heap by one slab
  * Return 0 on success, -1 on error
  */
 static int object_heap_expand(object_heap_p heap)
 {
     int i;
-    int malloc_error = FALSE;
-    object_base_p *new_heap_index;
-    int next_free;
-    int new_heap_size = heap->heap_size + heap->heap_increment;
+    int slab_index;
+    int first;
+    unsigned char *slab;
+    object_base_p obj = NULL;
 
-    new_heap_index = (object_base_p *) realloc(heap->heap_index, new_heap_size * sizeof(object_base_p));
-    if (NULL == new_heap_index) {
-        return -1; /* Out of memory */
+    pthread_mutex_lock(&heap->expand_mutex);
+
+    /* Another thread may have grown the heap while we were waiting */
+    if (FREE_HEAD_INDEX(__atomic_load_n(&heap->free_head, __ATOMIC_ACQUIRE)) != LAST_FREE) {
+        pthread_mutex_unlock(&heap->expand_mutex);
+        return 0;
     }
-    heap->heap_index = new_heap_index;
-    next_free = heap->next_free;
-    for (i = new_heap_size; i-- > heap->heap_size;) {
-        object_base_p obj = (object_base_p) calloc(1, heap->object_size);
-        heap->heap_index[i] = obj;
-        if (NULL == obj) {
-            malloc_error = TRUE;
-            continue; /* Clean up after the loop is completely done */
-        }
-        obj->id = i + heap->id_offset;
-        obj->next_free = next_free;
-        next_free = i;
+
+    slab_index = heap->num_slabs;
+    if (slab_index >= OBJECT_HEAP_MAX_SLABS) {
+        pthread_mutex_unlock(&heap->expand_mutex);
+        return -1; /* Out of IDs */
     }
 
-    if (malloc_error) {
-        /* Clean up the mess */
-        for (i = new_heap_size; i-- > heap->heap_size;) {
-            if (heap->heap_index[i]) {
-                free(heap->heap_index[i]);
-            }
-        }
-        /* heap->heap_index is left as is */
+    slab = (unsigned char *) calloc(OBJECT_HEAP_SLAB_SIZE, heap->object_size);
+    if (NULL == slab) {
+        pthread_mutex_unlock(&heap->expand_mutex);
         return -1; /* Out of memory */
     }
-    heap->next_free = next_free;
-    heap->heap_size = new_heap_size;
+
+    first = slab_index << OBJECT_HEAP_SLAB_SHIFT;
+    for (i = 0; i < OBJECT_HEAP_SLAB_SIZE; i++) {
+        obj = (object_base_p)(slab + i * heap->object_size);
+        obj->id = (first + i) + heap->id_offset;
+        obj->next_free = first + i + 1;
+    }
+
+    /* Publish the slab before any of its IDs can be handed out */
+    heap->slabs[slab_index] = slab;
+    __atomic_store_n(&heap->num_slabs, slab_index + 1, __ATOMIC_RELEASE);
+    object_heap_push_free(heap, first, obj);
+
+    pthread_mutex_unlock(&heap->expand_mutex);
     return 0; /* Success */
 }
 
@@ -90,10 +123,13 @@ int object_heap_init(object_heap_p heap, int object_size, int id_offset)
 {
     heap->object_size = object_size;
     heap->id_offset = id_offset & OBJECT_HEAP_OFFSET_MASK;
-    heap->heap_size = 0;
-    heap->heap_increment = 16;
-    heap->heap_index = NULL;
-    heap->next_free = LAST_FREE;
+    heap->num_slabs = 0;
+    heap->free_head = FREE_HEAD_MAKE(LAST_FREE, 0);
+    heap->slabs = (unsigned char **) calloc(OBJECT_HEAP_MAX_SLABS, sizeof(unsigned char *));
+    if (NULL == heap->slabs) {
+        return -1; /* Out of memory */
+    }
+    pthread_mutex_init(&heap->expand_mutex, NULL);
     return object_heap_expand(heap);
 }
 
@@ -104,16 +140,30 @@ int object_heap_init(object_heap_p heap, int object_size, int id_offset)
 int object_heap_allocate(object_heap_p heap)
 {
     object_base_p obj;
-    if (LAST_FREE == heap->next_free) {
-        if (-1 == object_heap_expand(heap)) {
-            return -1; /* Out of memory */
+    uint64_t old_head, new_head;
+    int index;
+
+    old_head = __atomic_load_n(&heap->free_head, __ATOMIC_ACQUIRE);
+    for (;;) {
+        index = FREE_HEAD_INDEX(old_head);
+        if (LAST_FREE == index) {
+            if (-1 == object_heap_expand(heap)) {
+                return -1; /* Out of memory */
+            }
+            old_head = __atomic_load_n(&heap->free_head, __ATOMIC_ACQUIRE);
+            continue;
         }
+        ASSERT(index >= 0);
+
+        obj = object_heap_obj(heap, index);
+        new_head = FREE_HEAD_MAKE(__atomic_load_n(&obj->next_free, __ATOMIC_RELAXED),
+                                  FREE_HEAD_TAG(old_head) + 1);
+        if (__atomic_compare_exchange_n(&heap->free_head, &old_head, new_head, 1,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE))
+            break;
     }
-    ASSERT(heap->next_free >= 0);
 
-    obj = heap->heap_index[heap->next_free];
-    heap->next_free = obj->next_free;
-    obj->next_free = ALLOCATED;
+    __atomic_store_n(&obj->next_free, ALLOCATED, __ATOMIC_RELEASE);
     return obj->id;
 }
 
@@ -124,18 +174,30 @@ int object_heap_allocate(object_heap_p heap)
 object_base_p object_heap_lookup(object_heap_p heap, int id)
 {
     object_base_p obj;
-    if ((id < heap->id_offset) || (id > (heap->heap_size + heap->id_offset))) {
+    int index;
+    int state;
+
+    if ((id & OBJECT_HEAP_OFFSET_MASK) != heap->id_offset) {
         return NULL;
     }
-    id &= OBJECT_HEAP_ID_MASK;
-    obj = heap->heap_index[id];
+    index = id & OBJECT_HEAP_INDEX_MASK;
+    if ((index >> OBJECT_HEAP_SLAB_SHIFT) >= __atomic_load_n(&heap->num_slabs, __ATOMIC_ACQUIRE)) {
+        return NULL;
+    }
+    obj = object_heap_obj(heap, index);
 
-    /* Check if the object has in fact been allocated */
-#if 0
-    if (obj->next_free != ALLOCATED) {
+    /* Reject stale IDs and objects that sit on the free list */
+    if (__atomic_load_n(&obj->id, __ATOMIC_ACQUIRE) != id) {
+        return NULL;
+    }
+    state = __atomic_load_n(&obj->next_free, __ATOMIC_ACQUIRE);
+    /*
+     * Buffers released by vaRenderPicture are suspended but the application
+     * still owns their IDs until vaDestroyBuffer, so they stay visible here
+     */
+    if ((state != ALLOCATED) && (state != SUSPENDED)) {
         return NULL;
     }
-#endif
     return obj;
 }
 
@@ -157,8 +219,10 @@ object_base_p object_heap_next(object_heap_p heap, object_heap_iterator *iter)
 {
     object_base_p obj;
     int i = *iter + 1;
-    while (i < heap->heap_size) {
-        obj = heap->heap_index[i];
+    int heap_size = __atomic_load_n(&heap->num_slabs, __ATOMIC_ACQUIRE) << OBJECT_HEAP_SLAB_SHIFT;
+
+    while (i < heap_size) {
+        obj = object_heap_obj(heap, i);
         if ((obj->next_free == ALLOCATED) || (obj->next_free == SUSPENDED)) {
             *iter = i;
             return obj;
@@ -176,13 +240,20 @@ object_base_p object_heap_next(object_heap_p heap, object_heap_iterator *iter)
  */
 void object_heap_free(object_heap_p heap, object_base_p obj)
 {
+    int index;
+    int generation;
+
     /* Don't complain about NULL pointers */
     if (NULL != obj) {
         /* Check if the object has in fact been allocated */
         ASSERT((obj->next_free == ALLOCATED) || (obj->next_free == SUSPENDED));
 
-        obj->next_free = heap->next_free;
-        heap->next_free = obj->id & OBJECT_HEAP_ID_MASK;
+        /* Retire the current ID before the slot can be reused */
+        index = obj->id & OBJECT_HEAP_INDEX_MASK;
+        generation = (obj->id + (1 << OBJECT_HEAP_GEN_SHIFT)) & OBJECT_HEAP_GEN_MASK;
+        __atomic_store_n(&obj->id, heap->id_offset | generation | index, __ATOMIC_RELEASE);
+
+        object_heap_push_free(heap, index, obj);
     }
 }
 
@@ -193,31 +264,36 @@ void object_heap_destroy(object_heap_p heap)
 {
     object_base_p obj;
     int i;
-    for (i = 0; i < heap->heap_size; i++) {
+
+    for (i = 0; i < (heap->num_slabs << OBJECT_HEAP_SLAB_SHIFT); i++) {
         /* Check if object is not still allocated */
-        obj = heap->heap_index[i];
+        obj = object_heap_obj(heap, i);
         ASSERT(obj->next_free != ALLOCATED);
         ASSERT(obj->next_free != SUSPENDED);
-        /* Free object itself */
-        free(obj);
     }
-    free(heap->heap_index);
-    heap->heap_size = 0;
-    heap->heap_index = NULL;
-    heap->next_free = LAST_FREE;
+    for (i = 0; i < heap->num_slabs; i++) {
+        /* Free the slab holding the objects */
+        free(heap->slabs[i]);
+    }
+    free(heap->slabs);
+    pthread_mutex_destroy(&heap->expand_mutex);
+    heap->num_slabs = 0;
+    heap->slabs = NULL;
+    heap->free_head = FREE_HEAD_MAKE(LAST_FREE, 0);
 }
 
 /*
  * Suspend an object
- * Suspended objects can not be looked up
+ * Suspended objects can still be looked up and iterated until freed,
+ * suspending only marks them as not in use by the driver
  */
 void object_heap_suspend_object(object_base_p obj, int suspend)
 {
     if (suspend) {
         ASSERT(obj->next_free == ALLOCATED);
-        obj->next_free = SUSPENDED;
+        __atomic_store_n(&obj->next_free, SUSPENDED, __ATOMIC_RELEASE);
     } else {
         ASSERT(obj->next_free == SUSPENDED);
-        obj->next_free = ALLOCATED;
+        __atomic_store_n(&obj->next_free, ALLOCATED, __ATOMIC_RELEASE);
     }
 }
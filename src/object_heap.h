@@ -29,9 +29,26 @@
 #ifndef _OBJECT_HEAP_H_
 #define _OBJECT_HEAP_H_
 
+#include <stdint.h>
+#include <pthread.h>
+
 #define OBJECT_HEAP_OFFSET_MASK         0x7F000000
 #define OBJECT_HEAP_ID_MASK                     0x00FFFFFF
 
+/*
+ * Object IDs are laid out as [offset:7][generation:8][index:16].
+ * The generation is bumped every time an object is freed so that
+ * stale IDs handed back by the application are rejected on lookup.
+ */
+#define OBJECT_HEAP_GEN_MASK            0x00FF0000
+#define OBJECT_HEAP_GEN_SHIFT           16
+#define OBJECT_HEAP_INDEX_MASK          0x0000FFFF
+
+/* Objects are carved out of contiguous slabs of (1 << SLAB_SHIFT) objects */
+#define OBJECT_HEAP_SLAB_SHIFT          6
+#define OBJECT_HEAP_SLAB_SIZE           (1 << OBJECT_HEAP_SLAB_SHIFT)
+#define OBJECT_HEAP_MAX_SLABS           ((OBJECT_HEAP_INDEX_MASK + 1) >> OBJECT_HEAP_SLAB_SHIFT)
+
 typedef struct object_base_s *object_base_p;
 typedef struct object_heap_s *object_heap_p;
 
@@ -43,10 +60,13 @@ struct object_base_s {
 struct object_heap_s {
     int object_size;
     int id_offset;
-    object_base_p *heap_index;
-    int next_free;
-    int heap_size;
-    int heap_increment;
+    /* Fixed size slab table, never reallocated so lookups need no lock */
+    unsigned char **slabs;
+    int num_slabs;
+    /* Free list head: low 32 bits index, high 32 bits ABA tag */
+    uint64_t free_head;
+    /* Only serializes heap growth */
+    pthread_mutex_t expand_mutex;
 };
 
 typedef int object_heap_iterator;
@@ -64,7 +84,8 @@ int object_heap_allocate(object_heap_p heap);
 
 /*
  * Lookup an allocated object by object ID
- * Returns a pointer to the object on success, returns NULL on error
+ * Returns a pointer to the object on success, returns NULL on error,
+ * including when the ID is stale or refers to a freed object
  */
 object_base_p object_heap_lookup(object_heap_p heap, int id);
 
@@ -92,7 +113,8 @@ void object_heap_destroy(object_heap_p heap);
 
 /*
  * Suspend an object
- * Suspended objects can not be looked up
+ * Suspended objects can still be looked up and iterated until freed,
+ * suspending only marks them as not in use by the driver
  */
 void object_heap_suspend_object(object_base_p obj, int suspend);
 
@@ -32,6 +32,7 @@
 #include "tng_vld_dec.h"
 #include "psb_def.h"
 #include "psb_drv_debug.h"
+#include "psb_vlc_cache.h"
 #include "pnw_rotate.h"
 
 #include "hwdefs/reg_io2.h"
@@ -175,7 +176,7 @@ struct context_H264_s {
     uint32_t slice1_params;
 
     /* VLC packed data */
-    struct psb_buffer_s vlc_packed_table;
+    psb_buffer_p vlc_packed_table; /* own reference to the shared BO, see psb_vlc_cache.c */
 
     /* Preload buffer */
     struct psb_buffer_s preload_buffer;
@@ -198,6 +199,18 @@ struct context_H264_s {
 
 typedef struct context_H264_s *context_H264_p;
 
+/* Per-slice words built ahead of the cmdbuf by psb__H264_prepare_slice */
+struct H264_slice_prep_s {
+    uint32_t first_mb_x;
+    uint32_t first_mb_y;
+    uint32_t slice0_params;             /* without SLICECOUNT */
+    uint32_t slice1_params;
+    uint32_t list0[8];                  /* H264_CR_VEC_H264_BE_LIST0 */
+    uint32_t list0_inverse[8];          /* B slices only */
+    uint32_t list1[8];                  /* B slices only */
+    uint32_t weights[4][32];            /* factors A, offsets A, factors B, offsets B */
+};
+
 #define INIT_CONTEXT_H264    context_H264_p ctx = (context_H264_p) obj_context->format_data;
 
 #define SURFACE(id)    ((object_surface_p) object_heap_lookup( &ctx->obj_context->driver_data->surface_heap, id ))
@@ -402,6 +415,7 @@ static void pnw_H264_DestroyContext(object_context_p obj_context);
 static void psb__H264_process_slice_data(context_DEC_p dec_ctx, VASliceParameterBufferBase *vld_slice_param);
 static void psb__H264_end_slice(context_DEC_p dec_ctx);
 static void psb__H264_begin_slice(context_DEC_p dec_ctx, VASliceParameterBufferBase *vld_slice_param);
+static void psb__H264_prepare_slice(context_DEC_p dec_ctx, VASliceParameterBufferBase *vld_slice_param, void *prep_data);
 static VAStatus pnw_H264_process_buffer(context_DEC_p dec_ctx, object_buffer_p buffer);
 
 static VAStatus pnw_H264_CreateContext(
@@ -423,6 +437,8 @@ static VAStatus pnw_H264_CreateContext(
     ctx->obj_context = obj_context;
     ctx->pic_params = NULL;
 
+    ctx->dec_ctx.prepare_slice = psb__H264_prepare_slice;
+    ctx->dec_ctx.slice_prep_size = sizeof(struct H264_slice_prep_s);
     ctx->dec_ctx.begin_slice = psb__H264_begin_slice;
     ctx->dec_ctx.process_slice = psb__H264_process_slice_data;
     ctx->dec_ctx.end_slice = psb__H264_end_slice;
@@ -473,18 +489,9 @@ static VAStatus pnw_H264_CreateContext(
     }
 
     if (vaStatus == VA_STATUS_SUCCESS) {
-        vaStatus = psb_buffer_create(obj_context->driver_data,
-                                     sizeof(ui16H264VLCTableData),
-                                     psb_bt_cpu_vpu,
-                                     &ctx->vlc_packed_table);
-        DEBUG_FAILURE;
-    }
-    if (vaStatus == VA_STATUS_SUCCESS) {
-        unsigned char *vlc_packed_data_address;
-        if (0 ==  psb_buffer_map(&ctx->vlc_packed_table, &vlc_packed_data_address)) {
-            memcpy(vlc_packed_data_address, ui16H264VLCTableData, sizeof(ui16H264VLCTableData));
-            psb_buffer_unmap(&ctx->vlc_packed_table);
-        } else {
+        ctx->vlc_packed_table = psb_vlc_table_get(obj_context->driver_data, PSB_VLC_TABLE_H264,
+                                                  sizeof(ui16H264VLCTableData), ui16H264VLCTableData, NULL);
+        if (NULL == ctx->vlc_packed_table) {
             vaStatus = VA_STATUS_ERROR_ALLOCATION_FAILED;
             DEBUG_FAILURE;
         }
@@ -512,7 +519,10 @@ static void pnw_H264_DestroyContext(
 
     psb_buffer_destroy(&ctx->reference_cache);
     psb_buffer_destroy(&ctx->preload_buffer);
-    psb_buffer_destroy(&ctx->vlc_packed_table);
+    if (ctx->vlc_packed_table) {
+        psb_vlc_table_put(obj_context->driver_data, PSB_VLC_TABLE_H264, ctx->vlc_packed_table);
+        ctx->vlc_packed_table = NULL;
+    }
 
     if (ctx->pic_params) {
         free(ctx->pic_params);
@@ -1048,6 +1058,7 @@ static void psb__H264_build_B_slice_chunk(context_H264_p ctx, VASliceParameterBu
 {
     psb_cmdbuf_p cmdbuf = ctx->obj_context->cmdbuf;
     VAPictureParameterBufferH264 *pic_params = ctx->pic_params;
+    struct H264_slice_prep_s *prep = (struct H264_slice_prep_s *)ctx->dec_ctx.slice_prep;
     uint32_t reg_value;
     int i;
 
@@ -1098,53 +1109,13 @@ static void psb__H264_build_B_slice_chunk(context_H264_p ctx, VASliceParameterBu
         psb_cmdbuf_rendec_write(cmdbuf, 0xDEADBEEF);
     }
 
-    /* Calculate inverse index for reference pictures */
-    {
-        IMG_UINT8 list0_inverse[32];
-        memset(list0_inverse, 0xff, 32); /* Unused entries get 0xff */
-
-        if (slice_param->num_ref_idx_l0_active_minus1 + 1 > 32) {
-            drv_debug_msg(VIDEO_DEBUG_ERROR, "num_ref_idx_l0_active_minus1(%d) is too big. Set it with 31\n",
-                               slice_param->num_ref_idx_l0_active_minus1);
-            slice_param->num_ref_idx_l0_active_minus1 = 31;
-        }
-
-        if (slice_param->num_ref_idx_l0_active_minus1 > 30)
-            slice_param->num_ref_idx_l0_active_minus1 = 30;
-        for (i = slice_param->num_ref_idx_l0_active_minus1 + 1; i--;) {
-            object_surface_p surface = SURFACE(slice_param->RefPicList0[i].picture_id);
-            if (surface) {
-                uint32_t dpb_idx = GET_SURFACE_INFO_dpb_idx(surface->psb_surface);
-                if (dpb_idx < 16) {
-                    if (slice_param->RefPicList0[i].flags & VA_PICTURE_H264_BOTTOM_FIELD) {
-                        dpb_idx |= 0x10;
-                    }
-                    list0_inverse[dpb_idx] = i;
-                }
-            }
-        }
-        for (i = 0; i < 32; i += 4) {
-            reg_value = 0;
-            reg_value |= list0_inverse[i];
-            reg_value |= list0_inverse[i+1] << 8;
-            reg_value |= list0_inverse[i+2] << 16;
-            reg_value |= list0_inverse[i+3] << 24;
-            psb_cmdbuf_rendec_write(cmdbuf, reg_value);
-        }
-    }
-
-    if (slice_param->num_ref_idx_l1_active_minus1 > 28)
-        slice_param->num_ref_idx_l1_active_minus1 = 28;
+    /* Inverse index for reference pictures */
+    for (i = 0; i < 8; i++)
+        psb_cmdbuf_rendec_write(cmdbuf, prep->list0_inverse[i]);
 
-    /* Write Ref List 1 - but only need the valid ones */
-    for (i = 0; i <= slice_param->num_ref_idx_l1_active_minus1; i += 4) {
-        reg_value = 0;
-        reg_value |= PICTURE2INDEX(ctx, &slice_param->RefPicList1[i]);
-        reg_value |= PICTURE2INDEX(ctx, &slice_param->RefPicList1[i+1]) << 8;
-        reg_value |= PICTURE2INDEX(ctx, &slice_param->RefPicList1[i+2]) << 16;
-        reg_value |= PICTURE2INDEX(ctx, &slice_param->RefPicList1[i+3]) << 24;
-        psb_cmdbuf_rendec_write(cmdbuf, reg_value);
-    }
+    /* Ref List 1 - but only need the valid ones */
+    for (i = 0; i <= slice_param->num_ref_idx_l1_active_minus1; i += 4)
+        psb_cmdbuf_rendec_write(cmdbuf, prep->list1[i / 4]);
 
     psb_cmdbuf_rendec_end(cmdbuf);
 }
@@ -1189,6 +1160,7 @@ static void psb__H264_build_rendec_params(context_H264_p ctx, VASliceParameterBu
     psb_cmdbuf_p cmdbuf = ctx->obj_context->cmdbuf;
     psb_surface_p target_surface = ctx->obj_context->current_render_target->psb_surface;
     VAPictureParameterBufferH264 *pic_params = ctx->pic_params;
+    struct H264_slice_prep_s *prep = (struct H264_slice_prep_s *)ctx->dec_ctx.slice_prep;
     uint32_t reg_value;
     unsigned int i;
 
@@ -1260,20 +1232,8 @@ static void psb__H264_build_rendec_params(context_H264_p ctx, VASliceParameterBu
     if (slice_param->slice_type == ST_B ||  slice_param->slice_type == ST_P) {
         psb_cmdbuf_rendec_start(cmdbuf, RENDEC_REGISTER_OFFSET(MSVDX_VEC, H264_CR_VEC_H264_BE_LIST0));
 
-        if (slice_param->num_ref_idx_l0_active_minus1 > 31) {
-            drv_debug_msg(VIDEO_DEBUG_ERROR, "num_ref_idx_l0_active_minus1(%d) is too big, limit it to 31.\n",
-                               slice_param->num_ref_idx_l0_active_minus1);
-            slice_param->num_ref_idx_l0_active_minus1 = 28;
-        }
-
-        for (i = 0; i <= slice_param->num_ref_idx_l0_active_minus1; i += 4) {
-            reg_value = 0;
-            reg_value |= PICTURE2INDEX(ctx, &slice_param->RefPicList0[i]);
-            reg_value |= PICTURE2INDEX(ctx, &slice_param->RefPicList0[i+1]) << 8;
-            reg_value |= PICTURE2INDEX(ctx, &slice_param->RefPicList0[i+2]) << 16;
-            reg_value |= PICTURE2INDEX(ctx, &slice_param->RefPicList0[i+3]) << 24;
-            psb_cmdbuf_rendec_write(cmdbuf, reg_value);
-        }
+        for (i = 0; i <= slice_param->num_ref_idx_l0_active_minus1; i += 4)
+            psb_cmdbuf_rendec_write(cmdbuf, prep->list0[i / 4]);
 
         psb_cmdbuf_rendec_end(cmdbuf);
     }
@@ -1337,84 +1297,24 @@ static void psb__H264_build_rendec_params(context_H264_p ctx, VASliceParameterBu
     /* works as long as weighted factors A and B commands remain the same */
     if ((pic_params->pic_fields.bits.weighted_pred_flag && (slice_param->slice_type == ST_P)) ||
         ((pic_params->pic_fields.bits.weighted_bipred_idc != 0) && (slice_param->slice_type == ST_B))) {
-        IMG_UINT32 num_ref_0 = slice_param->num_ref_idx_l0_active_minus1;
-
+        /* weighted factors and offsets, padded to 32 */
         psb_cmdbuf_rendec_start(cmdbuf, RENDEC_REGISTER_OFFSET(MSVDX_CMDS, H264_WEIGHTED_FACTORS_A));
-
-        if (num_ref_0 > 31)
-            num_ref_0 = 31;
-
-        /* weighted factors */
-        for (i = 0; i <= num_ref_0; i++) {
-            reg_value = 0;
-            REGIO_WRITE_FIELD_MASKEDLITE(reg_value, MSVDX_CMDS, H264_WEIGHTED_FACTORS_A, CR_WEIGHT_A,   slice_param->chroma_weight_l0[i][1]);/* Cr - 1 */
-            REGIO_WRITE_FIELD_MASKEDLITE(reg_value, MSVDX_CMDS, H264_WEIGHTED_FACTORS_A, CB_WEIGHT_A,   slice_param->chroma_weight_l0[i][0]);/* Cb - 0 */
-            REGIO_WRITE_FIELD_MASKEDLITE(reg_value, MSVDX_CMDS, H264_WEIGHTED_FACTORS_A, Y_WEIGHT_A,    slice_param->luma_weight_l0[i]);
-
-            psb_cmdbuf_rendec_write(cmdbuf, reg_value);
-        }
-        /* pad remainder */
-        for (; i < 32; i++) {
-            psb_cmdbuf_rendec_write(cmdbuf, 0);
-        }
-
-        /* weighted offsets */
-        for (i = 0; i <= num_ref_0; i++) {
-            reg_value = 0;
-            REGIO_WRITE_FIELD_MASKEDLITE(reg_value, MSVDX_CMDS, H264_WEIGHTED_OFFSET_A, CR_OFFSET_A,    slice_param->chroma_offset_l0[i][1]);/* Cr - 1 */
-            REGIO_WRITE_FIELD_MASKEDLITE(reg_value, MSVDX_CMDS, H264_WEIGHTED_OFFSET_A, CB_OFFSET_A,    slice_param->chroma_offset_l0[i][0]);/* Cb - 0 */
-            REGIO_WRITE_FIELD_MASKEDLITE(reg_value, MSVDX_CMDS, H264_WEIGHTED_OFFSET_A, Y_OFFSET_A,     slice_param->luma_offset_l0[i]);
-
-            psb_cmdbuf_rendec_write(cmdbuf, reg_value);
-        }
-        /* pad remainder */
-        for (; i < 32; i++) {
-            psb_cmdbuf_rendec_write(cmdbuf, 0);
-        }
+        for (i = 0; i < 32; i++)
+            psb_cmdbuf_rendec_write(cmdbuf, prep->weights[0][i]);
+        for (i = 0; i < 32; i++)
+            psb_cmdbuf_rendec_write(cmdbuf, prep->weights[1][i]);
         psb_cmdbuf_rendec_end(cmdbuf);
 
         if (slice_param->slice_type == ST_B) {
-            IMG_UINT32 num_ref_1 = slice_param->num_ref_idx_l1_active_minus1;
-
             psb_cmdbuf_rendec_start(cmdbuf, RENDEC_REGISTER_OFFSET(MSVDX_CMDS, H264_WEIGHTED_FACTORS_B));
-
-            if (num_ref_1 > 31) {
-                drv_debug_msg(VIDEO_DEBUG_ERROR, "num_ref_1 shouldn't be larger than 31\n");
-                num_ref_1 = 31;
-            }
-
-            /* weighted factors */
-            for (i = 0; i <= num_ref_1; i++) {
-                reg_value = 0;
-                REGIO_WRITE_FIELD_MASKEDLITE(reg_value, MSVDX_CMDS, H264_WEIGHTED_FACTORS_B, CR_WEIGHT_B,       slice_param->chroma_weight_l1[i][1]);/* Cr - 1 */
-                REGIO_WRITE_FIELD_MASKEDLITE(reg_value, MSVDX_CMDS, H264_WEIGHTED_FACTORS_B, CB_WEIGHT_B,       slice_param->chroma_weight_l1[i][0]);/* Cb - 0 */
-                REGIO_WRITE_FIELD_MASKEDLITE(reg_value, MSVDX_CMDS, H264_WEIGHTED_FACTORS_B, Y_WEIGHT_B,        slice_param->luma_weight_l1[i]);
-
-                psb_cmdbuf_rendec_write(cmdbuf, reg_value);
-            }
-            /* pad remainder */
-            for (; i < 32; i++) {
-                psb_cmdbuf_rendec_write(cmdbuf, 0);
-            }
-
-            /* weighted offsets */
-            for (i = 0; i <= num_ref_1; i++) {
-                reg_value = 0;
-                REGIO_WRITE_FIELD_MASKEDLITE(reg_value, MSVDX_CMDS, H264_WEIGHTED_OFFSET_B, CR_OFFSET_B,        slice_param->chroma_offset_l1[i][1]);/* Cr - 1 */
-                REGIO_WRITE_FIELD_MASKEDLITE(reg_value, MSVDX_CMDS, H264_WEIGHTED_OFFSET_B, CB_OFFSET_B,        slice_param->chroma_offset_l1[i][0]);/* Cb - 0 */
-                REGIO_WRITE_FIELD_MASKEDLITE(reg_value, MSVDX_CMDS, H264_WEIGHTED_OFFSET_B, Y_OFFSET_B, slice_param->luma_offset_l1[i]);
-
-                psb_cmdbuf_rendec_write(cmdbuf, reg_value);
-            }
-            /* pad remainder */
-            for (; i < 32; i++) {
-                psb_cmdbuf_rendec_write(cmdbuf, 0);
-            }
+            for (i = 0; i < 32; i++)
+                psb_cmdbuf_rendec_write(cmdbuf, prep->weights[2][i]);
+            for (i = 0; i < 32; i++)
+                psb_cmdbuf_rendec_write(cmdbuf, prep->weights[3][i]);
             psb_cmdbuf_rendec_end(cmdbuf);
         }
     }
 
-
     /* CHUNK: SEQ Commands 1 */
     /* send Slice Data for every slice */
     /* MUST be the last slice sent */
@@ -1511,16 +1411,21 @@ static void psb__H264_build_rendec_params(context_H264_p ctx, VASliceParameterBu
         vld_dec_setup_alternative_frame(ctx->obj_context);
 }
 
-static void psb__H264_preprocess_slice(context_H264_p ctx,
-                                       VASliceParameterBufferH264 *slice_param)
+/*
+ * Computes the slice registers, reference list and weight table words from
+ * the slice and picture parameters only. Does not touch ctx or the cmdbuf,
+ * so it can run for all slices of a picture on the driver worker threads.
+ */
+static void psb__H264_prepare_slice(context_DEC_p dec_ctx, VASliceParameterBufferBase *vld_slice_param, void *prep_data)
 {
+    VASliceParameterBufferH264 *slice_param = (VASliceParameterBufferH264 *) vld_slice_param;
+    context_H264_p ctx = (context_H264_p)dec_ctx;
+    struct H264_slice_prep_s *prep = (struct H264_slice_prep_s *)prep_data;
     VAPictureParameterBufferH264 *pic_params = ctx->pic_params;
-    uint32_t slice_qpy;
+    uint32_t slice_qpy, reg_value;
+    unsigned int i;
 
-    ctx->first_mb_x = slice_param->first_mb_in_slice % ctx->picture_width_mb;
-    ctx->first_mb_y = slice_param->first_mb_in_slice / ctx->picture_width_mb;
-    ctx->slice0_params = 0;
-    ctx->slice1_params = 0;
+    memset(prep, 0, sizeof(*prep));
 
     ASSERT(pic_params);
     if (!pic_params) {
@@ -1528,27 +1433,156 @@ static void psb__H264_preprocess_slice(context_H264_p ctx,
         return;
     }
 
+    prep->first_mb_x = slice_param->first_mb_in_slice % ctx->picture_width_mb;
+    prep->first_mb_y = slice_param->first_mb_in_slice / ctx->picture_width_mb;
+
     if (!pic_params->pic_fields.bits.field_pic_flag && pic_params->seq_fields.bits.mb_adaptive_frame_field_flag) {
         /* If in MBAFF mode multiply MB y-address by 2 */
-        ctx->first_mb_y *= 2;
+        prep->first_mb_y *= 2;
     }
 
     slice_qpy = 26 + pic_params->pic_init_qp_minus26 + slice_param->slice_qp_delta;     /* (7-27) */
 
-    REGIO_WRITE_FIELD_LITE(ctx->slice0_params, MSVDX_VEC_H264, CR_VEC_H264_BE_SLICE0, BE_DIRECT_SPATIAL_MV_PRED_FLAG,                   slice_param->direct_spatial_mv_pred_flag);
-    REGIO_WRITE_FIELD_LITE(ctx->slice0_params, MSVDX_VEC_H264, CR_VEC_H264_BE_SLICE0, H264_BE_SLICE0_DISABLE_DEBLOCK_FILTER_IDC,        slice_param->disable_deblocking_filter_idc);
-    REGIO_WRITE_FIELD_MASKEDLITE(ctx->slice0_params, MSVDX_VEC_H264, CR_VEC_H264_BE_SLICE0, H264_BE_SLICE0_ALPHA_CO_OFFSET_DIV2,        slice_param->slice_alpha_c0_offset_div2);
-    REGIO_WRITE_FIELD_MASKEDLITE(ctx->slice0_params, MSVDX_VEC_H264, CR_VEC_H264_BE_SLICE0, H264_BE_SLICE0_BETA_OFFSET_DIV2,            slice_param->slice_beta_offset_div2);
-    REGIO_WRITE_FIELD_LITE(ctx->slice0_params, MSVDX_VEC_H264, CR_VEC_H264_BE_SLICE0, H264_BE_SLICE0_FIELD_TYPE,                        ctx->field_type);
-    REGIO_WRITE_FIELD_LITE(ctx->slice0_params, MSVDX_VEC_H264, CR_VEC_H264_FE_SLICE0, SLICETYPE,                                        aSliceTypeVAtoMsvdx[ slice_param->slice_type % 5]);
-    REGIO_WRITE_FIELD_LITE(ctx->slice0_params, MSVDX_VEC_H264, CR_VEC_H264_FE_SLICE0, CABAC_INIT_IDC,                                   slice_param->cabac_init_idc);
-    REGIO_WRITE_FIELD_LITE(ctx->slice0_params, MSVDX_VEC_H264, CR_VEC_H264_FE_SLICE0, SLICECOUNT,                                       ctx->slice_count);
+    /* SLICECOUNT is added when the slice is emitted */
+    REGIO_WRITE_FIELD_LITE(prep->slice0_params, MSVDX_VEC_H264, CR_VEC_H264_BE_SLICE0, BE_DIRECT_SPATIAL_MV_PRED_FLAG,                   slice_param->direct_spatial_mv_pred_flag);
+    REGIO_WRITE_FIELD_LITE(prep->slice0_params, MSVDX_VEC_H264, CR_VEC_H264_BE_SLICE0, H264_BE_SLICE0_DISABLE_DEBLOCK_FILTER_IDC,        slice_param->disable_deblocking_filter_idc);
+    REGIO_WRITE_FIELD_MASKEDLITE(prep->slice0_params, MSVDX_VEC_H264, CR_VEC_H264_BE_SLICE0, H264_BE_SLICE0_ALPHA_CO_OFFSET_DIV2,        slice_param->slice_alpha_c0_offset_div2);
+    REGIO_WRITE_FIELD_MASKEDLITE(prep->slice0_params, MSVDX_VEC_H264, CR_VEC_H264_BE_SLICE0, H264_BE_SLICE0_BETA_OFFSET_DIV2,            slice_param->slice_beta_offset_div2);
+    REGIO_WRITE_FIELD_LITE(prep->slice0_params, MSVDX_VEC_H264, CR_VEC_H264_BE_SLICE0, H264_BE_SLICE0_FIELD_TYPE,                        ctx->field_type);
+    REGIO_WRITE_FIELD_LITE(prep->slice0_params, MSVDX_VEC_H264, CR_VEC_H264_FE_SLICE0, SLICETYPE,                                        aSliceTypeVAtoMsvdx[ slice_param->slice_type % 5]);
+    REGIO_WRITE_FIELD_LITE(prep->slice0_params, MSVDX_VEC_H264, CR_VEC_H264_FE_SLICE0, CABAC_INIT_IDC,                                   slice_param->cabac_init_idc);
+
+    REGIO_WRITE_FIELD_LITE(prep->slice1_params, MSVDX_VEC_H264, CR_VEC_H264_FE_SLICE1, FIRST_MB_IN_SLICE_X,      prep->first_mb_x);
+    REGIO_WRITE_FIELD_LITE(prep->slice1_params, MSVDX_VEC_H264, CR_VEC_H264_FE_SLICE1, FIRST_MB_IN_SLICE_Y,      prep->first_mb_y);
+    REGIO_WRITE_FIELD_LITE(prep->slice1_params, MSVDX_VEC_H264, CR_VEC_H264_FE_SLICE1, SLICEQPY,                 slice_qpy);
+    REGIO_WRITE_FIELD_LITE(prep->slice1_params, MSVDX_VEC_H264, CR_VEC_H264_FE_SLICE1, NUM_REF_IDX_L0_ACTIVE_MINUS1, slice_param->num_ref_idx_l0_active_minus1);
+    REGIO_WRITE_FIELD_LITE(prep->slice1_params, MSVDX_VEC_H264, CR_VEC_H264_FE_SLICE1, NUM_REF_IDX_L1_ACTIVE_MINUS1, slice_param->num_ref_idx_l1_active_minus1);
+
+    /* CHUNK: BIN, inverse index for reference pictures and list 1 */
+    if (slice_param->slice_type == ST_B) {
+        IMG_UINT8 list0_inverse[32];
+        memset(list0_inverse, 0xff, 32); /* Unused entries get 0xff */
+
+        if (slice_param->num_ref_idx_l0_active_minus1 + 1 > 32) {
+            drv_debug_msg(VIDEO_DEBUG_ERROR, "num_ref_idx_l0_active_minus1(%d) is too big. Set it with 31\n",
+                               slice_param->num_ref_idx_l0_active_minus1);
+            slice_param->num_ref_idx_l0_active_minus1 = 31;
+        }
+
+        if (slice_param->num_ref_idx_l0_active_minus1 > 30)
+            slice_param->num_ref_idx_l0_active_minus1 = 30;
+        for (i = slice_param->num_ref_idx_l0_active_minus1 + 1; i--;) {
+            object_surface_p surface = SURFACE(slice_param->RefPicList0[i].picture_id);
+            if (surface) {
+                uint32_t dpb_idx = GET_SURFACE_INFO_dpb_idx(surface->psb_surface);
+                if (dpb_idx < 16) {
+                    if (slice_param->RefPicList0[i].flags & VA_PICTURE_H264_BOTTOM_FIELD) {
+                        dpb_idx |= 0x10;
+                    }
+                    list0_inverse[dpb_idx] = i;
+                }
+            }
+        }
+        for (i = 0; i < 32; i += 4) {
+            reg_value = 0;
+            reg_value |= list0_inverse[i];
+            reg_value |= list0_inverse[i+1] << 8;
+            reg_value |= list0_inverse[i+2] << 16;
+            reg_value |= list0_inverse[i+3] << 24;
+            prep->list0_inverse[i / 4] = reg_value;
+        }
+
+        if (slice_param->num_ref_idx_l1_active_minus1 > 28)
+            slice_param->num_ref_idx_l1_active_minus1 = 28;
 
-    REGIO_WRITE_FIELD_LITE(ctx->slice1_params, MSVDX_VEC_H264, CR_VEC_H264_FE_SLICE1, FIRST_MB_IN_SLICE_X,      ctx->first_mb_x);
-    REGIO_WRITE_FIELD_LITE(ctx->slice1_params, MSVDX_VEC_H264, CR_VEC_H264_FE_SLICE1, FIRST_MB_IN_SLICE_Y,      ctx->first_mb_y);
-    REGIO_WRITE_FIELD_LITE(ctx->slice1_params, MSVDX_VEC_H264, CR_VEC_H264_FE_SLICE1, SLICEQPY,                 slice_qpy);
-    REGIO_WRITE_FIELD_LITE(ctx->slice1_params, MSVDX_VEC_H264, CR_VEC_H264_FE_SLICE1, NUM_REF_IDX_L0_ACTIVE_MINUS1, slice_param->num_ref_idx_l0_active_minus1);
-    REGIO_WRITE_FIELD_LITE(ctx->slice1_params, MSVDX_VEC_H264, CR_VEC_H264_FE_SLICE1, NUM_REF_IDX_L1_ACTIVE_MINUS1, slice_param->num_ref_idx_l1_active_minus1);
+        /* Ref List 1 - but only need the valid ones */
+        for (i = 0; i <= slice_param->num_ref_idx_l1_active_minus1; i += 4) {
+            reg_value = 0;
+            reg_value |= PICTURE2INDEX(ctx, &slice_param->RefPicList1[i]);
+            reg_value |= PICTURE2INDEX(ctx, &slice_param->RefPicList1[i+1]) << 8;
+            reg_value |= PICTURE2INDEX(ctx, &slice_param->RefPicList1[i+2]) << 16;
+            reg_value |= PICTURE2INDEX(ctx, &slice_param->RefPicList1[i+3]) << 24;
+            prep->list1[i / 4] = reg_value;
+        }
+    }
+
+    /* CHUNK: PIN */
+    if (slice_param->slice_type == ST_B ||  slice_param->slice_type == ST_P) {
+        if (slice_param->num_ref_idx_l0_active_minus1 > 31) {
+            drv_debug_msg(VIDEO_DEBUG_ERROR, "num_ref_idx_l0_active_minus1(%d) is too big, limit it to 31.\n",
+                               slice_param->num_ref_idx_l0_active_minus1);
+            slice_param->num_ref_idx_l0_active_minus1 = 28;
+        }
+
+        for (i = 0; i <= slice_param->num_ref_idx_l0_active_minus1; i += 4) {
+            reg_value = 0;
+            reg_value |= PICTURE2INDEX(ctx, &slice_param->RefPicList0[i]);
+            reg_value |= PICTURE2INDEX(ctx, &slice_param->RefPicList0[i+1]) << 8;
+            reg_value |= PICTURE2INDEX(ctx, &slice_param->RefPicList0[i+2]) << 16;
+            reg_value |= PICTURE2INDEX(ctx, &slice_param->RefPicList0[i+3]) << 24;
+            prep->list0[i / 4] = reg_value;
+        }
+    }
+
+    /* CHUNK: MVA and MVB, unused entries stay 0 */
+    if ((pic_params->pic_fields.bits.weighted_pred_flag && (slice_param->slice_type == ST_P)) ||
+        ((pic_params->pic_fields.bits.weighted_bipred_idc != 0) && (slice_param->slice_type == ST_B))) {
+        IMG_UINT32 num_ref_0 = slice_param->num_ref_idx_l0_active_minus1;
+
+        if (num_ref_0 > 31)
+            num_ref_0 = 31;
+
+        for (i = 0; i <= num_ref_0; i++) {
+            REGIO_WRITE_FIELD_MASKEDLITE(prep->weights[0][i], MSVDX_CMDS, H264_WEIGHTED_FACTORS_A, CR_WEIGHT_A,   slice_param->chroma_weight_l0[i][1]);/* Cr - 1 */
+            REGIO_WRITE_FIELD_MASKEDLITE(prep->weights[0][i], MSVDX_CMDS, H264_WEIGHTED_FACTORS_A, CB_WEIGHT_A,   slice_param->chroma_weight_l0[i][0]);/* Cb - 0 */
+            REGIO_WRITE_FIELD_MASKEDLITE(prep->weights[0][i], MSVDX_CMDS, H264_WEIGHTED_FACTORS_A, Y_WEIGHT_A,    slice_param->luma_weight_l0[i]);
+
+            REGIO_WRITE_FIELD_MASKEDLITE(prep->weights[1][i], MSVDX_CMDS, H264_WEIGHTED_OFFSET_A, CR_OFFSET_A,    slice_param->chroma_offset_l0[i][1]);/* Cr - 1 */
+            REGIO_WRITE_FIELD_MASKEDLITE(prep->weights[1][i], MSVDX_CMDS, H264_WEIGHTED_OFFSET_A, CB_OFFSET_A,    slice_param->chroma_offset_l0[i][0]);/* Cb - 0 */
+            REGIO_WRITE_FIELD_MASKEDLITE(prep->weights[1][i], MSVDX_CMDS, H264_WEIGHTED_OFFSET_A, Y_OFFSET_A,     slice_param->luma_offset_l0[i]);
+        }
+
+        if (slice_param->slice_type == ST_B) {
+            IMG_UINT32 num_ref_1 = slice_param->num_ref_idx_l1_active_minus1;
+
+            if (num_ref_1 > 31) {
+                drv_debug_msg(VIDEO_DEBUG_ERROR, "num_ref_1 shouldn't be larger than 31\n");
+                num_ref_1 = 31;
+            }
+
+            for (i = 0; i <= num_ref_1; i++) {
+                REGIO_WRITE_FIELD_MASKEDLITE(prep->weights[2][i], MSVDX_CMDS, H264_WEIGHTED_FACTORS_B, CR_WEIGHT_B,       slice_param->chroma_weight_l1[i][1]);/* Cr - 1 */
+                REGIO_WRITE_FIELD_MASKEDLITE(prep->weights[2][i], MSVDX_CMDS, H264_WEIGHTED_FACTORS_B, CB_WEIGHT_B,       slice_param->chroma_weight_l1[i][0]);/* Cb - 0 */
+                REGIO_WRITE_FIELD_MASKEDLITE(prep->weights[2][i], MSVDX_CMDS, H264_WEIGHTED_FACTORS_B, Y_WEIGHT_B,        slice_param->luma_weight_l1[i]);
+
+                REGIO_WRITE_FIELD_MASKEDLITE(prep->weights[3][i], MSVDX_CMDS, H264_WEIGHTED_OFFSET_B, CR_OFFSET_B,        slice_param->chroma_offset_l1[i][1]);/* Cr - 1 */
+                REGIO_WRITE_FIELD_MASKEDLITE(prep->weights[3][i], MSVDX_CMDS, H264_WEIGHTED_OFFSET_B, CB_OFFSET_B,        slice_param->chroma_offset_l1[i][0]);/* Cb - 0 */
+                REGIO_WRITE_FIELD_MASKEDLITE(prep->weights[3][i], MSVDX_CMDS, H264_WEIGHTED_OFFSET_B, Y_OFFSET_B, slice_param->luma_offset_l1[i]);
+            }
+        }
+    }
+}
+
+static void psb__H264_preprocess_slice(context_H264_p ctx,
+                                       VASliceParameterBufferH264 *slice_param)
+{
+    VAPictureParameterBufferH264 *pic_params = ctx->pic_params;
+    struct H264_slice_prep_s *prep = (struct H264_slice_prep_s *)ctx->dec_ctx.slice_prep;
+
+    ctx->first_mb_x = prep->first_mb_x;
+    ctx->first_mb_y = prep->first_mb_y;
+    ctx->slice0_params = 0;
+    ctx->slice1_params = 0;
+
+    ASSERT(pic_params);
+    if (!pic_params) {
+        /* This is an error */
+        return;
+    }
+
+    ctx->slice0_params = prep->slice0_params;
+    REGIO_WRITE_FIELD_LITE(ctx->slice0_params, MSVDX_VEC_H264, CR_VEC_H264_FE_SLICE0, SLICECOUNT,                                       ctx->slice_count);
+    ctx->slice1_params = prep->slice1_params;
 
     IMG_BOOL deblocker_disable = (slice_param->disable_deblocking_filter_idc  == 1);
 
@@ -1602,7 +1636,7 @@ static void psb__H264_write_VLC_tables(context_H264_p ctx)
 
     /* VLC Table */
     /* Write a LLDMA Cmd to transfer VLD Table data */
-    psb_cmdbuf_dma_write_cmdbuf(cmdbuf, &ctx->vlc_packed_table, 0,
+    psb_cmdbuf_dma_write_cmdbuf(cmdbuf, ctx->vlc_packed_table, 0,
                                   sizeof(ui16H264VLCTableData), 0,
                                   DMA_TYPE_VLC_TABLE);
 
@@ -32,6 +32,7 @@
 #include "tng_vld_dec.h"
 #include "psb_def.h"
 #include "psb_drv_debug.h"
+#include "psb_vlc_cache.h"
 #include "pnw_rotate.h"
 
 #include "hwdefs/reg_io2.h"
@@ -518,7 +519,7 @@ struct context_MPEG2_s {
     int got_iq_matrix;
 
     /* VLC packed data */
-    struct psb_buffer_s vlc_packed_table;
+    psb_buffer_p vlc_packed_table; /* own reference to the shared BO, see psb_vlc_cache.c */
 
     /* Misc */
     unsigned int previous_slice_vertical_position;
@@ -662,18 +663,9 @@ static VAStatus pnw_MPEG2_CreateContext(
     ctx->dec_ctx.preload_buffer = NULL;
 
     if (vaStatus == VA_STATUS_SUCCESS) {
-        vaStatus = psb_buffer_create(obj_context->driver_data,
-                                     sizeof(gaui16mpeg2VlcTableDataPacked),
-                                     psb_bt_cpu_vpu,
-                                     &ctx->vlc_packed_table);
-        DEBUG_FAILURE;
-    }
-    if (vaStatus == VA_STATUS_SUCCESS) {
-        unsigned char *vlc_packed_data_address;
-        if (0 ==  psb_buffer_map(&ctx->vlc_packed_table, &vlc_packed_data_address)) {
-            memcpy(vlc_packed_data_address, gaui16mpeg2VlcTableDataPacked, sizeof(gaui16mpeg2VlcTableDataPacked));
-            psb_buffer_unmap(&ctx->vlc_packed_table);
-        } else {
+        ctx->vlc_packed_table = psb_vlc_table_get(obj_context->driver_data, PSB_VLC_TABLE_MPEG2,
+                                                  sizeof(gaui16mpeg2VlcTableDataPacked), gaui16mpeg2VlcTableDataPacked, NULL);
+        if (NULL == ctx->vlc_packed_table) {
             vaStatus = VA_STATUS_ERROR_ALLOCATION_FAILED;
             DEBUG_FAILURE;
         }
@@ -698,7 +690,10 @@ static void pnw_MPEG2_DestroyContext(
 
     vld_dec_DestroyContext(&ctx->dec_ctx);
 
-    psb_buffer_destroy(&ctx->vlc_packed_table);
+    if (ctx->vlc_packed_table) {
+        psb_vlc_table_put(obj_context->driver_data, PSB_VLC_TABLE_MPEG2, ctx->vlc_packed_table);
+        ctx->vlc_packed_table = NULL;
+    }
 
     if (ctx->pic_params) {
         free(ctx->pic_params);
@@ -901,7 +896,7 @@ static void psb__MPEG2_write_VLC_tables(context_MPEG2_p ctx)
     psb_cmdbuf_skip_start_block(cmdbuf, SKIP_ON_CONTEXT_SWITCH);
     /* VLC Table */
     /* Write a LLDMA Cmd to transfer VLD Table data */
-    psb_cmdbuf_dma_write_cmdbuf(cmdbuf, &ctx->vlc_packed_table, 0,
+    psb_cmdbuf_dma_write_cmdbuf(cmdbuf, ctx->vlc_packed_table, 0,
                                   sizeof(gaui16mpeg2VlcTableDataPacked), 0,
                                   DMA_TYPE_VLC_TABLE);
 
@@ -32,6 +32,7 @@
 #include "tng_vld_dec.h"
 #include "psb_def.h"
 #include "psb_drv_debug.h"
+#include "psb_vlc_cache.h"
 
 #include "hwdefs/reg_io2.h"
 #include "hwdefs/msvdx_offsets.h"
@@ -1136,7 +1137,7 @@ struct context_MPEG4_s {
     int load_intra_quant_mat;
 
     /* VLC packed data */
-    struct psb_buffer_s vlc_packed_table;
+    psb_buffer_p vlc_packed_table; /* own reference to the shared BO, see psb_vlc_cache.c */
 
     /* FE state buffer */
     struct psb_buffer_s preload_buffer;
@@ -1319,18 +1320,9 @@ static VAStatus pnw_MPEG4_CreateContext(
     ctx->dec_ctx.preload_buffer = &ctx->preload_buffer;
 
     if (vaStatus == VA_STATUS_SUCCESS) {
-        vaStatus = psb_buffer_create(obj_context->driver_data,
-                                     sizeof(gaui16mpeg4VlcTableDataPacked),
-                                     psb_bt_cpu_vpu,
-                                     &ctx->vlc_packed_table);
-        DEBUG_FAILURE;
-    }
-    if (vaStatus == VA_STATUS_SUCCESS) {
-        unsigned char *vlc_packed_data_address;
-        if (0 ==  psb_buffer_map(&ctx->vlc_packed_table, &vlc_packed_data_address)) {
-            memcpy(vlc_packed_data_address, gaui16mpeg4VlcTableDataPacked, sizeof(gaui16mpeg4VlcTableDataPacked));
-            psb_buffer_unmap(&ctx->vlc_packed_table);
-        } else {
+        ctx->vlc_packed_table = psb_vlc_table_get(obj_context->driver_data, PSB_VLC_TABLE_MPEG4,
+                                                  sizeof(gaui16mpeg4VlcTableDataPacked), gaui16mpeg4VlcTableDataPacked, NULL);
+        if (NULL == ctx->vlc_packed_table) {
             vaStatus = VA_STATUS_ERROR_ALLOCATION_FAILED;
             DEBUG_FAILURE;
         }
@@ -1358,7 +1350,10 @@ static void pnw_MPEG4_DestroyContext(
 
     vld_dec_DestroyContext(&ctx->dec_ctx);
 
-    psb_buffer_destroy(&ctx->vlc_packed_table);
+    if (ctx->vlc_packed_table) {
+        psb_vlc_table_put(obj_context->driver_data, PSB_VLC_TABLE_MPEG4, ctx->vlc_packed_table);
+        ctx->vlc_packed_table = NULL;
+    }
     psb_buffer_destroy(&ctx->preload_buffer);
 
     if(ctx->data_partition_buffer0)
@@ -1704,7 +1699,7 @@ static void psb__MPEG4_write_VLC_tables(context_MPEG4_p ctx)
     psb_cmdbuf_skip_start_block(cmdbuf, SKIP_ON_CONTEXT_SWITCH);
     /* VLC Table */
     /* Write a LLDMA Cmd to transfer VLD Table data */
-    psb_cmdbuf_dma_write_cmdbuf(cmdbuf, &ctx->vlc_packed_table, 0,
+    psb_cmdbuf_dma_write_cmdbuf(cmdbuf, ctx->vlc_packed_table, 0,
                                   sizeof(gaui16mpeg4VlcTableDataPacked), 0,
                                   DMA_TYPE_VLC_TABLE);
 
@@ -31,6 +31,7 @@
 #include "pnw_VC1.h"
 #include "psb_def.h"
 #include "psb_drv_debug.h"
+#include "psb_vlc_cache.h"
 #include "pnw_rotate.h"
 
 #include "vc1_header.h"
@@ -47,6 +48,7 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <pthread.h>
 
 #define VC1_Header_Parser_HW
 
@@ -384,6 +386,20 @@ static void psb__VC1_pack_index_table_info(uint32_t *packed_index_table,
     }
 }
 
+static void psb__VC1_fill_vlc_table(unsigned char *dst, unsigned int __maybe_unused size)
+{
+    psb__VC1_pack_vlc_tables((uint16_t *)dst, gaui16vc1VlcTableData, gui16vc1VlcTableSize);
+}
+
+/* The index table only depends on the static VLC data, pack it once per process */
+static uint32_t psb__VC1_packed_index_table[VLC_INDEX_TABLE_SIZE];
+static pthread_once_t psb__VC1_index_table_once = PTHREAD_ONCE_INIT;
+
+static void psb__VC1_init_index_table(void)
+{
+    psb__VC1_pack_index_table_info(psb__VC1_packed_index_table, gaui16vc1VlcIndexData);
+}
+
 static VAStatus psb__VC1_check_legal_picture(object_context_p obj_context, object_config_p obj_config)
 {
     VAStatus vaStatus = VA_STATUS_SUCCESS;
@@ -538,23 +554,19 @@ static VAStatus pnw_VC1_CreateContext(
     }
 
     if (vaStatus == VA_STATUS_SUCCESS) {
-        vaStatus = psb_buffer_create(obj_context->driver_data,
-                                     (gui16vc1VlcTableSize * sizeof(IMG_UINT16) + 0xfff) & ~0xfff,
-                                     psb_bt_cpu_vpu,
-                                     &ctx->vlc_packed_table);
-        DEBUG_FAILURE;
-    }
-    if (vaStatus == VA_STATUS_SUCCESS) {
-        uint16_t *vlc_packed_data_address;
-        if (0 ==  psb_buffer_map(&ctx->vlc_packed_table, (unsigned char **)&vlc_packed_data_address)) {
-            psb__VC1_pack_vlc_tables(vlc_packed_data_address, gaui16vc1VlcTableData, gui16vc1VlcTableSize);
-            psb_buffer_unmap(&ctx->vlc_packed_table);
-            psb__VC1_pack_index_table_info(ctx->vlc_packed_index_table, gaui16vc1VlcIndexData);
-        } else {
+        ctx->vlc_packed_table = psb_vlc_table_get(obj_context->driver_data, PSB_VLC_TABLE_VC1,
+                                                  (gui16vc1VlcTableSize * sizeof(IMG_UINT16) + 0xfff) & ~0xfff,
+                                                  NULL, psb__VC1_fill_vlc_table);
+        if (NULL == ctx->vlc_packed_table) {
             vaStatus = VA_STATUS_ERROR_ALLOCATION_FAILED;
             DEBUG_FAILURE;
         }
     }
+    if (vaStatus == VA_STATUS_SUCCESS) {
+        pthread_once(&psb__VC1_index_table_once, psb__VC1_init_index_table);
+        memcpy(ctx->vlc_packed_index_table, psb__VC1_packed_index_table, sizeof(ctx->vlc_packed_index_table));
+        ctx->vlc_selection_valid = FALSE;
+    }
 
     if (vaStatus == VA_STATUS_SUCCESS) {
         vaStatus = vld_dec_CreateContext(&ctx->dec_ctx, obj_context);
@@ -576,7 +588,10 @@ static void pnw_VC1_DestroyContext(
 
     vld_dec_DestroyContext(&ctx->dec_ctx);
 
-    psb_buffer_destroy(&ctx->vlc_packed_table);
+    if (ctx->vlc_packed_table) {
+        psb_vlc_table_put(obj_context->driver_data, PSB_VLC_TABLE_VC1, ctx->vlc_packed_table);
+        ctx->vlc_packed_table = NULL;
+    }
     psb_buffer_destroy(&ctx->aux_msb_buffer);
     psb_buffer_destroy(&ctx->aux_line_buffer);
     psb_buffer_destroy(&ctx->preload_buffer);
@@ -1317,11 +1332,50 @@ static void psb__VC1_extract_table_info(context_VC1_p ctx, sTableData *psInfo, i
 /*
  * This function selects the VLD tables from the picture layer parameters.
  */
+static uint64_t psb__VC1_VLC_selection_key(context_VC1_p ctx)
+{
+    VAPictureParameterBufferVC1 *pic_params = ctx->pic_params;
+    uint64_t key;
+    uint32_t rate;
+
+    if (pic_params->pic_quantizer_fields.bits.pic_quantizer_scale <= 4)
+        rate = 0;
+    else if (pic_params->pic_quantizer_fields.bits.pic_quantizer_scale <= 12)
+        rate = 1;
+    else
+        rate = 2;
+
+    /* Every picture parameter psb__VC1_write_VLC_tables looks at */
+    key = pic_params->sequence_fields.bits.interlace;
+    key |= (uint64_t)(pic_params->picture_fields.bits.frame_coding_mode & 0x7) << 1;
+    key |= (uint64_t)(pic_params->picture_fields.bits.picture_type & 0x7) << 4;
+    key |= (uint64_t)(pic_params->cbp_table & 0xff) << 7;
+    key |= (uint64_t)(pic_params->mv_fields.bits.four_mv_block_pattern_table & 0x3) << 15;
+    key |= (uint64_t)(pic_params->mv_fields.bits.two_mv_block_pattern_table & 0x3) << 17;
+    key |= (uint64_t)(pic_params->mv_fields.bits.mv_table & 0x7) << 19;
+    key |= (uint64_t)(pic_params->reference_fields.bits.num_reference_pictures & 0x1) << 22;
+    key |= (uint64_t)(pic_params->mb_mode_table & 0xff) << 23;
+    key |= (uint64_t)(pic_params->mv_fields.bits.mv_mode == WMF_MVMODE_MIXED_MV) << 31;
+    key |= (uint64_t)(pic_params->mv_fields.bits.four_mv_switch & 0x1) << 32;
+    key |= (uint64_t)rate << 33;
+    key |= (uint64_t)(pic_params->transform_fields.bits.transform_ac_codingset_idx1 & 0x3) << 35;
+    key |= (uint64_t)(pic_params->transform_fields.bits.transform_ac_codingset_idx2 & 0x3) << 37;
+    key |= (uint64_t)(ctx->pqindex_gt8 ? 1 : 0) << 39;
+    key |= (uint64_t)(pic_params->transform_fields.bits.intra_transform_dc_table & 0x1) << 40;
+
+    return key;
+}
+
 static void psb__VC1_write_VLC_tables(context_VC1_p ctx)
 {
     VAPictureParameterBufferVC1 *pic_params = ctx->pic_params;
     IMG_UINT16          ui16Table = 0, ui16IntraTable = 0, ui16InterTable = 0, aui16Table[3];
     IMG_UINT32          i, ui32TableNum = 0;
+    uint64_t            key = psb__VC1_VLC_selection_key(ctx);
+
+    /* Consecutive pictures usually select the same tables */
+    if (ctx->vlc_selection_valid && (ctx->vlc_selection_key == key))
+        return;
 
     /* select the required table from the n different types
             A - vc1DEC_I_Picture_CBPCY_VLC            (1)       
@@ -1691,6 +1745,9 @@ static void psb__VC1_write_VLC_tables(context_VC1_p ctx)
         this should be constant and equal 12 */
     ctx->ui32NumTables = ui32TableNum;
     ASSERT(ctx->ui32NumTables == 12);
+
+    ctx->vlc_selection_key = key;
+    ctx->vlc_selection_valid = TRUE;
 }
 
 static void psb__VC1_build_VLC_tables(context_VC1_p ctx)
@@ -1709,7 +1766,7 @@ static void psb__VC1_build_VLC_tables(context_VC1_p ctx)
 
         /* VLC Table */
         /* Write a LLDMA Cmd to transfer VLD Table data */
-        psb_cmdbuf_dma_write_cmdbuf(cmdbuf, &ctx->vlc_packed_table,
+        psb_cmdbuf_dma_write_cmdbuf(cmdbuf, ctx->vlc_packed_table,
                                       ctx->sTableInfo[i].aui16StartLocation * sizeof(IMG_UINT16), /* origin */
                                       ctx->sTableInfo[i].aui16VLCTableLength * sizeof(IMG_UINT16), /* size */
                                       RAM_location * sizeof(IMG_UINT32), /* destination */
@@ -2555,7 +2612,7 @@ static void psb__VC1_Send_Parse_Header_Cmd(context_VC1_p ctx, IMG_BOOL new_pic)
     RELOC(pParseHeaderCMD->ui32BitplaneAddr[2], ctx->bitplane_hw_buffer.buffer_ofs + 0xa000 * 2, &ctx->bitplane_hw_buffer);
 
 //        pParseHeaderCMD->ui32VLCTableAddr       =       psVlcPackedTableData->GetTopDeviceMemAlloc()->GetDeviceVirtAddress();
-    RELOC(pParseHeaderCMD->ui32VLCTableAddr, ctx->vlc_packed_table.buffer_ofs, &ctx->vlc_packed_table);
+    RELOC(pParseHeaderCMD->ui32VLCTableAddr, ctx->vlc_packed_table->buffer_ofs, ctx->vlc_packed_table);
     /*
         pParseHeaderCMD->ui32ICParamData[0]      = ((msPicParam.wBitstreamFcodes >> 8) & 0xFF);
         pParseHeaderCMD->ui32ICParamData[0] |= ((msPicParam.wBitstreamPCEelements >> 8) & 0xFF) << 8;
@@ -2627,7 +2684,7 @@ static void psb__VC1_end_slice(context_DEC_p dec_ctx)
     if (psb_video_trace_fp && (psb_video_trace_level & AUXBUF_TRACE)) {
         psb__debug_schedule_hexdump("Preload buffer", &ctx->preload_buffer, 0, PRELOAD_BUFFER_SIZE);
         psb__debug_schedule_hexdump("AUXMSB buffer", &ctx->aux_msb_buffer, 0, 0x8000 /* AUXMSB_BUFFER_SIZE */);
-        psb__debug_schedule_hexdump("VLC Table", &ctx->vlc_packed_table, 0, gui16vc1VlcTableSize * sizeof(IMG_UINT16));
+        psb__debug_schedule_hexdump("VLC Table", ctx->vlc_packed_table, 0, gui16vc1VlcTableSize * sizeof(IMG_UINT16));
     }
 
     ctx->is_first_slice = FALSE; /* Reset */
@@ -566,6 +566,7 @@ int pnw_context_flush_cmdbuf(object_context_p obj_context)
     struct psb_ttm_fence_rep fence_rep;
     unsigned int reloc_offset;
     unsigned int num_relocs;
+    uint64_t submit_start_us;
     int ret;
     unsigned int cmdbuffer_size = (unsigned char *) cmdbuf->cmd_idx - cmdbuf->cmd_start; /* In bytes */
 
@@ -596,6 +597,7 @@ int pnw_context_flush_cmdbuf(object_context_p obj_context)
 #define LNC_ENGINE_ENCODE  5
 #endif
 
+    submit_start_us = psb_stats_now_us();
     wsbmWriteLockKernelBO();
     ret = pnwDRMCmdBuf(driver_data->drm_fd, driver_data->execIoctlOffset, /* FIXME Still use ioctl cmd? */
                        cmdbuf->buffer_refs, cmdbuf->buffer_refs_count, wsbmKBufHandle(wsbmKBuf(cmdbuf->buf.drm_buf)),
@@ -605,6 +607,7 @@ int pnw_context_flush_cmdbuf(object_context_p obj_context)
 
     wsbmWriteUnlockKernelBO();
     UNLOCK_HARDWARE(driver_data);
+    psb_stats_submit(obj_context, submit_start_us);
 
     if (ret) {
         obj_context->pnw_cmdbuf = NULL;
@@ -29,6 +29,7 @@
 
 #include <sys/types.h>
 #include "psb_buffer.h"
+#include "psb_coded_iov.h"
 
 #include <errno.h>
 #include <stdlib.h>
@@ -48,6 +49,7 @@
 
 #include "psb_def.h"
 #include "psb_drv_debug.h"
+#include "psb_cmdbuf.h"
 #include "tng_cmdbuf.h"
 
 #ifndef BAYTRAIL
@@ -78,6 +80,7 @@ VAStatus psb_buffer_create(psb_driver_data_p driver_data,
 
     buf->type = type;
     buf->driver_data = driver_data; /* only for RAR buffers */
+    buf->submit_seq = 0;
     buf->size = size;
     /* TODO: Mask values are a guess */
     switch (type) {
@@ -221,6 +224,7 @@ VAStatus psb_buffer_create_from_ub(psb_driver_data_p driver_data,
 
     buf->type = type;
     buf->driver_data = driver_data; /* only for RAR buffers */
+    buf->submit_seq = 0;
     buf->user_ptr = vaddr;
     buf->fd = fd;
 
@@ -351,6 +355,7 @@ VAStatus psb_kbuffer_reference(psb_driver_data_p driver_data,
     VAStatus vaStatus = VA_STATUS_SUCCESS;
 
     buf->drm_buf = NULL;
+    buf->submit_seq = 0;
 
     ret = LOCK_HARDWARE(driver_data);
     if (ret) {
@@ -387,6 +392,20 @@ VAStatus psb_kbuffer_reference(psb_driver_data_p driver_data,
  * Destroy buffer
  */
 void psb_buffer_destroy(psb_buffer_p buf)
+{
+    ASSERT(buf);
+    if (buf->drm_buf == NULL)
+        return;
+    /* a queued cmdbuf still lists the BO */
+    if (psb_bs_unfinished != buf->status)
+        psb_cmdbuf_buffer_wait_submitted(buf);
+    psb_buffer_release(buf);
+}
+
+/*
+ * Release buffer
+ */
+void psb_buffer_release(psb_buffer_p buf)
 {
     ASSERT(buf);
     if (buf->drm_buf == NULL)
@@ -401,6 +420,45 @@ void psb_buffer_destroy(psb_buffer_p buf)
     }
 }
 
+/*
+ * Check whether the GPU may still access the buffer
+ *
+ * Returns 0 when the buffer is idle, without blocking on its fence
+ */
+int psb_buffer_is_busy(psb_buffer_p buf)
+{
+    int ret;
+    uint32_t synccpu_flag = WSBM_SYNCCPU_READ | WSBM_SYNCCPU_WRITE | WSBM_SYNCCPU_DONT_BLOCK;
+
+    ASSERT(buf);
+
+    if (psb_bs_queued == buf->status)
+        return 1;
+    if (psb_cmdbuf_buffer_submit_pending(buf))
+        return 1;
+    if ((buf->drm_buf == NULL) || buf->wsbm_synccpu_flag)
+        return 0;
+
+    ret = wsbmBOSyncForCpu(buf->drm_buf, synccpu_flag);
+    if (ret)
+        return 1;
+
+    (void) wsbmBOReleaseFromCpu(buf->drm_buf, synccpu_flag);
+    return 0;
+}
+
+/*
+ * Wait for buffer to become idle
+ */
+void psb_buffer_wait_idle(psb_buffer_p buf)
+{
+    ASSERT(buf);
+
+    psb_cmdbuf_buffer_wait_submitted(buf);
+    if (buf->drm_buf)
+        wsbmBOWaitIdle(buf->drm_buf, 0);
+}
+
 /*
  * Map buffer
  *
@@ -421,6 +479,9 @@ int psb_buffer_map(psb_buffer_p buf, unsigned char **address /* out */)
         psb_buffer_unmap(buf);
     }
 
+    /* the fence of a cmdbuf still waiting for the submission thread isn't attached yet */
+    psb_cmdbuf_buffer_wait_submitted(buf);
+
     /* don't think TG deal with READ/WRITE differently */
     buf->wsbm_synccpu_flag = WSBM_SYNCCPU_READ | WSBM_SYNCCPU_WRITE;
     if (psb_video_trace_fp) {
@@ -522,6 +583,7 @@ static void tng_get_coded_data(
 	tmp = (tmp + 15) & (~15);
 	drv_debug_msg(VIDEO_DEBUG_GENERAL, "Force slice size from %d to %d\n",
                       vaCodedBufSeg[iPipeIndex].size, tmp);
+	obj_buffer->codedbuf_pad[iPipeIndex] = tmp - vaCodedBufSeg[iPipeIndex].size;
 	vaCodedBufSeg[iPipeIndex].size  = tmp;
     }
 
@@ -551,6 +613,7 @@ static void tng_get_coded_data(
             drv_debug_msg(VIDEO_DEBUG_GENERAL,"Force slice size from %d to %d\n",
                           vaCodedBufSeg[iPipeIndex].size, tmp);
 
+            obj_buffer->codedbuf_pad[iPipeIndex] = tmp - vaCodedBufSeg[iPipeIndex].size;
             vaCodedBufSeg[iPipeIndex].size  = tmp;
         }
 
@@ -602,6 +665,7 @@ int psb_codedbuf_map_mangle(
     raw_codedbuf = *pbuf;
     /* reset the mapinfo */
     memset(obj_buffer->codedbuf_mapinfo, 0, sizeof(obj_buffer->codedbuf_mapinfo));
+    memset(obj_buffer->codedbuf_pad, 0, sizeof(obj_buffer->codedbuf_pad));
 
     *pbuf = p = &obj_buffer->codedbuf_mapinfo[0];
 #ifdef PSBVIDEO_MRFL
@@ -833,3 +897,102 @@ int psb_codedbuf_map_mangle(
     return 0;
 }
 
+/*
+ * Counts one scatter list entry and stores it when there is room
+ */
+static unsigned int psb__codedbuf_add_iov(
+    struct iovec *iov, uint32_t *info, unsigned int max_iov, unsigned int n,
+    unsigned char *data, unsigned int size, uint32_t entry_info)
+{
+    if (size == 0)
+        return n;
+
+    if (n < max_iov) {
+        iov[n].iov_base = data;
+        iov[n].iov_len = size;
+        if (info)
+            info[n] = entry_info;
+    }
+    return n + 1;
+}
+
+/*
+ * Adds one entry per NAL unit of an Annex B byte stream. A zero byte ahead
+ * of 00 00 01 is taken as the first byte of a four byte start code.
+ */
+static unsigned int psb__codedbuf_split_nal(
+    struct iovec *iov, uint32_t *info, unsigned int max_iov, unsigned int n,
+    unsigned char *data, unsigned int size, uint32_t entry_info)
+{
+    unsigned int i = 0, start = 0, nal;
+
+    while (i + 2 < size) {
+        /* no start code can begin in data[i..i+2] */
+        if (data[i + 2] > 1) {
+            i += 3;
+            continue;
+        }
+        if (data[i + 2] == 1 && data[i] == 0 && data[i + 1] == 0) {
+            nal = (i > start && data[i - 1] == 0) ? i - 1 : i;
+            if (nal > start) {
+                n = psb__codedbuf_add_iov(iov, info, max_iov, n, data + start, nal - start, entry_info);
+                entry_info = 0;
+            }
+            start = nal;
+            entry_info |= PSB_CODED_IOV_NAL_START;
+            if (i + 3 < size)
+                entry_info |= (data[i + 3] & 0x1f) << 8;
+            i += 3;
+            continue;
+        }
+        i++;
+    }
+
+    return psb__codedbuf_add_iov(iov, info, max_iov, n, data + start, size - start, entry_info);
+}
+
+VAStatus psb_codedbuf_get_iov(
+    object_buffer_p obj_buffer,
+    struct iovec *iov,
+    uint32_t *info,
+    unsigned int max_iov,
+    unsigned int *num_iov,
+    unsigned int flags
+)
+{
+    VACodedBufferSegment *seg = &obj_buffer->codedbuf_mapinfo[0];
+    VAProfile profile = VAProfileNone;
+    unsigned int n = 0, i, size, pad;
+    uint32_t entry_info;
+
+    *num_iov = 0;
+    if (obj_buffer->type != VAEncCodedBufferType || obj_buffer->buffer_data == NULL)
+        return VA_STATUS_ERROR_INVALID_BUFFER;
+
+    if (obj_buffer->context)
+        profile = obj_buffer->context->profile;
+
+    for (i = 0; seg && i < PSB_CODEDBUF_SEGMENT_MAX; seg = seg->next, i++) {
+        size = seg->size;
+        pad = obj_buffer->codedbuf_pad[seg - obj_buffer->codedbuf_mapinfo];
+        if (pad > size)
+            pad = 0;
+        size -= pad;
+
+        entry_info = PSB_CODED_IOV_SEGMENT;
+        if (profile == VAProfileJPEGBaseline && i == 0)
+            entry_info |= PSB_CODED_IOV_JPEG_HEADER;
+
+        if (PROFILE_H264(profile) && (flags & PSB_CODED_IOV_SPLIT_NAL))
+            n = psb__codedbuf_split_nal(iov, info, max_iov, n, seg->buf, size, entry_info);
+        else
+            n = psb__codedbuf_add_iov(iov, info, max_iov, n, seg->buf, size, entry_info);
+
+        if (!(flags & PSB_CODED_IOV_NO_PADDING))
+            n = psb__codedbuf_add_iov(iov, info, max_iov, n, seg->buf + size, pad, PSB_CODED_IOV_PADDING);
+    }
+
+    *num_iov = n;
+    return (n > max_iov) ? VA_STATUS_ERROR_MAX_NUM_EXCEEDED : VA_STATUS_SUCCESS;
+}
+
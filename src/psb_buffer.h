@@ -30,6 +30,7 @@
 #ifndef _PSB_BUFFER_H_
 #define _PSB_BUFFER_H_
 
+#include <sys/uio.h>
 #include "psb_drv_video.h"
 
 //#include "xf86mm.h"
@@ -83,6 +84,7 @@ struct psb_buffer_s {
     void *handle;
     unsigned char *virtual_addr;
     int unfence_flag;
+    unsigned int submit_seq; /* last asynchronously submitted cmdbuf referencing this buffer */
 };
 
 /*
@@ -139,6 +141,24 @@ void psb__suspend_buffer(psb_driver_data_p driver_data, object_buffer_p obj_buff
  */
 void psb_buffer_destroy(psb_buffer_p buf);
 
+/*
+ * Destroy buffer without waiting for asynchronous submission, for the
+ * submitter releasing buffers abandoned by the cmdbuf it just sent
+ */
+void psb_buffer_release(psb_buffer_p buf);
+
+/*
+ * Check whether the GPU may still access the buffer
+ *
+ * Returns 0 when the buffer is idle
+ */
+int psb_buffer_is_busy(psb_buffer_p buf);
+
+/*
+ * Block until the GPU is done with the buffer, without mapping it
+ */
+void psb_buffer_wait_idle(psb_buffer_p buf);
+
 /*
  * Map buffer
  *
@@ -152,6 +172,18 @@ int psb_codedbuf_map_mangle(
     void **pbuf /* out */
 );
 
+/*
+ * Scatter list of a mapped coded buffer, see psb_coded_iov.h
+ */
+VAStatus psb_codedbuf_get_iov(
+    object_buffer_p obj_buffer,
+    struct iovec *iov,
+    uint32_t *info,
+    unsigned int max_iov,
+    unsigned int *num_iov,
+    unsigned int flags
+);
+
 
 /*
  * Unmap buffer
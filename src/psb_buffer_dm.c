@@ -181,6 +181,7 @@ VAStatus psb_buffer_create_camera_from_ub(psb_driver_data_p driver_data,
     buf->type = psb_bt_user_buffer;
     buf->user_ptr = (unsigned char *)user_ptr;
     buf->driver_data = driver_data;
+    buf->submit_seq = 0;
 
     allignment = 4096;
     placement =  DRM_PSB_FLAG_MEM_MMU | WSBM_PL_FLAG_TT | WSBM_PL_FLAG_CACHED | WSBM_PL_FLAG_SHARED ;
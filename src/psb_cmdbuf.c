@@ -51,9 +51,12 @@
 #include <errno.h>
 #include <string.h>
 #include <sys/time.h>
+#include <pthread.h>
+#include <semaphore.h>
 
 #include "psb_def.h"
 #include "psb_drv_debug.h"
+#include "psb_record.h"
 #ifndef BAYTRAIL
 #include "psb_ws_driver.h"
 #endif
@@ -64,7 +67,7 @@
 
 /*
  * Buffer layout:
- *         cmd_base <= cmd_idx < CMD_END() == lldma_base
+ *         cmd_base <= cmd_idx < CMD_END() == lldma_base == cmd_base + cmd_size
  *         lldma_base <= lldma_idx < LLDMA_END() == (cmd_base + size)
  *
  * Reloc buffer layout:
@@ -77,12 +80,19 @@
 #define CMD_END(cmdbuf)       (cmdbuf->lldma_base)
 #define LLDMA_END(cmdbuf)     (cmdbuf->cmd_base + cmdbuf->size)
 
+/*
+ * Region sizes for SD content. Larger pictures start from a multiple of
+ * these, and a region that forces a flush in the middle of a picture is
+ * doubled (up to REGION_GROW_MAX times the base) for the following cmdbufs.
+ */
 #define MTXMSG_SIZE           (0x1000)
 #define RELOC_SIZE            (0x3000)
 
 #define CMD_SIZE              (0x3000)
 #define LLDMA_SIZE            (0x2000)
 
+#define REGION_GROW_MAX       (8)
+
 #define MTXMSG_MARGIN         (0x0040)
 #define RELOC_MARGIN          (0x0800)
 
@@ -93,16 +103,55 @@
 /*
  * Create command buffer
  */
+static void psb__cmdbuf_init_region_sizes(object_context_p obj_context)
+{
+    unsigned int mb_count = (obj_context->picture_width >> 4) * (obj_context->picture_height >> 4);
+    unsigned int scale = 1;
+
+    /* more macroblocks generally means more slices per picture */
+    if (mb_count > 3600)            /* above 720p */
+        scale = 4;
+    else if (mb_count > 1620)       /* above SD */
+        scale = 2;
+
+    obj_context->cmdbuf_cmd_size = CMD_SIZE * scale;
+    obj_context->cmdbuf_lldma_size = LLDMA_SIZE * scale;
+    obj_context->cmdbuf_reloc_size = RELOC_SIZE * scale;
+}
+
+static VAStatus psb__cmdbuf_alloc_regions(psb_driver_data_p driver_data, object_context_p obj_context,
+                                          psb_cmdbuf_p cmdbuf)
+{
+    VAStatus vaStatus;
+    unsigned int size = obj_context->cmdbuf_cmd_size + obj_context->cmdbuf_lldma_size;
+    unsigned int reloc_size = MTXMSG_SIZE + obj_context->cmdbuf_reloc_size;
+
+    vaStatus = psb_buffer_create(driver_data, size, psb_bt_cpu_vpu, &cmdbuf->buf);
+    if (VA_STATUS_SUCCESS != vaStatus)
+        return vaStatus;
+    cmdbuf->size = size;
+    cmdbuf->cmd_size = obj_context->cmdbuf_cmd_size;
+
+    vaStatus = psb_buffer_create(driver_data, reloc_size, psb_bt_cpu_only, &cmdbuf->reloc_buf);
+    if (VA_STATUS_SUCCESS != vaStatus)
+        return vaStatus;
+    cmdbuf->reloc_size = reloc_size;
+
+    return VA_STATUS_SUCCESS;
+}
+
 VAStatus psb_cmdbuf_create(object_context_p obj_context, psb_driver_data_p driver_data,
                            psb_cmdbuf_p cmdbuf
                           )
 {
     VAStatus vaStatus = VA_STATUS_SUCCESS;
-    unsigned int size = CMD_SIZE + LLDMA_SIZE;
-    unsigned int reloc_size = MTXMSG_SIZE + RELOC_SIZE;
     unsigned int regio_size = (obj_context->picture_width >> 4) * (obj_context->picture_height >> 4) * 172;
 
+    if (obj_context->cmdbuf_cmd_size == 0)
+        psb__cmdbuf_init_region_sizes(obj_context);
+
     cmdbuf->size = 0;
+    cmdbuf->cmd_size = 0;
     cmdbuf->reloc_size = 0;
     cmdbuf->regio_size = 0;
     cmdbuf->MTX_msg = NULL;
@@ -120,6 +169,9 @@ VAStatus psb_cmdbuf_create(object_context_p obj_context, psb_driver_data_p drive
     cmdbuf->rendec_chunk_start = NULL;
     cmdbuf->skip_block_start = NULL;
     cmdbuf->last_next_segment_cmd = NULL;
+    cmdbuf->submit_next = NULL;
+    cmdbuf->submit_pending = 0;
+    cmdbuf->submit_ret = 0;
     cmdbuf->buffer_refs_count = 0;
     cmdbuf->buffer_refs_allocated = 10;
     cmdbuf->buffer_refs = (psb_buffer_p *) calloc(1, sizeof(psb_buffer_p) * cmdbuf->buffer_refs_allocated);
@@ -128,12 +180,7 @@ VAStatus psb_cmdbuf_create(object_context_p obj_context, psb_driver_data_p drive
         vaStatus = VA_STATUS_ERROR_ALLOCATION_FAILED;
     }
     if (VA_STATUS_SUCCESS == vaStatus) {
-        vaStatus = psb_buffer_create(driver_data, size, psb_bt_cpu_vpu, &cmdbuf->buf);
-        cmdbuf->size = size;
-    }
-    if (VA_STATUS_SUCCESS == vaStatus) {
-        vaStatus = psb_buffer_create(driver_data, reloc_size, psb_bt_cpu_only, &cmdbuf->reloc_buf);
-        cmdbuf->reloc_size = reloc_size;
+        vaStatus = psb__cmdbuf_alloc_regions(driver_data, obj_context, cmdbuf);
     }
     if (VA_STATUS_SUCCESS == vaStatus) {
         vaStatus = psb_buffer_create(driver_data, regio_size, psb_bt_cpu_only, &cmdbuf->regio_buf);
@@ -149,8 +196,12 @@ VAStatus psb_cmdbuf_create(object_context_p obj_context, psb_driver_data_p drive
 /*
  * Destroy buffer
  */
+static void psb__cmdbuf_wait_submitted(psb_cmdbuf_p cmdbuf);
+
 void psb_cmdbuf_destroy(psb_cmdbuf_p cmdbuf)
 {
+    psb__cmdbuf_wait_submitted(cmdbuf);
+
     if (cmdbuf->size) {
         psb_buffer_destroy(&cmdbuf->buf);
         cmdbuf->size = 0;
@@ -211,7 +262,7 @@ int psb_cmdbuf_reset(psb_cmdbuf_p cmdbuf)
     cmdbuf->cmd_start = cmdbuf->cmd_base;
     cmdbuf->cmd_idx = (uint32_t *) cmdbuf->cmd_base;
     cmdbuf->cmd_bitstream_size = NULL;
-    cmdbuf->lldma_base = cmdbuf->cmd_base + CMD_SIZE;
+    cmdbuf->lldma_base = cmdbuf->cmd_base + cmdbuf->cmd_size;
     cmdbuf->lldma_idx = cmdbuf->lldma_base;
 
     cmdbuf->reloc_base = cmdbuf->MTX_msg + MTXMSG_SIZE;
@@ -278,6 +329,9 @@ int psb_cmdbuf_buffer_ref(psb_cmdbuf_p cmdbuf, psb_buffer_p buf)
         }
         cmdbuf->buffer_refs[item_loc] = buf;
         cmdbuf->buffer_refs_count++;
+
+        /* an earlier cmdbuf still on the submission thread owns status/next */
+        psb_cmdbuf_buffer_wait_submitted(buf);
         buf->status = psb_bs_queued;
 
         buf->next = NULL;
@@ -297,6 +351,7 @@ int psb_cmdbuf_buffer_ref(psb_cmdbuf_p cmdbuf, psb_buffer_p buf)
         }
 
         if (tmp != buf) {
+            psb_cmdbuf_buffer_wait_submitted(buf);
             tmp->next = buf; /* link it */
             buf->status = psb_bs_queued;
             buf->next = NULL;
@@ -386,6 +441,32 @@ int psb_context_get_next_cmdbuf(object_context_p obj_context)
         obj_context->cmdbuf_current = 0;
     }
     cmdbuf = obj_context->cmdbuf_list[obj_context->cmdbuf_current];
+
+    /* The ring wrapped around onto a cmdbuf the submission thread still owns */
+    psb__cmdbuf_wait_submitted(cmdbuf);
+    if (cmdbuf->submit_ret) {
+        drv_debug_msg(VIDEO_DEBUG_ERROR, "asynchronous cmdbuf submission failed (%d)\n", cmdbuf->submit_ret);
+        cmdbuf->submit_ret = 0;
+    }
+
+    /* Catch up with regions grown since this cmdbuf was allocated */
+    if ((cmdbuf->cmd_size != obj_context->cmdbuf_cmd_size) ||
+        (cmdbuf->size != obj_context->cmdbuf_cmd_size + obj_context->cmdbuf_lldma_size) ||
+        (cmdbuf->reloc_size != MTXMSG_SIZE + obj_context->cmdbuf_reloc_size)) {
+        if (cmdbuf->size)
+            psb_buffer_destroy(&cmdbuf->buf);
+        if (cmdbuf->reloc_size)
+            psb_buffer_destroy(&cmdbuf->reloc_buf);
+        cmdbuf->size = 0;
+        cmdbuf->reloc_size = 0;
+        if (VA_STATUS_SUCCESS != psb__cmdbuf_alloc_regions(obj_context->driver_data, obj_context, cmdbuf)) {
+            drv_debug_msg(VIDEO_DEBUG_ERROR, "failed to grow cmdbuf\n");
+            return -ENOMEM;
+        }
+        drv_debug_msg(VIDEO_DEBUG_GENERAL, "cmdbuf grown to cmd %08x lldma %08x reloc %08x\n",
+                      cmdbuf->cmd_size, cmdbuf->size - cmdbuf->cmd_size, cmdbuf->reloc_size - MTXMSG_SIZE);
+    }
+
     ret = psb_cmdbuf_reset(cmdbuf);
     if (!ret) {
         /* Success */
@@ -563,7 +644,8 @@ out:
                 break;
 
             case psb_bs_abandoned:
-                psb_buffer_destroy(p);
+                /* may run on the submission thread, which would wait for itself */
+                psb_buffer_release(p);
                 free(p);
                 break;
 
@@ -577,6 +659,262 @@ out:
     return ret;
 }
 
+/*
+ * Asynchronous submission
+ *
+ * psb_context_flush_cmdbuf pushes finished cmdbufs onto a lock-free LIFO
+ * and returns. A single thread per driver instance detaches the whole
+ * list, restores submission order and issues all of it under one
+ * LOCK_HARDWARE, so decoders running on several threads no longer queue
+ * up on drm_mutex one ioctl at a time.
+ */
+struct psb_submit_queue_s {
+    psb_driver_data_p driver_data;
+    psb_cmdbuf_p head;                  /* pushed by any thread, detached by the submitter */
+    int outstanding;                    /* pushed but not yet returned from the kernel */
+    pthread_mutex_t push_lock;          /* keeps the list in submit_seq order */
+    unsigned int push_seq;              /* submit_seq of the last pushed cmdbuf */
+    unsigned int done_seq;              /* every cmdbuf up to this submit_seq is in the kernel */
+    int quit;
+    sem_t wake;
+    pthread_mutex_t idle_lock;
+    pthread_cond_t idle_cond;
+    pthread_t thread;
+
+    unsigned int batch_count;
+    unsigned int cmdbuf_count;
+};
+
+static void psb__submit_batch(struct psb_submit_queue_s *queue, psb_cmdbuf_p list, unsigned int last_seq)
+{
+    psb_driver_data_p driver_data = queue->driver_data;
+    struct psb_ttm_fence_rep fence_rep;
+    psb_cmdbuf_p cmdbuf, next;
+    int ret;
+
+    ret = LOCK_HARDWARE(driver_data);
+    if (!ret) {
+        wsbmWriteLockKernelBO();
+        for (cmdbuf = list; cmdbuf; cmdbuf = cmdbuf->submit_next) {
+            cmdbuf->submit_ret = psbDRMCmdBuf(driver_data->drm_fd, driver_data->execIoctlOffset,
+                                              cmdbuf->buffer_refs, cmdbuf->buffer_refs_count,
+                                              wsbmKBufHandle(wsbmKBuf(cmdbuf->reloc_buf.drm_buf)),
+                                              0, cmdbuf->submit_msg_size,
+                                              wsbmKBufHandle(wsbmKBuf(cmdbuf->reloc_buf.drm_buf)),
+                                              cmdbuf->submit_reloc_offset, cmdbuf->submit_num_relocs,
+                                              0, PSB_ENGINE_DECODE, cmdbuf->submit_fence_flags, &fence_rep);
+            queue->cmdbuf_count++;
+        }
+        wsbmWriteUnlockKernelBO();
+    } else {
+        for (cmdbuf = list; cmdbuf; cmdbuf = cmdbuf->submit_next)
+            cmdbuf->submit_ret = ret;
+    }
+    UNLOCK_HARDWARE(driver_data);
+    queue->batch_count++;
+
+    /* Hand the cmdbufs back; they may be reset as soon as pending drops */
+    pthread_mutex_lock(&queue->idle_lock);
+    for (cmdbuf = list; cmdbuf; cmdbuf = next) {
+        next = cmdbuf->submit_next;
+        cmdbuf->submit_next = NULL;
+        __atomic_store_n(&cmdbuf->submit_pending, 0, __ATOMIC_RELEASE);
+        __atomic_sub_fetch(&queue->outstanding, 1, __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(&queue->done_seq, last_seq, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&queue->idle_cond);
+    pthread_mutex_unlock(&queue->idle_lock);
+}
+
+static void *psb__submit_thread(void *arg)
+{
+    struct psb_submit_queue_s *queue = (struct psb_submit_queue_s *)arg;
+    psb_cmdbuf_p list, fifo, next;
+    unsigned int last_seq;
+
+    for (;;) {
+        while (sem_wait(&queue->wake) && (errno == EINTR))
+            ;
+
+        list = __atomic_exchange_n(&queue->head, NULL, __ATOMIC_ACQUIRE);
+        if (list == NULL) {
+            if (__atomic_load_n(&queue->quit, __ATOMIC_ACQUIRE))
+                break;
+            continue; /* already taken by an earlier wakeup */
+        }
+
+        /* pushes are serialized, so the head is the newest and everything older is already detached */
+        last_seq = list->submit_seq;
+
+        /* LIFO to submission order */
+        fifo = NULL;
+        while (list) {
+            next = list->submit_next;
+            list->submit_next = fifo;
+            fifo = list;
+            list = next;
+        }
+        psb__submit_batch(queue, fifo, last_seq);
+    }
+
+    return NULL;
+}
+
+/*
+ * Tags every buffer the cmdbuf references with its sequence number, so
+ * that waiters only block until that particular cmdbuf is in the kernel
+ */
+static void psb__submit_push(struct psb_submit_queue_s *queue, psb_cmdbuf_p cmdbuf)
+{
+    psb_cmdbuf_p head;
+    unsigned int seq;
+    int i;
+
+    cmdbuf->submit_ret = 0;
+    __atomic_store_n(&cmdbuf->submit_pending, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&queue->outstanding, 1, __ATOMIC_RELAXED);
+
+    pthread_mutex_lock(&queue->push_lock);
+    seq = ++queue->push_seq;
+    cmdbuf->submit_seq = seq;
+    for (i = 0; i < cmdbuf->buffer_refs_count; i++)
+        __atomic_store_n(&cmdbuf->buffer_refs[i]->submit_seq, seq, __ATOMIC_RELAXED);
+
+    head = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+    do {
+        cmdbuf->submit_next = head;
+    } while (!__atomic_compare_exchange_n(&queue->head, &head, cmdbuf, 1,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    pthread_mutex_unlock(&queue->push_lock);
+    sem_post(&queue->wake);
+}
+
+static int psb__submit_seq_done(struct psb_submit_queue_s *queue, unsigned int seq)
+{
+    return (int)(seq - __atomic_load_n(&queue->done_seq, __ATOMIC_ACQUIRE)) <= 0;
+}
+
+int psb_cmdbuf_buffer_submit_pending(psb_buffer_p buf)
+{
+    struct psb_submit_queue_s *queue = buf->driver_data ? buf->driver_data->submit_queue : NULL;
+
+    if (queue == NULL)
+        return 0;
+
+    return !psb__submit_seq_done(queue, __atomic_load_n(&buf->submit_seq, __ATOMIC_RELAXED));
+}
+
+void psb_cmdbuf_buffer_wait_submitted(psb_buffer_p buf)
+{
+    struct psb_submit_queue_s *queue = buf->driver_data ? buf->driver_data->submit_queue : NULL;
+    unsigned int seq;
+
+    if (queue == NULL)
+        return;
+
+    seq = __atomic_load_n(&buf->submit_seq, __ATOMIC_RELAXED);
+    if (psb__submit_seq_done(queue, seq))
+        return;
+
+    pthread_mutex_lock(&queue->idle_lock);
+    while (!psb__submit_seq_done(queue, seq))
+        pthread_cond_wait(&queue->idle_cond, &queue->idle_lock);
+    pthread_mutex_unlock(&queue->idle_lock);
+}
+
+static void psb__cmdbuf_wait_submitted(psb_cmdbuf_p cmdbuf)
+{
+    struct psb_submit_queue_s *queue;
+
+    if (!__atomic_load_n(&cmdbuf->submit_pending, __ATOMIC_ACQUIRE))
+        return;
+
+    queue = cmdbuf->buf.driver_data->submit_queue;
+    pthread_mutex_lock(&queue->idle_lock);
+    while (__atomic_load_n(&cmdbuf->submit_pending, __ATOMIC_ACQUIRE))
+        pthread_cond_wait(&queue->idle_cond, &queue->idle_lock);
+    pthread_mutex_unlock(&queue->idle_lock);
+}
+
+void psb_cmdbuf_submit_sync(psb_driver_data_p driver_data)
+{
+    struct psb_submit_queue_s *queue = driver_data ? driver_data->submit_queue : NULL;
+
+    if ((queue == NULL) || (__atomic_load_n(&queue->outstanding, __ATOMIC_ACQUIRE) == 0))
+        return;
+
+    pthread_mutex_lock(&queue->idle_lock);
+    while (__atomic_load_n(&queue->outstanding, __ATOMIC_ACQUIRE))
+        pthread_cond_wait(&queue->idle_cond, &queue->idle_lock);
+    pthread_mutex_unlock(&queue->idle_lock);
+}
+
+int psb_cmdbuf_submit_init(psb_driver_data_p driver_data)
+{
+    struct psb_submit_queue_s *queue;
+    char env_value[1024] = {0};
+
+    driver_data->submit_queue = NULL;
+
+    if (psb_parse_config("PSB_VIDEO_ASYNC_SUBMIT", &env_value[0]) || (atoi(env_value) == 0))
+        return 0;
+
+    /* the trace path inspects the cmdbuf right after the ioctl */
+    if (psb_video_trace_fp)
+        return 0;
+
+    queue = (struct psb_submit_queue_s *) calloc(1, sizeof(*queue));
+    if (queue == NULL)
+        return -ENOMEM;
+
+    queue->driver_data = driver_data;
+    if (sem_init(&queue->wake, 0, 0)) {
+        free(queue);
+        return -errno;
+    }
+    pthread_mutex_init(&queue->idle_lock, NULL);
+    pthread_cond_init(&queue->idle_cond, NULL);
+    pthread_mutex_init(&queue->push_lock, NULL);
+
+    if (pthread_create(&queue->thread, NULL, psb__submit_thread, queue)) {
+        drv_debug_msg(VIDEO_DEBUG_ERROR, "failed to start cmdbuf submission thread\n");
+        pthread_mutex_destroy(&queue->push_lock);
+        pthread_cond_destroy(&queue->idle_cond);
+        pthread_mutex_destroy(&queue->idle_lock);
+        sem_destroy(&queue->wake);
+        free(queue);
+        return 0; /* fall back to synchronous submission */
+    }
+
+    drv_debug_msg(VIDEO_DEBUG_INIT, "asynchronous cmdbuf submission enabled\n");
+    driver_data->submit_queue = queue;
+    return 0;
+}
+
+void psb_cmdbuf_submit_deinit(psb_driver_data_p driver_data)
+{
+    struct psb_submit_queue_s *queue = driver_data->submit_queue;
+
+    if (queue == NULL)
+        return;
+
+    psb_cmdbuf_submit_sync(driver_data);
+
+    __atomic_store_n(&queue->quit, 1, __ATOMIC_RELEASE);
+    sem_post(&queue->wake);
+    pthread_join(queue->thread, NULL);
+
+    drv_debug_msg(VIDEO_DEBUG_GENERAL, "cmdbuf submission: %u cmdbufs in %u batches\n",
+                  queue->cmdbuf_count, queue->batch_count);
+
+    pthread_mutex_destroy(&queue->push_lock);
+    pthread_cond_destroy(&queue->idle_cond);
+    pthread_mutex_destroy(&queue->idle_lock);
+    sem_destroy(&queue->wake);
+    free(queue);
+    driver_data->submit_queue = NULL;
+}
+
 #if 0
 int psb_fence_destroy(struct _WsbmFenceObject *pFence)
 {
@@ -727,6 +1065,14 @@ int psb_context_submit_host_be_opp(object_context_p obj_context,
     return 0;
 }
 #endif
+static int psb__context_flush_cmdbuf(object_context_p obj_context, psb_flush_reason_t reason);
+
+static void psb__cmdbuf_grow_region(unsigned int *region_size, unsigned int base_size)
+{
+    if (*region_size < base_size * REGION_GROW_MAX)
+        *region_size *= 2;
+}
+
 /*
  * Submits the current cmdbuf
  *
@@ -775,7 +1121,7 @@ int psb_context_submit_cmdbuf(object_context_p obj_context)
     memset(msg, 0, msg_size);
 
     *cmdbuf->cmd_idx = 0; // Add a trailing 0 just in case.
-    ASSERT(cmdbuffer_size < CMD_SIZE);
+    ASSERT(cmdbuffer_size < cmdbuf->cmd_size);
     ASSERT((unsigned char *) cmdbuf->cmd_idx < CMD_END(cmdbuf));
 
     MEMIO_WRITE_FIELD(msg, FWRK_GENMSG_SIZE,                  msg_size);
@@ -799,16 +1145,26 @@ int psb_context_submit_cmdbuf(object_context_p obj_context)
 
     cmdbuf->cmd_start = (unsigned char *)cmdbuf->cmd_idx;
 
-    if (psb_video_trace_fp) {
-        return psb_context_flush_cmdbuf(obj_context);
-    } else {
-        if ((cmdbuf->cmd_count >= MAX_CMD_COUNT) ||
-            (MTXMSG_END(cmdbuf) - (unsigned char *) msg < MTXMSG_MARGIN) ||
-            (CMD_END(cmdbuf) - (unsigned char *) cmdbuf->cmd_idx < CMD_MARGIN) ||
-            (LLDMA_END(cmdbuf) - cmdbuf->lldma_idx < LLDMA_MARGIN) ||
-            (RELOC_END(cmdbuf) - (unsigned char *) cmdbuf->reloc_idx < RELOC_MARGIN)) {
-            return psb_context_flush_cmdbuf(obj_context);
-        }
+    if (psb_video_trace_fp)
+        return psb__context_flush_cmdbuf(obj_context, PSB_FLUSH_TRACE);
+
+    if (cmdbuf->cmd_count >= MAX_CMD_COUNT)
+        return psb__context_flush_cmdbuf(obj_context, PSB_FLUSH_CMD_COUNT);
+    if (MTXMSG_END(cmdbuf) - (unsigned char *) msg < MTXMSG_MARGIN)
+        return psb__context_flush_cmdbuf(obj_context, PSB_FLUSH_MTXMSG_FULL);
+
+    /* Region overflows: flush now and give the following cmdbufs more room */
+    if (CMD_END(cmdbuf) - (unsigned char *) cmdbuf->cmd_idx < CMD_MARGIN) {
+        psb__cmdbuf_grow_region(&obj_context->cmdbuf_cmd_size, CMD_SIZE);
+        return psb__context_flush_cmdbuf(obj_context, PSB_FLUSH_CMD_FULL);
+    }
+    if (LLDMA_END(cmdbuf) - cmdbuf->lldma_idx < LLDMA_MARGIN) {
+        psb__cmdbuf_grow_region(&obj_context->cmdbuf_lldma_size, LLDMA_SIZE);
+        return psb__context_flush_cmdbuf(obj_context, PSB_FLUSH_LLDMA_FULL);
+    }
+    if (RELOC_END(cmdbuf) - (unsigned char *) cmdbuf->reloc_idx < RELOC_MARGIN) {
+        psb__cmdbuf_grow_region(&obj_context->cmdbuf_reloc_size, RELOC_SIZE);
+        return psb__context_flush_cmdbuf(obj_context, PSB_FLUSH_RELOC_FULL);
     }
     return 0;
 }
@@ -817,10 +1173,16 @@ int psb_context_submit_cmdbuf(object_context_p obj_context)
  * Flushes all cmdbufs
  */
 int psb_context_flush_cmdbuf(object_context_p obj_context)
+{
+    return psb__context_flush_cmdbuf(obj_context, PSB_FLUSH_EXPLICIT);
+}
+
+static int psb__context_flush_cmdbuf(object_context_p obj_context, psb_flush_reason_t reason)
 {
     psb_cmdbuf_p cmdbuf = obj_context->cmdbuf;
     psb_driver_data_p driver_data = obj_context->driver_data;
     unsigned int fence_flags;
+    uint64_t submit_start_us;
     /* unsigned int fence_handle = 0; */
     struct psb_ttm_fence_rep fence_rep;
     unsigned int reloc_offset;
@@ -841,17 +1203,22 @@ int psb_context_flush_cmdbuf(object_context_p obj_context)
     }
 #endif
 
+    obj_context->cmdbuf_flushes[reason]++;
+    PSB_TRACE3(CMDBUF_FLUSH, obj_context->base.id, reason, cmdbuf->cmd_count);
+
     uint32_t msg_size = 0;
     uint32_t *msg = (uint32_t *)cmdbuf->MTX_msg;
     int32_t i;
     uint32_t index;
 
-    /* LOCK */
-    ret = LOCK_HARDWARE(driver_data);
-    if (ret) {
-        UNLOCK_HARDWARE(driver_data);
-        DEBUG_FAILURE_RET;
-        return ret;
+    /* LOCK, the submission thread takes it for the whole batch instead */
+    if (driver_data->submit_queue == NULL) {
+        ret = LOCK_HARDWARE(driver_data);
+        if (ret) {
+            UNLOCK_HARDWARE(driver_data);
+            DEBUG_FAILURE_RET;
+            return ret;
+        }
     }
 
     for (i = 1; i <= cmdbuf->frame_info_count; i++) {
@@ -915,9 +1282,12 @@ int psb_context_flush_cmdbuf(object_context_p obj_context)
     num_relocs = (((unsigned char *) cmdbuf->reloc_idx) - cmdbuf->reloc_base) / sizeof(struct drm_psb_reloc);
 
     drv_debug_msg(VIDEO_DEBUG_GENERAL, "Cmdbuf MTXMSG size = %08x [%08x]\n", msg_size, MTXMSG_SIZE);
-    drv_debug_msg(VIDEO_DEBUG_GENERAL, "Cmdbuf CMD size = %08x - %d[%08x]\n", (unsigned char *) cmdbuf->cmd_idx - cmdbuf->cmd_base, cmdbuf->cmd_count, CMD_SIZE);
-    drv_debug_msg(VIDEO_DEBUG_GENERAL, "Cmdbuf LLDMA size = %08x [%08x]\n", cmdbuf->lldma_idx - cmdbuf->lldma_base, LLDMA_SIZE);
-    drv_debug_msg(VIDEO_DEBUG_GENERAL, "Cmdbuf RELOC size = %08x [%08x]\n", num_relocs * sizeof(struct drm_psb_reloc), RELOC_SIZE);
+    drv_debug_msg(VIDEO_DEBUG_GENERAL, "Cmdbuf CMD size = %08x - %d[%08x]\n", (unsigned char *) cmdbuf->cmd_idx - cmdbuf->cmd_base, cmdbuf->cmd_count, cmdbuf->cmd_size);
+    drv_debug_msg(VIDEO_DEBUG_GENERAL, "Cmdbuf LLDMA size = %08x [%08x]\n", cmdbuf->lldma_idx - cmdbuf->lldma_base, cmdbuf->size - cmdbuf->cmd_size);
+    drv_debug_msg(VIDEO_DEBUG_GENERAL, "Cmdbuf RELOC size = %08x [%08x]\n", num_relocs * sizeof(struct drm_psb_reloc), cmdbuf->reloc_size - MTXMSG_SIZE);
+
+    if (PSB_RECORD(CMDBUF))
+        psb_record_cmdbuf(obj_context, cmdbuf, msg_size);
 
     psb_cmdbuf_unmap(cmdbuf);
 
@@ -935,6 +1305,21 @@ int psb_context_flush_cmdbuf(object_context_p obj_context)
     if (obj_context->msvdx_frame_end)
         fence_flags |= PSB_SLICE_EXTRACT_UPDATE;
 #endif
+
+    submit_start_us = psb_stats_now_us();
+    if (driver_data->submit_queue) {
+        cmdbuf->submit_msg_size = msg_size;
+        cmdbuf->submit_reloc_offset = reloc_offset;
+        cmdbuf->submit_num_relocs = num_relocs;
+        cmdbuf->submit_fence_flags = fence_flags;
+        psb__submit_push(driver_data->submit_queue, cmdbuf);
+        psb_stats_submit(obj_context, submit_start_us);
+
+        obj_context->cmdbuf = NULL;
+        obj_context->slice_count++;
+        return 0;
+    }
+
     /* cmdbuf will be validated as part of the buffer list */
     /* Submit */
     wsbmWriteLockKernelBO();
@@ -947,6 +1332,7 @@ int psb_context_flush_cmdbuf(object_context_p obj_context)
                        0, PSB_ENGINE_DECODE, fence_flags, &fence_rep);
     wsbmWriteUnlockKernelBO();
     UNLOCK_HARDWARE(driver_data);
+    psb_stats_submit(obj_context, submit_start_us);
 
     if (ret) {
         obj_context->cmdbuf = NULL;
@@ -975,7 +1361,7 @@ int psb_context_flush_cmdbuf(object_context_p obj_context)
 
         if (psb_video_trace_level & LLDMA_TRACE) {
             psb__trace_message("lldma_count = %d, vitual=0x%08x\n",
-                               debug_lldma_count,  wsbmBOOffsetHint(cmdbuf->buf.drm_buf) + CMD_SIZE);
+                               debug_lldma_count,  wsbmBOOffsetHint(cmdbuf->buf.drm_buf) + cmdbuf->cmd_size);
             for (index = 0; index < debug_lldma_count; index++) {
                 DMA_sLinkedList* pasDmaList = (DMA_sLinkedList*)(cmdbuf->cmd_base + debug_lldma_start);
                 pasDmaList += index;
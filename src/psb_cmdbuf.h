@@ -49,6 +49,7 @@ typedef struct psb_cmdbuf_s *psb_cmdbuf_p;
 struct psb_cmdbuf_s {
     struct psb_buffer_s buf;
     unsigned int size;
+    unsigned int cmd_size; /* CMD region, LLDMA records use the rest of buf */
     struct psb_buffer_s reloc_buf;
     unsigned int reloc_size;
 
@@ -101,6 +102,15 @@ struct psb_cmdbuf_s {
     /* Pointer for Skip block commands */
     uint32_t *skip_block_start;
     uint32_t skip_condition;
+    /* Asynchronous submission, see psb_cmdbuf_submit_init */
+    struct psb_cmdbuf_s *submit_next;
+    int submit_pending;
+    unsigned int submit_seq;
+    int submit_ret;
+    uint32_t submit_msg_size;
+    unsigned int submit_reloc_offset;
+    unsigned int submit_num_relocs;
+    unsigned int submit_fence_flags;
 };
 
 /*
@@ -159,6 +169,38 @@ void psb_cmdbuf_add_relocation(psb_cmdbuf_p cmdbuf,
 #define RELOC_SHIFT4(dest, offset, background, buf)     psb_cmdbuf_add_relocation(cmdbuf, (uint32_t*) &dest, buf, offset, 0X0FFFFFFF, background, 4, 1)
 #define RELOC_REGIO(dest, offset, buf, dst)     psb_cmdbuf_add_relocation(cmdbuf, (uint32_t*) &dest, buf, offset, 0XFFFFFFFF, 0, 0, dst)
 
+/*
+ * Starts the MSVDX submission thread when PSB_VIDEO_ASYNC_SUBMIT is set.
+ * Flushed cmdbufs are then handed to the thread instead of issuing the
+ * execbuf ioctl on the calling thread.
+ *
+ * Returns 0 on success, including when asynchronous submission is disabled
+ */
+int psb_cmdbuf_submit_init(psb_driver_data_p driver_data);
+
+/*
+ * Submits whatever is still queued and stops the submission thread
+ */
+void psb_cmdbuf_submit_deinit(psb_driver_data_p driver_data);
+
+/*
+ * Blocks until every queued cmdbuf has been handed to the kernel, used
+ * on teardown. Per buffer waits should use psb_cmdbuf_buffer_wait_submitted.
+ */
+void psb_cmdbuf_submit_sync(psb_driver_data_p driver_data);
+
+/*
+ * Returns 1 while the last cmdbuf referencing "buf" is still queued for
+ * the submission thread, i.e. its fence isn't attached yet
+ */
+int psb_cmdbuf_buffer_submit_pending(psb_buffer_p buf);
+
+/*
+ * Blocks until the last cmdbuf referencing "buf" has been handed to the
+ * kernel. Other queued cmdbufs are not waited for.
+ */
+void psb_cmdbuf_buffer_wait_submitted(psb_buffer_p buf);
+
 /*
  * Advances "obj_context" to the next cmdbuf
  *
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2011 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _PSB_CODED_IOV_H_
+#define _PSB_CODED_IOV_H_
+
+#include <stdint.h>
+#include <sys/uio.h>
+#include <va/va.h>
+
+/*
+ * Scatter list view of a mapped VAEncCodedBufferType buffer, read with
+ * psb_GetCodedBufferIov(). The iovecs point into the vaMapBuffer mapping,
+ * so they can go to writev()/sendmsg() or a muxer without copying and
+ * stay valid until vaUnmapBuffer.
+ */
+
+/* flags */
+#define PSB_CODED_IOV_SPLIT_NAL     0x1     /* one entry per H.264 NAL unit */
+#define PSB_CODED_IOV_NO_PADDING    0x2     /* leave out the encryption padding entries */
+
+/* per-entry info */
+#define PSB_CODED_IOV_SEGMENT       0x01    /* first entry of a coded segment: encoder pipe or JPEG part */
+#define PSB_CODED_IOV_NAL_START     0x02    /* begins with an Annex B start code */
+#define PSB_CODED_IOV_PADDING       0x04    /* 16 byte alignment for IED encryption, not bitstream */
+#define PSB_CODED_IOV_JPEG_HEADER   0x08    /* JPEG headers ahead of the first scan */
+#define PSB_CODED_IOV_NAL_TYPE(info)    (((info) >> 8) & 0x1f)
+
+/*
+ * Fill up to max_iov entries of iov, and of info unless it is NULL, for
+ * the coded buffer coded_buf, which must be mapped. *num_iov is set to
+ * the number of entries needed; VA_STATUS_ERROR_MAX_NUM_EXCEEDED is
+ * returned when that is more than max_iov. dpy is the VADisplay of the
+ * buffer; look the symbol up with dlsym() on the driver library.
+ */
+VAStatus psb_GetCodedBufferIov(VADisplay dpy, VABufferID coded_buf,
+                               struct iovec *iov, uint32_t *info,
+                               unsigned int max_iov, unsigned int *num_iov,
+                               unsigned int flags);
+
+#endif /* _PSB_CODED_IOV_H_ */
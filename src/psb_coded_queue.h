@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2011 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _PSB_CODED_QUEUE_H_
+#define _PSB_CODED_QUEUE_H_
+
+#include <va/va.h>
+
+/*
+ * Encode pipeline mode for TopazHP encode contexts (H.264, H.263 and
+ * MPEG-4). Once a depth is set, vaEndPicture returns as soon as the frame
+ * is submitted and up to "depth" frames may be encoding at a time; the
+ * coded buffer of every frame is queued and handed back, in submission
+ * order, by psb_GetCompletedCodedBuffer() once it is complete, so the
+ * following vaMapBuffer does not wait on the hardware.
+ *
+ * Look the symbols up with dlsym() on the driver library; dpy is the
+ * VADisplay the context was created on.
+ */
+
+#define PSB_CODED_QUEUE_SIZE        16      /* coded buffers queued at most */
+
+/*
+ * Set the number of frames in flight, 0 turns pipeline mode off and drops
+ * the queue. With B frames the depth is raised to the number of source
+ * slots so that the oldest frame can always complete.
+ */
+VAStatus psb_SetEncodePipelineDepth(VADisplay dpy, VAContextID context, unsigned int depth);
+
+/*
+ * Return the oldest queued coded buffer once its frame is encoded. When it
+ * is still encoding, wait for it if "wait" is non-zero or else return
+ * VA_STATUS_ERROR_SURFACE_BUSY. *coded_buf is VA_INVALID_ID when nothing
+ * is queued.
+ */
+VAStatus psb_GetCompletedCodedBuffer(VADisplay dpy, VAContextID context,
+                                     VABufferID *coded_buf, int wait);
+
+#endif /* _PSB_CODED_QUEUE_H_ */
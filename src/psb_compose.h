@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2011 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _PSB_COMPOSE_H_
+#define _PSB_COMPOSE_H_
+
+#include <va/va.h>
+
+/*
+ * RGBA overlay layers for the VSP compose path, set with
+ * psb_SetComposeLayers(). Each surface passed in additional_outputs of a
+ * compose VAProcPipelineParameterBuffer is blended over the video as one
+ * layer; surfaces without a descriptor cover the frame from (0, 0) with
+ * their own per-pixel alpha, in additional_outputs order.
+ */
+
+#define PSB_COMPOSE_MAX_LAYERS      4
+
+typedef struct {
+    VASurfaceID surface;            /* RGBA surface in additional_outputs */
+    int x;                          /* top-left of the layer in the output frame */
+    int y;
+    unsigned int alpha;             /* layer alpha 0..255 */
+    int z_order;                    /* layers are blended in increasing z_order */
+} psb_compose_layer_t;
+
+/*
+ * Replace the layer descriptors of a VSP video processing context.
+ * num_layers == 0 clears them. dpy is the VADisplay the context was
+ * created on; look the symbol up with dlsym() on the driver library.
+ */
+VAStatus psb_SetComposeLayers(VADisplay dpy, VAContextID context,
+                              const psb_compose_layer_t *layers, unsigned int num_layers);
+
+#endif /* _PSB_COMPOSE_H_ */
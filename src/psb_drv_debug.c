@@ -126,6 +126,15 @@ void psb__open_log(void)
         psb_video_debug_level = 0x1;
     }
 
+    /* dump per-context timing statistics every N frames */
+    if(psb_parse_config("PSB_VIDEO_STATS_INTERVAL", &env_fn[0]) == 0) {
+        psb_video_stats_interval = atoi(env_fn);
+        if (psb_video_stats_interval > 0)
+            psb_video_debug_level |= VIDEO_DEBUG_STATS;
+    } else {
+        psb_video_stats_interval = 0;
+    }
+
     /* control debug output option, logcat output or print to file */
     if(psb_parse_config("PSB_VIDEO_DEBUG_OPTION", &env_fn[0]) == 0) {
         psb_video_debug_option = atoi(env_fn);
@@ -219,10 +228,15 @@ void psb__open_log(void)
     } else {
         psb_dump_yuvbuf_fp = NULL;
     }
+
+    /* binary event trace, drained to a file by a background thread */
+    psb_trace_ring_start();
 }
 
 void psb__close_log(void)
 {
+    psb_trace_ring_stop();
+
     if ((psb_video_debug_fp != NULL) & (psb_video_debug_fp != stderr)) {
         debug_fp_count--;
         if (debug_fp_count == 0) {
@@ -307,6 +321,10 @@ void drv_debug_msg(DEBUG_LEVEL debug_level, const char *msg, ...)
 {
     va_list args;
 
+    /* nothing below prints a message whose level is masked off */
+    if ((debug_level != VIDEO_DEBUG_ERROR) && !(debug_level & psb_video_debug_level))
+        return;
+
 #ifdef ANDROID
     if (debug_level == VIDEO_DEBUG_ERROR) {
         va_start(args, msg);
@@ -36,6 +36,7 @@
 #include <time.h>
 #include <unistd.h>
 #include "psb_buffer.h"
+#include "psb_trace_ring.h"
 
 /* #define VA_EMULATOR 1 */
 
@@ -70,6 +71,7 @@ typedef enum
     VIDEO_DECODE_DEBUG      =   0x100,
     VIDEO_ENCODE_DEBUG      =   0x200,
     VIDEO_DISPLAY_DEBUG     =   0x400,
+    VIDEO_DEBUG_STATS       =   0x800,
 
     VIDEO_ENCODE_PDUMP     =   0x1000,
     VIDEO_ENCODE_HEADER    =   0x2000,
@@ -111,6 +113,7 @@ FILE *psb_dump_vabuf_verbose_fp;
 FILE *psb_dump_yuvbuf_fp;
 
 int psb_video_dump_cmdbuf;
+int psb_video_stats_interval;
 uint32_t g_hexdump_offset;
 
 void psb__debug_w(uint32_t val, char *fmt, uint32_t bit_to, uint32_t bit_from);
@@ -43,6 +43,7 @@
 #include "psb_drv_video.h"
 #include "psb_texture.h"
 #include "psb_cmdbuf.h"
+#include "psb_vlc_cache.h"
 #ifndef BAYTRAIL
 #include "pnw_cmdbuf.h"
 #include "tng_cmdbuf.h"
@@ -75,7 +76,13 @@
 #ifdef PSBVIDEO_MRFL_VPP
 #include "vsp_VPP.h"
 #include "vsp_vp8.h"
+#include "vsp_compose.h"
 #endif
+#include "psb_compose.h"
+#include "psb_coded_queue.h"
+#include "psb_sync.h"
+#include "psb_coded_iov.h"
+#include "psb_record.h"
 #include "psb_output.h"
 #include <stdio.h>
 #include <string.h>
@@ -113,6 +120,9 @@
 
 #define MAX_UNUSED_BUFFERS      16
 
+#define PSB_BUFFER_SIZE_CLASS_MIN       0x8000
+#define PSB_BUFFER_SIZE_CLASS_MAX       0x8000000
+
 #define PSB_SURFACE_UNAVAILABLE 0x40000000
 
 #define PSB_MAX_FLIP_DELAY (1000/30/10)
@@ -1161,6 +1171,16 @@ VAStatus psb_CreateContext(
     memset(obj_context->buffers_unused_count, 0, sizeof(obj_context->buffers_unused_count));
     memset(obj_context->buffers_unused_tail, 0, sizeof(obj_context->buffers_unused_tail));
     memset(obj_context->buffers_active, 0, sizeof(obj_context->buffers_active));
+    memset(obj_context->cmdbuf_flushes, 0, sizeof(obj_context->cmdbuf_flushes));
+    memset(&obj_context->stats, 0, sizeof(obj_context->stats));
+    obj_context->stats.version = PSB_STATS_VERSION;
+    obj_context->stats_frame_start_us = 0;
+    obj_context->stats_submit_us = 0;
+    obj_context->stats_frame_submits = 0;
+    pthread_mutex_init(&obj_context->stats_mutex, NULL);
+    obj_context->cmdbuf_cmd_size = 0;
+    obj_context->cmdbuf_lldma_size = 0;
+    obj_context->cmdbuf_reloc_size = 0;
 
     if (obj_config->entrypoint == VAEntrypointEncSlice
         || obj_config->entrypoint == VAEntrypointEncPicture) {
@@ -1252,6 +1272,7 @@ VAStatus psb_CreateContext(
         obj_context->render_targets = NULL;
         obj_context->num_render_targets = 0;
         obj_context->va_flags = 0;
+        pthread_mutex_destroy(&obj_context->stats_mutex);
         object_heap_free(&driver_data->context_heap, (object_base_p) obj_context);
 
         return vaStatus;
@@ -1468,6 +1489,7 @@ VAStatus psb_CreateContext(
         obj_context->render_targets = NULL;
         obj_context->num_render_targets = 0;
         obj_context->va_flags = 0;
+        pthread_mutex_destroy(&obj_context->stats_mutex);
         object_heap_free(&driver_data->context_heap, (object_base_p) obj_context);
     }
     obj_context->ctp_type = (((obj_config->profile << 8) |
@@ -1512,10 +1534,29 @@ VAStatus psb_CreateContext(
     if (ret)
         vaStatus = VA_STATUS_ERROR_UNKNOWN;
 
+    if ((VA_STATUS_SUCCESS == vaStatus) && PSB_RECORD(CONTEXT))
+        psb_record_context(obj_context);
+
     DEBUG_FUNC_EXIT
     return vaStatus;
 }
 
+/*
+ * Buffer objects are allocated in power-of-two size classes so that an
+ * unused buffer can be handed back for any request of the same class
+ */
+static unsigned int psb__buffer_size_class(unsigned int size)
+{
+    unsigned int size_class = PSB_BUFFER_SIZE_CLASS_MIN;
+
+    while ((size_class < size) && (size_class < PSB_BUFFER_SIZE_CLASS_MAX))
+        size_class <<= 1;
+    if (size_class < size)
+        size_class = (size + PSB_BUFFER_SIZE_CLASS_MIN - 1) & ~(PSB_BUFFER_SIZE_CLASS_MIN - 1);
+
+    return size_class;
+}
+
 static VAStatus psb__allocate_malloc_buffer(object_buffer_p obj_buffer, int size)
 {
     VAStatus vaStatus = VA_STATUS_SUCCESS;
@@ -1534,6 +1575,10 @@ static VAStatus psb__allocate_BO_buffer(psb_driver_data_p driver_data, object_co
 
     ASSERT(NULL == obj_buffer->buffer_data);
 
+    /* the submission thread moves the status of pushed buffers, let it finish first */
+    if (obj_buffer->psb_buffer)
+        psb_cmdbuf_buffer_wait_submitted(obj_buffer->psb_buffer);
+
     if (obj_buffer->psb_buffer && (psb_bs_queued == obj_buffer->psb_buffer->status)) {
         drv_debug_msg(VIDEO_DEBUG_GENERAL, "Abandoning BO for buffer %08x type %s\n", obj_buffer->base.id,
                                  buffer_type_to_string(obj_buffer->type));
@@ -1572,7 +1617,7 @@ static VAStatus psb__allocate_BO_buffer(psb_driver_data_p driver_data, object_co
             drv_debug_msg(VIDEO_DEBUG_GENERAL, "Allocate new GPU buffers for vaCreateBuffer:type=%s,size=%d.\n",
                                      buffer_type_to_string(obj_buffer->type), size);
 
-            size = (size + 0x7fff) & ~0x7fff; /* Round up */
+            size = psb__buffer_size_class(size); /* Round up */
             if (obj_buffer->type == VAImageBufferType) /* Xserver side PutSurface, Image/subpicture buffer
                                                         * should be shared between two process
                                                         */
@@ -1669,6 +1714,9 @@ void psb__suspend_buffer(psb_driver_data_p driver_data, object_buffer_p obj_buff
         return;
     }
 
+    if (obj_buffer->psb_buffer)
+        psb_cmdbuf_buffer_wait_submitted(obj_buffer->psb_buffer);
+
     if (obj_buffer->psb_buffer && (psb_bs_queued == obj_buffer->psb_buffer->status)) {
         /* need to set psb_buffer aside */
         obj_buffer->psb_buffer->status = psb_bs_abandoned;
@@ -1689,6 +1737,20 @@ static void psb__destroy_context(psb_driver_data_p driver_data, object_context_p
 
     obj_context->format_vtable->destroyContext(obj_context);
 
+    drv_debug_msg(VIDEO_DEBUG_INIT, "%s: buffer pool hits %d, misses %d, recycled %d, busy skips %d\n", __FUNCTION__,
+                  obj_context->buffer_pool_hits, obj_context->buffer_pool_misses,
+                  obj_context->buffer_pool_recycled, obj_context->buffer_pool_busy);
+    drv_debug_msg(VIDEO_DEBUG_INIT, "%s: cmdbuf flushes explicit %d, trace %d, cmd count %d, mtxmsg %d, cmd %d, lldma %d, reloc %d\n",
+                  __FUNCTION__, obj_context->cmdbuf_flushes[PSB_FLUSH_EXPLICIT], obj_context->cmdbuf_flushes[PSB_FLUSH_TRACE],
+                  obj_context->cmdbuf_flushes[PSB_FLUSH_CMD_COUNT], obj_context->cmdbuf_flushes[PSB_FLUSH_MTXMSG_FULL],
+                  obj_context->cmdbuf_flushes[PSB_FLUSH_CMD_FULL], obj_context->cmdbuf_flushes[PSB_FLUSH_LLDMA_FULL],
+                  obj_context->cmdbuf_flushes[PSB_FLUSH_RELOC_FULL]);
+    if (psb_video_stats_interval > 0) {
+        pthread_mutex_lock(&obj_context->stats_mutex);
+        psb_stats_dump(obj_context);
+        pthread_mutex_unlock(&obj_context->stats_mutex);
+    }
+
     for (i = 0; i < PSB_MAX_BUFFERTYPES; i++) {
         object_buffer_p obj_buffer;
         obj_buffer = obj_context->buffers_active[i];
@@ -1760,6 +1822,7 @@ static void psb__destroy_context(psb_driver_data_p driver_data, object_context_p
         free(obj_context->buffer_list);
     obj_context->num_buffers = 0;
 
+    pthread_mutex_destroy(&obj_context->stats_mutex);
     object_heap_free(&driver_data->context_heap, (object_base_p) obj_context);
 
     psb_rm_context(driver_data);
@@ -1776,6 +1839,9 @@ VAStatus psb_DestroyContext(
     object_context_p obj_context = CONTEXT(context);
     CHECK_CONTEXT(obj_context);
 
+    if (PSB_RECORD(DESTROY))
+        psb_record_picture(PSB_RECORD_DESTROY, obj_context, VA_INVALID_SURFACE);
+
     psb__destroy_context(driver_data, obj_context);
 
     DEBUG_FUNC_EXIT
@@ -1796,6 +1862,7 @@ VAStatus psb__CreateBuffer(
     VAStatus vaStatus = VA_STATUS_SUCCESS;
     int bufferID;
     object_buffer_p obj_buffer;
+    object_buffer_p obj_buffer_prev;
     int unused_count;
 
     /*PSB_MAX_BUFFERTYPES is the size of array buffers_unused*/
@@ -1805,19 +1872,20 @@ VAStatus psb__CreateBuffer(
     }
 
 
-    obj_buffer = obj_context ? obj_context->buffers_unused[type] : NULL;
-    unused_count = obj_context ? obj_context->buffers_unused_count[type] : 0;
-
     /*
      * Buffer Management
      * For each buffer type, maintain
      *   - a LRU sorted list of unused buffers
      *   - a list of active buffers
-     * We only create a new buffer when
-     *   - no unused buffers are available
-     *   - the last unused buffer is still queued
-     *   - the last unused buffer was used very recently and may still be fenced
-     *      - used recently is defined as within the current frame_count (subject to tweaks)
+     * An unused buffer is handed out again as soon as
+     *   - it is no longer queued in a pending command buffer
+     *   - the fence protecting its buffer object has signalled
+     *   - its buffer object is in the power-of-two size class of the request
+     * Once MAX_UNUSED_BUFFERS are parked for a type, the oldest idle buffer is
+     * recycled whatever its size class instead of growing the pool further.
+     * Only buffers that could be handed out are checked for busy, and the scan
+     * stops at the first busy one: the list is in release order, which is the
+     * order the hardware retires them in, so the newer ones are busy as well.
      *
      * The buffer that is returned will be moved to the list of active buffers
      *   - vaDestroyBuffer and vaRenderPicture will move the active buffer back to the list of unused buffers
@@ -1833,19 +1901,43 @@ VAStatus psb__CreateBuffer(
     }
     */
 
-    if (obj_buffer && obj_buffer->psb_buffer) {
-        if (psb_bs_queued == obj_buffer->psb_buffer->status) {
-            /* Buffer is still queued, allocate new buffer instead */
-            drv_debug_msg(VIDEO_DEBUG_GENERAL, "Skipping idle buffer %08x, still queued\n", obj_buffer->base.id);
-            obj_buffer = NULL;
-        } else if ((obj_buffer->last_used == obj_context->frame_count) && (unused_count < MAX_UNUSED_BUFFERS)) {
-            /* Buffer was used for this frame, allocate new buffer instead */
-            drv_debug_msg(VIDEO_DEBUG_GENERAL, "Skipping idle buffer %08x, recently used. Unused = %d\n", obj_buffer->base.id, unused_count);
-            obj_buffer = NULL;
-        } else if (obj_context->frame_count - obj_buffer->last_used < 5) {
-            /* Buffer was used for previous frame, allocate new buffer instead */
-            drv_debug_msg(VIDEO_DEBUG_GENERAL, "Skipping idle buffer %08x used by frame %d. Unused = %d\n", obj_buffer->base.id, obj_buffer->last_used, unused_count);
-            obj_buffer = NULL;
+    obj_buffer = NULL;
+    obj_buffer_prev = NULL;
+    unused_count = obj_context ? obj_context->buffers_unused_count[type] : 0;
+
+    if (obj_context) {
+        object_buffer_p candidate, candidate_prev = NULL;
+        object_buffer_p oldest_idle = NULL, oldest_idle_prev = NULL;
+        unsigned int size_class = psb__buffer_size_class(size * num_elements);
+
+        for (candidate = obj_context->buffers_unused[type]; candidate; candidate = candidate->ptr_next) {
+            int fits = (candidate->psb_buffer == NULL) || (candidate->alloc_size == size_class);
+
+            if (fits || ((oldest_idle == NULL) && (unused_count >= MAX_UNUSED_BUFFERS))) {
+                if (candidate->psb_buffer && psb_buffer_is_busy(candidate->psb_buffer)) {
+                    drv_debug_msg(VIDEO_DEBUG_GENERAL, "Unused buffer %08x still busy, stop looking\n", candidate->base.id);
+                    obj_context->buffer_pool_busy++;
+                    break;
+                }
+                if (fits) {
+                    obj_buffer = candidate;
+                    obj_buffer_prev = candidate_prev;
+                    break;
+                }
+                oldest_idle = candidate;
+                oldest_idle_prev = candidate_prev;
+            }
+            candidate_prev = candidate;
+        }
+
+        if (obj_buffer) {
+            obj_context->buffer_pool_hits++;
+        } else if (oldest_idle && (unused_count >= MAX_UNUSED_BUFFERS)) {
+            obj_buffer = oldest_idle;
+            obj_buffer_prev = oldest_idle_prev;
+            obj_context->buffer_pool_recycled++;
+        } else {
+            obj_context->buffer_pool_misses++;
         }
     }
 
@@ -1855,13 +1947,13 @@ VAStatus psb__CreateBuffer(
                                  buffer_type_to_string(type), unused_count);
 
         /* Remove from unused list */
-        obj_context->buffers_unused[type] = obj_buffer->ptr_next;
-        if (obj_context->buffers_unused[type]) {
-            obj_context->buffers_unused[type]->pptr_prev_next = &(obj_context->buffers_unused[type]);
+        *obj_buffer->pptr_prev_next = obj_buffer->ptr_next;
+        if (obj_buffer->ptr_next) {
+            obj_buffer->ptr_next->pptr_prev_next = obj_buffer->pptr_prev_next;
             ASSERT(obj_context->buffers_unused_tail[type] != obj_buffer);
         } else {
             ASSERT(obj_context->buffers_unused_tail[type] == obj_buffer);
-            obj_context->buffers_unused_tail[type] = 0;
+            obj_context->buffers_unused_tail[type] = obj_buffer_prev;
         }
         obj_context->buffers_unused_count[type]--;
 
@@ -1954,6 +2046,7 @@ VAStatus psb__CreateBuffer(
     }
     if (VA_STATUS_SUCCESS == vaStatus) {
         *buf_desc = bufferID;
+        PSB_TRACE4(CREATE_BUFFER, bufferID, type, size, num_elements);
     } else {
         psb__destroy_buffer(driver_data, obj_buffer);
     }
@@ -2151,6 +2244,7 @@ VAStatus psb_BeginPicture(
     object_surface_p obj_surface;
     object_config_p obj_config;
     unsigned int i = 0, j = VA_INVALID_ID;
+    uint64_t start_us = psb_stats_now_us();
 
     obj_context = CONTEXT(context);
     CHECK_CONTEXT(obj_context);
@@ -2317,6 +2411,14 @@ VAStatus psb_BeginPicture(
     drv_debug_msg(VIDEO_DEBUG_GENERAL, "---BeginPicture 0x%08x for frame %d --\n",
                              render_target, obj_context->frame_count);
     psb__trace_message("------Trace frame %d------\n", obj_context->frame_count);
+    PSB_TRACE3(BEGIN_PICTURE, context, render_target, obj_context->frame_count);
+    if ((VA_STATUS_SUCCESS == vaStatus) && PSB_RECORD(BEGIN))
+        psb_record_picture(PSB_RECORD_BEGIN, obj_context, render_target);
+
+    pthread_mutex_lock(&obj_context->stats_mutex);
+    obj_context->stats_frame_start_us = start_us;
+    psb_stats_timer_add(&obj_context->stats.begin_picture, psb_stats_now_us() - start_us);
+    pthread_mutex_unlock(&obj_context->stats_mutex);
 
     DEBUG_FUNC_EXIT
     return vaStatus;
@@ -2371,7 +2473,26 @@ VAStatus psb_RenderPicture(
     }
 
     if (VA_STATUS_SUCCESS == vaStatus) {
+        uint64_t start_us, share_us;
+
+        PSB_TRACE2(RENDER_PICTURE, context, num_buffers);
+        if (PSB_RECORD(RENDER))
+            psb_record_render(obj_context, buffer_list, num_buffers);
+        start_us = psb_stats_now_us();
         vaStatus = obj_context->format_vtable->renderPicture(obj_context, buffer_list, num_buffers);
+        share_us = (psb_stats_now_us() - start_us) / num_buffers;
+        PSB_TRACE1(RENDER_PICTURE_END, vaStatus);
+
+        pthread_mutex_lock(&obj_context->stats_mutex);
+        for (i = 0; i < num_buffers; i++) {
+            object_buffer_p obj_buffer = buffer_list[i];
+
+            if (obj_buffer->type < PSB_STATS_BUFFER_TYPES)
+                psb_stats_timer_add(&obj_context->stats.render[obj_buffer->type], share_us);
+            if (obj_buffer->type == VASliceDataBufferType)
+                obj_context->stats.slice_data_bytes += obj_buffer->size * obj_buffer->num_elements;
+        }
+        pthread_mutex_unlock(&obj_context->stats_mutex);
     }
 
     if (buffer_list) {
@@ -2396,13 +2517,29 @@ VAStatus psb_EndPicture(
     INIT_DRIVER_DATA
     VAStatus vaStatus;
     object_context_p obj_context;
+    uint64_t start_us, end_us, submit_us;
 
     obj_context = CONTEXT(context);
     CHECK_CONTEXT(obj_context);
 
+    PSB_TRACE2(END_PICTURE, context, obj_context->frame_count);
+    start_us = psb_stats_now_us();
+    submit_us = obj_context->stats_submit_us;
     vaStatus = obj_context->format_vtable->endPicture(obj_context);
+    end_us = psb_stats_now_us();
+    PSB_TRACE1(END_PICTURE_END, vaStatus);
+
+    pthread_mutex_lock(&obj_context->stats_mutex);
+    submit_us = obj_context->stats_submit_us - submit_us;
+    psb_stats_timer_add(&obj_context->stats.end_picture, end_us - start_us);
+    psb_stats_timer_add(&obj_context->stats.cmdbuf_build,
+                        (end_us - start_us > submit_us) ? (end_us - start_us - submit_us) : 0);
+    psb_stats_frame_done(obj_context);
+    pthread_mutex_unlock(&obj_context->stats_mutex);
 
     drv_debug_msg(VIDEO_DEBUG_GENERAL, "---EndPicture for frame %d --\n", obj_context->frame_count);
+    if (PSB_RECORD(END))
+        psb_record_picture(PSB_RECORD_END, obj_context, VA_INVALID_SURFACE);
 
     obj_context->current_render_target = NULL;
     obj_context->frame_count++;
@@ -2470,6 +2607,140 @@ static void psb__surface_usage(
     }
 }
 
+/*
+ * Block until the overlay no longer scans out render_target: either a newer
+ * surface got flipped in (signalled on display_cond), or the flip delay of
+ * the current surface has passed.
+ */
+static void psb__wait_flip_done(psb_driver_data_p driver_data, VASurfaceID render_target)
+{
+    object_surface_p cur_obj_surface;
+    long remaining_ms;
+    struct timespec ts;
+
+    pthread_mutex_lock(&driver_data->output_mutex);
+    while (render_target == driver_data->last_displaying_surface) {
+        cur_obj_surface = SURFACE(driver_data->cur_displaying_surface);
+        if (NULL == cur_obj_surface)
+            break;
+
+        /* only the difference of two GetTickCount values is meaningful, the count wraps */
+        remaining_ms = (long)(cur_obj_surface->display_timestamp + PSB_MAX_FLIP_DELAY - GetTickCount());
+        if (remaining_ms <= 0)
+            break;
+
+        /* display_cond runs on CLOCK_MONOTONIC, see psb_initOutput */
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        ts.tv_sec += remaining_ms / 1000;
+        ts.tv_nsec += (remaining_ms % 1000) * 1000000;
+        if (ts.tv_nsec >= 1000000000) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000;
+        }
+        if (pthread_cond_timedwait(&driver_data->display_cond, &driver_data->output_mutex, &ts) == ETIMEDOUT)
+            break;
+    }
+    pthread_mutex_unlock(&driver_data->output_mutex);
+}
+
+/*
+ * The buffer the hardware writes for obj_surface
+ */
+static psb_surface_p psb__sync_target(psb_driver_data_p driver_data, object_surface_p obj_surface)
+{
+#ifdef PSBVIDEO_MRFL_VPP_ROTATE
+    object_context_p obj_context = CONTEXT(obj_surface->context_id);
+    object_config_p obj_config = obj_context ? CONFIG(obj_context->config_id) : NULL;
+
+    /* For VPP buffer, will sync the rotated buffer */
+    if (obj_config && obj_config->entrypoint == VAEntrypointVideoProc &&
+        GET_SURFACE_INFO_tiling(obj_surface->psb_surface) &&
+        (obj_context->msvdx_rotate == VA_ROTATION_90 || obj_context->msvdx_rotate == VA_ROTATION_270) &&
+        obj_surface->out_loop_surface)
+        return obj_surface->out_loop_surface;
+#else
+    (void)driver_data;
+#endif
+    return obj_surface->psb_surface;
+}
+
+/*
+ * Common part of psb_SyncSurface and psb_SyncSurfaces, see psb_sync.h
+ */
+static VAStatus psb__sync_surfaces(psb_driver_data_p driver_data, const VASurfaceID *surfaces,
+                                   int num_surfaces, int wait_all, unsigned int timeout_ms,
+                                   int *ready_index, unsigned int *wait_us)
+{
+    psb_surface_p surface_list[PSB_SYNC_MAX_SURFACES];
+    int list_index[PSB_SYNC_MAX_SURFACES];
+    object_surface_p obj_surface;
+    object_context_p obj_context;
+    VAStatus vaStatus;
+    int in_displaying = 0, num = 0, ready = -1;
+    int i, j;
+
+    if (ready_index)
+        *ready_index = -1;
+    if ((num_surfaces < 0) || (num_surfaces > PSB_SYNC_MAX_SURFACES))
+        return VA_STATUS_ERROR_INVALID_PARAMETER;
+
+    for (i = 0; i < num_surfaces; i++) {
+        if (SURFACE(surfaces[i]) == NULL)
+            return VA_STATUS_ERROR_INVALID_SURFACE;
+    }
+
+    for (i = 0; i < num_surfaces; i++) {
+        obj_surface = SURFACE(surfaces[i]);
+        if (wait_us)
+            wait_us[i] = 0;
+
+        /* The cur_displaying_surface indicates the surface being displayed by overlay.
+         * The diaplay_timestamp records the time point of put surface, which would
+         * be set to zero while using texture blit.*/
+        if (surfaces[i] == driver_data->cur_displaying_surface) {
+            in_displaying = 1;
+            continue;
+        }
+        if ((VA_INVALID_SURFACE != driver_data->cur_displaying_surface)    /* use overlay */
+            && (surfaces[i] == driver_data->last_displaying_surface)) {    /* It's the last displaying surface*/
+            /*  The flip operation on current displaying surface could be delayed to
+             *  next VBlank and hadn't been finished yet. Then, the last displaying
+             *  surface shouldn't be freed, because the hardware may not
+             *  complete loading data of it. Any change of the last surface could
+             *  have a impect on the scrren.*/
+            psb__wait_flip_done(driver_data, surfaces[i]);
+        }
+
+        surface_list[num] = psb__sync_target(driver_data, obj_surface);
+        list_index[num++] = i;
+    }
+
+    vaStatus = psb_surface_sync_list(surface_list, num, wait_all, timeout_ms, &ready);
+
+    for (j = 0; j < num; j++) {
+        i = list_index[j];
+        if (wait_us)
+            wait_us[i] = surface_list[j]->sync_wait_us;
+
+        /* surfaces given up on, or not reached in wait-any mode, weren't synced */
+        if ((vaStatus != VA_STATUS_SUCCESS) || (!wait_all && j != ready))
+            continue;
+        obj_context = CONTEXT(SURFACE(surfaces[i])->context_id);
+        if (obj_context) {
+            pthread_mutex_lock(&obj_context->stats_mutex);
+            psb_stats_timer_add(&obj_context->stats.sync_wait, surface_list[j]->sync_wait_us);
+            pthread_mutex_unlock(&obj_context->stats_mutex);
+        }
+    }
+
+    if (ready_index && ready >= 0)
+        *ready_index = list_index[ready];
+    if ((vaStatus == VA_STATUS_SUCCESS) && in_displaying && (wait_all || num == 0))
+        vaStatus = VA_STATUS_ERROR_SURFACE_IN_DISPLAYING;
+
+    return vaStatus;
+}
+
 VAStatus psb_SyncSurface(
     VADriverContextP ctx,
     VASurfaceID render_target
@@ -2480,56 +2751,16 @@ VAStatus psb_SyncSurface(
     VAStatus vaStatus = VA_STATUS_SUCCESS;
     object_surface_p obj_surface;
     int decode = 0, encode = 0, rc_enable = 0, proc = 0;
-    object_context_p obj_context = NULL;
-    object_config_p obj_config = NULL;
+    unsigned int wait_us = 0;
 
     drv_debug_msg(VIDEO_DEBUG_GENERAL, "psb_SyncSurface: 0x%08x\n", render_target);
 
     obj_surface = SURFACE(render_target);
     CHECK_SURFACE(obj_surface);
+    PSB_TRACE1(SYNC_SURFACE, render_target);
 
-    obj_context = CONTEXT(obj_surface->context_id);
-    if (obj_context) {
-        obj_config = CONFIG(obj_context->config_id);
-    }
-
-    /* The cur_displaying_surface indicates the surface being displayed by overlay.
-     * The diaplay_timestamp records the time point of put surface, which would
-     * be set to zero while using texture blit.*/
-
-    /* don't use mutex here for performance concern... */
-    //pthread_mutex_lock(&output->output_mutex);
-    if (render_target == driver_data->cur_displaying_surface)
-        vaStatus = VA_STATUS_ERROR_SURFACE_IN_DISPLAYING;
-    else if ((VA_INVALID_SURFACE != driver_data->cur_displaying_surface)    /* use overlay */
-             && (render_target == driver_data->last_displaying_surface)) {  /* It's the last displaying surface*/
-        object_surface_p cur_obj_surface = SURFACE(driver_data->cur_displaying_surface);
-        /*  The flip operation on current displaying surface could be delayed to
-         *  next VBlank and hadn't been finished yet. Then, the last displaying
-         *  surface shouldn't be freed, because the hardware may not
-         *  complete loading data of it. Any change of the last surface could
-         *  have a impect on the scrren.*/
-        if (NULL != cur_obj_surface) {
-            while ((GetTickCount() - cur_obj_surface->display_timestamp) < PSB_MAX_FLIP_DELAY)
-                usleep(PSB_MAX_FLIP_DELAY * 1000);
-        }
-    }
-    //pthread_mutex_unlock(&output->output_mutex);
-
-    if (vaStatus != VA_STATUS_ERROR_SURFACE_IN_DISPLAYING) {
-#ifdef PSBVIDEO_MRFL_VPP_ROTATE
-        /* For VPP buffer, will sync the rotated buffer */
-        if (obj_config && obj_config->entrypoint == VAEntrypointVideoProc) {
-            if (GET_SURFACE_INFO_tiling(obj_surface->psb_surface) &&
-                (obj_context->msvdx_rotate == VA_ROTATION_90 || obj_context->msvdx_rotate == VA_ROTATION_270) &&
-                obj_surface->out_loop_surface)
-                vaStatus = psb_surface_sync(obj_surface->out_loop_surface);
-            else
-                vaStatus = psb_surface_sync(obj_surface->psb_surface);
-        } else
-#endif
-        vaStatus = psb_surface_sync(obj_surface->psb_surface);
-    }
+    vaStatus = psb__sync_surfaces(driver_data, &render_target, 1, 1, PSB_SYNC_WAIT_INFINITE, NULL, &wait_us);
+    drv_debug_msg(VIDEO_DEBUG_GENERAL, "psb_SyncSurface: 0x%08x waited %dus\n", render_target, wait_us);
 
     /* report any error of decode for Android */
     psb__surface_usage(driver_data, obj_surface, &decode, &encode, &rc_enable, &proc);
@@ -2562,6 +2793,7 @@ VAStatus psb_SyncSurface(
     //psb__dump_NV_buffers(obj_surface->psb_surface_rotate, 0, 0, obj_surface->height, ((obj_surface->width + 0x1f) & (~0x1f)));
     if (obj_surface->scaling_surface)
         psb__dump_NV12_buffers(obj_surface->scaling_surface, 0, 0, obj_surface->width_s, obj_surface->height_s);
+    PSB_TRACE3(SYNC_SURFACE_END, render_target, vaStatus, wait_us);
     DEBUG_FAILURE;
     DEBUG_FUNC_EXIT
     return vaStatus;
@@ -2988,6 +3220,213 @@ VAStatus psb_SetTimestampForSurface(
     }
 }
 
+EXPORT VAStatus psb_QueryContextStats(
+    VADisplay dpy,
+    VAContextID context,
+    psb_context_stats_t *stats,
+    int reset
+)
+{
+    VADisplayContextP display_ctx = (VADisplayContextP)dpy;
+    VADriverContextP ctx;
+    VAStatus vaStatus = VA_STATUS_SUCCESS;
+    object_context_p obj_context;
+
+    if (display_ctx == NULL || display_ctx->pDriverContext == NULL ||
+        display_ctx->pDriverContext->pDriverData == NULL)
+        return VA_STATUS_ERROR_INVALID_DISPLAY;
+    ctx = display_ctx->pDriverContext;
+
+    INIT_DRIVER_DATA
+    CHECK_INVALID_PARAM(stats == NULL);
+
+    obj_context = CONTEXT(context);
+    CHECK_CONTEXT(obj_context);
+
+    pthread_mutex_lock(&obj_context->stats_mutex);
+    memcpy(stats, &obj_context->stats, sizeof(*stats));
+    if (reset) {
+        memset(&obj_context->stats, 0, sizeof(obj_context->stats));
+        obj_context->stats.version = PSB_STATS_VERSION;
+    }
+    pthread_mutex_unlock(&obj_context->stats_mutex);
+
+    return vaStatus;
+}
+
+EXPORT VAStatus psb_SyncSurfaces(
+    VADisplay dpy,
+    const VASurfaceID *surfaces,
+    int num_surfaces,
+    int wait_all,
+    unsigned int timeout_ms,
+    int *ready_index,
+    unsigned int *wait_us
+)
+{
+    VADisplayContextP display_ctx = (VADisplayContextP)dpy;
+    VADriverContextP ctx;
+    VAStatus vaStatus = VA_STATUS_SUCCESS;
+
+    if (display_ctx == NULL || display_ctx->pDriverContext == NULL ||
+        display_ctx->pDriverContext->pDriverData == NULL)
+        return VA_STATUS_ERROR_INVALID_DISPLAY;
+    ctx = display_ctx->pDriverContext;
+
+    INIT_DRIVER_DATA
+    CHECK_INVALID_PARAM(num_surfaces && surfaces == NULL);
+
+    vaStatus = psb__sync_surfaces(driver_data, surfaces, num_surfaces, wait_all, timeout_ms,
+                                  ready_index, wait_us);
+
+    return vaStatus;
+}
+
+EXPORT VAStatus psb_SetComposeLayers(
+    VADisplay dpy,
+    VAContextID context,
+    const psb_compose_layer_t *layers,
+    unsigned int num_layers
+)
+{
+    VADisplayContextP display_ctx = (VADisplayContextP)dpy;
+    VADriverContextP ctx;
+    VAStatus vaStatus = VA_STATUS_SUCCESS;
+    object_context_p obj_context;
+
+    if (display_ctx == NULL || display_ctx->pDriverContext == NULL ||
+        display_ctx->pDriverContext->pDriverData == NULL)
+        return VA_STATUS_ERROR_INVALID_DISPLAY;
+    ctx = display_ctx->pDriverContext;
+
+    INIT_DRIVER_DATA
+    CHECK_INVALID_PARAM(num_layers && layers == NULL);
+
+    obj_context = CONTEXT(context);
+    CHECK_CONTEXT(obj_context);
+
+#ifdef PSBVIDEO_MRFL_VPP
+    if (obj_context->format_vtable != &vsp_VPP_vtable)
+        return VA_STATUS_ERROR_INVALID_CONTEXT;
+
+    vaStatus = vsp_compose_set_layers((context_VPP_p)obj_context->format_data, layers, num_layers);
+#else
+    vaStatus = VA_STATUS_ERROR_UNIMPLEMENTED;
+#endif
+
+    return vaStatus;
+}
+
+/*
+ * Returns "context" if it is a TopazHP video encode context, or NULL
+ */
+static object_context_p psb__get_tng_encode_context(psb_driver_data_p driver_data, VAContextID context)
+{
+    object_context_p obj_context = CONTEXT(context);
+
+    if (obj_context == NULL)
+        return NULL;
+#ifdef PSBVIDEO_MRFL
+    if (obj_context->format_vtable == &tng_H264ES_vtable ||
+        obj_context->format_vtable == &tng_H263ES_vtable ||
+        obj_context->format_vtable == &tng_MPEG4ES_vtable)
+        return obj_context;
+#endif
+    return NULL;
+}
+
+EXPORT VAStatus psb_SetEncodePipelineDepth(
+    VADisplay dpy,
+    VAContextID context,
+    unsigned int depth
+)
+{
+    VADisplayContextP display_ctx = (VADisplayContextP)dpy;
+    VADriverContextP ctx;
+    VAStatus vaStatus = VA_STATUS_SUCCESS;
+    object_context_p enc_ctx;
+
+    if (display_ctx == NULL || display_ctx->pDriverContext == NULL ||
+        display_ctx->pDriverContext->pDriverData == NULL)
+        return VA_STATUS_ERROR_INVALID_DISPLAY;
+    ctx = display_ctx->pDriverContext;
+
+    INIT_DRIVER_DATA
+    CHECK_INVALID_PARAM(depth > PSB_CODED_QUEUE_SIZE);
+
+    enc_ctx = psb__get_tng_encode_context(driver_data, context);
+    if (enc_ctx == NULL)
+        return VA_STATUS_ERROR_INVALID_CONTEXT;
+
+#ifdef PSBVIDEO_MRFL
+    vaStatus = tng_set_pipeline_depth(enc_ctx, depth);
+#endif
+
+    return vaStatus;
+}
+
+EXPORT VAStatus psb_GetCompletedCodedBuffer(
+    VADisplay dpy,
+    VAContextID context,
+    VABufferID *coded_buf,
+    int wait
+)
+{
+    VADisplayContextP display_ctx = (VADisplayContextP)dpy;
+    VADriverContextP ctx;
+    VAStatus vaStatus = VA_STATUS_SUCCESS;
+    object_context_p enc_ctx;
+
+    if (display_ctx == NULL || display_ctx->pDriverContext == NULL ||
+        display_ctx->pDriverContext->pDriverData == NULL)
+        return VA_STATUS_ERROR_INVALID_DISPLAY;
+    ctx = display_ctx->pDriverContext;
+
+    INIT_DRIVER_DATA
+    CHECK_INVALID_PARAM(coded_buf == NULL);
+
+    enc_ctx = psb__get_tng_encode_context(driver_data, context);
+    if (enc_ctx == NULL)
+        return VA_STATUS_ERROR_INVALID_CONTEXT;
+
+#ifdef PSBVIDEO_MRFL
+    vaStatus = tng_get_completed_codedbuf(enc_ctx, coded_buf, wait);
+#endif
+
+    return vaStatus;
+}
+
+EXPORT VAStatus psb_GetCodedBufferIov(
+    VADisplay dpy,
+    VABufferID coded_buf,
+    struct iovec *iov,
+    uint32_t *info,
+    unsigned int max_iov,
+    unsigned int *num_iov,
+    unsigned int flags
+)
+{
+    VADisplayContextP display_ctx = (VADisplayContextP)dpy;
+    VADriverContextP ctx;
+    VAStatus vaStatus = VA_STATUS_SUCCESS;
+    object_buffer_p obj_buffer;
+
+    if (display_ctx == NULL || display_ctx->pDriverContext == NULL ||
+        display_ctx->pDriverContext->pDriverData == NULL)
+        return VA_STATUS_ERROR_INVALID_DISPLAY;
+    ctx = display_ctx->pDriverContext;
+
+    INIT_DRIVER_DATA
+    CHECK_INVALID_PARAM(num_iov == NULL || (max_iov && iov == NULL));
+
+    obj_buffer = BUFFER(coded_buf);
+    CHECK_BUFFER(obj_buffer);
+
+    vaStatus = psb_codedbuf_get_iov(obj_buffer, iov, info, max_iov, num_iov, flags);
+
+    return vaStatus;
+}
+
 int  LOCK_HARDWARE(psb_driver_data_p driver_data)
 {
     char ret = 0;
@@ -3045,7 +3484,7 @@ static VAStatus psb__initDRI(VADriverContextP ctx)
     struct drm_state *drm_state = (struct drm_state *)ctx->drm_state;
 
     assert(dri_state);
-#ifdef _FOR_FPGA_
+#if defined(_FOR_FPGA_) && !defined(PSB_REPLAY)
     dri_state->driConnectedFlag = VA_DUMMY;
     /* ON FPGA machine, psb may co-exist with gfx's drm driver */
     dri_state->fd = open("/dev/dri/card1", O_RDWR);
@@ -3160,6 +3599,8 @@ VAStatus psb_Terminate(VADriverContextP ctx)
 
     drv_debug_msg(VIDEO_DEBUG_INIT, "vaTerminate: begin to tear down\n");
 
+    psb_record_stop();
+
     /* Clean up left over contexts */
     obj_context = (object_context_p) object_heap_first(&driver_data->context_heap, &iter);
     while (obj_context) {
@@ -3241,6 +3682,9 @@ VAStatus psb_Terminate(VADriverContextP ctx)
         driver_data->ws_priv = NULL;
     }
 
+    psb_vlc_cache_destroy(driver_data);
+    psb_cmdbuf_submit_deinit(driver_data);
+
     drv_debug_msg(VIDEO_DEBUG_INIT, "vaTerminate: de-initialized DRM\n");
 
     psb__deinitDRM(ctx);
@@ -3252,6 +3696,7 @@ VAStatus psb_Terminate(VADriverContextP ctx)
         free(driver_data->surface_mb_error);
 
     pthread_mutex_destroy(&driver_data->drm_mutex);
+    pthread_mutex_destroy(&driver_data->vlc_cache_mutex);
     free(ctx->pDriverData);
     free(ctx->vtable_egl);
     free(ctx->vtable_tpi);
@@ -3384,6 +3829,7 @@ EXPORT VAStatus __vaDriverInit_0_31(VADriverContextP ctx)
     }
 
     pthread_mutex_init(&driver_data->drm_mutex, NULL);
+    pthread_mutex_init(&driver_data->vlc_cache_mutex, NULL);
 
     /*
      * To read PBO.MSR.CCF Mode and Status Register C-Spec -p112
@@ -3585,6 +4031,11 @@ EXPORT VAStatus __vaDriverInit_0_31(VADriverContextP ctx)
         return VA_STATUS_ERROR_ALLOCATION_FAILED;
     }
 
+    if (0 != psb_cmdbuf_submit_init(driver_data))
+        drv_debug_msg(VIDEO_DEBUG_ERROR, "failed to set up asynchronous cmdbuf submission\n");
+
+    psb_record_start(driver_data->dev_id);
+
     drv_debug_msg(VIDEO_DEBUG_INIT, "vaInitilize: succeeded!\n\n");
 
 #ifdef ANDROID
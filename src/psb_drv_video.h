@@ -50,6 +50,7 @@
 #endif
 #include "psb_overlay.h"
 #include "psb_texture.h"
+#include "psb_stats.h"
 #include <stdint.h>
 #ifndef ANDROID
 #include <psb_drm.h>
@@ -113,6 +114,18 @@
 
 /* Max # of command submission buffers */
 #define PSB_MAX_CMDBUFS                         10
+
+/* Why an MSVDX cmdbuf was submitted, counted per context */
+typedef enum {
+    PSB_FLUSH_EXPLICIT = 0,     /* end of picture or other caller request */
+    PSB_FLUSH_TRACE,            /* every submit is flushed while tracing */
+    PSB_FLUSH_CMD_COUNT,        /* MAX_CMD_COUNT render messages queued */
+    PSB_FLUSH_MTXMSG_FULL,
+    PSB_FLUSH_CMD_FULL,
+    PSB_FLUSH_LLDMA_FULL,
+    PSB_FLUSH_RELOC_FULL,
+    PSB_FLUSH_REASONS
+} psb_flush_reason_t;
 #define LNC_MAX_CMDBUFS_ENCODE                  4
 #define PNW_MAX_CMDBUFS_ENCODE                  4
 #define TNG_MAX_CMDBUFS_ENCODE                  4
@@ -210,6 +223,9 @@ struct psb_driver_data_s {
     drmLock                     *drm_lock;
     int                         contended_lock;
     pthread_mutex_t             drm_mutex;
+    struct psb_submit_queue_s   *submit_queue; /* MSVDX submission thread, NULL if synchronous */
+    pthread_mutex_t             vlc_cache_mutex;
+    struct psb_vlc_table_s      *vlc_cache; /* packed VLC tables shared by decode contexts */
     format_vtable_p             profile2Format[PSB_MAX_PROFILES][PSB_MAX_ENTRYPOINTS];
 #ifdef PSBVIDEO_MRFL_VPP
     format_vtable_p             vpp_profile;
@@ -295,6 +311,8 @@ struct psb_driver_data_s {
     /* for multi-thread safe */
     int use_xrandr_thread;
     pthread_mutex_t output_mutex;
+    pthread_cond_t display_cond; /* broadcast when overlay flips to a new surface */
+    struct psb_row_pool_s *row_pool; /* workers for vaGetImage/vaPutImage conversion */
     pthread_t xrandr_thread_id;
     int extend_fullscreen;
 
@@ -408,12 +426,31 @@ struct object_context_s {
 
     int cmdbuf_current;
 
+    /* MSVDX cmdbuf region sizes, grown when a picture overflows them */
+    unsigned int cmdbuf_cmd_size;
+    unsigned int cmdbuf_lldma_size;
+    unsigned int cmdbuf_reloc_size;
+    uint32_t cmdbuf_flushes[PSB_FLUSH_REASONS];
+
     /* Buffers */
     object_buffer_p buffers_unused[PSB_MAX_BUFFERTYPES]; /* Linked lists (HEAD) of unused buffers for each buffer type */
     int buffers_unused_count[PSB_MAX_BUFFERTYPES]; /* Linked lists (HEAD) of unused buffers for each buffer type */
     object_buffer_p buffers_unused_tail[PSB_MAX_BUFFERTYPES]; /* Linked lists (TAIL) of unused buffers for each buffer type */
     object_buffer_p buffers_active[PSB_MAX_BUFFERTYPES]; /* Linked lists of active buffers for each buffer type */
 
+    /* Buffer pool statistics, see psb__CreateBuffer */
+    uint32_t buffer_pool_hits;
+    uint32_t buffer_pool_misses;
+    uint32_t buffer_pool_busy;
+    uint32_t buffer_pool_recycled;
+
+    /* Timing statistics, see psb_stats.h */
+    pthread_mutex_t stats_mutex;
+    psb_context_stats_t stats;
+    uint64_t stats_frame_start_us;
+    uint64_t stats_submit_us;           /* running total of submit time */
+    uint32_t stats_frame_submits;
+
     object_buffer_p *buffer_list; /* for vaRenderPicture */
     int num_buffers;
 
@@ -600,6 +637,7 @@ struct object_buffer_s {
 
     /* for VAEncCodedBufferType */
     VACodedBufferSegment codedbuf_mapinfo[PSB_CODEDBUF_SEGMENT_MAX];
+    unsigned int codedbuf_pad[PSB_CODEDBUF_SEGMENT_MAX]; /* padding bytes included in each size */
     uint32_t codedbuf_aux_info;
 };
 
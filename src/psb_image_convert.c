@@ -0,0 +1,715 @@
+/*
+ * Copyright (c) 2011 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "psb_image_convert.h"
+
+#if defined(__i386__) || defined(__x86_64__)
+#include <emmintrin.h>
+#define PSB_CONVERT_SSE2
+#endif
+
+#ifndef VA_FOURCC_YUY2
+#define VA_FOURCC_YUY2          0x32595559
+#endif
+#ifndef VA_FOURCC_YV12
+#define VA_FOURCC_YV12          0x32315659
+#endif
+#ifndef VA_FOURCC_IYUV
+#define VA_FOURCC_IYUV          0x56555949
+#endif
+#ifndef VA_FOURCC_I420
+#define VA_FOURCC_I420          0x30323449
+#endif
+
+/* Chroma rows per band, each band also covers the two matching luma rows */
+#define PSB_CONVERT_MIN_ROWS    32
+
+/* Output rows per band when scaling to RGB */
+#define PSB_SCALE_MIN_ROWS      16
+
+/*
+ * Limited range YUV to RGB in fixed point with 6 fractional bits, so the
+ * SSE2 kernel fits in 16 bits. RGB to YUV is BT.601 only.
+ */
+struct psb_yuv2rgb_s {
+    short y, rv, gv, gu, bu;
+};
+
+static const struct psb_yuv2rgb_s psb__yuv2rgb_bt601 = {
+    75, 102, 52, 25, 129        /* 1.164, 1.596, 0.813, 0.391, 2.018 */
+};
+
+static const struct psb_yuv2rgb_s psb__yuv2rgb_bt709 = {
+    75, 115, 34, 14, 135        /* 1.164, 1.793, 0.533, 0.213, 2.112 */
+};
+
+struct psb_convert_kernels_s {
+    void (*split_uv)(const unsigned char *uv, unsigned char *u, unsigned char *v, int pairs);
+    void (*merge_uv)(const unsigned char *u, const unsigned char *v, unsigned char *uv, int pairs);
+    void (*pack_yuy2)(const unsigned char *y, const unsigned char *uv, unsigned char *yuy2, int pairs);
+    void (*unpack_yuy2)(const unsigned char *yuy2, unsigned char *y, unsigned char *uv, int pairs);
+    /* 4:2:0 row to 32 bit pixels, bytes in R G B A order or B G R A with bgr set */
+    void (*yuv_to_rgb32)(const unsigned char *y, const unsigned char *uv, unsigned char *dst, int pairs,
+                         const struct psb_yuv2rgb_s *m, int bgr);
+};
+
+struct psb_convert_job_s {
+    unsigned int fourcc;
+    int width;
+    int height;
+
+    /* NV12 surface side */
+    unsigned char *nv12_y;
+    unsigned char *nv12_uv;
+    int nv12_stride;
+
+    /* image side, U and V plane order is normalized for YV12 */
+    unsigned char *plane[3];
+    int pitch[3];
+};
+
+struct psb_rgb32_job_s {
+    unsigned char *src_y;
+    unsigned char *src_uv;
+    int src_stride;
+    int src_width;
+    int src_height;
+
+    unsigned char *dst;
+    int dst_pitch;
+    int dst_width;
+    int dst_height;
+
+    const struct psb_yuv2rgb_s *m;
+    int bgr;
+    int repack;                 /* channel layout the kernels can't write directly */
+    int rshift, gshift, bshift;
+
+    /* bilinear source positions in 16.8 fixed point, NULL when not scaling */
+    int *luma_x;
+    int *chroma_x;
+};
+
+static struct psb_convert_kernels_s psb__kernels;
+static pthread_once_t psb__convert_once = PTHREAD_ONCE_INIT;
+
+static inline unsigned char psb__clamp_u8(int v)
+{
+    return (v < 0) ? 0 : ((v > 255) ? 255 : v);
+}
+
+static void psb__split_uv_c(const unsigned char *uv, unsigned char *u, unsigned char *v, int pairs)
+{
+    int i;
+
+    for (i = 0; i < pairs; i++) {
+        u[i] = uv[2 * i];
+        v[i] = uv[2 * i + 1];
+    }
+}
+
+static void psb__merge_uv_c(const unsigned char *u, const unsigned char *v, unsigned char *uv, int pairs)
+{
+    int i;
+
+    for (i = 0; i < pairs; i++) {
+        uv[2 * i] = u[i];
+        uv[2 * i + 1] = v[i];
+    }
+}
+
+static void psb__pack_yuy2_c(const unsigned char *y, const unsigned char *uv, unsigned char *yuy2, int pairs)
+{
+    int i;
+
+    for (i = 0; i < pairs; i++) {
+        yuy2[4 * i] = y[2 * i];
+        yuy2[4 * i + 1] = uv[2 * i];
+        yuy2[4 * i + 2] = y[2 * i + 1];
+        yuy2[4 * i + 3] = uv[2 * i + 1];
+    }
+}
+
+static void psb__unpack_yuy2_c(const unsigned char *yuy2, unsigned char *y, unsigned char *uv, int pairs)
+{
+    int i;
+
+    for (i = 0; i < pairs; i++) {
+        y[2 * i] = yuy2[4 * i];
+        y[2 * i + 1] = yuy2[4 * i + 2];
+        if (uv) {
+            uv[2 * i] = yuy2[4 * i + 1];
+            uv[2 * i + 1] = yuy2[4 * i + 3];
+        }
+    }
+}
+
+static void psb__yuv_to_rgb32_c(const unsigned char *y, const unsigned char *uv, unsigned char *dst, int pairs,
+                                const struct psb_yuv2rgb_s *m, int bgr)
+{
+    int i, j, c, u, v;
+    int ri = bgr ? 2 : 0, bi = bgr ? 0 : 2;
+
+    for (i = 0; i < pairs; i++) {
+        u = uv[2 * i] - 128;
+        v = uv[2 * i + 1] - 128;
+        for (j = 0; j < 2; j++) {
+            c = m->y * (y[2 * i + j] - 16);
+            dst[ri] = psb__clamp_u8((c + m->rv * v + 32) >> 6);
+            dst[1] = psb__clamp_u8((c - m->gv * v - m->gu * u + 32) >> 6);
+            dst[bi] = psb__clamp_u8((c + m->bu * u + 32) >> 6);
+            dst[3] = 0xff;
+            dst += 4;
+        }
+    }
+}
+
+/*
+ * RGBA to NV12 for one chroma row: rgba1 is NULL on the last row of an
+ * odd height image. Chroma is the average of each 2x2 block.
+ */
+static void psb__rgba_to_nv12_c(const unsigned char *rgba0, const unsigned char *rgba1,
+                                unsigned char *y0, unsigned char *y1, unsigned char *uv, int pairs)
+{
+    const unsigned char *p;
+    int i, j, r, g, b, n;
+
+    for (i = 0; i < pairs; i++) {
+        r = g = b = n = 0;
+        for (j = 0; j < 4; j++) {
+            if ((j >= 2) && (rgba1 == NULL))
+                break;
+            p = ((j < 2) ? rgba0 : rgba1) + 8 * i + 4 * (j & 1);
+            r += p[0];
+            g += p[1];
+            b += p[2];
+            n++;
+            ((j < 2) ? y0 : y1)[2 * i + (j & 1)] = ((66 * p[0] + 129 * p[1] + 25 * p[2] + 128) >> 8) + 16;
+        }
+        r /= n;
+        g /= n;
+        b /= n;
+        uv[2 * i] = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+        uv[2 * i + 1] = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+    }
+}
+
+#ifdef PSB_CONVERT_SSE2
+__attribute__((target("sse2")))
+static void psb__split_uv_sse2(const unsigned char *uv, unsigned char *u, unsigned char *v, int pairs)
+{
+    const __m128i mask = _mm_set1_epi16(0x00ff);
+    int i;
+
+    for (i = 0; i + 16 <= pairs; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(uv + 2 * i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(uv + 2 * i + 16));
+        _mm_storeu_si128((__m128i *)(u + i),
+                         _mm_packus_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask)));
+        _mm_storeu_si128((__m128i *)(v + i),
+                         _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8)));
+    }
+    psb__split_uv_c(uv + 2 * i, u + i, v + i, pairs - i);
+}
+
+__attribute__((target("sse2")))
+static void psb__merge_uv_sse2(const unsigned char *u, const unsigned char *v, unsigned char *uv, int pairs)
+{
+    int i;
+
+    for (i = 0; i + 16 <= pairs; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(u + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(v + i));
+        _mm_storeu_si128((__m128i *)(uv + 2 * i), _mm_unpacklo_epi8(a, b));
+        _mm_storeu_si128((__m128i *)(uv + 2 * i + 16), _mm_unpackhi_epi8(a, b));
+    }
+    psb__merge_uv_c(u + i, v + i, uv + 2 * i, pairs - i);
+}
+
+__attribute__((target("sse2")))
+static void psb__pack_yuy2_sse2(const unsigned char *y, const unsigned char *uv, unsigned char *yuy2, int pairs)
+{
+    int i;
+
+    for (i = 0; i + 8 <= pairs; i += 8) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(y + 2 * i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(uv + 2 * i));
+        _mm_storeu_si128((__m128i *)(yuy2 + 4 * i), _mm_unpacklo_epi8(a, b));
+        _mm_storeu_si128((__m128i *)(yuy2 + 4 * i + 16), _mm_unpackhi_epi8(a, b));
+    }
+    psb__pack_yuy2_c(y + 2 * i, uv + 2 * i, yuy2 + 4 * i, pairs - i);
+}
+
+__attribute__((target("sse2")))
+static void psb__unpack_yuy2_sse2(const unsigned char *yuy2, unsigned char *y, unsigned char *uv, int pairs)
+{
+    const __m128i mask = _mm_set1_epi16(0x00ff);
+    int i;
+
+    for (i = 0; i + 8 <= pairs; i += 8) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(yuy2 + 4 * i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(yuy2 + 4 * i + 16));
+        _mm_storeu_si128((__m128i *)(y + 2 * i),
+                         _mm_packus_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask)));
+        if (uv)
+            _mm_storeu_si128((__m128i *)(uv + 2 * i),
+                             _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8)));
+    }
+    psb__unpack_yuy2_c(yuy2 + 4 * i, y + 2 * i, uv ? uv + 2 * i : NULL, pairs - i);
+}
+
+__attribute__((target("sse2")))
+static void psb__yuv_to_rgb32_sse2(const unsigned char *y, const unsigned char *uv, unsigned char *dst, int pairs,
+                                   const struct psb_yuv2rgb_s *m, int bgr)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i alpha = _mm_set1_epi8((char)0xff);
+    const __m128i round = _mm_set1_epi16(32);
+    int i;
+
+    for (i = 0; i + 4 <= pairs; i += 4) {
+        __m128i yy, cc, u, v, r, g, b, rg, ba;
+
+        /* 8 luma samples and the 4 chroma pairs they share */
+        yy = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(y + 2 * i)), zero);
+        yy = _mm_mullo_epi16(_mm_sub_epi16(yy, _mm_set1_epi16(16)), _mm_set1_epi16(m->y));
+        cc = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(uv + 2 * i)), zero);
+        cc = _mm_sub_epi16(cc, _mm_set1_epi16(128));
+        u = _mm_and_si128(cc, _mm_set1_epi32(0xffff));
+        u = _mm_or_si128(u, _mm_slli_epi32(u, 16));
+        v = _mm_srli_epi32(cc, 16);
+        v = _mm_or_si128(v, _mm_slli_epi32(v, 16));
+
+        r = _mm_adds_epi16(yy, _mm_mullo_epi16(v, _mm_set1_epi16(m->rv)));
+        g = _mm_subs_epi16(yy, _mm_mullo_epi16(v, _mm_set1_epi16(m->gv)));
+        g = _mm_subs_epi16(g, _mm_mullo_epi16(u, _mm_set1_epi16(m->gu)));
+        b = _mm_adds_epi16(yy, _mm_mullo_epi16(u, _mm_set1_epi16(m->bu)));
+        r = _mm_srai_epi16(_mm_adds_epi16(r, round), 6);
+        g = _mm_srai_epi16(_mm_adds_epi16(g, round), 6);
+        b = _mm_srai_epi16(_mm_adds_epi16(b, round), 6);
+
+        r = _mm_packus_epi16(r, r);
+        g = _mm_packus_epi16(g, g);
+        b = _mm_packus_epi16(b, b);
+        if (bgr) {
+            __m128i t = r;
+            r = b;
+            b = t;
+        }
+        rg = _mm_unpacklo_epi8(r, g);
+        ba = _mm_unpacklo_epi8(b, alpha);
+        _mm_storeu_si128((__m128i *)(dst + 8 * i), _mm_unpacklo_epi16(rg, ba));
+        _mm_storeu_si128((__m128i *)(dst + 8 * i + 16), _mm_unpackhi_epi16(rg, ba));
+    }
+    psb__yuv_to_rgb32_c(y + 2 * i, uv + 2 * i, dst + 8 * i, pairs - i, m, bgr);
+}
+#endif
+
+static void psb__convert_init(void)
+{
+    psb__kernels.split_uv = psb__split_uv_c;
+    psb__kernels.merge_uv = psb__merge_uv_c;
+    psb__kernels.pack_yuy2 = psb__pack_yuy2_c;
+    psb__kernels.unpack_yuy2 = psb__unpack_yuy2_c;
+    psb__kernels.yuv_to_rgb32 = psb__yuv_to_rgb32_c;
+#ifdef PSB_CONVERT_SSE2
+    if (psb_cpu_has_sse2()) {
+        psb__kernels.split_uv = psb__split_uv_sse2;
+        psb__kernels.merge_uv = psb__merge_uv_sse2;
+        psb__kernels.pack_yuy2 = psb__pack_yuy2_sse2;
+        psb__kernels.unpack_yuy2 = psb__unpack_yuy2_sse2;
+        psb__kernels.yuv_to_rgb32 = psb__yuv_to_rgb32_sse2;
+    }
+#endif
+}
+
+int psb_image_convert_supported(unsigned int fourcc)
+{
+    switch (fourcc) {
+    case VA_FOURCC_NV12:
+    case VA_FOURCC_IYUV:
+    case VA_FOURCC_I420:
+    case VA_FOURCC_YV12:
+    case VA_FOURCC_YUY2:
+    case VA_FOURCC_RGBA:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/*
+ * Point the job at the image planes, (x, y) being the top left pixel.
+ * plane[1] is always U and plane[2] always V.
+ */
+static void psb__convert_setup_image(struct psb_convert_job_s *job, VAImage *image,
+                                     unsigned char *image_data, int x, int y)
+{
+    int i;
+
+    for (i = 0; i < 3; i++) {
+        job->plane[i] = image_data + image->offsets[i];
+        job->pitch[i] = image->pitches[i];
+    }
+
+    switch (job->fourcc) {
+    case VA_FOURCC_NV12:
+        job->plane[0] += y * job->pitch[0] + x;
+        job->plane[1] += (y / 2) * job->pitch[1] + (x & ~1);
+        break;
+    case VA_FOURCC_YV12:
+        job->plane[1] = image_data + image->offsets[2];
+        job->pitch[1] = image->pitches[2];
+        job->plane[2] = image_data + image->offsets[1];
+        job->pitch[2] = image->pitches[1];
+        /* fall through */
+    case VA_FOURCC_IYUV:
+    case VA_FOURCC_I420:
+        job->plane[0] += y * job->pitch[0] + x;
+        job->plane[1] += (y / 2) * job->pitch[1] + x / 2;
+        job->plane[2] += (y / 2) * job->pitch[2] + x / 2;
+        break;
+    case VA_FOURCC_YUY2:
+        job->plane[0] += y * job->pitch[0] + (x & ~1) * 2;
+        break;
+    case VA_FOURCC_RGBA:
+        job->plane[0] += y * job->pitch[0] + x * 4;
+        break;
+    }
+}
+
+/*
+ * Band unit is one chroma row and the one or two luma rows above it.
+ * Odd widths are rounded up to a whole chroma pair.
+ */
+static void psb__convert_from_nv12_rows(void *arg, int row_start, int row_end)
+{
+    struct psb_convert_job_s *job = (struct psb_convert_job_s *)arg;
+    int pairs = (job->width + 1) / 2;
+    int k, r, luma_row, luma_rows;
+
+    for (k = row_start; k < row_end; k++) {
+        const unsigned char *src_y, *src_uv;
+
+        luma_row = 2 * k;
+        luma_rows = (luma_row + 1 < job->height) ? 2 : 1;
+        src_y = job->nv12_y + luma_row * job->nv12_stride;
+        src_uv = job->nv12_uv + k * job->nv12_stride;
+
+        switch (job->fourcc) {
+        case VA_FOURCC_NV12:
+            psb_copy_rows(job->plane[0] + luma_row * job->pitch[0], job->pitch[0],
+                          src_y, job->nv12_stride, job->width, luma_rows);
+            psb_copy_rows(job->plane[1] + k * job->pitch[1], job->pitch[1],
+                          src_uv, job->nv12_stride, pairs * 2, 1);
+            break;
+        case VA_FOURCC_IYUV:
+        case VA_FOURCC_I420:
+        case VA_FOURCC_YV12:
+            psb_copy_rows(job->plane[0] + luma_row * job->pitch[0], job->pitch[0],
+                          src_y, job->nv12_stride, job->width, luma_rows);
+            psb__kernels.split_uv(src_uv, job->plane[1] + k * job->pitch[1],
+                                  job->plane[2] + k * job->pitch[2], pairs);
+            break;
+        case VA_FOURCC_YUY2:
+            for (r = 0; r < luma_rows; r++)
+                psb__kernels.pack_yuy2(src_y + r * job->nv12_stride, src_uv,
+                                       job->plane[0] + (luma_row + r) * job->pitch[0], pairs);
+            break;
+        case VA_FOURCC_RGBA:
+            for (r = 0; r < luma_rows; r++)
+                psb__kernels.yuv_to_rgb32(src_y + r * job->nv12_stride, src_uv,
+                                          job->plane[0] + (luma_row + r) * job->pitch[0], pairs,
+                                          &psb__yuv2rgb_bt601, 0);
+            break;
+        }
+    }
+}
+
+static void psb__convert_to_nv12_rows(void *arg, int row_start, int row_end)
+{
+    struct psb_convert_job_s *job = (struct psb_convert_job_s *)arg;
+    int pairs = (job->width + 1) / 2;
+    int k, luma_row, luma_rows;
+
+    for (k = row_start; k < row_end; k++) {
+        unsigned char *dst_y, *dst_uv;
+        unsigned char *src0, *src1;
+
+        luma_row = 2 * k;
+        luma_rows = (luma_row + 1 < job->height) ? 2 : 1;
+        dst_y = job->nv12_y + luma_row * job->nv12_stride;
+        dst_uv = job->nv12_uv + k * job->nv12_stride;
+        src0 = job->plane[0] + luma_row * job->pitch[0];
+        src1 = (luma_rows == 2) ? src0 + job->pitch[0] : NULL;
+
+        switch (job->fourcc) {
+        case VA_FOURCC_NV12:
+            psb_copy_rows(dst_y, job->nv12_stride, src0, job->pitch[0], job->width, luma_rows);
+            psb_copy_rows(dst_uv, job->nv12_stride, job->plane[1] + k * job->pitch[1], job->pitch[1],
+                          pairs * 2, 1);
+            break;
+        case VA_FOURCC_IYUV:
+        case VA_FOURCC_I420:
+        case VA_FOURCC_YV12:
+            psb_copy_rows(dst_y, job->nv12_stride, src0, job->pitch[0], job->width, luma_rows);
+            psb__kernels.merge_uv(job->plane[1] + k * job->pitch[1],
+                                  job->plane[2] + k * job->pitch[2], dst_uv, pairs);
+            break;
+        case VA_FOURCC_YUY2:
+            psb__kernels.unpack_yuy2(src0, dst_y, dst_uv, pairs);
+            if (src1)
+                psb__kernels.unpack_yuy2(src1, dst_y + job->nv12_stride, NULL, pairs);
+            break;
+        case VA_FOURCC_RGBA:
+            psb__rgba_to_nv12_c(src0, src1, dst_y, dst_y + job->nv12_stride, dst_uv, pairs);
+            break;
+        }
+    }
+}
+
+VAStatus psb_image_from_nv12(psb_row_pool_p pool, VAImage *image, unsigned char *image_data,
+                             unsigned char *src_y, unsigned char *src_uv, int src_stride,
+                             int width, int height)
+{
+    struct psb_convert_job_s job;
+
+    if (!psb_image_convert_supported(image->format.fourcc))
+        return VA_STATUS_ERROR_OPERATION_FAILED;
+    if ((width <= 0) || (height <= 0))
+        return VA_STATUS_SUCCESS;
+
+    pthread_once(&psb__convert_once, psb__convert_init);
+
+    job.fourcc = image->format.fourcc;
+    job.width = width;
+    job.height = height;
+    job.nv12_y = src_y;
+    job.nv12_uv = src_uv;
+    job.nv12_stride = src_stride;
+    psb__convert_setup_image(&job, image, image_data, 0, 0);
+
+    psb_parallel_rows(pool, psb__convert_from_nv12_rows, &job, (height + 1) / 2, PSB_CONVERT_MIN_ROWS);
+
+    return VA_STATUS_SUCCESS;
+}
+
+VAStatus psb_image_to_nv12(psb_row_pool_p pool, VAImage *image, unsigned char *image_data,
+                           int src_x, int src_y,
+                           unsigned char *dst_y, unsigned char *dst_uv, int dst_stride,
+                           int width, int height)
+{
+    struct psb_convert_job_s job;
+
+    if (!psb_image_convert_supported(image->format.fourcc))
+        return VA_STATUS_ERROR_OPERATION_FAILED;
+    if ((width <= 0) || (height <= 0))
+        return VA_STATUS_SUCCESS;
+
+    pthread_once(&psb__convert_once, psb__convert_init);
+
+    job.fourcc = image->format.fourcc;
+    job.width = width;
+    job.height = height;
+    job.nv12_y = dst_y;
+    job.nv12_uv = dst_uv;
+    job.nv12_stride = dst_stride;
+    psb__convert_setup_image(&job, image, image_data, src_x, src_y);
+
+    psb_parallel_rows(pool, psb__convert_to_nv12_rows, &job, (height + 1) / 2, PSB_CONVERT_MIN_ROWS);
+
+    return VA_STATUS_SUCCESS;
+}
+
+/*
+ * Bilinear source positions for dst_size output samples taken from
+ * src_size input samples, pixel centres aligned, in 16.8 fixed point
+ */
+static void psb__scale_positions(int *pos, int dst_size, int src_size)
+{
+    int i, p;
+
+    for (i = 0; i < dst_size; i++) {
+        p = (int)((((long long)(2 * i + 1) * src_size << 8) / (2 * dst_size)) - 128);
+        if (p < 0)
+            p = 0;
+        if (p > (src_size - 1) << 8)
+            p = (src_size - 1) << 8;
+        pos[i] = p;
+    }
+}
+
+/* Blend two source rows at vertical fraction fy, then resample horizontally */
+static void psb__scale_row(const unsigned char *row0, const unsigned char *row1, int fy,
+                           unsigned char *tmp, int src_size, const int *pos, int dst_size,
+                           int step, unsigned char *out)
+{
+    int i, c, x, fx, a, b;
+
+    for (i = 0; i < src_size * step; i++)
+        tmp[i] = (row0[i] * (256 - fy) + row1[i] * fy + 128) >> 8;
+
+    for (i = 0; i < dst_size; i++) {
+        x = pos[i] >> 8;
+        fx = pos[i] & 0xff;
+        for (c = 0; c < step; c++) {
+            a = tmp[x * step + c];
+            b = (x + 1 < src_size) ? tmp[(x + 1) * step + c] : a;
+            out[i * step + c] = (a * (256 - fx) + b * fx + 128) >> 8;
+        }
+    }
+}
+
+/* Convert one output row; the kernels work on pixel pairs so an odd tail goes through a scratch pair */
+static void psb__rgb32_row(struct psb_rgb32_job_s *job, const unsigned char *y, const unsigned char *uv,
+                           unsigned char *dst)
+{
+    int width = job->dst_width;
+    unsigned int *pixel = (unsigned int *)dst;
+    unsigned char *p;
+    int i;
+
+    psb__kernels.yuv_to_rgb32(y, uv, dst, width / 2, job->m, job->bgr);
+    if (width & 1) {
+        unsigned char tail_y[2], tail[8];
+
+        tail_y[0] = tail_y[1] = y[width - 1];
+        psb__kernels.yuv_to_rgb32(tail_y, uv + (width - 1), tail, 1, job->m, job->bgr);
+        memcpy(dst + (width - 1) * 4, tail, 4);
+    }
+
+    if (!job->repack)
+        return;
+
+    /* Move R G B A bytes to the visual's channel shifts */
+    for (i = 0, p = dst; i < width; i++, p += 4)
+        pixel[i] = ((unsigned int)p[0] << job->rshift) | ((unsigned int)p[1] << job->gshift) |
+                   ((unsigned int)p[2] << job->bshift);
+}
+
+/* Unscaled: band unit is one chroma row and its one or two luma rows */
+static void psb__nv12_to_rgb32_rows(void *arg, int row_start, int row_end)
+{
+    struct psb_rgb32_job_s *job = (struct psb_rgb32_job_s *)arg;
+    int k, r, luma_row;
+
+    for (k = row_start; k < row_end; k++) {
+        for (r = 0; r < 2; r++) {
+            luma_row = 2 * k + r;
+            if (luma_row >= job->dst_height)
+                break;
+            psb__rgb32_row(job, job->src_y + luma_row * job->src_stride,
+                           job->src_uv + k * job->src_stride, job->dst + luma_row * job->dst_pitch);
+        }
+    }
+}
+
+/* Scaled: band unit is one output row */
+static void psb__nv12_scale_rgb32_rows(void *arg, int row_start, int row_end)
+{
+    struct psb_rgb32_job_s *job = (struct psb_rgb32_job_s *)arg;
+    int src_pairs = (job->src_width + 1) / 2, dst_pairs = (job->dst_width + 1) / 2;
+    int chroma_height = (job->src_height + 1) / 2;
+    int k, pos_y, pos_c, y0, c0;
+    unsigned char *tmp, *luma, *chroma;
+
+    tmp = malloc(2 * src_pairs * 2 + dst_pairs * 2 * 2);
+    if (tmp == NULL)
+        return;
+    luma = tmp + 2 * src_pairs * 2;
+    chroma = luma + dst_pairs * 2;
+
+    for (k = row_start; k < row_end; k++) {
+        pos_y = (int)((((long long)(2 * k + 1) * job->src_height << 8) / (2 * job->dst_height)) - 128);
+        pos_c = (int)((((long long)(2 * k + 1) * chroma_height << 8) / (2 * job->dst_height)) - 128);
+        pos_y = (pos_y < 0) ? 0 : pos_y;
+        pos_c = (pos_c < 0) ? 0 : pos_c;
+        y0 = pos_y >> 8;
+        c0 = pos_c >> 8;
+
+        psb__scale_row(job->src_y + y0 * job->src_stride,
+                       job->src_y + ((y0 + 1 < job->src_height) ? y0 + 1 : y0) * job->src_stride,
+                       pos_y & 0xff, tmp, job->src_width, job->luma_x, job->dst_width, 1, luma);
+        psb__scale_row(job->src_uv + c0 * job->src_stride,
+                       job->src_uv + ((c0 + 1 < chroma_height) ? c0 + 1 : c0) * job->src_stride,
+                       pos_c & 0xff, tmp, src_pairs, job->chroma_x, dst_pairs, 2, chroma);
+
+        psb__rgb32_row(job, luma, chroma, job->dst + k * job->dst_pitch);
+    }
+
+    free(tmp);
+}
+
+VAStatus psb_nv12_to_rgb32(psb_row_pool_p pool,
+                           unsigned char *src_y, unsigned char *src_uv, int src_stride,
+                           int src_width, int src_height,
+                           unsigned char *dst, int dst_pitch, int dst_width, int dst_height,
+                           int rshift, int gshift, int bshift, int bt709)
+{
+    struct psb_rgb32_job_s job;
+
+    if ((src_width <= 0) || (src_height <= 0) || (dst_width <= 0) || (dst_height <= 0))
+        return VA_STATUS_SUCCESS;
+
+    pthread_once(&psb__convert_once, psb__convert_init);
+
+    job.src_y = src_y;
+    job.src_uv = src_uv;
+    job.src_stride = src_stride;
+    job.src_width = src_width;
+    job.src_height = src_height;
+    job.dst = dst;
+    job.dst_pitch = dst_pitch;
+    job.dst_width = dst_width;
+    job.dst_height = dst_height;
+    job.m = bt709 ? &psb__yuv2rgb_bt709 : &psb__yuv2rgb_bt601;
+    job.rshift = rshift;
+    job.gshift = gshift;
+    job.bshift = bshift;
+    job.bgr = (rshift == 16) && (gshift == 8) && (bshift == 0);
+    job.repack = !job.bgr && !((rshift == 0) && (gshift == 8) && (bshift == 16));
+    job.luma_x = NULL;
+    job.chroma_x = NULL;
+
+    if ((src_width == dst_width) && (src_height == dst_height)) {
+        psb_parallel_rows(pool, psb__nv12_to_rgb32_rows, &job, (dst_height + 1) / 2, PSB_CONVERT_MIN_ROWS);
+        return VA_STATUS_SUCCESS;
+    }
+
+    job.luma_x = malloc(sizeof(int) * (dst_width + (dst_width + 1) / 2));
+    if (job.luma_x == NULL)
+        return VA_STATUS_ERROR_ALLOCATION_FAILED;
+    job.chroma_x = job.luma_x + dst_width;
+    psb__scale_positions(job.luma_x, dst_width, src_width);
+    psb__scale_positions(job.chroma_x, (dst_width + 1) / 2, (src_width + 1) / 2);
+
+    psb_parallel_rows(pool, psb__nv12_scale_rgb32_rows, &job, dst_height, PSB_SCALE_MIN_ROWS);
+
+    free(job.luma_x);
+    return VA_STATUS_SUCCESS;
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2011 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _PSB_IMAGE_CONVERT_H_
+#define _PSB_IMAGE_CONVERT_H_
+
+#include <va/va.h>
+#include "psb_unpack.h"
+
+/*
+ * Returns nonzero if images of this fourcc can be read from or written to
+ * NV12 surfaces
+ */
+int psb_image_convert_supported(unsigned int fourcc);
+
+/*
+ * Convert a width x height region of an NV12 surface into the image,
+ * starting at the image origin. image_data is the mapped image buffer,
+ * which may be a user pointer so no intermediate copy is made.
+ */
+VAStatus psb_image_from_nv12(psb_row_pool_p pool, VAImage *image, unsigned char *image_data,
+                             unsigned char *src_y, unsigned char *src_uv, int src_stride,
+                             int width, int height);
+
+/*
+ * Convert a width x height region of the image starting at (src_x, src_y)
+ * into an NV12 surface
+ */
+VAStatus psb_image_to_nv12(psb_row_pool_p pool, VAImage *image, unsigned char *image_data,
+                           int src_x, int src_y,
+                           unsigned char *dst_y, unsigned char *dst_uv, int dst_stride,
+                           int width, int height);
+
+/*
+ * Convert a src_width x src_height region of an NV12 surface to
+ * dst_width x dst_height 32 bit pixels, scaling bilinearly when the sizes
+ * differ. Red, green and blue bytes go to the given bit shifts; bt709
+ * selects the BT.709 matrix instead of BT.601.
+ */
+VAStatus psb_nv12_to_rgb32(psb_row_pool_p pool,
+                           unsigned char *src_y, unsigned char *src_uv, int src_stride,
+                           int src_width, int src_height,
+                           unsigned char *dst, int dst_pitch, int dst_width, int dst_height,
+                           int rshift, int gshift, int bshift, int bt709);
+
+#endif /* _PSB_IMAGE_CONVERT_H_ */
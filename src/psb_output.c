@@ -38,11 +38,14 @@
 #include <va/va_backend.h>
 #include <dlfcn.h>
 #include <stdlib.h>
+#include <time.h>
 #include "psb_output.h"
 #include "psb_surface.h"
 #include "psb_buffer.h"
 #include "psb_surface_ext.h"
 #include "pnw_rotate.h"
+#include "psb_unpack.h"
+#include "psb_image_convert.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdarg.h>
@@ -81,7 +84,10 @@ static VAImageFormat psb__CreateImageFormat[] = {
     //psb__ImageAYUV,
     //psb__ImageAI44,
     psb__ImageYV16,
-    psb__ImageYV32
+    psb__ImageYV32,
+    psb__ImageI420,
+    psb__ImageYV12,
+    psb__ImageYUY2
 };
 
 unsigned char *psb_x11_output_init(VADriverContextP ctx);
@@ -97,8 +103,15 @@ VAStatus psb_initOutput(VADriverContextP ctx)
     INIT_DRIVER_DATA;
     unsigned char *ws_priv = NULL;
     char env_value[1024];
+    pthread_condattr_t cond_attr;
 
     pthread_mutex_init(&driver_data->output_mutex, NULL);
+    /* flip waits use monotonic deadlines, see psb__wait_flip_done */
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&driver_data->display_cond, &cond_attr);
+    pthread_condattr_destroy(&cond_attr);
+    driver_data->row_pool = psb_row_pool_create();
 
     if (psb_parse_config("PSB_VIDEO_PUTSURFACE_DUMMY", &env_value[0]) == 0) {
         drv_debug_msg(VIDEO_DEBUG_GENERAL, "vaPutSurface: dummy mode, return directly\n");
@@ -187,6 +200,9 @@ VAStatus psb_deinitOutput(
     psb_surface_set_displaying(driver_data, 0, 0, NULL);
 #endif
     pthread_mutex_destroy(&driver_data->output_mutex);
+    pthread_cond_destroy(&driver_data->display_cond);
+    psb_row_pool_destroy(driver_data->row_pool);
+    driver_data->row_pool = NULL;
 
     return VA_STATUS_SUCCESS;
 }
@@ -369,7 +385,8 @@ VAStatus psb_CreateImage(
         obj_image->image.component_order[3] = '\0';
         break;
     }
-    case VA_FOURCC_IYUV: {
+    case VA_FOURCC_IYUV:
+    case VA_FOURCC_I420: {
         obj_image->image.width = width;
         obj_image->image.height = height;
         obj_image->image.data_size = pitch_pot * height /*Y*/ + 2 * (pitch_pot / 2) * (height / 2);/*UV*/
@@ -388,6 +405,40 @@ VAStatus psb_CreateImage(
         obj_image->image.component_order[3] = '\0';
         break;
     }
+    case VA_FOURCC_YV12: {
+        obj_image->image.width = width;
+        obj_image->image.height = height;
+        obj_image->image.data_size = pitch_pot * height /*Y*/ + 2 * (pitch_pot / 2) * (height / 2);/*VU*/
+        obj_image->image.num_planes = 3;
+        obj_image->image.pitches[0] = pitch_pot;
+        obj_image->image.pitches[1] = pitch_pot / 2;
+        obj_image->image.pitches[2] = pitch_pot / 2;
+        obj_image->image.offsets[0] = 0;
+        obj_image->image.offsets[1] = pitch_pot * height;
+        obj_image->image.offsets[2] = pitch_pot * height + (pitch_pot / 2) * (height / 2);
+        obj_image->image.num_palette_entries = 0;
+        obj_image->image.entry_bytes = 0;
+        obj_image->image.component_order[0] = 'Y';
+        obj_image->image.component_order[1] = 'V';
+        obj_image->image.component_order[2] = 'U';
+        obj_image->image.component_order[3] = '\0';
+        break;
+    }
+    case VA_FOURCC_YUY2: {
+        obj_image->image.width = width;
+        obj_image->image.height = height;
+        obj_image->image.data_size = 2 * pitch_pot * height;
+        obj_image->image.num_planes = 1;
+        obj_image->image.pitches[0] = 2 * pitch_pot;
+        obj_image->image.offsets[0] = 0;
+        obj_image->image.num_palette_entries = 0;
+        obj_image->image.entry_bytes = 0;
+        obj_image->image.component_order[0] = 'Y';
+        obj_image->image.component_order[1] = 'U';
+        obj_image->image.component_order[2] = 'Y';
+        obj_image->image.component_order[3] = 'V';
+        break;
+    }
     case VA_FOURCC_YV32: {
         obj_image->image.width = width;
         obj_image->image.height = height;
@@ -727,125 +778,6 @@ static VAStatus lnc_unpack_topaz_rec(int src_width, int src_height,
     return VA_STATUS_SUCCESS;
 }
 
-/*
-* Convert the memroy format from tiled to linear
-*/
-static VAStatus tng_unpack_vsp_rec(
-    int src_width, int src_height,
-    unsigned char *p_srcY, unsigned char *p_srcUV,
-    unsigned char *p_dstY, unsigned char *p_dstU,
-    int dstY_stride, int dstU_stride, int __maybe_unused dstV_stride,
-    int __maybe_unused surface_height)
-{
-    unsigned char *tmp_dstY = p_dstY;
-    unsigned char *tmp_dstU = p_dstU;
-
-    int n, t,x,y;
-
-   //"	Y_address(x,y) =    Y_base + (((H            +64+63)/64) * (x/64) + (y/64))*4096 + (y%64)*64 + (x%64)
-   //"	U_address(x,y) = UV_base + ((((H+1)/2+32+63)/64) * (x/32) + (y/64))*4096 + (y%64)*64 + (x%32)*2
-   //"	V_address(x,y) = UV_base + ((((H+1)/2+32+63)/64) * (x/32) + (y/64))*4096 + (y%64)*64 + (x%32)*2 + 1
-
-    /*  Copy Y data */
-    for (y = 32; y < src_height + 32; y++) {
-        for (x= 32;x < src_width + 32; x++) {
-            * tmp_dstY++ =  *(p_srcY + (((src_height+64+63)/64) * (x/64) + (y/64))*4096 + (y%64)*64 + (x%64));
-            }
-            tmp_dstY += dstY_stride - src_width;
-    }
-
-    /*  Copy UV data */
-    for (y = 16; y < 16 + ((src_height+1)>>1) ; y++) {
-        for (x= 16;x < 16 + ( (src_width+1)>>1); x++) {
-            * tmp_dstU++ = * (p_srcUV + ((((src_height+1)/2+32+63)/64) * (x/32) + (y/64))*4096 + (y%64)*64 + (x%32)*2);
-            * tmp_dstU++ = * (p_srcUV + ((((src_height+1)/2+32+63)/64) * (x/32) + (y/64))*4096 + (y%64)*64 + (x%32)*2 +1);
-            }
-           tmp_dstU += dstU_stride - ((src_width));
-    }
-
-    return VA_STATUS_SUCCESS;
-}
-/*
-* Convert the memroy format from tiled to linear
-*/
-static VAStatus tng_unpack_topaz_rec(
-    int src_width, int src_height,
-    unsigned char *p_srcY, unsigned char *p_srcUV,
-    unsigned char *p_dstY, unsigned char *p_dstU, unsigned char *p_dstV,
-    int dstY_stride, int __maybe_unused dstU_stride, int __maybe_unused dstV_stride,
-    int __maybe_unused surface_height)
-{
-    unsigned char *tmp_dstY = p_dstY;
-    unsigned char *tmp_dstU = p_dstU;
-    unsigned char *tmp_dstV = p_dstV;
-    unsigned char *tmp_srcY = p_srcY;
-    unsigned char *tmp_srcX = p_srcUV;
-
-    int i, j, n, t;
-    int mb_src_y_w = src_width >> 4;
-    int mb_src_y_h = src_height >> 5;
-    int mb_src_y_p = src_height - (mb_src_y_h << 5);
-
-    /*  Copy Y data */
-    for (j = 0; j < mb_src_y_h; j++) {
-        tmp_dstY = p_dstY + j * dstY_stride * 32;
-        for (i = 0; i < mb_src_y_w; i++) {
-            for (n = 0; n < 32; n++) {
-                memcpy(tmp_dstY + dstY_stride * n, tmp_srcY,16);
-                tmp_srcY += 16;
-            }
-            tmp_dstY += 16;
-        }
-    }
-
-    if(mb_src_y_p != 0) {
-        tmp_dstY = p_dstY + j * dstY_stride * 32;
-        for (i = 0; i < mb_src_y_w; i++) {
-            for (n = 0; n < mb_src_y_p; n++) {
-                memcpy(tmp_dstY + dstY_stride * n, tmp_srcY,16);
-                tmp_srcY += 16;
-            }
-            for (; n < 32; n++) {
-                tmp_srcY += 16;
-            }
-            tmp_dstY += 16;
-        }
-    }
-
-    for (j = 0; j < mb_src_y_h; j++) {
-        tmp_dstU = p_dstU + j * dstY_stride * 16;
-        for (i = 0; i < mb_src_y_w; i++) {
-            for (n = 0; n < 16; n++) {
-                for (t = 0; t < 16; t++) {
-                    tmp_dstU[(n * dstY_stride) + t] = tmp_srcX[t];
-                }
-                tmp_srcX += 16;
-            }
-            tmp_dstU += 16;
-        }
-    }
-    mb_src_y_p >>= 1;
-    if(mb_src_y_p != 0) {
-        tmp_dstU = p_dstU + j * dstY_stride * 16;
-        for (i = 0; i < mb_src_y_w; i++) {
-            for (n = 0; n < mb_src_y_p; n++) {
-                for (t = 0; t < 16; t++) {
-                   tmp_dstU[(n * dstY_stride) + t] = tmp_srcX[t];
-                }
-                tmp_srcX += 16;
-            }
-
-            for (; n < 16; n++) {
-                tmp_srcX += 16;
-            }
-
-            tmp_dstU += 16;
-        }
-    }
-
-    return VA_STATUS_SUCCESS;
-}
-
 VAStatus psb_GetImage(
     VADriverContextP ctx,
     VASurfaceID surface,
@@ -871,8 +803,8 @@ VAStatus psb_GetImage(
         return vaStatus;
     }
 
-    if (obj_image->image.format.fourcc != VA_FOURCC_NV12) {
-        drv_debug_msg(VIDEO_DEBUG_ERROR, "target VAImage fourcc should be NV12 or IYUV\n");
+    if (!psb_image_convert_supported(obj_image->image.format.fourcc)) {
+        drv_debug_msg(VIDEO_DEBUG_ERROR, "target VAImage fourcc 0x%x isn't supported\n", obj_image->image.format.fourcc);
         vaStatus = VA_STATUS_ERROR_OPERATION_FAILED;
         return vaStatus;
     }
@@ -880,6 +812,12 @@ VAStatus psb_GetImage(
     object_surface_p obj_surface = SURFACE(surface);
     CHECK_SURFACE(obj_surface);
 
+    if (obj_surface->is_ref_surface && (obj_image->image.format.fourcc != VA_FOURCC_NV12)) {
+        drv_debug_msg(VIDEO_DEBUG_ERROR, "reconstructed frames can only be read as NV12\n");
+        vaStatus = VA_STATUS_ERROR_OPERATION_FAILED;
+        return vaStatus;
+    }
+
     psb__VAImageCheckRegion(obj_surface, &obj_image->image, &src_x, &src_y, &dest_x, &dest_y,
                             (int *)&width, (int *)&height);
 
@@ -906,95 +844,45 @@ VAStatus psb_GetImage(
     image_data += obj_surface->psb_surface->buf.buffer_ofs;
 
 
-    switch (obj_image->image.format.fourcc) {
-    case VA_FOURCC_NV12: {
-        unsigned char *src_y, *src_uv, *dst_y, *dst_uv;
-	unsigned char *dst_u, *dst_v;
-        unsigned int i;
-
-	/*
-	 * For reconstructed frame, tiled to linear conversion
-	 * must be done.
-	*/
-	if (obj_surface->is_ref_surface == 1) {
-	    src_y = surface_data + y * psb_surface->stride + x;
-	    src_uv = surface_data + ((height + 0x1f) & (~0x1f)) * width;
-
-	    dst_y = image_data;
-	    dst_u = image_data + obj_image->image.offsets[1],
-	    dst_v = dst_u + (height * width) / 4;
-
-	    tng_unpack_topaz_rec(width, height, \
-				 src_y, src_uv, \
-			         dst_y, dst_u, dst_v, \
-			         obj_image->image.pitches[0], \
-			         obj_image->image.width / 2, \
-			         obj_image->image.width / 2, \
-			         obj_surface->height);
-	} else if (obj_surface->is_ref_surface == 2) {
-	    src_y = surface_data + y * psb_surface->stride + x;
-	    src_uv = surface_data + ((height + 2*32 + 63)/64*64) * ((width  + 2*32 + 63)/64*64);
-	    dst_y = image_data;
-	    dst_u = image_data +  obj_image->image.offsets[1];
-
-	    tng_unpack_vsp_rec(width, height, \
-				 src_y, src_uv, \
-			         dst_y, dst_u, \
-			         obj_image->image.pitches[0], \
-			         obj_image->image.pitches[1], \
-			         obj_image->image.pitches[1], \
-			         obj_surface->height);
-	} else{
-            /* copy Y plane */
-            dst_y = image_data;
-            src_y = surface_data + y * psb_surface->stride + x;
-            for (i = 0; i < height; i++)  {
-		memcpy(dst_y, src_y, width);
-		dst_y += obj_image->image.pitches[0];
-		src_y += psb_surface->stride;
-            }
+    unsigned char *src_y, *src_uv, *dst_y, *dst_uv;
 
-	    /* copy UV plane */
-	    dst_uv = image_data + obj_image->image.offsets[1];
-            src_uv = surface_data + psb_surface->stride * obj_surface->height + (y / 2) * psb_surface->stride + x;;
-            for (i = 0; i < obj_image->image.height / 2; i++) {
-		memcpy(dst_uv, src_uv, width);
-		dst_uv += obj_image->image.pitches[1];
-		src_uv += psb_surface->stride;
-	    }
-	}
-        break;
-    }
-#if 0
-    case VA_FOURCC_IYUV: {
-        unsigned char *source_y, *dst_y;
-        unsigned char *source_uv, *source_u, *source_v, *dst_u, *dst_v;
-        unsigned int i;
-
-        if (psb_surface->extra_info[4] == VA_FOURCC_IREC) {
-            /* copy Y plane */
-            dst_y = image_data + obj_image->image.offsets[0] + src_y * obj_image->image.pitches[0] + src_x;
-            dst_u = image_data + obj_image->image.offsets[1] + src_y * obj_image->image.pitches[1] + src_x;
-            dst_v = image_data + obj_image->image.offsets[2] + src_y * obj_image->image.pitches[2] + src_x;
-
-            source_y = surface_data + dest_y * psb_surface->stride + dest_x;
-            source_uv = surface_data + obj_surface->height * psb_surface->stride
-                        + dest_y * (psb_surface->stride / 2) + dest_x;
-
-            vaStatus = lnc_unpack_topaz_rec(width, height, source_y, source_uv,
-                                            dst_y, dst_u, dst_v,
-                                            obj_image->image.pitches[0],
-                                            obj_image->image.pitches[1],
-                                            obj_image->image.pitches[2],
-                                            obj_surface->height);
-        }
+    /*
+     * For reconstructed frame, tiled to linear conversion
+     * must be done.
+     */
+    if (obj_surface->is_ref_surface == 1) {
+        src_y = surface_data + y * psb_surface->stride + x;
+        src_uv = surface_data + ((height + 0x1f) & (~0x1f)) * width;
+
+        dst_y = image_data;
+        dst_uv = image_data + obj_image->image.offsets[1];
+
+        vaStatus = psb_unpack_topaz_rec(driver_data->row_pool, width, height,
+                                        src_y, src_uv,
+                                        dst_y, dst_uv,
+                                        obj_image->image.pitches[0],
+                                        obj_image->image.pitches[1]);
+    } else if (obj_surface->is_ref_surface == 2) {
+        src_y = surface_data + y * psb_surface->stride + x;
+        src_uv = surface_data + ((height + 2*32 + 63)/64*64) * ((width  + 2*32 + 63)/64*64);
+
+        dst_y = image_data;
+        dst_uv = image_data +  obj_image->image.offsets[1];
+
+        vaStatus = psb_unpack_vsp_rec(driver_data->row_pool, width, height,
+                                      src_y, src_uv,
+                                      dst_y, dst_uv,
+                                      obj_image->image.pitches[0],
+                                      obj_image->image.pitches[1]);
+    } else {
+        src_y = surface_data + y * psb_surface->stride + x;
+        src_uv = surface_data + psb_surface->stride * obj_surface->height + (y / 2) * psb_surface->stride + x;
 
-        break;
-    }
-#endif
-    default:
-        break;
+        vaStatus = psb_image_from_nv12(driver_data->row_pool, &obj_image->image, image_data,
+                                       src_y, src_uv, psb_surface->stride,
+                                       width, height);
     }
+
     psb_buffer_unmap(obj_buffer->psb_buffer);
     psb_buffer_unmap(&psb_surface->buf);
 
@@ -1023,8 +911,8 @@ static VAStatus psb_PutImage2(
     object_surface_p obj_surface = SURFACE(surface);
     CHECK_SURFACE(obj_surface);
 
-    if (obj_image->image.format.fourcc != VA_FOURCC_NV12) {
-        drv_debug_msg(VIDEO_DEBUG_ERROR, "target VAImage fourcc should be NV12 or IYUV\n");
+    if (!psb_image_convert_supported(obj_image->image.format.fourcc)) {
+        drv_debug_msg(VIDEO_DEBUG_ERROR, "source VAImage fourcc 0x%x isn't supported\n", obj_image->image.format.fourcc);
         vaStatus = VA_STATUS_ERROR_OPERATION_FAILED;
         return vaStatus;
     }
@@ -1051,76 +939,20 @@ static VAStatus psb_PutImage2(
 
     image_data += obj_surface->psb_surface->buf.buffer_ofs;
 
-    switch (obj_image->image.format.fourcc) {
-    case VA_FOURCC_NV12: {
-        unsigned char *source_y, *src_uv, *dst_y, *dst_uv;
-        unsigned int i;
-
-        /* copy Y plane */
-        source_y = image_data + obj_image->image.offsets[0] + src_y * obj_image->image.pitches[0] + src_x;
-        dst_y = surface_data + dest_y * psb_surface->stride + dest_x;
-        for (i = 0; i < height; i++)  {
-            memcpy(dst_y, source_y, width);
-            source_y += obj_image->image.pitches[0];
-            dst_y += psb_surface->stride;
-        }
-
-        /* copy UV plane */
-        src_uv = image_data + obj_image->image.offsets[1] + (src_y / 2) * obj_image->image.pitches[1] + src_x;
-        dst_uv = surface_data + psb_surface->stride * obj_surface->height + (dest_y / 2) * psb_surface->stride + dest_x;
-        for (i = 0; i < obj_image->image.height / 2; i++) {
-            memcpy(dst_uv, src_uv, width);
-            src_uv += obj_image->image.pitches[1];
-            dst_uv += psb_surface->stride;
-        }
-        break;
-    }
-#if 0
-    case VA_FOURCC_IYUV: {
-        char *source_y, *dst_y;
-        char *source_u, *source_v, *dst_u, *dst_v;
-        unsigned int i;
-
-        /* copy Y plane */
-        source_y = image_data + obj_image->image.offsets[0] + src_y * obj_image->image.pitches[0] + src_x;
-        source_u = image_data + obj_image->image.offsets[1] + src_y * obj_image->image.pitches[1] + src_x;
-        source_v = image_data + obj_image->image.offsets[2] + src_y * obj_image->image.pitches[2] + src_x;
-
-        dst_y = surface_data + dest_y * psb_surface->stride + dest_x;
-        dst_u = surface_data + obj_surface->height * psb_surface->stride
-                + dest_y * (psb_surface->stride / 2) + dest_x;
-        dst_v = surface_data + obj_surface->height * psb_surface->stride
-                + (obj_surface->height / 2) * (psb_surface->stride / 2)
-                + dest_y * (psb_surface->stride / 2) + dest_x;
-
-        for (i = 0; i < height; i++)  {
-            memcpy(dst_y, source_y, width);
-            source_y += obj_image->image.pitches[0];
-            dst_y += psb_surface->stride;
-        }
-
-        /* copy UV plane */
-        for (i = 0; i < obj_image->image.height / 2; i++) {
-            memcpy(dst_u, source_u, width);
-            memcpy(dst_v, source_v, width);
+    unsigned char *dst_y, *dst_uv;
 
-            source_u += obj_image->image.pitches[1];
-            source_v += obj_image->image.pitches[2];
+    dst_y = surface_data + dest_y * psb_surface->stride + dest_x;
+    dst_uv = surface_data + psb_surface->stride * obj_surface->height + (dest_y / 2) * psb_surface->stride + dest_x;
 
-            dst_u += psb_surface->stride / 2;
-            dst_v += psb_surface->stride / 2;
-        }
-        break;
-    }
-#endif
-    default:
-        break;
-    }
+    vaStatus = psb_image_to_nv12(driver_data->row_pool, &obj_image->image, image_data,
+                                 src_x, src_y,
+                                 dst_y, dst_uv, psb_surface->stride,
+                                 width, height);
 
     psb_buffer_unmap(obj_buffer->psb_buffer);
     psb_buffer_unmap(&psb_surface->buf);
 
-    return VA_STATUS_SUCCESS;
+    return vaStatus;
 }
 
 
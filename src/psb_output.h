@@ -47,7 +47,7 @@
 #define LOG_TAG "pvr_drv_video"
 #endif
 
-#define PSB_MAX_IMAGE_FORMATS      4 /* sizeof(psb__CreateImageFormat)/sizeof(VAImageFormat) */
+#define PSB_MAX_IMAGE_FORMATS      7 /* sizeof(psb__CreateImageFormat)/sizeof(VAImageFormat) */
 #define PSB_MAX_SUBPIC_FORMATS     3 /* sizeof(psb__SubpicFormat)/sizeof(VAImageFormat) */
 #define PSB_MAX_DISPLAY_ATTRIBUTES 14     /* sizeof(psb__DisplayAttribute)/sizeof(VADisplayAttribute) */
 
@@ -144,6 +144,42 @@
     0,                                          \
 }
 
+#define psb__ImageI420                          \
+{                                               \
+    VA_FOURCC_I420,                             \
+    VA_LSB_FIRST,                               \
+    12,                                         \
+    0,                                          \
+    0,                                          \
+    0,                                          \
+    0,                                          \
+    0,                                          \
+}
+
+#define psb__ImageYV12                          \
+{                                               \
+    VA_FOURCC_YV12,                             \
+    VA_LSB_FIRST,                               \
+    12,                                         \
+    0,                                          \
+    0,                                          \
+    0,                                          \
+    0,                                          \
+    0,                                          \
+}
+
+#define psb__ImageYUY2                          \
+{                                               \
+    VA_FOURCC_YUY2,                             \
+    VA_LSB_FIRST,                               \
+    16,                                         \
+    0,                                          \
+    0,                                          \
+    0,                                          \
+    0,                                          \
+    0,                                          \
+}
+
 #define psb__ImageYV32                          \
 {                                               \
     VA_FOURCC_YV32,                             \
@@ -407,6 +407,44 @@ UpdateCoeff(int taps, double fCutoff, Bool isHoriz, Bool isY, coeffPtr pCoeff)
     }
 }
 
+/*
+ * Returns the horizontal filter register words for "fCutoff". The cutoff
+ * is quantized to one of N_CUTOFF_BANKS banks and each bank is computed
+ * once, so rescaling does not redo the sinc/window maths every time.
+ */
+static const uint16_t *
+GetHorizCoeffs(PsbPortPrivPtr pPriv, double fCutoff, Bool isY)
+{
+    int bank, taps, i, valid_bit;
+    uint16_t *words;
+    coeffRec coeff[MAX_TAPS * N_PHASES];
+
+    bank = (int)((fCutoff - MIN_CUTOFF_FREQ) * N_CUTOFF_STEPS + 0.5);
+    if (bank < 0)
+        bank = 0;
+    if (bank > N_CUTOFF_BANKS - 1)
+        bank = N_CUTOFF_BANKS - 1;
+
+    if (isY) {
+        taps = N_HORIZ_Y_TAPS;
+        words = pPriv->y_hcoefs[bank];
+        valid_bit = HCOEFS_Y_VALID;
+    } else {
+        taps = N_HORIZ_UV_TAPS;
+        words = pPriv->uv_hcoefs[bank];
+        valid_bit = HCOEFS_UV_VALID;
+    }
+
+    if (!(pPriv->hcoefs_valid[bank] & valid_bit)) {
+        UpdateCoeff(taps, MIN_CUTOFF_FREQ + (double)bank / N_CUTOFF_STEPS, TRUE, isY, coeff);
+        for (i = 0; i < taps * N_PHASES; i++)
+            words[i] = coeff[i].sign << 15 | coeff[i].exponent << 12 | coeff[i].mantissa;
+        pPriv->hcoefs_valid[bank] |= valid_bit;
+    }
+
+    return words;
+}
+
 static void
 i830_display_video(
     VADriverContextP ctx, PsbPortPrivPtr pPriv, VASurfaceID __maybe_unused surface,
@@ -593,9 +631,6 @@ i830_display_video(
         /* UV is half the size of Y -- YUV420 */
         int uvratio = 2;
         uint32_t newval;
-        coeffRec xcoeffY[N_HORIZ_Y_TAPS * N_PHASES];
-        coeffRec xcoeffUV[N_HORIZ_UV_TAPS * N_PHASES];
-        int i, j, pos;
         int deinterlace_factor;
 
         /*
@@ -695,25 +730,10 @@ i830_display_video(
             if (fCutoffUV > MAX_CUTOFF_FREQ)
                 fCutoffUV = MAX_CUTOFF_FREQ;
 
-            UpdateCoeff(N_HORIZ_Y_TAPS, fCutoffY, TRUE, TRUE, xcoeffY);
-            UpdateCoeff(N_HORIZ_UV_TAPS, fCutoffUV, TRUE, FALSE, xcoeffUV);
-
-            for (i = 0; i < N_PHASES; i++) {
-                for (j = 0; j < N_HORIZ_Y_TAPS; j++) {
-                    pos = i * N_HORIZ_Y_TAPS + j;
-                    overlay->Y_HCOEFS[pos] = (xcoeffY[pos].sign << 15 |
-                                              xcoeffY[pos].exponent << 12 |
-                                              xcoeffY[pos].mantissa);
-                }
-            }
-            for (i = 0; i < N_PHASES; i++) {
-                for (j = 0; j < N_HORIZ_UV_TAPS; j++) {
-                    pos = i * N_HORIZ_UV_TAPS + j;
-                    overlay->UV_HCOEFS[pos] = (xcoeffUV[pos].sign << 15 |
-                                               xcoeffUV[pos].exponent << 12 |
-                                               xcoeffUV[pos].mantissa);
-                }
-            }
+            memcpy(overlay->Y_HCOEFS, GetHorizCoeffs(pPriv, fCutoffY, TRUE),
+                   N_HORIZ_Y_TAPS * N_PHASES * sizeof(uint16_t));
+            memcpy(overlay->UV_HCOEFS, GetHorizCoeffs(pPriv, fCutoffUV, FALSE),
+                   N_HORIZ_UV_TAPS * N_PHASES * sizeof(uint16_t));
         }
     }
 
@@ -1467,7 +1487,7 @@ VAStatus psb_putsurface_overlay(
                  destx, desty, destw, desth,
                  VA_FOURCC_NV12, flags, overlayId, pipeId);
 
-    /* current surface is being displayed */
+    /* current surface is being displayed, the caller holds output_mutex */
     if (driver_data->cur_displaying_surface != VA_INVALID_SURFACE)
         driver_data->last_displaying_surface = driver_data->cur_displaying_surface;
 
@@ -1478,6 +1498,7 @@ VAStatus psb_putsurface_overlay(
 
     obj_surface->display_timestamp = GetTickCount();
     driver_data->cur_displaying_surface = surface;
+    pthread_cond_broadcast(&driver_data->display_cond);
 
     return VA_STATUS_SUCCESS;
 }
@@ -175,6 +175,12 @@
 #define MIN_CUTOFF_FREQ         1.0
 #define MAX_CUTOFF_FREQ         3.0
 
+/* Cutoffs are quantized to 1/N_CUTOFF_STEPS, one coefficient bank per step */
+#define N_CUTOFF_STEPS          32
+#define N_CUTOFF_BANKS          (2 * N_CUTOFF_STEPS + 1)        /* MIN_CUTOFF_FREQ..MAX_CUTOFF_FREQ */
+#define HCOEFS_Y_VALID          0x1
+#define HCOEFS_UV_VALID         0x2
+
 #define RGB16ToColorKey(c) \
 (((c & 0xF800) << 8) | ((c & 0x07E0) << 5) | ((c & 0x001F) << 3))
 
@@ -333,6 +339,11 @@ typedef struct _PsbPortPrivRec {
     uint32_t UBuf1offset;
     uint32_t VBuf1offset;
     unsigned char *regmap[2];
+
+    /* horizontal polyphase filter register words, filled per cutoff bank on first use */
+    uint16_t y_hcoefs[N_CUTOFF_BANKS][N_HORIZ_Y_TAPS * N_PHASES];
+    uint16_t uv_hcoefs[N_CUTOFF_BANKS][N_HORIZ_UV_TAPS * N_PHASES];
+    unsigned char hcoefs_valid[N_CUTOFF_BANKS];
 } PsbPortPrivRec, *PsbPortPrivPtr;
 
 
@@ -0,0 +1,300 @@
+/*
+ * Copyright (c) 2011 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "psb_drv_video.h"
+#include "psb_drv_debug.h"
+#include "psb_buffer.h"
+#include "psb_cmdbuf.h"
+#include "psb_record.h"
+
+#define INIT_DRIVER_DATA    psb_driver_data_p driver_data = obj_context->driver_data;
+#define SURFACE(id)    ((object_surface_p) object_heap_lookup( &driver_data->surface_heap, id ))
+
+volatile uint32_t psb_record_mask;
+
+/* serializes whole records, contexts may be driven from several threads */
+static pthread_mutex_t record_mutex = PTHREAD_MUTEX_INITIALIZER;
+static FILE *record_fp;
+
+/* start/stop serialization */
+static pthread_mutex_t record_ctl_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int record_users;
+
+static void psb__record_write(uint32_t type, uint32_t size)
+{
+    psb_record_header_t header;
+
+    header.type = type;
+    header.size = size;
+    fwrite(&header, sizeof(header), 1, record_fp);
+}
+
+int psb_record_open(const char *filename, uint32_t dev_id, uint32_t mask)
+{
+    psb_record_file_header_t header;
+    FILE *fp;
+
+    fp = fopen(filename, "wb");
+    if (fp == NULL) {
+        drv_debug_msg(VIDEO_DEBUG_ERROR, "Record file %s open failed, reason %s\n",
+                      filename, strerror(errno));
+        return -1;
+    }
+
+    memset(&header, 0, sizeof(header));
+    header.magic = PSB_RECORD_MAGIC;
+    header.version = PSB_RECORD_VERSION;
+    header.dev_id = dev_id;
+    header.pid = getpid();
+    fwrite(&header, sizeof(header), 1, fp);
+
+    pthread_mutex_lock(&record_mutex);
+    if (record_fp)
+        fclose(record_fp);
+    record_fp = fp;
+    psb_record_mask = mask;
+    pthread_mutex_unlock(&record_mutex);
+
+    drv_debug_msg(VIDEO_DEBUG_INIT, "Recording to %s, mask %08x\n", filename, mask);
+    return 0;
+}
+
+void psb_record_close(void)
+{
+    pthread_mutex_lock(&record_mutex);
+    psb_record_mask = 0;
+    if (record_fp) {
+        fclose(record_fp);
+        record_fp = NULL;
+    }
+    pthread_mutex_unlock(&record_mutex);
+}
+
+void psb_record_start(uint32_t dev_id)
+{
+    char env_value[1024] = {0};
+    char record_fn[1024 + 16];
+
+    if (psb_parse_config("PSB_VIDEO_RECORD", &env_value[0]) != 0)
+        return;
+
+    pthread_mutex_lock(&record_ctl_mutex);
+    if (record_users++ == 0) {
+        snprintf(record_fn, sizeof(record_fn), "%s.%d", env_value, getpid());
+        psb_record_open(record_fn, dev_id, PSB_RECORD_MASK_ALL);
+    }
+    pthread_mutex_unlock(&record_ctl_mutex);
+}
+
+void psb_record_stop(void)
+{
+    pthread_mutex_lock(&record_ctl_mutex);
+    if ((record_users > 0) && (--record_users == 0))
+        psb_record_close();
+    pthread_mutex_unlock(&record_ctl_mutex);
+}
+
+void psb_record_context(object_context_p obj_context)
+{
+    INIT_DRIVER_DATA
+    psb_record_context_t rec;
+    psb_record_surface_t surface;
+    int i;
+
+    pthread_mutex_lock(&record_mutex);
+    if (record_fp == NULL) {
+        pthread_mutex_unlock(&record_mutex);
+        return;
+    }
+
+    rec.context_id = obj_context->context_id;
+    rec.profile = obj_context->profile;
+    rec.entrypoint = obj_context->entry_point;
+    rec.width = obj_context->picture_width;
+    rec.height = obj_context->picture_height;
+    rec.flag = obj_context->va_flags;
+    rec.num_surfaces = obj_context->num_render_targets;
+
+    psb__record_write(PSB_RECORD_CONTEXT, sizeof(rec) + rec.num_surfaces * sizeof(surface));
+    fwrite(&rec, sizeof(rec), 1, record_fp);
+    for (i = 0; i < obj_context->num_render_targets; i++) {
+        object_surface_p obj_surface = SURFACE(obj_context->render_targets[i]);
+
+        surface.surface_id = obj_context->render_targets[i];
+        surface.width = obj_surface ? obj_surface->width : 0;
+        surface.height = obj_surface ? obj_surface->height_origin : 0;
+        fwrite(&surface, sizeof(surface), 1, record_fp);
+    }
+    pthread_mutex_unlock(&record_mutex);
+}
+
+void psb_record_picture(uint32_t type, object_context_p obj_context, uint32_t render_target)
+{
+    psb_record_picture_t rec;
+
+    pthread_mutex_lock(&record_mutex);
+    if (record_fp) {
+        rec.context_id = obj_context->context_id;
+        rec.render_target = render_target;
+        rec.frame = obj_context->frame_count;
+
+        psb__record_write(type, sizeof(rec));
+        fwrite(&rec, sizeof(rec), 1, record_fp);
+    }
+    pthread_mutex_unlock(&record_mutex);
+}
+
+void psb_record_render(object_context_p obj_context, object_buffer_p *buffer_list, int num_buffers)
+{
+    psb_record_render_t rec;
+    psb_record_buffer_t buffer;
+    uint32_t size = sizeof(rec);
+    int i;
+
+    for (i = 0; i < num_buffers; i++)
+        size += sizeof(buffer) + buffer_list[i]->size * buffer_list[i]->num_elements;
+
+    pthread_mutex_lock(&record_mutex);
+    if (record_fp == NULL) {
+        pthread_mutex_unlock(&record_mutex);
+        return;
+    }
+
+    rec.context_id = obj_context->context_id;
+    rec.num_buffers = num_buffers;
+
+    psb__record_write(PSB_RECORD_RENDER, size);
+    fwrite(&rec, sizeof(rec), 1, record_fp);
+    for (i = 0; i < num_buffers; i++) {
+        object_buffer_p obj_buffer = buffer_list[i];
+        unsigned char *data = obj_buffer->buffer_data;
+        uint32_t data_size = obj_buffer->size * obj_buffer->num_elements;
+        int mapped = 0;
+
+        buffer.type = obj_buffer->type;
+        buffer.size = obj_buffer->size;
+        buffer.num_elements = obj_buffer->num_elements;
+        fwrite(&buffer, sizeof(buffer), 1, record_fp);
+
+        if ((data == NULL) && obj_buffer->psb_buffer &&
+            (psb_buffer_map(obj_buffer->psb_buffer, &data) == 0))
+            mapped = 1;
+
+        if (data) {
+            fwrite(data, 1, data_size, record_fp);
+        } else {
+            /* keep the record size, the replay sees zeroes */
+            drv_debug_msg(VIDEO_DEBUG_ERROR, "Record: buffer %08x not mappable\n", obj_buffer->base.id);
+            while (data_size--)
+                fputc(0, record_fp);
+        }
+
+        if (mapped)
+            psb_buffer_unmap(obj_buffer->psb_buffer);
+    }
+    pthread_mutex_unlock(&record_mutex);
+}
+
+/*
+ * Writes "size" bytes of a section at DWORD offset "base" of the space the
+ * relocations with "dst_buffer" point into, background bits only
+ */
+static void psb__record_section(psb_cmdbuf_p cmdbuf, const unsigned char *data, uint32_t size,
+                                uint32_t base, uint32_t dst_buffer)
+{
+    struct drm_psb_reloc *reloc = (struct drm_psb_reloc *) cmdbuf->reloc_base;
+    unsigned char *copy;
+
+    if (size == 0)
+        return;
+
+    copy = malloc(size);
+    if (copy == NULL) {
+        fwrite(data, 1, size, record_fp);
+        return;
+    }
+    memcpy(copy, data, size);
+
+    for (; reloc < cmdbuf->reloc_idx; reloc++) {
+        uint32_t *dword;
+
+        if ((reloc->dst_buffer != dst_buffer) || (reloc->where < base) ||
+            ((reloc->where - base) * sizeof(uint32_t) >= size))
+            continue;
+
+        dword = (uint32_t *) copy + (reloc->where - base);
+        *dword = reloc->background & ~reloc->mask;
+    }
+
+    fwrite(copy, 1, size, record_fp);
+    free(copy);
+}
+
+void psb_record_cmdbuf(object_context_p obj_context, psb_cmdbuf_p cmdbuf, uint32_t msg_size)
+{
+    psb_record_cmdbuf_t rec;
+    psb_record_reloc_t rec_reloc;
+    struct drm_psb_reloc *reloc;
+
+    pthread_mutex_lock(&record_mutex);
+    if (record_fp == NULL) {
+        pthread_mutex_unlock(&record_mutex);
+        return;
+    }
+
+    rec.context_id = obj_context->context_id;
+    rec.frame = obj_context->frame_count;
+    rec.num_relocs = cmdbuf->reloc_idx - (struct drm_psb_reloc *) cmdbuf->reloc_base;
+    rec.msg_size = msg_size;
+    rec.cmd_size = (unsigned char *) cmdbuf->cmd_idx - cmdbuf->cmd_base;
+    rec.lldma_size = cmdbuf->lldma_idx - cmdbuf->lldma_base;
+
+    psb__record_write(PSB_RECORD_CMDBUF, sizeof(rec) + rec.num_relocs * sizeof(rec_reloc) +
+                      rec.msg_size + rec.cmd_size + rec.lldma_size);
+    fwrite(&rec, sizeof(rec), 1, record_fp);
+
+    for (reloc = (struct drm_psb_reloc *) cmdbuf->reloc_base; reloc < cmdbuf->reloc_idx; reloc++) {
+        rec_reloc.where = reloc->where;
+        rec_reloc.buffer = reloc->buffer;
+        rec_reloc.mask = reloc->mask;
+        rec_reloc.shift = reloc->shift;
+        rec_reloc.pre_add = reloc->pre_add;
+        rec_reloc.background = reloc->background;
+        rec_reloc.dst_buffer = reloc->dst_buffer;
+        fwrite(&rec_reloc, sizeof(rec_reloc), 1, record_fp);
+    }
+
+    psb__record_section(cmdbuf, cmdbuf->MTX_msg, rec.msg_size, 0, 0);
+    psb__record_section(cmdbuf, cmdbuf->cmd_base, rec.cmd_size, 0, 1);
+    psb__record_section(cmdbuf, cmdbuf->lldma_base, rec.lldma_size,
+                        (cmdbuf->lldma_base - cmdbuf->cmd_base) / sizeof(uint32_t), 1);
+    pthread_mutex_unlock(&record_mutex);
+}
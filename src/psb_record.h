@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2011 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _PSB_RECORD_H_
+#define _PSB_RECORD_H_
+
+#include <stdint.h>
+
+/*
+ * Decode session recorder.
+ *
+ * Captures the contexts, the VA buffers handed to vaRenderPicture and the
+ * MSVDX command buffers built from them into one file, so the command
+ * stream generation can be replayed and diffed without the hardware by
+ * tools/psb_replay. Switched on at run time by setting PSB_VIDEO_RECORD
+ * to a file name prefix in psbvideo.conf or the environment.
+ */
+
+#define PSB_RECORD_MAGIC        0x43455250      /* "PREC" */
+#define PSB_RECORD_VERSION      1
+
+/* Record types, stored in files */
+typedef enum {
+    PSB_RECORD_CONTEXT = 1,     /* psb_record_context_t, surfaces */
+    PSB_RECORD_BEGIN,           /* psb_record_picture_t */
+    PSB_RECORD_RENDER,          /* psb_record_render_t, buffers */
+    PSB_RECORD_END,             /* psb_record_picture_t */
+    PSB_RECORD_CMDBUF,          /* psb_record_cmdbuf_t, relocs, sections */
+    PSB_RECORD_DESTROY,         /* psb_record_picture_t */
+    PSB_RECORD_TYPES
+} psb_record_type_t;
+
+#define PSB_RECORD_MASK(type)   (1u << (type))
+#define PSB_RECORD_MASK_ALL     (PSB_RECORD_MASK(PSB_RECORD_TYPES) - 2)
+
+/* On-disk layout, native endian */
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t dev_id;
+    uint32_t pid;
+} psb_record_file_header_t;
+
+/* Every record starts with this, followed by "size" payload bytes */
+typedef struct {
+    uint32_t type;              /* psb_record_type_t */
+    uint32_t size;
+} psb_record_header_t;
+
+typedef struct {
+    uint32_t context_id;
+    uint32_t profile;
+    uint32_t entrypoint;
+    uint32_t width;
+    uint32_t height;
+    uint32_t flag;
+    uint32_t num_surfaces;      /* psb_record_surface_t follow */
+} psb_record_context_t;
+
+typedef struct {
+    uint32_t surface_id;
+    uint32_t width;
+    uint32_t height;
+} psb_record_surface_t;
+
+typedef struct {
+    uint32_t context_id;
+    uint32_t render_target;     /* VA_INVALID_SURFACE for END and DESTROY */
+    uint32_t frame;
+} psb_record_picture_t;
+
+typedef struct {
+    uint32_t context_id;
+    uint32_t num_buffers;       /* psb_record_buffer_t and data follow */
+} psb_record_render_t;
+
+typedef struct {
+    uint32_t type;              /* VABufferType */
+    uint32_t size;              /* element size */
+    uint32_t num_elements;      /* size * num_elements data bytes follow */
+} psb_record_buffer_t;
+
+/*
+ * The MTX messages, the CMD region and the LLDMA records of one flushed
+ * cmdbuf. Relocated DWORDs hold only their background bits so that dumps
+ * taken with different buffer placements compare equal; the relocations
+ * themselves are stored in front of the sections.
+ */
+typedef struct {
+    uint32_t context_id;
+    uint32_t frame;
+    uint32_t num_relocs;        /* psb_record_reloc_t follow */
+    uint32_t msg_size;
+    uint32_t cmd_size;
+    uint32_t lldma_size;
+} psb_record_cmdbuf_t;
+
+typedef struct {
+    uint32_t where;             /* DWORD offset in the MTX msgs or the CMD region */
+    uint32_t buffer;            /* index in the cmdbuf buffer list */
+    uint32_t mask;
+    uint32_t shift;
+    uint32_t pre_add;
+    uint32_t background;
+    uint32_t dst_buffer;        /* 0 = MTX msgs, 1 = CMD region */
+} psb_record_reloc_t;
+
+struct object_context_s;
+struct object_buffer_s;
+struct psb_cmdbuf_s;
+
+/* Record types being written, 0 when not recording */
+extern volatile uint32_t psb_record_mask;
+
+/*
+ * Starts recording the types in "mask" to "filename", replacing any
+ * recording in progress. Returns 0 on success
+ */
+int psb_record_open(const char *filename, uint32_t dev_id, uint32_t mask);
+void psb_record_close(void);
+
+/* Honours PSB_VIDEO_RECORD, called from vaInitialize/vaTerminate */
+void psb_record_start(uint32_t dev_id);
+void psb_record_stop(void);
+
+void psb_record_context(struct object_context_s *obj_context);
+void psb_record_picture(uint32_t type, struct object_context_s *obj_context, uint32_t render_target);
+void psb_record_render(struct object_context_s *obj_context, struct object_buffer_s **buffer_list,
+                       int num_buffers);
+void psb_record_cmdbuf(struct object_context_s *obj_context, struct psb_cmdbuf_s *cmdbuf, uint32_t msg_size);
+
+#define PSB_RECORD(type)        (psb_record_mask & PSB_RECORD_MASK(PSB_RECORD_##type))
+
+#endif /* _PSB_RECORD_H_ */
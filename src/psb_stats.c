@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2011 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <time.h>
+#include <string.h>
+
+#include "psb_drv_video.h"
+#include "psb_drv_debug.h"
+#include "psb_stats.h"
+
+/* psb_context_stats_t is indexed by VABufferType like the context buffer lists */
+typedef char psb_stats_buffer_types_check[(PSB_STATS_BUFFER_TYPES == PSB_MAX_BUFFERTYPES) ? 1 : -1];
+
+uint64_t psb_stats_now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void psb_stats_timer_add(psb_stats_timer_t *timer, uint64_t us)
+{
+    int bucket = 0;
+
+    if (us > 0xffffffff)
+        us = 0xffffffff;
+    if (us)
+        bucket = 31 - __builtin_clz((uint32_t)us);
+    if (bucket >= PSB_STATS_HIST_BUCKETS)
+        bucket = PSB_STATS_HIST_BUCKETS - 1;
+
+    timer->count++;
+    timer->total_us += us;
+    if (us > timer->max_us)
+        timer->max_us = (uint32_t)us;
+    timer->hist[bucket]++;
+}
+
+/* Called by the engine flush functions right after a command buffer went out */
+void psb_stats_submit(object_context_p obj_context, uint64_t start_us)
+{
+    uint64_t us = psb_stats_now_us() - start_us;
+
+    pthread_mutex_lock(&obj_context->stats_mutex);
+    psb_stats_timer_add(&obj_context->stats.submit, us);
+    obj_context->stats.submits++;
+    obj_context->stats_frame_submits++;
+    obj_context->stats_submit_us += us;
+    pthread_mutex_unlock(&obj_context->stats_mutex);
+}
+
+/* Called with stats_mutex held at the end of EndPicture */
+void psb_stats_frame_done(object_context_p obj_context)
+{
+    psb_context_stats_t *stats = &obj_context->stats;
+    uint32_t submits = obj_context->stats_frame_submits;
+
+    if (obj_context->stats_frame_start_us)
+        psb_stats_timer_add(&stats->frame, psb_stats_now_us() - obj_context->stats_frame_start_us);
+    obj_context->stats_frame_start_us = 0;
+
+    if (submits >= PSB_STATS_FLUSH_BUCKETS)
+        submits = PSB_STATS_FLUSH_BUCKETS - 1;
+    stats->flushes_per_frame[submits]++;
+    obj_context->stats_frame_submits = 0;
+    stats->frames++;
+
+    if (psb_video_stats_interval > 0 && (stats->frames % psb_video_stats_interval) == 0)
+        psb_stats_dump(obj_context);
+}
+
+#define AVG(t) ((t).count ? (unsigned int)((t).total_us / (t).count) : 0)
+
+/* Called with stats_mutex held */
+void psb_stats_dump(object_context_p obj_context)
+{
+    psb_context_stats_t *stats = &obj_context->stats;
+    int i;
+
+    drv_debug_msg(VIDEO_DEBUG_STATS, "context 0x%08x: %d frames, %d submits, %llu slice bytes\n",
+                  obj_context->base.id, stats->frames, stats->submits,
+                  (unsigned long long)stats->slice_data_bytes);
+    drv_debug_msg(VIDEO_DEBUG_STATS, "context 0x%08x: avg/max us frame %d/%d, begin %d/%d, end %d/%d, "
+                  "build %d/%d, submit %d/%d, sync %d/%d\n", obj_context->base.id,
+                  AVG(stats->frame), stats->frame.max_us,
+                  AVG(stats->begin_picture), stats->begin_picture.max_us,
+                  AVG(stats->end_picture), stats->end_picture.max_us,
+                  AVG(stats->cmdbuf_build), stats->cmdbuf_build.max_us,
+                  AVG(stats->submit), stats->submit.max_us,
+                  AVG(stats->sync_wait), stats->sync_wait.max_us);
+    for (i = 0; i < PSB_STATS_BUFFER_TYPES; i++) {
+        if (stats->render[i].count == 0)
+            continue;
+        drv_debug_msg(VIDEO_DEBUG_STATS, "context 0x%08x: render %s x%d avg/max us %d/%d\n",
+                      obj_context->base.id, buffer_type_to_string(i), stats->render[i].count,
+                      AVG(stats->render[i]), stats->render[i].max_us);
+    }
+}
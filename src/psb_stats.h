@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2011 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _PSB_STATS_H_
+#define _PSB_STATS_H_
+
+#include <stdint.h>
+#include <va/va.h>
+
+/*
+ * Per-context timing statistics, read with psb_QueryContextStats().
+ * All times are host microseconds from CLOCK_MONOTONIC.
+ */
+
+#define PSB_STATS_VERSION           1
+#define PSB_STATS_BUFFER_TYPES      64      /* == PSB_MAX_BUFFERTYPES */
+#define PSB_STATS_HIST_BUCKETS      16      /* bucket i counts [2^i, 2^(i+1)) us, the last one is open */
+#define PSB_STATS_FLUSH_BUCKETS     8       /* submits per frame 0..6, 7 or more */
+
+typedef struct {
+    uint32_t count;
+    uint32_t max_us;
+    uint64_t total_us;
+    uint32_t hist[PSB_STATS_HIST_BUCKETS];
+} psb_stats_timer_t;
+
+typedef struct {
+    uint32_t version;                       /* PSB_STATS_VERSION */
+    uint32_t frames;                        /* EndPicture calls */
+    uint32_t submits;                       /* cmdbuf submissions to the kernel */
+    uint32_t flushes_per_frame[PSB_STATS_FLUSH_BUCKETS];
+    uint64_t slice_data_bytes;              /* VASliceDataBufferType bytes rendered */
+
+    psb_stats_timer_t frame;                /* BeginPicture to end of EndPicture */
+    psb_stats_timer_t begin_picture;
+    psb_stats_timer_t end_picture;          /* whole EndPicture, including submit */
+    psb_stats_timer_t cmdbuf_build;         /* EndPicture minus its submits */
+    psb_stats_timer_t submit;               /* execbuf ioctl, or queueing when submit is asynchronous */
+    psb_stats_timer_t sync_wait;            /* fence wait in vaSyncSurface */
+    /* RenderPicture time, shared evenly among the buffers of each call */
+    psb_stats_timer_t render[PSB_STATS_BUFFER_TYPES];
+} psb_context_stats_t;
+
+/*
+ * Copy the statistics of context into stats, and clear them if reset is
+ * non-zero. dpy is the VADisplay the context was created on; look the
+ * symbol up with dlsym() on the driver library.
+ */
+VAStatus psb_QueryContextStats(VADisplay dpy, VAContextID context,
+                               psb_context_stats_t *stats, int reset);
+
+/* driver internal */
+struct object_context_s;
+
+uint64_t psb_stats_now_us(void);
+void psb_stats_timer_add(psb_stats_timer_t *timer, uint64_t us);
+void psb_stats_submit(struct object_context_s *obj_context, uint64_t start_us);
+void psb_stats_frame_done(struct object_context_s *obj_context);
+void psb_stats_dump(struct object_context_s *obj_context);
+
+#endif /* _PSB_STATS_H_ */
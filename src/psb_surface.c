@@ -28,9 +28,12 @@
  */
 
 #include <wsbm/wsbm_manager.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "psb_def.h"
 #include "psb_surface.h"
+#include "psb_cmdbuf.h"
 #include "psb_drv_debug.h"
 
 /*
@@ -344,7 +347,116 @@ void psb_surface_destroy(psb_surface_p psb_surface)
 
 VAStatus psb_surface_sync(psb_surface_p psb_surface)
 {
-    wsbmBOWaitIdle(psb_surface->buf.drm_buf, 0);
+    return psb_surface_sync_list(&psb_surface, 1, 1, PSB_SURFACE_WAIT_INFINITE, NULL);
+}
+
+/* First back-off step and cap used when several fences are watched at once */
+#define SYNC_POLL_MIN_US    (50)
+#define SYNC_POLL_MAX_US    (1000)
+
+static uint64_t psb__surface_now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int psb__surface_is_idle(psb_surface_p psb_surface)
+{
+    uint32_t synccpu_flag = WSBM_SYNCCPU_READ | WSBM_SYNCCPU_WRITE | WSBM_SYNCCPU_DONT_BLOCK;
+
+    if (wsbmBOSyncForCpu(psb_surface->buf.drm_buf, synccpu_flag))
+        return 0;
+    (void) wsbmBOReleaseFromCpu(psb_surface->buf.drm_buf, synccpu_flag);
+    return 1;
+}
+
+/*
+ * The kernel only offers a blocking, untimed wait on a single buffer. That
+ * wait is used whenever exactly one surface remains and there is no
+ * deadline; otherwise the pending fences are probed with a growing back-off.
+ */
+VAStatus psb_surface_sync_list(psb_surface_p *surface_list, int num_surfaces, int wait_all,
+                               unsigned int timeout_ms, int *ready_index)
+{
+    uint64_t start, now, deadline = 0;
+    unsigned int poll_us = SYNC_POLL_MIN_US;
+    int pending = num_surfaces;
+    int i;
+
+    if (ready_index)
+        *ready_index = -1;
+    if (num_surfaces <= 0)
+        return VA_STATUS_SUCCESS;
+
+    /* Fences only exist once the cmdbufs referencing the surfaces are submitted */
+    for (i = 0; i < num_surfaces; i++)
+        psb_cmdbuf_buffer_wait_submitted(&surface_list[i]->buf);
+
+    start = psb__surface_now_us();
+    if (timeout_ms != PSB_SURFACE_WAIT_INFINITE)
+        deadline = start + (uint64_t)timeout_ms * 1000;
+
+    for (i = 0; i < num_surfaces; i++)
+        surface_list[i]->sync_wait_us = (unsigned int) -1;
+
+    while (1) {
+        int last = -1;
+
+        for (i = 0; i < num_surfaces; i++) {
+            psb_surface_p psb_surface = surface_list[i];
+
+            if (psb_surface->sync_wait_us != (unsigned int) -1)
+                continue;
+
+            if ((pending == 1) && (deadline == 0)) {
+                /* sleep in the kernel until the fence signals */
+                wsbmBOWaitIdle(psb_surface->buf.drm_buf, 0);
+            } else if (!psb__surface_is_idle(psb_surface)) {
+                continue;
+            }
+
+            psb_surface->sync_wait_us = (unsigned int)(psb__surface_now_us() - start);
+            pending--;
+            last = i;
+        }
+
+        if ((last >= 0) && !wait_all) {
+            if (ready_index)
+                *ready_index = last;
+            break;
+        }
+        if (pending == 0) {
+            if (ready_index)
+                *ready_index = last;
+            break;
+        }
+
+        now = psb__surface_now_us();
+        if (deadline && (now >= deadline)) {
+            drv_debug_msg(VIDEO_DEBUG_GENERAL, "%s: %d of %d surfaces still busy after %dms\n",
+                          __FUNCTION__, pending, num_surfaces, timeout_ms);
+            for (i = 0; i < num_surfaces; i++)
+                if (surface_list[i]->sync_wait_us == (unsigned int) -1)
+                    surface_list[i]->sync_wait_us = (unsigned int)(now - start);
+            return VA_STATUS_ERROR_TIMEDOUT;
+        }
+        if ((pending == 1) && (deadline == 0))
+            continue;
+
+        if (deadline && (now + poll_us > deadline))
+            usleep(deadline - now);
+        else
+            usleep(poll_us);
+        if (poll_us < SYNC_POLL_MAX_US)
+            poll_us *= 2;
+    }
+
+    /* surfaces not reached in wait-any mode were not waited for */
+    for (i = 0; i < num_surfaces; i++)
+        if (surface_list[i]->sync_wait_us == (unsigned int) -1)
+            surface_list[i]->sync_wait_us = 0;
 
     return VA_STATUS_SUCCESS;
 }
@@ -354,6 +466,11 @@ VAStatus psb_surface_query_status(psb_surface_p psb_surface, VASurfaceStatus *st
     int ret;
     uint32_t synccpu_flag = WSBM_SYNCCPU_READ | WSBM_SYNCCPU_WRITE | WSBM_SYNCCPU_DONT_BLOCK;
 
+    /* still queued for the submission thread */
+    if (psb_cmdbuf_buffer_submit_pending(&psb_surface->buf)) {
+        *status = VASurfaceRendering;
+        return VA_STATUS_SUCCESS;
+    }
     ret = wsbmBOSyncForCpu(psb_surface->buf.drm_buf, synccpu_flag);
 
     if (ret == 0) {
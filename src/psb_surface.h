@@ -75,6 +75,7 @@ struct psb_surface_s {
     int size;
     unsigned int bc_buffer;
     void *handle;
+    unsigned int sync_wait_us;  /* time the last sync on this surface blocked */
 };
 
 /*
@@ -109,6 +110,21 @@ void psb_surface_destroy(psb_surface_p psb_surface);
  */
 VAStatus psb_surface_sync(psb_surface_p psb_surface);
 
+#ifndef VA_STATUS_ERROR_TIMEDOUT
+#define VA_STATUS_ERROR_TIMEDOUT VA_STATUS_ERROR_UNKNOWN
+#endif
+
+#define PSB_SURFACE_WAIT_INFINITE ((unsigned int)-1)
+
+/*
+ * Wait for several surfaces to become idle: all of them when wait_all is set,
+ * otherwise the first one, whose index is returned in ready_index.
+ * Returns VA_STATUS_ERROR_TIMEDOUT when timeout_ms expires first.
+ * Each surface's sync_wait_us records how long it was waited for.
+ */
+VAStatus psb_surface_sync_list(psb_surface_p *surface_list, int num_surfaces, int wait_all,
+                               unsigned int timeout_ms, int *ready_index);
+
 /*
  * Return surface status
  */
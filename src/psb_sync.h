@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2011 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _PSB_SYNC_H_
+#define _PSB_SYNC_H_
+
+#include <va/va.h>
+
+/*
+ * Multi-surface sync. Look the symbol up with dlsym() on the driver
+ * library; dpy is the VADisplay the surfaces were created on.
+ */
+
+#define PSB_SYNC_MAX_SURFACES       64      /* surfaces per call at most */
+#define PSB_SYNC_WAIT_INFINITE      ((unsigned int)-1)
+
+/*
+ * Wait for all "num_surfaces" surfaces when wait_all is non-zero, otherwise
+ * for the first one to finish, whose index is returned in *ready_index (-1
+ * when none is ready). Returns VA_STATUS_ERROR_TIMEDOUT if timeout_ms
+ * expires first. Surfaces still scanned out by the overlay are not waited
+ * for and make the call return VA_STATUS_ERROR_SURFACE_IN_DISPLAYING.
+ *
+ * wait_us, if not NULL, receives how long each surface was waited for.
+ * ready_index may be NULL.
+ */
+VAStatus psb_SyncSurfaces(VADisplay dpy, const VASurfaceID *surfaces, int num_surfaces,
+                          int wait_all, unsigned int timeout_ms,
+                          int *ready_index, unsigned int *wait_us);
+
+#endif /* _PSB_SYNC_H_ */
@@ -133,6 +133,7 @@ static psb_transform_coeffs s240M = {
 };
 
 static void psb_setup_coeffs(struct psb_texture_s * pPriv);
+static void psb_compute_coeffs(struct psb_texture_s * pPriv);
 static void psb_scale_transfermatrix(psb_transform_coeffs * transfer_matrix,
                                      double YColumScale, double CbColumScale,
                                      double CrColumnScale);
@@ -269,6 +270,8 @@ int psb_ctexture_init(VADriverContextP ctx)
     for (i = 0; i < 6; i++)
         texture_priv->pal_meminfo[i] = NULL;
 
+    memset(texture_priv->coeffs_cache, 0, sizeof(texture_priv->coeffs_cache));
+    texture_priv->coeffs_cache_clock = 0;
     psb_setup_coeffs(texture_priv);
     psb_fix_drmfd_closesequence(driver_data);
 
@@ -713,8 +716,48 @@ void psb_putsurface_textureblit(
 }
 #endif
 
+/*
+ * Loads pPriv->coeffs for the current transfer matrix, nominal ranges and
+ * color balance. The fixed point coefficients of the last few settings are
+ * kept in a small LRU, so only a new setting goes through the floating
+ * point maths of psb_compute_coeffs.
+ */
 static void
 psb_setup_coeffs(struct psb_texture_s * pPriv)
+{
+    psb_coeffs_key_s key;
+    psb_coeffs_cache_s *entry, *victim = &pPriv->coeffs_cache[0];
+    int i;
+
+    memset(&key, 0, sizeof(key));
+    key.video_transfermatrix = pPriv->video_transfermatrix;
+    key.src_nominalrange = pPriv->src_nominalrange;
+    key.dst_nominalrange = pPriv->dst_nominalrange;
+    key.brightness = pPriv->brightness.Value;
+    key.contrast = pPriv->contrast.Value;
+    key.saturation = pPriv->saturation.Value;
+    key.hue = pPriv->hue.Value;
+
+    for (i = 0; i < PSB_COEFFS_CACHE_SIZE; i++) {
+        entry = &pPriv->coeffs_cache[i];
+        if (entry->last_use && !memcmp(&entry->key, &key, sizeof(key))) {
+            entry->last_use = ++pPriv->coeffs_cache_clock;
+            pPriv->coeffs = entry->coeffs;
+            return;
+        }
+        if (entry->last_use < victim->last_use)
+            victim = entry;
+    }
+
+    psb_compute_coeffs(pPriv);
+
+    victim->key = key;
+    victim->coeffs = pPriv->coeffs;
+    victim->last_use = ++pPriv->coeffs_cache_clock;
+}
+
+static void
+psb_compute_coeffs(struct psb_texture_s * pPriv)
 {
     double yCoeff, uCoeff, vCoeff, Constant;
     double fContrast;
@@ -62,6 +62,25 @@ typedef struct _psb_coeffs_ {
     signed short bConst;
 } psb_coeffs_s, *psb_coeffs_p;
 
+/* Color settings a psb_coeffs_s was computed for */
+typedef struct _psb_coeffs_key_ {
+    unsigned int video_transfermatrix;
+    unsigned int src_nominalrange;
+    unsigned int dst_nominalrange;
+    short brightness;
+    short contrast;
+    short saturation;
+    short hue;
+} psb_coeffs_key_s;
+
+#define PSB_COEFFS_CACHE_SIZE   4
+
+typedef struct _psb_coeffs_cache_ {
+    psb_coeffs_key_s key;
+    psb_coeffs_s coeffs;
+    uint32_t last_use; /* 0 if the entry is empty */
+} psb_coeffs_cache_s;
+
 typedef struct _sgx_psb_fixed32 {
     union {
         struct {
@@ -101,6 +120,9 @@ struct psb_texture_s {
     sgx_psb_fixed32 hue;
 
     psb_coeffs_s coeffs;
+    /* recently used color settings, so that psb_setup_coeffs rarely recomputes */
+    psb_coeffs_cache_s coeffs_cache[PSB_COEFFS_CACHE_SIZE];
+    uint32_t coeffs_cache_clock;
 
     uint32_t update_coeffs;
     PVRDRI2BackBuffersExport dri2_bb_export;
@@ -0,0 +1,291 @@
+/*
+ * Copyright (c) 2011 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/syscall.h>
+
+#include "psb_drv_debug.h"
+#include "psb_trace_ring.h"
+
+#ifdef PSBVIDEO_TRACE_RING
+
+#define PSB_VIDEO_TRACE_RING_FILE "/data/mediadrm/trace.ring"
+
+#define PSB_TRACE_RING_SIZE     2048    /* records per thread, power of 2 */
+#define PSB_TRACE_RING_MASK     (PSB_TRACE_RING_SIZE - 1)
+#define PSB_TRACE_DRAIN_MS      20
+
+typedef struct psb_trace_ring_s psb_trace_ring_t;
+struct psb_trace_ring_s {
+    uint32_t head;              /* next slot to fill, written by the owner only */
+    uint32_t tail;              /* next slot to drain, written by the drainer only */
+    uint32_t dropped;           /* records lost since the last drain */
+    uint32_t tid;
+    psb_trace_ring_t *next;
+    psb_trace_record_t rec[PSB_TRACE_RING_SIZE];
+};
+
+volatile int psb_trace_ring_enabled;
+
+/*
+ * The key has no destructor: rings of exited threads stay on trace_rings
+ * and everything is freed, and the key deleted, by the last stop. Nothing
+ * of ours is left to run at thread exit once libva unloads the driver.
+ */
+static pthread_key_t trace_key;
+
+/* start/stop serialization */
+static pthread_mutex_t trace_ctl_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int trace_users;
+
+/*
+ * Rings are pushed onto trace_rings atomically, so a thread's first emit
+ * never waits for the drainer's writes, and only removed by the last stop.
+ */
+static psb_trace_ring_t *trace_rings;
+
+/* drainer state */
+static pthread_mutex_t trace_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t trace_cond = PTHREAD_COND_INITIALIZER;
+static int trace_running;
+static pthread_t trace_thread;
+static FILE *trace_fp;
+
+static uint64_t psb__trace_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/* called with trace_mutex held, after the drainer has stopped */
+static void psb__trace_ring_free_all(void)
+{
+    psb_trace_ring_t *ring, *next;
+
+    for (ring = trace_rings; ring; ring = next) {
+        next = ring->next;
+        free(ring);
+    }
+    trace_rings = NULL;
+}
+
+static psb_trace_ring_t *psb__trace_ring_attach(void)
+{
+    psb_trace_ring_t *ring;
+
+    ring = (psb_trace_ring_t *)calloc(1, sizeof(*ring));
+    if (ring == NULL)
+        return NULL;
+
+    ring->tid = (uint32_t)syscall(__NR_gettid);
+
+    ring->next = __atomic_load_n(&trace_rings, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&trace_rings, &ring->next, ring, 1,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        ;
+
+    pthread_setspecific(trace_key, ring);
+    return ring;
+}
+
+void psb_trace_ring_emit(uint32_t id, uint32_t nargs,
+                         uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3)
+{
+    psb_trace_ring_t *ring = (psb_trace_ring_t *)pthread_getspecific(trace_key);
+    psb_trace_record_t *rec;
+    uint32_t head;
+
+    if (ring == NULL) {
+        ring = psb__trace_ring_attach();
+        if (ring == NULL)
+            return;
+    }
+
+    head = ring->head;
+    if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= PSB_TRACE_RING_SIZE) {
+        __atomic_fetch_add(&ring->dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    rec = &ring->rec[head & PSB_TRACE_RING_MASK];
+    rec->ts_ns = psb__trace_now();
+    rec->tid = ring->tid;
+    rec->id = id;
+    rec->nargs = nargs;
+    rec->args[0] = a0;
+    rec->args[1] = a1;
+    rec->args[2] = a2;
+    rec->args[3] = a3;
+
+    /* publish the record to the drainer */
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+/* called with trace_mutex held */
+static void psb__trace_drain(void)
+{
+    psb_trace_ring_t *ring;
+    psb_trace_record_t drop;
+    uint32_t head, tail, idx, n, dropped;
+
+    for (ring = __atomic_load_n(&trace_rings, __ATOMIC_ACQUIRE); ring; ring = ring->next) {
+        head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        tail = ring->tail;
+        while (tail != head) {
+            idx = tail & PSB_TRACE_RING_MASK;
+            n = head - tail;
+            if (n > PSB_TRACE_RING_SIZE - idx)
+                n = PSB_TRACE_RING_SIZE - idx;
+            fwrite(&ring->rec[idx], sizeof(psb_trace_record_t), n, trace_fp);
+            tail += n;
+        }
+        __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+
+        dropped = __atomic_exchange_n(&ring->dropped, 0, __ATOMIC_RELAXED);
+        if (dropped) {
+            memset(&drop, 0, sizeof(drop));
+            drop.ts_ns = psb__trace_now();
+            drop.tid = ring->tid;
+            drop.id = PSB_TRACE_EV_DROPPED;
+            drop.nargs = 1;
+            drop.args[0] = dropped;
+            fwrite(&drop, sizeof(drop), 1, trace_fp);
+        }
+    }
+}
+
+static void *psb__trace_drain_thread(void *arg)
+{
+    struct timespec ts;
+
+    (void)arg;
+
+    pthread_mutex_lock(&trace_mutex);
+    while (trace_running) {
+        psb__trace_drain();
+        fflush(trace_fp);
+
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_nsec += PSB_TRACE_DRAIN_MS * 1000000;
+        if (ts.tv_nsec >= 1000000000) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000;
+        }
+        pthread_cond_timedwait(&trace_cond, &trace_mutex, &ts);
+    }
+    psb__trace_drain();
+    pthread_mutex_unlock(&trace_mutex);
+
+    return NULL;
+}
+
+void psb_trace_ring_start(void)
+{
+    char env_value[1024] = {0};
+    char trace_fn[1024];
+    psb_trace_file_header_t header;
+
+    if (psb_parse_config("PSB_VIDEO_TRACE_RING", &env_value[0]) != 0)
+        return;
+
+    pthread_mutex_lock(&trace_ctl_mutex);
+    if (trace_users++ > 0) {
+        pthread_mutex_unlock(&trace_ctl_mutex);
+        return;
+    }
+
+    if (pthread_key_create(&trace_key, NULL) != 0) {
+        drv_debug_msg(VIDEO_DEBUG_ERROR, "Trace ring key creation failed\n");
+        pthread_mutex_unlock(&trace_ctl_mutex);
+        return;
+    }
+
+    snprintf(trace_fn, sizeof(trace_fn), "%s.%d", PSB_VIDEO_TRACE_RING_FILE, getpid());
+    trace_fp = fopen(trace_fn, "wb");
+    if (trace_fp == NULL) {
+        drv_debug_msg(VIDEO_DEBUG_ERROR, "Trace ring file %s open failed, reason %s\n",
+                      trace_fn, strerror(errno));
+        pthread_key_delete(trace_key);
+        pthread_mutex_unlock(&trace_ctl_mutex);
+        return;
+    }
+
+    memset(&header, 0, sizeof(header));
+    header.magic = PSB_TRACE_MAGIC;
+    header.version = PSB_TRACE_VERSION;
+    header.record_size = sizeof(psb_trace_record_t);
+    header.pid = getpid();
+    header.start_ns = psb__trace_now();
+    fwrite(&header, sizeof(header), 1, trace_fp);
+
+    trace_running = 1;
+    if (pthread_create(&trace_thread, NULL, psb__trace_drain_thread, NULL) != 0) {
+        drv_debug_msg(VIDEO_DEBUG_ERROR, "Trace ring drain thread creation failed\n");
+        trace_running = 0;
+        fclose(trace_fp);
+        trace_fp = NULL;
+        pthread_key_delete(trace_key);
+    } else {
+        psb_trace_ring_enabled = 1;
+        drv_debug_msg(VIDEO_DEBUG_GENERAL, "Trace ring logging to %s\n", trace_fn);
+    }
+    pthread_mutex_unlock(&trace_ctl_mutex);
+}
+
+void psb_trace_ring_stop(void)
+{
+    pthread_mutex_lock(&trace_ctl_mutex);
+    if (trace_users == 0 || --trace_users > 0 || trace_fp == NULL) {
+        pthread_mutex_unlock(&trace_ctl_mutex);
+        return;
+    }
+
+    psb_trace_ring_enabled = 0;
+
+    pthread_mutex_lock(&trace_mutex);
+    trace_running = 0;
+    pthread_cond_signal(&trace_cond);
+    pthread_mutex_unlock(&trace_mutex);
+    pthread_join(trace_thread, NULL);
+
+    fclose(trace_fp);
+    trace_fp = NULL;
+
+    /* vaTerminate: no VA calls, so no emitters, can be running any more */
+    pthread_mutex_lock(&trace_mutex);
+    psb__trace_ring_free_all();
+    pthread_mutex_unlock(&trace_mutex);
+    pthread_key_delete(trace_key);
+    pthread_mutex_unlock(&trace_ctl_mutex);
+}
+
+#endif /* PSBVIDEO_TRACE_RING */
@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2011 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _PSB_TRACE_RING_H_
+#define _PSB_TRACE_RING_H_
+
+#include <stdint.h>
+
+/*
+ * Binary event trace.
+ *
+ * Each thread logs fixed size records into its own lock-free ring; a
+ * background thread drains all rings into PSB_VIDEO_TRACE_RING_FILE.
+ * Built in only with -DPSBVIDEO_TRACE_RING, switched on at run time by
+ * setting PSB_VIDEO_TRACE_RING in psbvideo.conf or the environment.
+ * The file is decoded by tools/psb_trace_dump.
+ */
+
+#define PSB_TRACE_MAGIC         0x43525450      /* "PTRC" */
+#define PSB_TRACE_VERSION       1
+#define PSB_TRACE_MAX_ARGS      4
+
+/*
+ * X(event, phase): phase is 'B'/'E' for the start/end of a span on the
+ * emitting thread, 'i' for an instant event. Append only, the ids are
+ * stored in trace files.
+ */
+#define PSB_TRACE_EVENTS(X) \
+    X(DROPPED,          'i')    /* records lost on a full ring: count */ \
+    X(CREATE_BUFFER,    'i')    /* buffer id, type, size, num_elements */ \
+    X(BEGIN_PICTURE,    'i')    /* context, render target, frame */ \
+    X(RENDER_PICTURE,   'B')    /* context, num_buffers */ \
+    X(RENDER_PICTURE_END,'E')   /* status */ \
+    X(END_PICTURE,      'B')    /* context, frame */ \
+    X(END_PICTURE_END,  'E')    /* status */ \
+    X(CMDBUF_FLUSH,     'i')    /* context, reason, cmd_count */ \
+    X(SYNC_SURFACE,     'B')    /* surface */ \
+    X(SYNC_SURFACE_END, 'E')    /* surface, status, wait_us */
+
+#define PSB_TRACE_ENUM(name, phase) PSB_TRACE_EV_##name,
+typedef enum {
+    PSB_TRACE_EVENTS(PSB_TRACE_ENUM)
+    PSB_TRACE_EV_COUNT
+} psb_trace_event_t;
+#undef PSB_TRACE_ENUM
+
+/* On-disk layout, native endian */
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t record_size;
+    uint32_t pid;
+    uint32_t reserved;
+    uint64_t start_ns;          /* CLOCK_MONOTONIC when tracing started */
+} psb_trace_file_header_t;
+
+typedef struct {
+    uint64_t ts_ns;             /* CLOCK_MONOTONIC */
+    uint32_t tid;
+    uint16_t id;                /* psb_trace_event_t */
+    uint16_t nargs;
+    uint32_t args[PSB_TRACE_MAX_ARGS];
+} psb_trace_record_t;
+
+#ifdef PSBVIDEO_TRACE_RING
+
+extern volatile int psb_trace_ring_enabled;
+
+void psb_trace_ring_emit(uint32_t id, uint32_t nargs,
+                         uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3);
+void psb_trace_ring_start(void);
+void psb_trace_ring_stop(void);
+
+#define PSB_TRACE_EMIT(id, n, a0, a1, a2, a3) \
+    do { \
+        if (psb_trace_ring_enabled) \
+            psb_trace_ring_emit(PSB_TRACE_EV_##id, (n), (uint32_t)(a0), (uint32_t)(a1), \
+                                (uint32_t)(a2), (uint32_t)(a3)); \
+    } while (0)
+
+#else
+
+#define psb_trace_ring_start()  do { } while (0)
+#define psb_trace_ring_stop()   do { } while (0)
+#define PSB_TRACE_EMIT(id, n, a0, a1, a2, a3) do { } while (0)
+
+#endif /* PSBVIDEO_TRACE_RING */
+
+#define PSB_TRACE0(id)                  PSB_TRACE_EMIT(id, 0, 0, 0, 0, 0)
+#define PSB_TRACE1(id, a0)              PSB_TRACE_EMIT(id, 1, a0, 0, 0, 0)
+#define PSB_TRACE2(id, a0, a1)          PSB_TRACE_EMIT(id, 2, a0, a1, 0, 0)
+#define PSB_TRACE3(id, a0, a1, a2)      PSB_TRACE_EMIT(id, 3, a0, a1, a2, 0)
+#define PSB_TRACE4(id, a0, a1, a2, a3)  PSB_TRACE_EMIT(id, 4, a0, a1, a2, a3)
+
+#endif /* _PSB_TRACE_RING_H_ */
@@ -0,0 +1,428 @@
+/*
+ * Copyright (c) 2011 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "psb_unpack.h"
+
+#if defined(__i386__) || defined(__x86_64__)
+#include <cpuid.h>
+#include <emmintrin.h>
+#define PSB_UNPACK_SSE2
+#endif
+
+#define PSB_PARALLEL_MAX_THREADS        4
+
+/* TopazHP reconstructed frame tiles */
+#define TOPAZ_TILE_WIDTH                16
+#define TOPAZ_Y_TILE_HEIGHT             32
+#define TOPAZ_UV_TILE_HEIGHT            16
+
+/* VSP reconstructed frame tiles */
+#define VSP_TILE_WIDTH                  64
+#define VSP_TILE_HEIGHT                 64
+#define VSP_TILE_SIZE                   (VSP_TILE_WIDTH * VSP_TILE_HEIGHT)
+#define VSP_BORDER                      32
+
+typedef void (*psb_copy_rows_func)(unsigned char *dst, int dst_stride,
+                                   const unsigned char *src, int src_stride,
+                                   int width, int rows);
+
+struct psb_row_pool_s {
+    pthread_mutex_t submit_lock;        /* one job at a time */
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond;
+    pthread_cond_t done_cond;
+    pthread_t threads[PSB_PARALLEL_MAX_THREADS];
+    int num_threads;
+    int quit;
+    unsigned int generation;
+
+    /* current job */
+    psb_rows_func func;
+    void *arg;
+    int rows;
+    int num_bands;
+    int next_band;
+    int bands_done;
+};
+
+struct psb_unpack_rec_s {
+    int width;
+    int height;
+    unsigned char *src_y;
+    unsigned char *src_uv;
+    unsigned char *dst_y;
+    unsigned char *dst_uv;
+    int dst_y_stride;
+    int dst_uv_stride;
+};
+
+static psb_copy_rows_func psb__copy_rows_kernel;
+static int psb__cpu_sse2;
+static pthread_once_t psb__unpack_once = PTHREAD_ONCE_INIT;
+
+static void psb__copy_rows_c(unsigned char *dst, int dst_stride,
+                             const unsigned char *src, int src_stride,
+                             int width, int rows)
+{
+    int i;
+
+    for (i = 0; i < rows; i++) {
+        memcpy(dst, src, width);
+        dst += dst_stride;
+        src += src_stride;
+    }
+}
+
+#ifdef PSB_UNPACK_SSE2
+__attribute__((target("sse2")))
+static void psb__copy_rows_sse2(unsigned char *dst, int dst_stride,
+                                const unsigned char *src, int src_stride,
+                                int width, int rows)
+{
+    int i, x;
+
+    if (width == TOPAZ_TILE_WIDTH) {
+        /* One TopazHP tile column, 16 bytes per row */
+        for (i = 0; i < rows; i++) {
+            _mm_storeu_si128((__m128i *)dst, _mm_loadu_si128((const __m128i *)src));
+            dst += dst_stride;
+            src += src_stride;
+        }
+        return;
+    }
+
+    for (i = 0; i < rows; i++) {
+        for (x = 0; x + 64 <= width; x += 64) {
+            __m128i a = _mm_loadu_si128((const __m128i *)(src + x));
+            __m128i b = _mm_loadu_si128((const __m128i *)(src + x + 16));
+            __m128i c = _mm_loadu_si128((const __m128i *)(src + x + 32));
+            __m128i d = _mm_loadu_si128((const __m128i *)(src + x + 48));
+            _mm_storeu_si128((__m128i *)(dst + x), a);
+            _mm_storeu_si128((__m128i *)(dst + x + 16), b);
+            _mm_storeu_si128((__m128i *)(dst + x + 32), c);
+            _mm_storeu_si128((__m128i *)(dst + x + 48), d);
+        }
+        for (; x + 16 <= width; x += 16)
+            _mm_storeu_si128((__m128i *)(dst + x), _mm_loadu_si128((const __m128i *)(src + x)));
+        if (x < width)
+            memcpy(dst + x, src + x, width - x);
+        dst += dst_stride;
+        src += src_stride;
+    }
+}
+#endif
+
+static void psb__unpack_init(void)
+{
+    psb__copy_rows_kernel = psb__copy_rows_c;
+#ifdef PSB_UNPACK_SSE2
+    {
+        unsigned int eax, ebx, ecx, edx;
+
+        if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) && (edx & bit_SSE2)) {
+            psb__cpu_sse2 = 1;
+            psb__copy_rows_kernel = psb__copy_rows_sse2;
+        }
+    }
+#endif
+}
+
+int psb_cpu_has_sse2(void)
+{
+    pthread_once(&psb__unpack_once, psb__unpack_init);
+    return psb__cpu_sse2;
+}
+
+void psb_copy_rows(unsigned char *dst, int dst_stride,
+                   const unsigned char *src, int src_stride,
+                   int width, int rows)
+{
+    pthread_once(&psb__unpack_once, psb__unpack_init);
+    psb__copy_rows_kernel(dst, dst_stride, src, src_stride, width, rows);
+}
+
+/*
+ * Run the bands of the current job that nobody has claimed yet.
+ * Called with pool->lock held.
+ */
+static void psb__row_pool_run_bands(psb_row_pool_p pool)
+{
+    int band;
+
+    while (pool->next_band < pool->num_bands) {
+        band = pool->next_band++;
+        pthread_mutex_unlock(&pool->lock);
+
+        pool->func(pool->arg,
+                   pool->rows * band / pool->num_bands,
+                   pool->rows * (band + 1) / pool->num_bands);
+
+        pthread_mutex_lock(&pool->lock);
+        if (++pool->bands_done == pool->num_bands)
+            pthread_cond_signal(&pool->done_cond);
+    }
+}
+
+static void *psb__row_pool_thread(void *arg)
+{
+    psb_row_pool_p pool = (psb_row_pool_p)arg;
+    unsigned int generation = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (!pool->quit && (pool->generation == generation))
+            pthread_cond_wait(&pool->work_cond, &pool->lock);
+        if (pool->quit)
+            break;
+        generation = pool->generation;
+        psb__row_pool_run_bands(pool);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+psb_row_pool_p psb_row_pool_create(void)
+{
+    psb_row_pool_p pool;
+    long num_cpus;
+    int i;
+
+    num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (num_cpus > PSB_PARALLEL_MAX_THREADS)
+        num_cpus = PSB_PARALLEL_MAX_THREADS;
+    if (num_cpus <= 1)
+        return NULL;
+
+    pool = (psb_row_pool_p) calloc(1, sizeof(struct psb_row_pool_s));
+    if (NULL == pool)
+        return NULL;
+
+    pthread_mutex_init(&pool->submit_lock, NULL);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_cond, NULL);
+    pthread_cond_init(&pool->done_cond, NULL);
+
+    /* The submitting thread works too, so one worker less than CPUs */
+    for (i = 0; i < num_cpus - 1; i++) {
+        if (pthread_create(&pool->threads[pool->num_threads], NULL, psb__row_pool_thread, pool))
+            break;
+        pool->num_threads++;
+    }
+
+    if (pool->num_threads == 0) {
+        psb_row_pool_destroy(pool);
+        return NULL;
+    }
+
+    return pool;
+}
+
+void psb_row_pool_destroy(psb_row_pool_p pool)
+{
+    int i;
+
+    if (NULL == pool)
+        return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->quit = 1;
+    pthread_cond_broadcast(&pool->work_cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (i = 0; i < pool->num_threads; i++)
+        pthread_join(pool->threads[i], NULL);
+
+    pthread_cond_destroy(&pool->done_cond);
+    pthread_cond_destroy(&pool->work_cond);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_mutex_destroy(&pool->submit_lock);
+    free(pool);
+}
+
+void psb_parallel_rows(psb_row_pool_p pool, psb_rows_func func, void *arg, int rows, int min_rows)
+{
+    int num_bands;
+
+    num_bands = pool ? pool->num_threads + 1 : 1;
+    if ((min_rows > 0) && (num_bands > rows / min_rows))
+        num_bands = rows / min_rows;
+    if (num_bands <= 1) {
+        func(arg, 0, rows);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->submit_lock);
+    pthread_mutex_lock(&pool->lock);
+
+    pool->func = func;
+    pool->arg = arg;
+    pool->rows = rows;
+    pool->num_bands = num_bands;
+    pool->next_band = 0;
+    pool->bands_done = 0;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->work_cond);
+
+    psb__row_pool_run_bands(pool);
+    while (pool->bands_done < pool->num_bands)
+        pthread_cond_wait(&pool->done_cond, &pool->lock);
+
+    pthread_mutex_unlock(&pool->lock);
+    pthread_mutex_unlock(&pool->submit_lock);
+}
+
+/*
+ * Each band covers whole 16x32 luma tile rows and the matching 16x16
+ * chroma tile rows; tiles of a row are stored one after the other
+ */
+static void psb__unpack_topaz_rows(void *arg, int row_start, int row_end)
+{
+    struct psb_unpack_rec_s *rec = (struct psb_unpack_rec_s *)arg;
+    int tiles_w = rec->width / TOPAZ_TILE_WIDTH;
+    int j, i, rows;
+
+    for (j = row_start; j < row_end; j++) {
+        const unsigned char *src_y = rec->src_y + j * tiles_w * TOPAZ_TILE_WIDTH * TOPAZ_Y_TILE_HEIGHT;
+        const unsigned char *src_uv = rec->src_uv + j * tiles_w * TOPAZ_TILE_WIDTH * TOPAZ_UV_TILE_HEIGHT;
+        unsigned char *dst_y = rec->dst_y + j * TOPAZ_Y_TILE_HEIGHT * rec->dst_y_stride;
+        unsigned char *dst_uv = rec->dst_uv + j * TOPAZ_UV_TILE_HEIGHT * rec->dst_uv_stride;
+
+        rows = rec->height - j * TOPAZ_Y_TILE_HEIGHT;
+        if (rows > TOPAZ_Y_TILE_HEIGHT)
+            rows = TOPAZ_Y_TILE_HEIGHT;
+
+        for (i = 0; i < tiles_w; i++) {
+            psb__copy_rows_kernel(dst_y + i * TOPAZ_TILE_WIDTH, rec->dst_y_stride,
+                                  src_y + i * TOPAZ_TILE_WIDTH * TOPAZ_Y_TILE_HEIGHT, TOPAZ_TILE_WIDTH,
+                                  TOPAZ_TILE_WIDTH, rows);
+            psb__copy_rows_kernel(dst_uv + i * TOPAZ_TILE_WIDTH, rec->dst_uv_stride,
+                                  src_uv + i * TOPAZ_TILE_WIDTH * TOPAZ_UV_TILE_HEIGHT, TOPAZ_TILE_WIDTH,
+                                  TOPAZ_TILE_WIDTH, rows >> 1);
+        }
+    }
+}
+
+VAStatus psb_unpack_topaz_rec(psb_row_pool_p pool, int src_width, int src_height,
+                              unsigned char *p_srcY, unsigned char *p_srcUV,
+                              unsigned char *p_dstY, unsigned char *p_dstUV,
+                              int dstY_stride, int dstUV_stride)
+{
+    struct psb_unpack_rec_s rec;
+
+    pthread_once(&psb__unpack_once, psb__unpack_init);
+
+    rec.width = src_width;
+    rec.height = src_height;
+    rec.src_y = p_srcY;
+    rec.src_uv = p_srcUV;
+    rec.dst_y = p_dstY;
+    rec.dst_uv = p_dstUV;
+    rec.dst_y_stride = dstY_stride;
+    rec.dst_uv_stride = dstUV_stride;
+
+    psb_parallel_rows(pool, psb__unpack_topaz_rows, &rec,
+                      (src_height + TOPAZ_Y_TILE_HEIGHT - 1) / TOPAZ_Y_TILE_HEIGHT, 8);
+
+    return VA_STATUS_SUCCESS;
+}
+
+/*
+ * VSP tiles are 64 bytes by 64 rows, stored column by column with tiles_h
+ * tiles per column. Copy rows [row_start, row_end) of one plane, one run
+ * per tile so every row segment is a contiguous 64 byte span.
+ */
+static void psb__unpack_vsp_plane(unsigned char *dst, int dst_stride, const unsigned char *src,
+                                  int tiles_h, int border_x, int border_y, int width_bytes,
+                                  int row_start, int row_end)
+{
+    int x, y, run, rows;
+
+    for (y = row_start + border_y; y < row_end + border_y; y += rows) {
+        rows = VSP_TILE_HEIGHT - (y % VSP_TILE_HEIGHT);
+        if (rows > row_end + border_y - y)
+            rows = row_end + border_y - y;
+
+        for (x = border_x; x < width_bytes + border_x; x += run) {
+            run = VSP_TILE_WIDTH - (x % VSP_TILE_WIDTH);
+            if (run > width_bytes + border_x - x)
+                run = width_bytes + border_x - x;
+
+            psb__copy_rows_kernel(dst + (y - border_y) * dst_stride + (x - border_x), dst_stride,
+                                  src + (tiles_h * (x / VSP_TILE_WIDTH) + y / VSP_TILE_HEIGHT) * VSP_TILE_SIZE
+                                  + (y % VSP_TILE_HEIGHT) * VSP_TILE_WIDTH + (x % VSP_TILE_WIDTH),
+                                  VSP_TILE_WIDTH, run, rows);
+        }
+    }
+}
+
+/*
+ * Each band unit is one chroma row and the two luma rows it covers
+ */
+static void psb__unpack_vsp_rows(void *arg, int row_start, int row_end)
+{
+    struct psb_unpack_rec_s *rec = (struct psb_unpack_rec_s *)arg;
+    int uv_height = (rec->height + 1) >> 1;
+    int y_end = row_end * 2;
+
+    if (y_end > rec->height)
+        y_end = rec->height;
+
+    psb__unpack_vsp_plane(rec->dst_y, rec->dst_y_stride, rec->src_y,
+                          (rec->height + 2 * VSP_BORDER + VSP_TILE_HEIGHT - 1) / VSP_TILE_HEIGHT,
+                          VSP_BORDER, VSP_BORDER, rec->width,
+                          row_start * 2, y_end);
+    psb__unpack_vsp_plane(rec->dst_uv, rec->dst_uv_stride, rec->src_uv,
+                          (uv_height + VSP_BORDER + VSP_TILE_HEIGHT - 1) / VSP_TILE_HEIGHT,
+                          VSP_BORDER, VSP_BORDER / 2, ((rec->width + 1) >> 1) * 2,
+                          row_start, row_end);
+}
+
+VAStatus psb_unpack_vsp_rec(psb_row_pool_p pool, int src_width, int src_height,
+                            unsigned char *p_srcY, unsigned char *p_srcUV,
+                            unsigned char *p_dstY, unsigned char *p_dstUV,
+                            int dstY_stride, int dstUV_stride)
+{
+    struct psb_unpack_rec_s rec;
+
+    pthread_once(&psb__unpack_once, psb__unpack_init);
+
+    rec.width = src_width;
+    rec.height = src_height;
+    rec.src_y = p_srcY;
+    rec.src_uv = p_srcUV;
+    rec.dst_y = p_dstY;
+    rec.dst_uv = p_dstUV;
+    rec.dst_y_stride = dstY_stride;
+    rec.dst_uv_stride = dstUV_stride;
+
+    psb_parallel_rows(pool, psb__unpack_vsp_rows, &rec, (src_height + 1) >> 1, 64);
+
+    return VA_STATUS_SUCCESS;
+}
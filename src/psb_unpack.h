@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2011 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _PSB_UNPACK_H_
+#define _PSB_UNPACK_H_
+
+#include <va/va.h>
+
+/*
+ * Row band worker used to split image processing across threads
+ */
+typedef void (*psb_rows_func)(void *arg, int row_start, int row_end);
+
+typedef struct psb_row_pool_s *psb_row_pool_p;
+
+/*
+ * Create a pool of worker threads for psb_parallel_rows, sized from the
+ * number of online CPUs. Returns NULL if the pool would have no workers.
+ */
+psb_row_pool_p psb_row_pool_create(void);
+
+/*
+ * Stop the worker threads and free the pool
+ */
+void psb_row_pool_destroy(psb_row_pool_p pool);
+
+/*
+ * Run func over [0, rows) split in bands of at least min_rows rows on the
+ * pool workers and the calling thread, and wait for all of them to complete.
+ * With a NULL pool everything runs on the calling thread.
+ */
+void psb_parallel_rows(psb_row_pool_p pool, psb_rows_func func, void *arg, int rows, int min_rows);
+
+/*
+ * Returns nonzero when the CPU supports SSE2
+ */
+int psb_cpu_has_sse2(void);
+
+/*
+ * Copy rows of width bytes, using the fastest kernel this CPU supports
+ */
+void psb_copy_rows(unsigned char *dst, int dst_stride,
+                   const unsigned char *src, int src_stride,
+                   int width, int rows);
+
+/*
+ * Convert a TopazHP reconstructed frame (16x32 luma tiles, 16x16 chroma
+ * tiles) to linear NV12
+ */
+VAStatus psb_unpack_topaz_rec(psb_row_pool_p pool, int src_width, int src_height,
+                              unsigned char *p_srcY, unsigned char *p_srcUV,
+                              unsigned char *p_dstY, unsigned char *p_dstUV,
+                              int dstY_stride, int dstUV_stride);
+
+/*
+ * Convert a VSP reconstructed frame (64x64 tiles with a 32 pixel border)
+ * to linear NV12
+ */
+VAStatus psb_unpack_vsp_rec(psb_row_pool_p pool, int src_width, int src_height,
+                            unsigned char *p_srcY, unsigned char *p_srcUV,
+                            unsigned char *p_dstY, unsigned char *p_dstUV,
+                            int dstY_stride, int dstUV_stride);
+
+#endif /* _PSB_UNPACK_H_ */
@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2011 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "psb_vlc_cache.h"
+#include "psb_def.h"
+#include "psb_drv_debug.h"
+
+/*
+ * Only the BO is shared. Every context gets its own psb_buffer_s around
+ * it, because cmdbufs keep per-submission state (status, list link,
+ * submit_seq) in the psb_buffer_s they reference.
+ */
+struct psb_vlc_table_s {
+    psb_buffer_p buf;
+    unsigned int size;
+    int refcount;
+};
+
+static psb_buffer_p psb__vlc_table_create(psb_driver_data_p driver_data, unsigned int size,
+                                          const void *data, psb_vlc_pack_func pack)
+{
+    psb_buffer_p buf;
+    unsigned char *address;
+
+    buf = (psb_buffer_p) calloc(1, sizeof(struct psb_buffer_s));
+    if (buf == NULL)
+        return NULL;
+
+    if (VA_STATUS_SUCCESS != psb_buffer_create(driver_data, size, psb_bt_cpu_vpu, buf)) {
+        free(buf);
+        return NULL;
+    }
+
+    if (psb_buffer_map(buf, &address)) {
+        psb_buffer_destroy(buf);
+        free(buf);
+        return NULL;
+    }
+    if (pack)
+        pack(address, size);
+    else
+        memcpy(address, data, size);
+    psb_buffer_unmap(buf);
+
+    return buf;
+}
+
+psb_buffer_p psb_vlc_table_get(psb_driver_data_p driver_data, psb_vlc_table_t id,
+                               unsigned int size, const void *data, psb_vlc_pack_func pack)
+{
+    struct psb_vlc_table_s *table;
+    psb_buffer_p buf = NULL;
+
+    ASSERT(id < PSB_VLC_TABLE_NUM);
+
+    pthread_mutex_lock(&driver_data->vlc_cache_mutex);
+
+    if (driver_data->vlc_cache == NULL) {
+        driver_data->vlc_cache = (struct psb_vlc_table_s *) calloc(PSB_VLC_TABLE_NUM, sizeof(struct psb_vlc_table_s));
+        if (driver_data->vlc_cache == NULL)
+            goto out;
+    }
+    table = &driver_data->vlc_cache[id];
+
+    if (table->buf == NULL) {
+        table->buf = psb__vlc_table_create(driver_data, size, data, pack);
+        if (table->buf == NULL)
+            goto out;
+        table->size = size;
+        drv_debug_msg(VIDEO_DEBUG_GENERAL, "VLC table %d created, %d bytes\n", id, size);
+    }
+    ASSERT(table->size == size);
+
+    buf = (psb_buffer_p) calloc(1, sizeof(struct psb_buffer_s));
+    if (buf == NULL)
+        goto out;
+
+    if (VA_STATUS_SUCCESS != psb_buffer_reference(driver_data, buf, table->buf)) {
+        free(buf);
+        buf = NULL;
+        goto out;
+    }
+    buf->status = psb_bs_ready;
+    buf->next = NULL;
+    buf->submit_seq = 0;
+
+    table->refcount++;
+    drv_debug_msg(VIDEO_DEBUG_GENERAL, "VLC table %d referenced, refcount %d\n", id, table->refcount);
+
+out:
+    pthread_mutex_unlock(&driver_data->vlc_cache_mutex);
+    return buf;
+}
+
+void psb_vlc_table_put(psb_driver_data_p driver_data, psb_vlc_table_t id, psb_buffer_p buf)
+{
+    ASSERT(id < PSB_VLC_TABLE_NUM);
+
+    /* waits for a cmdbuf still listing it */
+    psb_buffer_destroy(buf);
+    free(buf);
+
+    pthread_mutex_lock(&driver_data->vlc_cache_mutex);
+    if (driver_data->vlc_cache && driver_data->vlc_cache[id].refcount > 0)
+        driver_data->vlc_cache[id].refcount--;
+    pthread_mutex_unlock(&driver_data->vlc_cache_mutex);
+}
+
+void psb_vlc_cache_destroy(psb_driver_data_p driver_data)
+{
+    int i;
+
+    if (driver_data->vlc_cache == NULL)
+        return;
+
+    /* cmdbufs only ever list the per-context references, see psb_vlc_table_put */
+    for (i = 0; i < PSB_VLC_TABLE_NUM; i++) {
+        struct psb_vlc_table_s *table = &driver_data->vlc_cache[i];
+
+        if (table->buf == NULL)
+            continue;
+        if (table->refcount)
+            drv_debug_msg(VIDEO_DEBUG_ERROR, "VLC table %d still has %d users\n", i, table->refcount);
+
+        psb_buffer_destroy(table->buf);
+        free(table->buf);
+        table->buf = NULL;
+    }
+    free(driver_data->vlc_cache);
+    driver_data->vlc_cache = NULL;
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2011 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _PSB_VLC_CACHE_H_
+#define _PSB_VLC_CACHE_H_
+
+#include "psb_drv_video.h"
+#include "psb_buffer.h"
+
+/*
+ * Packed VLC table sets shared by all decode contexts of a driver instance
+ */
+typedef enum {
+    PSB_VLC_TABLE_H264 = 0,
+    PSB_VLC_TABLE_MPEG2,
+    PSB_VLC_TABLE_MPEG4,
+    PSB_VLC_TABLE_VC1,
+    PSB_VLC_TABLE_NUM
+} psb_vlc_table_t;
+
+/*
+ * Fills a freshly mapped table buffer of "size" bytes
+ */
+typedef void (*psb_vlc_pack_func)(unsigned char *dst, unsigned int size);
+
+/*
+ * Returns a new buffer referencing the BO that holds table set "id".
+ * The first caller creates the BO and fills it, either by copying
+ * "size" bytes from "data" or, if "pack" is set, by calling "pack".
+ * The returned buffer belongs to the caller's context only.
+ *
+ * Returns NULL on failure
+ */
+psb_buffer_p psb_vlc_table_get(psb_driver_data_p driver_data, psb_vlc_table_t id,
+                               unsigned int size, const void *data, psb_vlc_pack_func pack);
+
+/*
+ * Destroys a buffer returned by psb_vlc_table_get. Unreferenced tables
+ * stay cached for the next context until psb_vlc_cache_destroy.
+ */
+void psb_vlc_table_put(psb_driver_data_p driver_data, psb_vlc_table_t id, psb_buffer_p buf);
+
+/*
+ * Frees all cached tables, called from vaTerminate
+ */
+void psb_vlc_cache_destroy(psb_driver_data_p driver_data);
+
+#endif /* _PSB_VLC_CACHE_H_ */
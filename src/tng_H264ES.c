@@ -463,8 +463,7 @@ static VAStatus tng__H264ES_process_misc_air_param(context_ENC_p ctx, object_buf
         psMiscAirParams->air_num_mbs, psMiscAirParams->air_threshold,
         psMiscAirParams->air_auto);
 
-    if (psAIRInfo->pi8AIR_Table != NULL)
-        free(psAIRInfo->pi8AIR_Table);
+    tng_air_buf_free(ctx);
     tng_air_buf_create(ctx);
     
     return VA_STATUS_SUCCESS;
@@ -744,6 +744,7 @@ int tng_context_flush_cmdbuf(object_context_p obj_context)
     struct psb_ttm_fence_rep fence_rep;
     unsigned int reloc_offset;
     unsigned int num_relocs;
+    uint64_t submit_start_us;
     int ret;
     unsigned int cmdbuffer_size = (unsigned int) (((unsigned char *)(cmdbuf->cmd_idx)) - cmdbuf->cmd_start); /* In bytes */
 
@@ -772,6 +773,7 @@ int tng_context_flush_cmdbuf(object_context_p obj_context)
 #endif
 
 
+    submit_start_us = psb_stats_now_us();
     wsbmWriteLockKernelBO();
 #if 1 //_PO_DEBUG_
     ret = ptgDRMCmdBuf(driver_data->drm_fd, driver_data->execIoctlOffset, /* FIXME Still use ioctl cmd? */
@@ -783,6 +785,7 @@ int tng_context_flush_cmdbuf(object_context_p obj_context)
     wsbmWriteUnlockKernelBO();
 
     UNLOCK_HARDWARE(driver_data);
+    psb_stats_submit(obj_context, submit_start_us);
 
     if (ret) {
         obj_context->tng_cmdbuf = NULL;
@@ -266,5 +266,11 @@ void tng_cmdbuf_set_phys(IMG_UINT32 *dest_buf, int dest_num, psb_buffer_p ref_bu
 int tng_get_pipe_number(object_context_p obj_context);
 VAStatus tng_set_frame_skip_flag(object_context_p obj_context);
 
+/*
+ * Encode pipeline mode of a video encode context, see psb_coded_queue.h
+ */
+VAStatus tng_set_pipeline_depth(object_context_p obj_context, unsigned int depth);
+VAStatus tng_get_completed_codedbuf(object_context_p obj_context, VABufferID *coded_buf, int wait);
+
 #endif /* _TNG_CMDBUF_H_ */
 
@@ -51,6 +51,8 @@ VAStatus tng_air_buf_create(context_ENC_p ctx)
         return VA_STATUS_ERROR_ALLOCATION_FAILED;
     }
     memset(ctx->sAirInfo.pi8AIR_Table, 0, ui32MbNum);
+    /* allocated by the host AIR calculation on first use */
+    ctx->sAirInfo.pui32SAD_Table = NULL;
     return VA_STATUS_SUCCESS;
 }
 
@@ -71,6 +73,10 @@ void tng_air_buf_free(context_ENC_p ctx)
 {
     if (ctx->sAirInfo.pi8AIR_Table != NULL)
         free(ctx->sAirInfo.pi8AIR_Table);
+    if (ctx->sAirInfo.pui32SAD_Table != NULL)
+        free(ctx->sAirInfo.pui32SAD_Table);
+    ctx->sAirInfo.pi8AIR_Table = NULL;
+    ctx->sAirInfo.pui32SAD_Table = NULL;
     return ;
 }
 
@@ -625,34 +631,98 @@ VAStatus tng__unmap_best_mb_decision_out_buf(
     return vaStatus;
 }
 
+// SAD histogram used to pick the auto-adjusting AIR threshold: 1024 bins of 64,
+// SADs above 65535 all land in the last bin
+#define AIR_SAD_HIST_SHIFT      (6)
+#define AIR_SAD_HIST_BINS       (1024)
+
+// Copy the per-MB SADs out of the (uncached) first pass output into a packed table
+// and histogram them, touching each MB record exactly once
+static void tng__gather_air_sads(
+    IMG_UINT8 *pSADPointer,
+    IMG_BOOL bBestMultipass,
+    IMG_UINT32 ui32MBFrameWidth,
+    IMG_UINT32 ui32MBPictureHeight,
+    IMG_UINT32 *pui32SAD,
+    IMG_UINT32 *pui32Hist)
+{
+    IMG_UINT32 ui32MBx, ui32MBy;
+    IMG_UINT32 ui32SADParam, ui32Bin;
+
+    for (ui32MBy = 0; ui32MBy < ui32MBPictureHeight; ui32MBy++) {
+        if (bBestMultipass) {
+            IMG_BEST_MULTIPASS_MB_PARAMS *psBestMB_Params = (IMG_BEST_MULTIPASS_MB_PARAMS *) pSADPointer;
+            for (ui32MBx = 0; ui32MBx < ui32MBFrameWidth; ui32MBx++) {
+                ui32SADParam = psBestMB_Params[ui32MBx].ui32SAD_Inter_MBInfo & IMG_BEST_MULTIPASS_SAD_MASK;
+                ui32Bin = ui32SADParam >> AIR_SAD_HIST_SHIFT;
+                pui32Hist[ui32Bin < AIR_SAD_HIST_BINS ? ui32Bin : AIR_SAD_HIST_BINS - 1]++;
+                *pui32SAD++ = ui32SADParam;
+            }
+            pSADPointer = (IMG_UINT8 *) &(psBestMB_Params[ui32MBFrameWidth]);
+        } else {
+            IMG_FIRST_STAGE_MB_PARAMS *psFirstMB_Params = (IMG_FIRST_STAGE_MB_PARAMS *) pSADPointer;
+            for (ui32MBx = 0; ui32MBx < ui32MBFrameWidth; ui32MBx++) {
+                ui32SADParam = ((IMG_UINT32) psFirstMB_Params[ui32MBx].ui16Ipe0Sad +
+                                (IMG_UINT32) psFirstMB_Params[ui32MBx].ui16Ipe1Sad) / 2;
+                pui32Hist[ui32SADParam >> AIR_SAD_HIST_SHIFT]++;
+                *pui32SAD++ = ui32SADParam;
+            }
+            pSADPointer = (IMG_UINT8 *) &(psFirstMB_Params[ui32MBFrameWidth]);
+        }
+        pSADPointer = (IMG_UINT8 *) ALIGN_64(((IMG_UINT32) pSADPointer));
+    }
+}
+
+// Lowest threshold that marks no more than ui32MaxMBs, interpolated inside the boundary bin
+static IMG_UINT32 tng__air_percentile_threshold(IMG_UINT32 *pui32Hist, IMG_UINT32 ui32MaxMBs)
+{
+    IMG_UINT32 ui32Count = 0;
+    IMG_INT32 i32Bin;
+
+    for (i32Bin = AIR_SAD_HIST_BINS - 1; i32Bin >= 0; i32Bin--) {
+        if (ui32Count + pui32Hist[i32Bin] > ui32MaxMBs)
+            break;
+        ui32Count += pui32Hist[i32Bin];
+    }
+
+    if (i32Bin < 0)
+        return 0;
+
+    return ((IMG_UINT32)(i32Bin + 1) << AIR_SAD_HIST_SHIFT) -
+        (((ui32MaxMBs - ui32Count) << AIR_SAD_HIST_SHIFT) / pui32Hist[i32Bin]);
+}
+
 // Calculate Adaptive Intra Refresh (AIR)
 static void tng__calc_air_inp_ctrl_buf(context_ENC_p ctx, IMG_UINT8 *pFirstPassOutBuf, IMG_UINT8 *pBestMBDecisionCtrlBuf)
 {
-    IMG_UINT8 *pSADPointer;
     IMG_UINT8 *pvSADBuffer;
-    IMG_UINT8 ui8IsAlreadyIntra;
     IMG_UINT32 ui32MBFrameWidth;
     IMG_UINT32 ui32MBPictureHeight;
-    IMG_UINT16 ui16IntraParam;
-    IMG_UINT32 ui32MBx, ui32MBy;
-    IMG_UINT32 ui32SADParam;
-    IMG_UINT32 ui32tSAD_Threshold, ui32tSAD_ThresholdLo, ui32tSAD_ThresholdHi;
-    IMG_UINT32 ui32MaxMBs, ui32NumMBsOverThreshold, ui32NumMBsOverLo, ui32NumMBsOverHi;
-    IMG_BEST_MULTIPASS_MB_PARAMS *psBestMB_Params;
-    IMG_FIRST_STAGE_MB_PARAMS *psFirstMB_Params;
+    IMG_UINT32 ui32MBNum, ui32MB;
+    IMG_UINT32 ui32tSAD_Threshold;
+    IMG_UINT32 ui32MaxMBs, ui32NumMBsOverThreshold;
+    IMG_UINT32 aui32SADHist[AIR_SAD_HIST_BINS];
+    IMG_UINT32 *pui32SAD = ctx->sAirInfo.pui32SAD_Table;
+    IMG_INT8 *pi8AIR = ctx->sAirInfo.pi8AIR_Table;
 
-    ui16IntraParam = (0 << 7) | (0 << 4);
-    ui32NumMBsOverThreshold = ui32NumMBsOverLo = ui32NumMBsOverHi = 0;
-    //drv_debug_msg(VIDEO_DEBUG_GENERAL,"%s: start\n", __FUNCTION__);
-
-//    if (psActiveContext->ui32EncodeSent < (IMG_UINT32)psActiveContext->ui8MaxSourceSlots + 1)
-//    if (ctx->ui32FrameCount[0] < (IMG_UINT32)(ctx->ui8SlotsInUse + 1))
-//        return;
     drv_debug_msg(VIDEO_DEBUG_GENERAL,"%s: start\n", __FUNCTION__);
-    //fill data 
+    //fill data
     ui32MBFrameWidth  = (ctx->ui16Width/16);
     ui32MBPictureHeight = (ctx->ui16PictureHeight/16);
-	
+    ui32MBNum = ui32MBFrameWidth * ui32MBPictureHeight;
+
+    if (pi8AIR == NULL)
+        return;
+
+    if (pui32SAD == NULL) {
+        pui32SAD = (IMG_UINT32 *)malloc(ui32MBNum * sizeof(IMG_UINT32));
+        if (pui32SAD == NULL) {
+            drv_debug_msg(VIDEO_DEBUG_ERROR, "%s: error allocating AIR SAD table\n", __FUNCTION__);
+            return;
+        }
+        ctx->sAirInfo.pui32SAD_Table = pui32SAD;
+    }
+
     // get the SAD results buffer (either IPE0 and IPE1 results or, preferably, the more accurate Best Multipass SAD results)
     if (pBestMBDecisionCtrlBuf) {
         pvSADBuffer = pBestMBDecisionCtrlBuf;
@@ -671,154 +741,58 @@ static void tng__calc_air_inp_ctrl_buf(context_ENC_p ctx, IMG_UINT8 *pFirstPassO
     }
 
     if (ctx->sAirInfo.i32NumAIRSPerFrame == 0)
-        ui32MaxMBs = ui32MBFrameWidth * ui32MBPictureHeight; // Default to ALL MB's in frame
+        ui32MaxMBs = ui32MBNum; // Default to ALL MB's in frame
     else if (ctx->sAirInfo.i32NumAIRSPerFrame < 0)
-        ctx->sAirInfo.i32NumAIRSPerFrame = ui32MaxMBs = ((ui32MBFrameWidth * ui32MBPictureHeight) + 99) / 100; // Default to 1% of MB's in frame (min 1)
+        ctx->sAirInfo.i32NumAIRSPerFrame = ui32MaxMBs = (ui32MBNum + 99) / 100; // Default to 1% of MB's in frame (min 1)
     else
         ui32MaxMBs = ctx->sAirInfo.i32NumAIRSPerFrame;
 
-    pSADPointer = (IMG_UINT8 *)pvSADBuffer;
-	
+    memset(aui32SADHist, 0, sizeof(aui32SADHist));
+    tng__gather_air_sads(pvSADBuffer, pBestMBDecisionCtrlBuf != NULL,
+        ui32MBFrameWidth, ui32MBPictureHeight, pui32SAD, aui32SADHist);
+
     if (ctx->sAirInfo.i32SAD_Threshold >= 0)
         ui32tSAD_Threshold = (IMG_UINT16)ctx->sAirInfo.i32SAD_Threshold;
     else {
-        // Running auto adjust threshold adjust mode
-        if (ctx->sAirInfo.i32SAD_Threshold == -1) {
-            // This will occur only the first time
-            if (pBestMBDecisionCtrlBuf) {
-                psBestMB_Params=(IMG_BEST_MULTIPASS_MB_PARAMS *) pSADPointer; // Auto seed the threshold with the first value
-                ui32SADParam = psBestMB_Params->ui32SAD_Inter_MBInfo & IMG_BEST_MULTIPASS_SAD_MASK;
-            } else {
-                psFirstMB_Params=(IMG_FIRST_STAGE_MB_PARAMS *) pSADPointer; // Auto seed the threshold with the first value
-                ui32SADParam = (IMG_UINT32) psFirstMB_Params->ui16Ipe0Sad;
-            }
-            ctx->sAirInfo.i32SAD_Threshold = -1 - ui32SADParam; // Negative numbers indicate auto-adjusting threshold
-        }
-        ui32tSAD_Threshold = (IMG_UINT32) - (ctx->sAirInfo.i32SAD_Threshold + 1);
+        // Running auto adjust threshold mode: take the threshold straight from this frame's
+        // SAD distribution (stored negative minus 1 to indicate it's auto-adjustable)
+        ui32tSAD_Threshold = tng__air_percentile_threshold(aui32SADHist, ui32MaxMBs);
+        ctx->sAirInfo.i32SAD_Threshold = -((IMG_INT32)ui32tSAD_Threshold) - 1;
     }
 
-    ui32tSAD_ThresholdLo = ui32tSAD_Threshold / 2;
-    ui32tSAD_ThresholdHi = ui32tSAD_Threshold + ui32tSAD_ThresholdLo;
-
     drv_debug_msg(VIDEO_DEBUG_GENERAL,"Th:%u, MaxMbs:%u, Skp:%i\n", (unsigned int)ui32tSAD_Threshold, (unsigned int)ui32MaxMBs, ctx->sAirInfo.i16AIRSkipCnt);
 
-#ifdef ADAPTIVE_INTRA_REFRESH_DEBUG_OUTPUT
-	if (fp)
-		fp=fopen("SADvals.txt","a");
-	else
-		fp=fopen("SADvals.txt","w");
-
-	if (ctx->sAirInfo.i32SAD_Threshold>=0)
-		if (ctx->sAirInfo.i32NumAIRSPerFrame>0)
-			fprintf(fp, "S_SADThreshold: %i	MaxMBs: %i\n", ui32tSAD_Threshold, ui32MaxMBs);
-		else
-			fprintf(fp, "S_SADThreshold: %i	MaxMBs: NA\n", ui32tSAD_Threshold, ui32MaxMBs);
-	else
-		fprintf(fp, "V_SADThreshold: %i	MaxMBs: %i\n", ui32tSAD_Threshold, ui32MaxMBs);
-
-	if (pBestMBDecisionCtrlBuf)
-		fprintf(fp, "Using Best Multipass SAD values\n");
-	else
-		fprintf(fp, "Using Motion Search Data IPE SAD values\n");
-#endif
-
-    // This loop could be optimised to a single counter if necessary, retaining for clarity
-    for (ui32MBy = 0; ui32MBy < ui32MBPictureHeight; ui32MBy++) {
-        for( ui32MBx=0; ui32MBx<ui32MBFrameWidth; ui32MBx++) {
-#ifdef ADAPTIVE_INTRA_REFRESH_DEBUG_OUTPUT	
-            IMG_CHAR cMarked;
-            cMarked='_';
-#endif
-            // Turn all negative table values to positive (reset 'touched' state of a block that may have been set in APP_SendAIRInpCtrlBuf())
-	    if (ctx->sAirInfo.pi8AIR_Table[ui32MBy *  ui32MBFrameWidth + ui32MBx] < 0)
-                ctx->sAirInfo.pi8AIR_Table[ui32MBy *  ui32MBFrameWidth + ui32MBx] = -1 - ctx->sAirInfo.pi8AIR_Table[ui32MBy *  ui32MBFrameWidth + ui32MBx];
+    // Branch free over the packed tables so the compiler can vectorise it:
+    // reset the 'touched' state set in tng__update_air_send() and mark MBs over threshold
+    ui32NumMBsOverThreshold = 0;
+    for (ui32MB = 0; ui32MB < ui32MBNum; ui32MB++) {
+        IMG_INT8 i8Air = pi8AIR[ui32MB];
+        IMG_UINT32 ui32Over = (pui32SAD[ui32MB] >= ui32tSAD_Threshold);
 
-            // This will read the SAD value from the buffer (either IPE0 SAD or the superior Best multipass parameter structure SAD value)
-            if (pBestMBDecisionCtrlBuf) {
-                psBestMB_Params = (IMG_BEST_MULTIPASS_MB_PARAMS *) pSADPointer;
-                ui32SADParam = psBestMB_Params->ui32SAD_Inter_MBInfo & IMG_BEST_MULTIPASS_SAD_MASK;
-
-                if ((psBestMB_Params->ui32SAD_Intra_MBInfo & IMG_BEST_MULTIPASS_MB_TYPE_MASK) >> IMG_BEST_MULTIPASS_MB_TYPE_SHIFT == 1)
-                    ui8IsAlreadyIntra = 1;
-                else
-                    ui8IsAlreadyIntra = 0;
-
-                pSADPointer=(IMG_UINT8 *) &(psBestMB_Params[1]);
-            } else {
-                psFirstMB_Params=(IMG_FIRST_STAGE_MB_PARAMS *) pSADPointer;
-                ui32SADParam = (IMG_UINT32) psFirstMB_Params->ui16Ipe0Sad;
-                ui32SADParam += (IMG_UINT32) psFirstMB_Params->ui16Ipe1Sad;
-                ui32SADParam /= 2;
-                ui8IsAlreadyIntra = 0; // We don't have the information to determine this
-                pSADPointer=(IMG_UINT8 *) &(psFirstMB_Params[1]);
-            }
-
-            if (ui32SADParam >= ui32tSAD_ThresholdLo) {
-                ui32NumMBsOverLo++;
+        i8Air = (i8Air < 0) ? (-1 - i8Air) : i8Air;
+        pi8AIR[ui32MB] = i8Air + ui32Over;
+        ui32NumMBsOverThreshold += ui32Over;
+    }
 
-                if (ui32SADParam >= ui32tSAD_Threshold) {
 #ifdef ADAPTIVE_INTRA_REFRESH_DEBUG_OUTPUT
-                    cMarked='i';
-#endif	
-
-                    // if (!ui8IsAlreadyIntra) // Don't mark this block if it's just been encoded as an Intra block anyway
-                    // (results seem better without this condition anyway)
-                    {
-                        ctx->sAirInfo.pi8AIR_Table[ui32MBy *  ui32MBFrameWidth + ui32MBx]++;
-#ifdef ADAPTIVE_INTRA_REFRESH_DEBUG_OUTPUT	
-                        cMarked='I';
-#endif	
-                    }
-                    ui32NumMBsOverThreshold++;
-                    if (ui32SADParam >= ui32tSAD_ThresholdHi)
-                        ui32NumMBsOverHi++;
-                }
+    {
+        FILE *fp = fopen("SADvals.txt", "a");
+        if (fp) {
+            fprintf(fp, "%s_SADThreshold: %u	MaxMBs: %u\n", (ctx->sAirInfo.i32SAD_Threshold >= 0) ? "S" : "V",
+                ui32tSAD_Threshold, ui32MaxMBs);
+            for (ui32MB = 0; ui32MB < ui32MBNum; ui32MB++) {
+                fprintf(fp, "%4x[%i]%c,	", pui32SAD[ui32MB], pi8AIR[ui32MB],
+                    (pui32SAD[ui32MB] >= ui32tSAD_Threshold) ? 'I' : '_');
+                if ((ui32MB + 1) % ui32MBFrameWidth == 0)
+                    fprintf(fp, "\n");
             }
-
-#ifdef ADAPTIVE_INTRA_REFRESH_DEBUG_OUTPUT	
-            fprintf(fp,"%4x[%i]%c,	",ui32SADParam, ctx->sAirInfo.pi8AIR_Table[ui32MBy * ui32MBFrameWidth + ui32MBx], cMarked);
-#endif
+            fprintf(fp, "\n MBs tagged:%u\n", ui32NumMBsOverThreshold);
+            fclose(fp);
         }
-        pSADPointer=(IMG_UINT8 *) ALIGN_64(((IMG_UINT32) pSADPointer));
-#ifdef ADAPTIVE_INTRA_REFRESH_DEBUG_OUTPUT
-	fprintf(fp,"\n");
-#endif
     }
-
-    // Test and process running adaptive threshold case
-    if (ctx->sAirInfo.i32SAD_Threshold < 0) {
-        // Adjust our threshold (to indicate it's auto-adjustable store it as a negative value minus 1)
-        if (ui32NumMBsOverLo <= ui32MaxMBs)
-            ctx->sAirInfo.i32SAD_Threshold = (IMG_INT32) - ((IMG_INT32)ui32tSAD_ThresholdLo) - 1;
-        else
-            if (ui32NumMBsOverHi >= ui32MaxMBs)
-                ctx->sAirInfo.i32SAD_Threshold = (IMG_INT32) - ((IMG_INT32)ui32tSAD_ThresholdHi) - 1;
-            else {
-                if (ui32MaxMBs < ui32NumMBsOverThreshold) {
-                    ctx->sAirInfo.i32SAD_Threshold = ((IMG_INT32)ui32tSAD_ThresholdHi - (IMG_INT32)ui32tSAD_Threshold);
-                    ctx->sAirInfo.i32SAD_Threshold *= ((IMG_INT32)ui32MaxMBs - (IMG_INT32)ui32NumMBsOverThreshold);
-                    ctx->sAirInfo.i32SAD_Threshold /= ((IMG_INT32)ui32NumMBsOverHi - (IMG_INT32)ui32NumMBsOverThreshold);
-                    ctx->sAirInfo.i32SAD_Threshold += ui32tSAD_Threshold;
-                } else {
-                    ctx->sAirInfo.i32SAD_Threshold = ((IMG_INT32)ui32tSAD_Threshold - (IMG_INT32)ui32tSAD_ThresholdLo);
-                    ctx->sAirInfo.i32SAD_Threshold *= ((IMG_INT32)ui32MaxMBs - (IMG_INT32)ui32NumMBsOverLo);
-                    ctx->sAirInfo.i32SAD_Threshold /= ((IMG_INT32)ui32NumMBsOverThreshold - (IMG_INT32)ui32NumMBsOverLo);
-                    ctx->sAirInfo.i32SAD_Threshold += ui32tSAD_ThresholdLo;
-                }
-                ctx->sAirInfo.i32SAD_Threshold = -ctx->sAirInfo.i32SAD_Threshold - 1;
-            }
-
-#ifdef ADAPTIVE_INTRA_REFRESH_DEBUG_OUTPUT
-            fprintf(fp,"THRESHOLDS ADJUSTMENT\nThrLo:%i	ThrMid:%i	ThrHi:%i\nMBsLo:%i	MBsMid:%i	MBsHi:%i\n",ui32tSAD_ThresholdLo, ui32tSAD_Threshold, ui32tSAD_ThresholdHi, ui32NumMBsOverLo, ui32NumMBsOverThreshold, ui32NumMBsOverHi);
-            fprintf(fp,"Target No. MB's:%i\nThreshold adjusted to: %i\n",ui32MaxMBs, -(ctx->sAirInfo.i32SAD_Threshold));
 #endif
-    }
-
-#ifdef ADAPTIVE_INTRA_REFRESH_DEBUG_OUTPUT
-    fprintf(fp,"\n MBs tagged:%i\n", ui32NumMBsOverThreshold);
-    fclose(fp);
-#endif
-    drv_debug_msg(VIDEO_DEBUG_GENERAL,"%s: end\n", __FUNCTION__);
+    drv_debug_msg(VIDEO_DEBUG_GENERAL,"%s: end, %u of %u MBs tagged\n", __FUNCTION__,
+        (unsigned int)ui32NumMBsOverThreshold, (unsigned int)ui32MBNum);
     return;
 }
 
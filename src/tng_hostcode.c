@@ -33,6 +33,7 @@
 //#include "tng_H263ES.h"
 #include "tng_hostheader.h"
 #include "tng_hostcode.h"
+#include "tng_scaler_coeff.h"
 #include "psb_def.h"
 #include "psb_drv_debug.h"
 #include "psb_cmdbuf.h"
@@ -557,6 +558,11 @@ void tng_DestroyContext(object_context_p obj_context, unsigned char is_JPEG)
     if (ctx->bEnableMVC)
         tng__free_context_buffer(ctx, is_JPEG, 1);
 
+    if (ctx->ui32CodedQueueDrops)
+        drv_debug_msg(VIDEO_DEBUG_GENERAL, "%s: %d coded buffers dropped from the completion queue\n",
+            __FUNCTION__, ctx->ui32CodedQueueDrops);
+    pthread_mutex_destroy(&ctx->coded_queue_mutex);
+
     free(obj_context->format_data);
     obj_context->format_data = NULL;
 }
@@ -796,6 +802,7 @@ VAStatus tng_CreateContext(
 
     obj_context->format_data = (void*) ctx;
     ctx->obj_context = obj_context;
+    pthread_mutex_init(&ctx->coded_queue_mutex, NULL);
 
     if (is_JPEG == 0) {
         ctx->ui16Width = (unsigned short)(~0xf & (ui16Width + 0xf));
@@ -2455,136 +2462,6 @@ static VAStatus tng__prepare_templates(context_ENC_p ctx, IMG_UINT32 ui32StreamI
     return VA_STATUS_SUCCESS;
 }
 
-#if INPUT_SCALER_SUPPORTED
-static IMG_FLOAT VIDEO_CalculateBessel0 (IMG_FLOAT fX)
-{
-    IMG_FLOAT fAX, fY;
-
-    fAX = (IMG_FLOAT)IMG_FABS(fX);
-
-    if (fAX < 3.75) 	{
-        fY = (IMG_FLOAT)(fX / 3.75);
-        fY *= fY;
-
-        return (IMG_FLOAT)(1.0 + fY *
-            (3.5156229 + fY *
-            (3.0899424 + fY *
-            (1.2067492 + fY *
-            (0.2659732 + fY *
-            (0.360768e-1 + fY * 0.45813e-2))))));
-    }
-
-    fY = (IMG_FLOAT)(3.75 / fAX);
-
-    return (IMG_FLOAT)((IMG_EXP(fAX) / IMG_SQRT(fAX)) *
-        (0.39894228 + fY *
-        (0.1328592e-1 + fY *
-        (0.225319e-2 + fY *
-        (-0.157565e-2 + fY *
-        (0.916281e-2 + fY *
-        (-0.2057706e-1 + fY *
-        (0.2635537e-1 + fY *
-        (-0.1647633e-1 + fY * 0.392377e-2)))))))));
-}
-
-static IMG_FLOAT VIDEO_SincFunc (IMG_FLOAT fInput, IMG_FLOAT fScale)
-{
-    IMG_FLOAT fX;
-    IMG_FLOAT fKaiser;
-
-    /* Kaiser window */
-    fX = fInput / (4.0f / 2.0f) - 1.0f;
-    fX = (IMG_FLOAT)IMG_SQRT(1.0f - fX * fX);
-    fKaiser = VIDEO_CalculateBessel0(2.0f * fX) / VIDEO_CalculateBessel0(2.0f);
-
-    /* Sinc function */
-    fX = 4.0f / 2.0f - fInput;
-    if (fX == 0) {
-        return fKaiser;
-    }
-
-    fX *= 0.9f * fScale * 3.1415926535897f;
-
-    return fKaiser * (IMG_FLOAT)(IMG_SIN(fX) / fX);
-}
-
-static void VIDEO_CalcCoefs_FromPitch (IMG_FLOAT	fPitch, IMG_UINT8 aui8Table[4][16])
-{
-    /* Based on sim code */
-    /* The function is symmetrical, so we only need to calculate the first half of the taps, and the middle value. */
-
-    IMG_FLOAT	fScale;
-    IMG_UINT32	ui32I, ui32Tap;
-    IMG_FLOAT	afTable[4][16];
-    IMG_INT32	i32Total;
-    IMG_FLOAT	fTotal;
-    IMG_INT32	i32MiddleTap, i32MiddleI;		/* Mirrored / middle Values for I and T */
-
-    if (fPitch < 1.0f) {
-        fScale = 1.0f;
-    } else {
-        fScale = 1.0f / fPitch;
-    }
-
-    for (ui32I = 0; ui32I < 16; ui32I++) {
-        for (ui32Tap = 0; ui32Tap < 4; ui32Tap++) {
-            afTable[ui32Tap][ui32I] = VIDEO_SincFunc(((IMG_FLOAT)ui32Tap) + ((IMG_FLOAT)ui32I) / 16.0f, fScale);
-        } 
-    }
-
-    for (ui32Tap = 0; ui32Tap < 2; ui32Tap++) {
-        for (ui32I = 0; ui32I < 16; ui32I++) {
-            /* Copy the table around the centre point */
-            i32MiddleTap = (3 - ui32Tap) + (16 - ui32I) / 16;
-            i32MiddleI = (16 - ui32I) & 15;
-            if ((IMG_UINT32)i32MiddleTap < 4) {
-                afTable[i32MiddleTap][i32MiddleI] = afTable[ui32Tap][ui32I];
-            }
-        }
-    }
-
-    /* The middle value */
-    afTable[2][0] = VIDEO_SincFunc(2.0f, fScale);
-	
-    /* Normalize this interpolation point, and convert to 2.6 format, truncating the result	*/
-    for (ui32I = 0; ui32I < 16; ui32I++) {
-        fTotal = 0.0f;
-        i32Total = 0;
-
-        for (ui32Tap = 0; ui32Tap < 4; ui32Tap++) {
-            fTotal += afTable[ui32Tap][ui32I];
-        }
-
-        for (ui32Tap = 0; ui32Tap < 4; ui32Tap++) {
-            aui8Table[ui32Tap][ui32I] = (IMG_UINT8)((afTable[ui32Tap][ui32I] * 64.0f) / fTotal);
-            i32Total += aui8Table[ui32Tap][ui32I];
-        }
-
-        if (ui32I <= 8) { /* normalize any floating point errors */
-            i32Total -= 64;
-            if (ui32I == 8) {
-                i32Total /= 2;
-            }
-            /* Subtract the error from the I Point in the first tap ( this will not get
-            mirrored, as it would go off the end). */
-            aui8Table[0][ui32I] = (IMG_UINT8)(aui8Table[0][ui32I] - (IMG_UINT8)i32Total); 
-        }
-    }
-
-    /* Copy the normalised table around the centre point */
-    for (ui32Tap = 0; ui32Tap < 2; ui32Tap++) {
-        for (ui32I = 0; ui32I < 16; ui32I++) {
-            i32MiddleTap = (3 - ui32Tap) + (16 - ui32I) / 16;
-            i32MiddleI = (16 - ui32I) & 15;
-            if ((IMG_UINT32)i32MiddleTap < 4) {
-                aui8Table[i32MiddleTap][i32MiddleI] = aui8Table[ui32Tap][ui32I];
-            }
-        }
-    }
-    return ;
-}
-#endif
-
 static void tng__setvideo_params(context_ENC_p ctx, IMG_UINT32 ui32StreamIndex)
 {
     context_ENC_mem *ps_mem = &(ctx->ctx_mem[ui32StreamIndex]);
@@ -2969,7 +2846,7 @@ static void tng__setvideo_params(context_ENC_p ctx, IMG_UINT32 ui32StreamIndex)
 
 #if INPUT_SCALER_SUPPORTED
     if (ctx->bEnableScaler) {
-        IMG_UINT8 sccCoeffs[4][16];
+        IMG_UINT8 sccCoeffs[TNG_SCALER_TAPS][TNG_SCALER_PHASES];
         IMG_UINT32 ui32PitchX, ui32PitchY;
         IMG_INT32 i32Phase, i32Tap;
 
@@ -3009,7 +2886,7 @@ static void tng__setvideo_params(context_ENC_p ctx, IMG_UINT32 ui32StreamIndex)
 
 
         // Coefficients
-        VIDEO_CalcCoefs_FromPitch(((IMG_FLOAT)ui32PitchX) / 4096.0f, sccCoeffs);
+        tng_scaler_coeff_lookup(ui32PitchX, sccCoeffs);
 
         for (i32Phase = 0; i32Phase < 4; i32Phase++) {
             psMtxEncContext->asHorScalerCoeffRegs[i32Phase] = 0;
@@ -3018,7 +2895,7 @@ static void tng__setvideo_params(context_ENC_p ctx, IMG_UINT32 ui32StreamIndex)
             }
         }
 
-        VIDEO_CalcCoefs_FromPitch(((IMG_FLOAT)ui32PitchY) / 4096.0f, sccCoeffs);
+        tng_scaler_coeff_lookup(ui32PitchY, sccCoeffs);
 
         for (i32Phase = 0; i32Phase < 4; i32Phase++) {
             psMtxEncContext->asVerScalerCoeffRegs[i32Phase] = 0;
@@ -3588,6 +3465,130 @@ static VAStatus tng__set_cmd_buf(context_ENC_p ctx, IMG_UINT32 __maybe_unused ui
     return vaStatus;
 }
 
+/*
+ * Encode pipeline mode: the coded buffer of every submitted frame is
+ * queued and handed back in order by tng_get_completed_codedbuf
+ */
+#define CODED_QUEUE_ID(ctx, i) \
+    ((ctx)->aui32CodedQueue[((ctx)->ui32CodedQueueHead + (i)) % TNG_CODED_QUEUE_SIZE])
+
+static psb_buffer_p tng__coded_queue_buf(context_ENC_p ctx, VABufferID id)
+{
+    object_buffer_p obj_buffer;
+
+    obj_buffer = (object_buffer_p) object_heap_lookup(&ctx->obj_context->driver_data->buffer_heap, id);
+    return obj_buffer ? obj_buffer->psb_buffer : NULL;
+}
+
+static IMG_UINT32 tng__get_pipeline_depth(context_ENC_p ctx)
+{
+    IMG_UINT32 depth = ctx->ui32PipelineDepth;
+
+    /* with B frames the oldest frame only completes once its following reference is submitted */
+    if (depth && ctx->sRCParams.ui16BFrames > 0 && depth < ctx->ui8SlotsInUse)
+        depth = ctx->ui8SlotsInUse;
+    if (depth > TNG_CODED_QUEUE_SIZE)
+        depth = TNG_CODED_QUEUE_SIZE;
+
+    return depth;
+}
+
+/* Wait until submitting one more frame keeps at most "depth" frames encoding */
+static void tng__coded_queue_throttle(context_ENC_p ctx)
+{
+    VABufferID id = VA_INVALID_ID;
+    IMG_UINT32 depth;
+    psb_buffer_p buf;
+
+    pthread_mutex_lock(&ctx->coded_queue_mutex);
+    depth = tng__get_pipeline_depth(ctx);
+    if (depth && ctx->ui32CodedQueueCount >= depth)
+        id = CODED_QUEUE_ID(ctx, ctx->ui32CodedQueueCount - depth);
+    pthread_mutex_unlock(&ctx->coded_queue_mutex);
+
+    if (id == VA_INVALID_ID)
+        return;
+
+    buf = tng__coded_queue_buf(ctx, id);
+    if (buf)
+        psb_buffer_wait_idle(buf);
+}
+
+static void tng__coded_queue_push(context_ENC_p ctx, object_buffer_p coded_buf)
+{
+    if (coded_buf == NULL)
+        return;
+
+    pthread_mutex_lock(&ctx->coded_queue_mutex);
+    if (ctx->ui32PipelineDepth) {
+        if (ctx->ui32CodedQueueCount == TNG_CODED_QUEUE_SIZE) {
+            /* clients that never call psb_GetCompletedCodedBuffer end up here every frame */
+            if (ctx->ui32CodedQueueDrops++ == 0)
+                drv_debug_msg(VIDEO_DEBUG_ERROR, "coded buffer queue full, dropping oldest entries\n");
+            drv_debug_msg(VIDEO_DEBUG_GENERAL, "coded buffer queue full, dropping 0x%08x\n",
+                CODED_QUEUE_ID(ctx, 0));
+            ctx->ui32CodedQueueHead = (ctx->ui32CodedQueueHead + 1) % TNG_CODED_QUEUE_SIZE;
+            --(ctx->ui32CodedQueueCount);
+        }
+        CODED_QUEUE_ID(ctx, ctx->ui32CodedQueueCount) = coded_buf->base.id;
+        ++(ctx->ui32CodedQueueCount);
+    }
+    pthread_mutex_unlock(&ctx->coded_queue_mutex);
+}
+
+VAStatus tng_set_pipeline_depth(object_context_p obj_context, unsigned int depth)
+{
+    context_ENC_p ctx = (context_ENC_p) obj_context->format_data;
+
+    if (depth > TNG_CODED_QUEUE_SIZE)
+        return VA_STATUS_ERROR_INVALID_PARAMETER;
+
+    pthread_mutex_lock(&ctx->coded_queue_mutex);
+    ctx->ui32PipelineDepth = depth;
+    if (depth == 0) {
+        ctx->ui32CodedQueueHead = 0;
+        ctx->ui32CodedQueueCount = 0;
+    }
+    pthread_mutex_unlock(&ctx->coded_queue_mutex);
+
+    return VA_STATUS_SUCCESS;
+}
+
+VAStatus tng_get_completed_codedbuf(object_context_p obj_context, VABufferID *coded_buf, int wait)
+{
+    context_ENC_p ctx = (context_ENC_p) obj_context->format_data;
+    VABufferID id = VA_INVALID_ID;
+    psb_buffer_p buf;
+
+    *coded_buf = VA_INVALID_ID;
+
+    pthread_mutex_lock(&ctx->coded_queue_mutex);
+    if (ctx->ui32CodedQueueCount)
+        id = CODED_QUEUE_ID(ctx, 0);
+    pthread_mutex_unlock(&ctx->coded_queue_mutex);
+
+    if (id == VA_INVALID_ID)
+        return VA_STATUS_SUCCESS;
+
+    /* wait outside the lock so that EndPicture can keep queueing */
+    buf = tng__coded_queue_buf(ctx, id);
+    if (buf && psb_buffer_is_busy(buf)) {
+        if (!wait)
+            return VA_STATUS_ERROR_SURFACE_BUSY;
+        psb_buffer_wait_idle(buf);
+    }
+
+    pthread_mutex_lock(&ctx->coded_queue_mutex);
+    if (ctx->ui32CodedQueueCount && CODED_QUEUE_ID(ctx, 0) == id) {
+        ctx->ui32CodedQueueHead = (ctx->ui32CodedQueueHead + 1) % TNG_CODED_QUEUE_SIZE;
+        --(ctx->ui32CodedQueueCount);
+    }
+    pthread_mutex_unlock(&ctx->coded_queue_mutex);
+
+    *coded_buf = id;
+    return VA_STATUS_SUCCESS;
+}
+
 VAStatus tng__end_one_frame(context_ENC_p ctx, IMG_UINT32 ui32StreamID)
 {
     VAStatus vaStatus = VA_STATUS_SUCCESS;
@@ -3711,8 +3712,13 @@ VAStatus tng_EndPicture(context_ENC_p ctx)
        drv_debug_msg(VIDEO_DEBUG_ERROR, "setting when one frame ends\n");
     }
 
+    /* the next frame was prepared while the previous ones encode */
+    tng__coded_queue_throttle(ctx);
+
     if (tng_context_flush_cmdbuf(ctx->obj_context)) {
         vaStatus = VA_STATUS_ERROR_UNKNOWN;
+    } else {
+        tng__coded_queue_push(ctx, ctx->ctx_frame_buf.coded_buf);
     }
 
 
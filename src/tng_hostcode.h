@@ -40,6 +40,7 @@
 #include "tng_hostheader.h"
 #include "tng_jpegES.h"
 #include "tng_slotorder.h"
+#include "psb_coded_queue.h"
 
 #define tng__max(a, b) ((a)> (b)) ? (a) : (b)
 #define tng__min(a, b) ((a) < (b)) ? (a) : (b)
@@ -58,6 +59,7 @@
 #define COMM_CMD_CODED_BUF_NUM     (4)
 #define COMM_CMD_FRAME_BUF_NUM     (16)
 #define COMM_CMD_PICMGMT_BUF_NUM (4)
+#define TNG_CODED_QUEUE_SIZE     PSB_CODED_QUEUE_SIZE
 
 /**************** command buffer count ****************/    
 typedef struct context_ENC_cmdbuf_s {
@@ -230,6 +232,7 @@ typedef struct _H264_PICMGMT_UP_PARAMS {
 typedef struct
 {
     IMG_INT8   *pi8AIR_Table;
+    IMG_UINT32 *pui32SAD_Table;     //!< per-MB SADs gathered from the first pass output
     IMG_INT32   i32NumAIRSPerFrame;
     IMG_INT16   i16AIRSkipCnt;
     IMG_UINT16  ui16AIRScanPos;
@@ -474,6 +477,14 @@ struct context_ENC_s {
     /* qp/maxqp/minqp/bitrate/intra_period */
     uint32_t rc_update_flag;
     IMG_UINT16 max_qp;
+
+    /* Encode pipeline: coded buffers submitted but not handed back yet */
+    pthread_mutex_t coded_queue_mutex;
+    VABufferID aui32CodedQueue[TNG_CODED_QUEUE_SIZE];
+    IMG_UINT32 ui32CodedQueueHead;
+    IMG_UINT32 ui32CodedQueueCount;
+    IMG_UINT32 ui32PipelineDepth;                       // 0: pipeline mode off
+    IMG_UINT32 ui32CodedQueueDrops;                     // buffers never collected by the client
 };
 
 typedef struct context_ENC_s *context_ENC_p;
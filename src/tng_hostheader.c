@@ -181,65 +181,73 @@ static void tng_print(unsigned char *ptmp, int num)
  * Low level bit writing and ue, se functions
  * HOST CODE
  */
-static void tng__write_upto8bits_elements(
+
+/* Raw data elements hold at most this many bits before a new one is chained */
+#define ELEMENT_MAX_RAWBITS     120
+
+static void tng__write_bits_elements(
     MTX_HEADER_PARAMS *pMTX_Header,
     MTX_HEADER_ELEMENT **aui32ElementPointers,
-    IMG_UINT8 ui8WriteBits,
-    IMG_UINT16 ui16BitCnt)
+    IMG_UINT64 ui64WriteBits,
+    IMG_UINT32 ui32BitCnt)
 {
-    // This is the core function to write bits/bytes to a header stream, it writes them directly to ELEMENT structures.
+    // This is the core function to write bits to a header stream, it writes them directly to ELEMENT structures.
+    // The bits are written MSB first, as many as fit in the current element per pass.
+    MTX_HEADER_ELEMENT *psElement;
     IMG_UINT8 *pui8WriteBytes;
-    IMG_UINT8 *pui8SizeBits;
-    union {
-        IMG_UINT32 UI16Input;
-        IMG_UINT8 UI8Input[2];
-    } InputVal;
-    IMG_UINT8 ui8OutByteIndex;
-    IMG_INT16 i16Shift;
-    if (ui16BitCnt==0)
-        return ;
-
-//    drv_debug_msg(VIDEO_DEBUG_GENERAL, "%s: mtx_hdr->ui32Elments overflow (%d)\n", __FUNCTION__, pMTX_Header->ui32Elements);
-    /* WA for klockwork */
+    IMG_UINT32 ui32Size, ui32Used, ui32Cnt, ui32Total, ui32Bytes, i;
+    IMG_UINT64 ui64Acc;
+
+    while (ui32BitCnt) {
+        psElement = aui32ElementPointers[pMTX_Header->ui32Elements];
+        pui8WriteBytes = &psElement->aui8Bits;
+        ui32Size = psElement->ui8Size;
 
-//    if (pMTX_Header->ui32Elements >= MAXNUMBERELEMENTS) {
-//        drv_debug_msg(VIDEO_DEBUG_ERROR, "%s: mtx_hdr->ui32Elments overflow (%d)\n", __FUNCTION__, pMTX_Header->ui32Elements);
-//        return;
-//    }
-    // First ensure that unused bits  in ui8WriteBits are zeroed
-    ui8WriteBits &= (0x00ff >> (8 - ui16BitCnt));
-    InputVal.UI16Input=0;
-    pui8SizeBits=&(aui32ElementPointers[pMTX_Header->ui32Elements]->ui8Size); //Pointer to the bit count field
-    pui8WriteBytes=&(aui32ElementPointers[pMTX_Header->ui32Elements]->aui8Bits); //Pointer to the space where header bits are to be written
-    ui8OutByteIndex=(pui8SizeBits[0] / 8);
-    if (!(pui8SizeBits[0]&7)) {
-        if (pui8SizeBits[0]>=120) {
+        if (ui32Size >= ELEMENT_MAX_RAWBITS) {
             //Element maximum bits send to element, time to start a new one
             pMTX_Header->ui32Elements++; // Increment element index
-            aui32ElementPointers[pMTX_Header->ui32Elements]=(MTX_HEADER_ELEMENT *) &pui8WriteBytes[15]; //Element pointer set to position of next element (120/8 = 15 bytes)
-            aui32ElementPointers[pMTX_Header->ui32Elements]->Element_Type=ELEMENT_RAWDATA; //Write ELEMENT_TYPE
-            aui32ElementPointers[pMTX_Header->ui32Elements]->ui8Size=0; // Set new element size (bits) to zero
-            tng__write_upto8bits_elements(pMTX_Header,aui32ElementPointers, ui8WriteBits, ui16BitCnt); // Begin writing to the new element
-        return ;//(IMG_UINT32) ui16BitCnt;
+            psElement = (MTX_HEADER_ELEMENT *) &pui8WriteBytes[ELEMENT_MAX_RAWBITS / 8]; //Element pointer set to position of next element
+            psElement->Element_Type = ELEMENT_RAWDATA; //Write ELEMENT_TYPE
+            psElement->ui8Size = 0; // Set new element size (bits) to zero
+            aui32ElementPointers[pMTX_Header->ui32Elements] = psElement;
+            continue;
         }
-        pui8WriteBytes[ui8OutByteIndex]=0; // Beginning a new byte, clear byte
-    }
-    i16Shift=(IMG_INT16) ((8-ui16BitCnt)-(pui8SizeBits[0]&7));
-    if (i16Shift>=0) {
-        ui8WriteBits <<= i16Shift;
-        pui8WriteBytes[ui8OutByteIndex]|=ui8WriteBits;
-        pui8SizeBits[0]=pui8SizeBits[0]+ui16BitCnt;
-    } else {
-        InputVal.UI8Input[1]=(IMG_UINT8) ui8WriteBits+256;
-        InputVal.UI16Input >>= -i16Shift;
-        pui8WriteBytes[ui8OutByteIndex]|=InputVal.UI8Input[1];
-
-        pui8SizeBits[0]=pui8SizeBits[0]+ui16BitCnt;
-        pui8SizeBits[0]=pui8SizeBits[0]-((IMG_UINT8) -i16Shift);
-        InputVal.UI8Input[0]=InputVal.UI8Input[0] >> (8+i16Shift);
-        tng__write_upto8bits_elements(pMTX_Header, aui32ElementPointers, InputVal.UI8Input[0],(IMG_UINT16) -i16Shift);
+
+        // At most 7 bits already used in the current byte, keep the accumulator within 64 bits
+        ui32Cnt = ui32BitCnt;
+        if (ui32Cnt > ELEMENT_MAX_RAWBITS - ui32Size)
+            ui32Cnt = ELEMENT_MAX_RAWBITS - ui32Size;
+        if (ui32Cnt > 56)
+            ui32Cnt = 56;
+
+        ui32Used = ui32Size & 7;
+        ui32Total = ui32Used + ui32Cnt;
+        ui32Bytes = (ui32Total + 7) / 8;
+        ui64Acc = (ui64WriteBits >> (ui32BitCnt - ui32Cnt)) & ((1ULL << ui32Cnt) - 1);
+        ui64Acc <<= ui32Bytes * 8 - ui32Total;
+
+        pui8WriteBytes += ui32Size / 8;
+        for (i = ui32Bytes - 1; i > 0; i--) {
+            pui8WriteBytes[i] = (IMG_UINT8) ui64Acc;
+            ui64Acc >>= 8;
+        }
+        if (ui32Used)
+            pui8WriteBytes[0] |= (IMG_UINT8) ui64Acc;
+        else
+            pui8WriteBytes[0] = (IMG_UINT8) ui64Acc; // Beginning a new byte
+
+        psElement->ui8Size = (IMG_UINT8)(ui32Size + ui32Cnt);
+        ui32BitCnt -= ui32Cnt;
     }
-    return ;//(IMG_UINT32) ui16BitCnt;
+}
+
+static void tng__write_upto8bits_elements(
+    MTX_HEADER_PARAMS *pMTX_Header,
+    MTX_HEADER_ELEMENT **aui32ElementPointers,
+    IMG_UINT8 ui8WriteBits,
+    IMG_UINT16 ui16BitCnt)
+{
+    tng__write_bits_elements(pMTX_Header, aui32ElementPointers, ui8WriteBits, ui16BitCnt);
 }
 
 static void tng__write_upto32bits_elements(
@@ -248,25 +256,7 @@ static void tng__write_upto32bits_elements(
     IMG_UINT32 ui32WriteBits,
     IMG_UINT32 ui32BitCnt)
 {
-    IMG_UINT32 ui32BitLp;
-    IMG_UINT32 ui32EndByte;
-    IMG_UINT8 ui8Bytes[4];
-    drv_debug_msg(VIDEO_DEBUG_GENERAL, "WBS(32) bits %x, cnt = %d\n", ui32WriteBits, ui32BitCnt);
-    for (ui32BitLp=0; ui32BitLp<4; ui32BitLp++) {
-        ui8Bytes[ui32BitLp]=(IMG_UINT8) (ui32WriteBits & 255);
-        ui32WriteBits = ui32WriteBits >> 8;
-    }
-
-    ui32EndByte=((ui32BitCnt+7)/8);
-    if ((ui32BitCnt)%8)
-        tng__write_upto8bits_elements(pMTX_Header, aui32ElementPointers, ui8Bytes[ui32EndByte-1], (IMG_UINT8) ((ui32BitCnt)%8));
-    else
-        tng__write_upto8bits_elements(pMTX_Header, aui32ElementPointers, ui8Bytes[ui32EndByte-1], 8);
-    if (ui32EndByte>1)
-        for (ui32BitLp=ui32EndByte-1; ui32BitLp>0; ui32BitLp--) {
-            tng__write_upto8bits_elements(pMTX_Header, aui32ElementPointers, ui8Bytes[ui32BitLp-1], 8);
-        }
-    return ;//ui32BitCnt;
+    tng__write_bits_elements(pMTX_Header, aui32ElementPointers, ui32WriteBits, ui32BitCnt);
 }
 
 static void tng__generate_ue(
@@ -274,29 +264,16 @@ static void tng__generate_ue(
     MTX_HEADER_ELEMENT **aui32ElementPointers,
     IMG_UINT32 uiVal)
 {
-    IMG_UINT32 uiLp;
-    IMG_UINT8 ucZeros;
-    IMG_UINT32 uiChunk;
-
-    for (uiLp=1, ucZeros=0;  (uiLp-1) < uiVal ; uiLp=uiLp+uiLp, ucZeros++)
-        uiVal=uiVal-uiLp;
-    // ucZeros = number of preceding zeros required
-    // uiVal = value to append after zeros and 1 bit
-    //** Write preceding zeros
-    for (uiLp=(IMG_UINT32) ucZeros; uiLp+1>8; uiLp-=8)
-        tng__write_upto8bits_elements(pMTX_Header, aui32ElementPointers, 0, 8);
-    //** Write zeros and 1 bit set
-    tng__write_upto8bits_elements(pMTX_Header, aui32ElementPointers, (IMG_UINT8) 1, (IMG_UINT8) (uiLp+1));
-    //** Write Numeric part
-    while (ucZeros>8) {
-        ucZeros-=8;
-        uiChunk=(uiVal >> ucZeros);
-        tng__write_upto8bits_elements(pMTX_Header, aui32ElementPointers, (IMG_UINT8) uiChunk, 8);
-        uiVal=uiVal-(uiChunk << ucZeros);
-    }
-    tng__write_upto8bits_elements(pMTX_Header, aui32ElementPointers, (IMG_UINT8) uiVal, ucZeros);
+    // ue(v) is codeNum + 1 in binary, preceded by one zero less than its bit length
+    IMG_UINT64 ui64Code = (IMG_UINT64) uiVal + 1;
+    IMG_UINT32 ui32Zeros = 63 - __builtin_clzll(ui64Code);
 
-    return ;//ui32BitCnter;
+    if (ui32Zeros >= 32) {
+        tng__write_bits_elements(pMTX_Header, aui32ElementPointers, 0, ui32Zeros);
+        tng__write_bits_elements(pMTX_Header, aui32ElementPointers, ui64Code, ui32Zeros + 1);
+    } else {
+        tng__write_bits_elements(pMTX_Header, aui32ElementPointers, ui64Code, 2 * ui32Zeros + 1);
+    }
 }
 
 static void tng__generate_se(
@@ -129,6 +129,41 @@ typedef struct
 } vlc_table_stats_jpeg; // VLCTableStatsJPEG
 
 
+/*
+******************************************************************************
+
+ The parts of a Huffman table buffer the compiled VLC tables depend on
+
+******************************************************************************/
+typedef struct
+{
+    uint8_t num_dc_codes[16];
+    uint8_t dc_values[12];
+    uint8_t num_ac_codes[16];
+    uint8_t ac_values[162];
+
+} huffman_key_jpeg;
+
+#define JPEG_HUFFMAN_CACHE_SIZE 4
+
+/*
+******************************************************************************
+
+ Compiled VLC tables of one set of Huffman tables, kept so that streams
+ repeating the same DHT segment every frame (MJPEG) skip the compile
+
+******************************************************************************/
+typedef struct
+{
+    uint32_t hash;
+    uint32_t last_use;                  /* 0 if the entry is empty */
+    huffman_key_jpeg key[JPEG_MAX_SETS_HUFFMAN_TABLES];
+    struct psb_buffer_s vlc_packed_table;
+    vlc_table_stats_jpeg table_stats[TABLE_CLASS_NUM][JPEG_MAX_SETS_HUFFMAN_TABLES];
+
+} huffman_cache_jpeg;
+
+
 /**************************************/
 /* JPEG VLC Table defines and OpCodes */
 
@@ -186,8 +221,12 @@ struct context_JPEG_s {
     uint8_t max_scalingH;
     uint8_t max_scalingV;
 
-    /* VLC packed data */
-    struct psb_buffer_s vlc_packed_table;
+    /* VLC packed data, one buffer per cached set of compiled Huffman tables */
+    huffman_cache_jpeg huffman_cache[JPEG_HUFFMAN_CACHE_SIZE];
+    huffman_cache_jpeg *huffman_current;
+    uint32_t huffman_cache_clock;
+    uint32_t huffman_cache_hits;
+    uint32_t huffman_cache_misses;
 
     uint32_t vlctable_buffer_size;
     uint32_t rendec_qmatrix[JPEG_MAX_QUANT_TABLES][16];
@@ -275,6 +314,7 @@ static VAStatus tng_JPEG_CreateContext(
     object_config_p obj_config) {
     VAStatus vaStatus = VA_STATUS_SUCCESS;
     context_JPEG_p ctx;
+    int i;
 
     /* Validate flag */
     /* Validate picture dimensions */
@@ -312,13 +352,14 @@ static VAStatus tng_JPEG_CreateContext(
     }
 
     ctx->vlctable_buffer_size = 1984 * 2;
-    if (vaStatus == VA_STATUS_SUCCESS) {
+    for (i = 0; (i < JPEG_HUFFMAN_CACHE_SIZE) && (vaStatus == VA_STATUS_SUCCESS); i++) {
         vaStatus = psb_buffer_create(obj_context->driver_data,
                                      ctx->vlctable_buffer_size,
                                      psb_bt_cpu_vpu,
-                                     &ctx->vlc_packed_table);
+                                     &ctx->huffman_cache[i].vlc_packed_table);
         DEBUG_FAILURE;
     }
+    ctx->huffman_current = &ctx->huffman_cache[0];
 
     if (vaStatus == VA_STATUS_SUCCESS) {
         vaStatus = vld_dec_CreateContext(&ctx->dec_ctx, obj_context);
@@ -339,7 +380,10 @@ static void tng_JPEG_DestroyContext(
 
     vld_dec_DestroyContext(&ctx->dec_ctx);
 
-    psb_buffer_destroy(&ctx->vlc_packed_table);
+    drv_debug_msg(VIDEO_DEBUG_GENERAL, "JPEG: Huffman table cache %d hits, %d misses\n",
+                  ctx->huffman_cache_hits, ctx->huffman_cache_misses);
+    for (i = 0; i < JPEG_HUFFMAN_CACHE_SIZE; i++)
+        psb_buffer_destroy(&ctx->huffman_cache[i].vlc_packed_table);
 
     if (ctx->pic_params) {
         free(ctx->pic_params);
@@ -534,11 +578,12 @@ static void JPG_VLC_CompileTable(
     IMG_ASSERT( ptable_stats->size <= ram_size );
 }
 
-static void compile_huffman_tables(context_JPEG_p ctx) {
+static VAStatus compile_huffman_tables(context_JPEG_p ctx, huffman_cache_jpeg *entry) {
     VAStatus vaStatus = VA_STATUS_SUCCESS;
     ctx->huffman_table_space = 1984;
 
-    if (0 == psb_buffer_map(&ctx->vlc_packed_table, (unsigned char **)&ctx->huffman_table_RAM)) {
+    memset(entry->table_stats, 0, sizeof(entry->table_stats));
+    if (0 == psb_buffer_map(&entry->vlc_packed_table, (unsigned char **)&ctx->huffman_table_RAM)) {
         // Compile Tables
         uint32_t table_class;
         uint32_t table_id;
@@ -547,19 +592,38 @@ static void compile_huffman_tables(context_JPEG_p ctx) {
                 if (ctx->symbol_stats[table_class][table_id].num_codes) {
                     JPG_VLC_CompileTable(ctx->symbol_codes[table_class][table_id],
                         &ctx->symbol_stats[table_class][table_id], ctx->huffman_table_space, ctx->huffman_table_RAM,
-                        &ctx->table_stats[table_class][table_id]);
-                    ctx->huffman_table_space -= ctx->table_stats[table_class][table_id].size;
-                    ctx->huffman_table_RAM += ctx->table_stats[table_class][table_id].size;
+                        &entry->table_stats[table_class][table_id]);
+                    ctx->huffman_table_space -= entry->table_stats[table_class][table_id].size;
+                    ctx->huffman_table_RAM += entry->table_stats[table_class][table_id].size;
                 }
 
             }
         }
-        psb_buffer_unmap(&ctx->vlc_packed_table);
+        psb_buffer_unmap(&entry->vlc_packed_table);
     } else {
         vaStatus = VA_STATUS_ERROR_ALLOCATION_FAILED;
         DEBUG_FAILURE;
     }
 
+    return vaStatus;
+}
+
+/* FNV-1a, only used to cheaply reject cache entries before the full compare */
+static uint32_t tng__JPEG_hash_huffman_key(const huffman_key_jpeg *key, uint32_t size) {
+    const uint8_t *data = (const uint8_t *) key;
+    uint32_t hash = 2166136261u;
+
+    while (size--) {
+        hash ^= *data++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static void tng__JPEG_select_huffman_tables(context_JPEG_p ctx, huffman_cache_jpeg *entry) {
+    entry->last_use = ++ctx->huffman_cache_clock;
+    ctx->huffman_current = entry;
+    memcpy(ctx->table_stats, entry->table_stats, sizeof(ctx->table_stats));
 }
 
 static VAStatus tng__JPEG_process_picture_param(context_JPEG_p ctx, object_buffer_p obj_buffer) {
@@ -667,7 +731,7 @@ static void tng__JPEG_write_huffman_tables(context_JPEG_p ctx) {
 
     // VLC Table
     // Write a LLDMA Cmd to transfer VLD Table data
-    psb_cmdbuf_dma_write_cmdbuf(cmdbuf, &ctx->vlc_packed_table, 0,
+    psb_cmdbuf_dma_write_cmdbuf(cmdbuf, &ctx->huffman_current->vlc_packed_table, 0,
                                   ctx->vlctable_buffer_size, 0,
                                   DMA_TYPE_VLC_TABLE);
 
@@ -725,7 +789,34 @@ static VAStatus tng__JPEG_process_huffman_tables(context_JPEG_p ctx, object_buff
     ASSERT(obj_buffer->num_elements == 1);
     ASSERT(obj_buffer->size == sizeof(VAHuffmanTableBufferJPEGBaseline));
 
+    VAStatus vaStatus;
+    huffman_key_jpeg key[JPEG_MAX_SETS_HUFFMAN_TABLES];
+    huffman_cache_jpeg *entry, *victim = &ctx->huffman_cache[0];
+    uint32_t hash;
     uint32_t table_id;
+    int i;
+
+    // Reuse the compiled tables if this set was seen recently
+    for (table_id = 0; table_id < JPEG_MAX_SETS_HUFFMAN_TABLES; table_id++) {
+        memcpy(key[table_id].num_dc_codes, huff->huffman_table[table_id].num_dc_codes, sizeof(key[table_id].num_dc_codes));
+        memcpy(key[table_id].dc_values, huff->huffman_table[table_id].dc_values, sizeof(key[table_id].dc_values));
+        memcpy(key[table_id].num_ac_codes, huff->huffman_table[table_id].num_ac_codes, sizeof(key[table_id].num_ac_codes));
+        memcpy(key[table_id].ac_values, huff->huffman_table[table_id].ac_values, sizeof(key[table_id].ac_values));
+    }
+    hash = tng__JPEG_hash_huffman_key(key, sizeof(key));
+
+    for (i = 0; i < JPEG_HUFFMAN_CACHE_SIZE; i++) {
+        entry = &ctx->huffman_cache[i];
+        if (entry->last_use && (entry->hash == hash) && !memcmp(entry->key, key, sizeof(key))) {
+            ctx->huffman_cache_hits++;
+            tng__JPEG_select_huffman_tables(ctx, entry);
+            return VA_STATUS_SUCCESS;
+        }
+        if (entry->last_use < victim->last_use)
+            victim = entry;
+    }
+    ctx->huffman_cache_misses++;
+
     for (table_id = 0; table_id < JPEG_MAX_SETS_HUFFMAN_TABLES; table_id++) {
         // Find out the number of entries in the table
         uint32_t table_entries = 0;
@@ -734,6 +825,7 @@ static VAStatus tng__JPEG_process_huffman_tables(context_JPEG_p ctx, object_buff
             table_entries += huff->huffman_table[table_id].num_dc_codes[bit_ind];
         }
 
+        free(ctx->symbol_codes[0][table_id]);
         ctx->symbol_codes[0][table_id] =(vlc_symbol_code_jpeg *)malloc(sizeof(vlc_symbol_code_jpeg) * table_entries);
         // Parse huffman code sizes
         uint32_t huff_ind = 0;
@@ -780,6 +872,7 @@ static VAStatus tng__JPEG_process_huffman_tables(context_JPEG_p ctx, object_buff
         }
 
         // Allocate memory for huffman table codes
+        free(ctx->symbol_codes[1][table_id]);
         ctx->symbol_codes[1][table_id] = (vlc_symbol_code_jpeg *)malloc(sizeof(vlc_symbol_code_jpeg) * table_entries);
 
         // Parse huffman code sizes
@@ -816,7 +909,14 @@ static VAStatus tng__JPEG_process_huffman_tables(context_JPEG_p ctx, object_buff
         ctx->symbol_stats[1][table_id].num_codes = table_entries;
     }
 
-    compile_huffman_tables(ctx);
+    victim->last_use = 0;
+    vaStatus = compile_huffman_tables(ctx, victim);
+    if (vaStatus != VA_STATUS_SUCCESS)
+        return vaStatus;
+
+    victim->hash = hash;
+    memcpy(victim->key, key, sizeof(key));
+    tng__JPEG_select_huffman_tables(ctx, victim);
 
     return VA_STATUS_SUCCESS;
 }
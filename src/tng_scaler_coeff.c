@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2011 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <math.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "tng_scaler_coeff.h"
+
+/* Direct-mapped memo of recent pitches; a stream normally uses one or two */
+#define SCALER_CACHE_SLOTS          32
+
+typedef struct {
+    IMG_UINT32 ui32Pitch;           /* 0: slot unused */
+    IMG_UINT8 aui8Table[TNG_SCALER_TAPS][TNG_SCALER_PHASES];
+} tng_scaler_cache_entry;
+
+static tng_scaler_cache_entry scaler_cache[SCALER_CACHE_SLOTS];
+static pthread_mutex_t scaler_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static float tng__scaler_bessel0(float fX)
+{
+    float fAX, fY;
+
+    fAX = (float)fabs(fX);
+
+    if (fAX < 3.75) {
+        fY = (float)(fX / 3.75);
+        fY *= fY;
+
+        return (float)(1.0 + fY *
+            (3.5156229 + fY *
+            (3.0899424 + fY *
+            (1.2067492 + fY *
+            (0.2659732 + fY *
+            (0.360768e-1 + fY * 0.45813e-2))))));
+    }
+
+    fY = (float)(3.75 / fAX);
+
+    return (float)((exp(fAX) / sqrt(fAX)) *
+        (0.39894228 + fY *
+        (0.1328592e-1 + fY *
+        (0.225319e-2 + fY *
+        (-0.157565e-2 + fY *
+        (0.916281e-2 + fY *
+        (-0.2057706e-1 + fY *
+        (0.2635537e-1 + fY *
+        (-0.1647633e-1 + fY * 0.392377e-2)))))))));
+}
+
+static float tng__scaler_sinc(float fInput, float fScale)
+{
+    float fX;
+    float fKaiser;
+
+    /* Kaiser window */
+    fX = fInput / (TNG_SCALER_TAPS / 2.0f) - 1.0f;
+    fX = (float)sqrt(1.0f - fX * fX);
+    fKaiser = tng__scaler_bessel0(2.0f * fX) / tng__scaler_bessel0(2.0f);
+
+    /* Sinc function */
+    fX = TNG_SCALER_TAPS / 2.0f - fInput;
+    if (fX == 0)
+        return fKaiser;
+
+    fX *= 0.9f * fScale * 3.1415926535897f;
+
+    return fKaiser * (float)(sin(fX) / fX);
+}
+
+/* Tap / phase mirrored around the centre point; the tap is out of range at the end */
+#define MIRROR_TAP(t, i)    ((IMG_INT32)(TNG_SCALER_TAPS - 1 - (t)) + (IMG_INT32)(TNG_SCALER_PHASES - (i)) / TNG_SCALER_PHASES)
+#define MIRROR_PHASE(i)     ((TNG_SCALER_PHASES - (i)) & (TNG_SCALER_PHASES - 1))
+
+static void tng__scaler_calc_coeff(IMG_UINT32 ui32Pitch,
+                                   IMG_UINT8 aui8Table[TNG_SCALER_TAPS][TNG_SCALER_PHASES])
+{
+    float fPitch = (float)ui32Pitch / (1 << TNG_SCALER_PITCH_SHIFT);
+    float afTable[TNG_SCALER_TAPS][TNG_SCALER_PHASES];
+    float fScale, fTotal;
+    IMG_UINT32 ui32I, ui32Tap;
+    IMG_INT32 i32Total, i32MiddleTap;
+
+    /* Upscaling keeps the full bandwidth */
+    fScale = (fPitch < 1.0f) ? 1.0f : 1.0f / fPitch;
+
+    /* The function is symmetrical: only the first half of the taps and the middle value are needed */
+    for (ui32I = 0; ui32I < TNG_SCALER_PHASES; ui32I++)
+        for (ui32Tap = 0; ui32Tap < TNG_SCALER_TAPS; ui32Tap++)
+            afTable[ui32Tap][ui32I] = tng__scaler_sinc((float)ui32Tap + (float)ui32I / TNG_SCALER_PHASES, fScale);
+
+    for (ui32Tap = 0; ui32Tap < TNG_SCALER_TAPS / 2; ui32Tap++) {
+        for (ui32I = 0; ui32I < TNG_SCALER_PHASES; ui32I++) {
+            i32MiddleTap = MIRROR_TAP(ui32Tap, ui32I);
+            if ((IMG_UINT32)i32MiddleTap < TNG_SCALER_TAPS)
+                afTable[i32MiddleTap][MIRROR_PHASE(ui32I)] = afTable[ui32Tap][ui32I];
+        }
+    }
+    afTable[TNG_SCALER_TAPS / 2][0] = tng__scaler_sinc(TNG_SCALER_TAPS / 2.0f, fScale);
+
+    /* Normalize each interpolation point and truncate to 2.6 format */
+    for (ui32I = 0; ui32I < TNG_SCALER_PHASES; ui32I++) {
+        fTotal = 0.0f;
+        i32Total = 0;
+
+        for (ui32Tap = 0; ui32Tap < TNG_SCALER_TAPS; ui32Tap++)
+            fTotal += afTable[ui32Tap][ui32I];
+
+        for (ui32Tap = 0; ui32Tap < TNG_SCALER_TAPS; ui32Tap++) {
+            /* outer taps go negative; keep their two's complement byte */
+            aui8Table[ui32Tap][ui32I] = (IMG_UINT8)(IMG_INT32)((afTable[ui32Tap][ui32I] * 64.0f) / fTotal);
+            i32Total += aui8Table[ui32Tap][ui32I];
+        }
+
+        if (ui32I <= TNG_SCALER_PHASES / 2) {
+            /* Put the rounding error on the first tap, which is not mirrored */
+            i32Total -= 64;
+            if (ui32I == TNG_SCALER_PHASES / 2)
+                i32Total /= 2;
+            aui8Table[0][ui32I] = (IMG_UINT8)(aui8Table[0][ui32I] - (IMG_UINT8)i32Total);
+        }
+    }
+
+    /* Copy the normalised half around the centre point */
+    for (ui32Tap = 0; ui32Tap < TNG_SCALER_TAPS / 2; ui32Tap++) {
+        for (ui32I = 0; ui32I < TNG_SCALER_PHASES; ui32I++) {
+            i32MiddleTap = MIRROR_TAP(ui32Tap, ui32I);
+            if ((IMG_UINT32)i32MiddleTap < TNG_SCALER_TAPS)
+                aui8Table[i32MiddleTap][MIRROR_PHASE(ui32I)] = aui8Table[ui32Tap][ui32I];
+        }
+    }
+}
+
+void tng_scaler_coeff_lookup(IMG_UINT32 ui32Pitch,
+                             IMG_UINT8 aui8Table[TNG_SCALER_TAPS][TNG_SCALER_PHASES])
+{
+    tng_scaler_cache_entry *entry;
+
+    if (ui32Pitch == 0)
+        ui32Pitch = 1 << TNG_SCALER_PITCH_SHIFT;
+
+    entry = &scaler_cache[(ui32Pitch ^ (ui32Pitch >> 5)) % SCALER_CACHE_SLOTS];
+
+    pthread_mutex_lock(&scaler_cache_mutex);
+    if (entry->ui32Pitch != ui32Pitch) {
+        tng__scaler_calc_coeff(ui32Pitch, entry->aui8Table);
+        entry->ui32Pitch = ui32Pitch;
+    }
+    memcpy(aui8Table, entry->aui8Table, sizeof(entry->aui8Table));
+    pthread_mutex_unlock(&scaler_cache_mutex);
+}
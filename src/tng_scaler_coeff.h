@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2011 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _TNG_SCALER_COEFF_H_
+#define _TNG_SCALER_COEFF_H_
+
+#include "hwdefs/img_types.h"
+
+#define TNG_SCALER_TAPS             4
+#define TNG_SCALER_PHASES           16
+
+/* Scale pitches are handled in the same 4.12 format the scalers step in */
+#define TNG_SCALER_PITCH_SHIFT      12
+#define TNG_SCALER_PITCH(f)         ((IMG_UINT32)((f) * (1 << TNG_SCALER_PITCH_SHIFT) + 0.5f))
+
+/*
+ * Kaiser-windowed sinc polyphase coefficients in 2.6 format for a scale
+ * pitch (input / output size) in 4.12 format, shared by the MSVDX output
+ * scaler and the TopazHP input scaler.
+ *
+ * Tables are memoized per pitch, so repeated setup is a lookup.
+ */
+void tng_scaler_coeff_lookup(IMG_UINT32 ui32Pitch,
+                             IMG_UINT8 aui8Table[TNG_SCALER_TAPS][TNG_SCALER_PHASES]);
+
+#endif /* _TNG_SCALER_COEFF_H_ */
@@ -29,6 +29,7 @@
  */
 #include "tng_vld_dec.h"
 #include "psb_drv_debug.h"
+#include "psb_unpack.h"
 #include "hwdefs/dxva_fw_ctrl.h"
 #include "hwdefs/reg_io2.h"
 #include "hwdefs/msvdx_offsets.h"
@@ -41,6 +42,9 @@
 #define GET_SURFACE_INFO_colocated_index(psb_surface) ((int) (psb_surface->extra_info[3]))
 #define SET_SURFACE_INFO_colocated_index(psb_surface, val) psb_surface->extra_info[3] = (uint32_t) val;
 
+/* Fewer slices per worker than this are not worth waking a thread for */
+#define VLD_DEC_PREPARE_MIN_SLICES      4
+
 /* Set MSVDX Front end register */
 void vld_dec_FE_state(object_context_p obj_context, psb_buffer_p buf)
 {
@@ -193,11 +197,64 @@ int vld_dec_slice_parameter_size(object_context_p obj_context)
     return size;
 }
 
+static void vld_dec__prepare_slice_rows(void *arg, int row_start, int row_end)
+{
+    context_DEC_p ctx = (context_DEC_p)arg;
+    int i;
+
+    for (i = row_start; i < row_end; i++)
+        ctx->prepare_slice(ctx, ctx->slice_prep_params[i],
+                           ctx->slice_prep_list + i * ctx->slice_prep_size);
+}
+
+/*
+ * Runs prepare_slice for every queued slice param element, split across
+ * the driver worker pool
+ */
+static VAStatus vld_dec__prepare_slices(context_DEC_p ctx, unsigned int element_size)
+{
+    int buffer_idx, num_slices = 0;
+    unsigned int element_idx;
+
+    for (buffer_idx = 0; buffer_idx < ctx->slice_param_list_idx; buffer_idx++)
+        num_slices += ctx->slice_param_list[buffer_idx]->num_elements;
+
+    if (num_slices > ctx->slice_prep_list_size) {
+        unsigned char *new_list;
+        VASliceParameterBufferBase **new_params;
+
+        new_list = realloc(ctx->slice_prep_list, num_slices * ctx->slice_prep_size);
+        if (NULL == new_list)
+            return VA_STATUS_ERROR_ALLOCATION_FAILED;
+        ctx->slice_prep_list = new_list;
+
+        new_params = realloc(ctx->slice_prep_params, num_slices * sizeof(VASliceParameterBufferBase *));
+        if (NULL == new_params)
+            return VA_STATUS_ERROR_ALLOCATION_FAILED;
+        ctx->slice_prep_params = new_params;
+
+        ctx->slice_prep_list_size = num_slices;
+    }
+
+    num_slices = 0;
+    for (buffer_idx = 0; buffer_idx < ctx->slice_param_list_idx; buffer_idx++) {
+        object_buffer_p slice_buf = ctx->slice_param_list[buffer_idx];
+        for (element_idx = 0; element_idx < slice_buf->num_elements; element_idx++)
+            ctx->slice_prep_params[num_slices++] =
+                (VASliceParameterBufferBase *)((unsigned long)slice_buf->buffer_data + element_idx * element_size);
+    }
+
+    psb_parallel_rows(ctx->obj_context->driver_data->row_pool, vld_dec__prepare_slice_rows, ctx,
+                      num_slices, VLD_DEC_PREPARE_MIN_SLICES);
+
+    return VA_STATUS_SUCCESS;
+}
+
 VAStatus vld_dec_process_slice_data(context_DEC_p ctx, object_buffer_p obj_buffer)
 {
     VAStatus vaStatus = VA_STATUS_SUCCESS;
     void *slice_param;
-    int buffer_idx = 0;
+    int buffer_idx = 0, slice_idx = 0;
     unsigned int element_idx = 0, element_size;
 
     ASSERT((obj_buffer->type == VASliceDataBufferType) || (obj_buffer->type == VAProtectedSliceDataBufferType));
@@ -219,6 +276,15 @@ VAStatus vld_dec_process_slice_data(context_DEC_p ctx, object_buffer_p obj_buffe
 
     element_size = vld_dec_slice_parameter_size(ctx->obj_context);
 
+    if (ctx->prepare_slice) {
+        vaStatus = vld_dec__prepare_slices(ctx, element_size);
+        if (vaStatus != VA_STATUS_SUCCESS) {
+            DEBUG_FAILURE;
+            ctx->slice_param_list_idx = 0;
+            return vaStatus;
+        }
+    }
+
     while (buffer_idx < ctx->slice_param_list_idx) {
         object_buffer_p slice_buf = ctx->slice_param_list[buffer_idx];
         if (element_idx >= slice_buf->num_elements) {
@@ -231,6 +297,9 @@ VAStatus vld_dec_process_slice_data(context_DEC_p ctx, object_buffer_p obj_buffe
         slice_param = slice_buf->buffer_data;
         slice_param = (void *)((unsigned long)slice_param + element_idx * element_size);
         element_idx++;
+        if (ctx->prepare_slice)
+            ctx->slice_prep = ctx->slice_prep_list + slice_idx * ctx->slice_prep_size;
+        slice_idx++;
         vaStatus = vld_dec_process_slice(ctx, slice_param, obj_buffer);
         if (vaStatus != VA_STATUS_SUCCESS) {
             DEBUG_FAILURE;
@@ -238,6 +307,7 @@ VAStatus vld_dec_process_slice_data(context_DEC_p ctx, object_buffer_p obj_buffe
         }
     }
     ctx->slice_param_list_idx = 0;
+    ctx->slice_prep = NULL;
 
     return vaStatus;
 }
@@ -438,6 +508,12 @@ void vld_dec_DestroyContext(context_DEC_p ctx)
         ctx->slice_param_list = NULL;
     }
 
+    free(ctx->slice_prep_list);
+    ctx->slice_prep_list = NULL;
+    free(ctx->slice_prep_params);
+    ctx->slice_prep_params = NULL;
+    ctx->slice_prep_list_size = 0;
+
     if (ctx->colocated_buffers) {
         for (i = 0; i < ctx->colocated_buffers_idx; ++i)
             psb_buffer_destroy(&(ctx->colocated_buffers[i]));
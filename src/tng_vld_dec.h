@@ -58,6 +58,20 @@ struct context_DEC_s {
     unsigned int bits_offset;
     unsigned int SR_flags;
 
+    /*
+     * Optional: fills slice_prep_size bytes at prep from the slice and
+     * picture parameters without touching the cmdbuf. It is called for all
+     * slices of a slice data buffer, possibly on several threads at once,
+     * before the first begin_slice; slice_prep then points at the entry of
+     * the slice being built.
+     */
+    void (*prepare_slice)(struct context_DEC_s *, VASliceParameterBufferBase *, void *prep);
+    unsigned int slice_prep_size;
+    unsigned char *slice_prep_list;
+    VASliceParameterBufferBase **slice_prep_params;
+    int slice_prep_list_size;
+    void *slice_prep;
+
     void (*begin_slice)(struct context_DEC_s *, VASliceParameterBufferBase *);
     void (*process_slice)(struct context_DEC_s *, VASliceParameterBufferBase *);
     void (*end_slice)(struct context_DEC_s *);
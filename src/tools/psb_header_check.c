@@ -0,0 +1,278 @@
+/*
+ * Copyright (c) 2011 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Check the TopazHP header bit writer against golden element streams
+ * and time it.
+ *
+ *   psb_header_check [iterations]
+ *
+ * The golden streams were produced by the byte at a time writer that
+ * tng__write_bits_elements() replaced. Each is stored as, per element,
+ * the size in bits followed by the raw bytes. Returns nonzero on a
+ * mismatch and prints the stream that was produced.
+ */
+
+#include <stdlib.h>
+#include <time.h>
+
+/* the writers are static, build them into this program */
+#include "../tng_hostheader.c"
+
+/* the rest of the driver tng_hostheader.c refers to */
+void drv_debug_msg(DEBUG_LEVEL __maybe_unused debug_level, const char __maybe_unused *msg, ...)
+{
+}
+
+void tng_trace_seq_header_params(H264_SEQUENCE_HEADER_PARAMS __maybe_unused *psSHParams)
+{
+}
+
+void tng_trace_pic_header_params(H264_PICTURE_HEADER_PARAMS __maybe_unused *psSHParams)
+{
+}
+
+void tng_trace_slice_header_params(H264_SLICE_HEADER_PARAMS __maybe_unused *psSlHParams)
+{
+}
+
+#define CHECK_BUF_WORDS         (1 << 14)
+#define CHECK_MAX_ELEMENTS      1024
+#define CHECK_MIXED_OPS         4000
+
+typedef struct {
+    MTX_HEADER_PARAMS *hdr;
+    MTX_HEADER_ELEMENT *elt[CHECK_MAX_ELEMENTS];
+} check_stream_t;
+
+static IMG_UINT32 check_buf[CHECK_BUF_WORDS];
+
+static void stream_init(check_stream_t *s)
+{
+    memset(check_buf, 0xab, sizeof(check_buf));
+    s->hdr = (MTX_HEADER_PARAMS *) check_buf;
+    s->hdr->ui32Elements = 0;
+    s->elt[0] = (MTX_HEADER_ELEMENT *) s->hdr->asElementStream;
+    s->elt[0]->Element_Type = ELEMENT_RAWDATA;
+    s->elt[0]->ui8Size = 0;
+}
+
+/* size and bytes of every element, as the golden data is stored */
+static int stream_serialize(check_stream_t *s, unsigned char *out, int max)
+{
+    unsigned int i, bytes;
+    int len = 0;
+
+    for (i = 0; i <= s->hdr->ui32Elements; i++) {
+        bytes = (s->elt[i]->ui8Size + 7) / 8;
+        if (len + 1 + (int)bytes > max)
+            return -1;
+        out[len++] = s->elt[i]->ui8Size;
+        memcpy(out + len, &s->elt[i]->aui8Bits, bytes);
+        len += bytes;
+    }
+
+    return len;
+}
+
+/* u(n) for every n, starting misaligned */
+static void stream_u(check_stream_t *s)
+{
+    IMG_UINT32 n;
+
+    tng__write_upto8bits_elements(s->hdr, s->elt, 5, 3);
+    for (n = 1; n <= 32; n++)
+        tng__write_upto32bits_elements(s->hdr, s->elt, 0xa5c3e187u >> (32 - n), n);
+    tng__write_upto8bits_elements(s->hdr, s->elt, 1, 1);
+}
+
+static void stream_ue(check_stream_t *s)
+{
+    static const IMG_UINT32 values[] = {
+        255, 256, 1000, 65534, 65535, 65536, 1 << 20, 0x7fffffffu, 0x80000000u, 0xfffffffeu
+    };
+    IMG_UINT32 i;
+
+    for (i = 0; i <= 20; i++)
+        tng__generate_ue(s->hdr, s->elt, i);
+    for (i = 0; i < sizeof(values) / sizeof(values[0]); i++)
+        tng__generate_ue(s->hdr, s->elt, values[i]);
+}
+
+static void stream_se(check_stream_t *s)
+{
+    static const int values[] = {
+        127, -128, 32767, -32768, 1 << 20, -(1 << 20), (1 << 30) - 1, -(1 << 30)
+    };
+    unsigned int i;
+    int v;
+
+    for (v = -20; v <= 20; v++)
+        tng__generate_se(s->hdr, s->elt, v);
+    for (i = 0; i < sizeof(values) / sizeof(values[0]); i++)
+        tng__generate_se(s->hdr, s->elt, values[i]);
+}
+
+/* pseudo random mix of u(n), ue and se, like a slice header but longer */
+static void stream_mixed(check_stream_t *s)
+{
+    IMG_UINT32 seed = 1, v, n;
+    int i;
+
+    for (i = 0; i < CHECK_MIXED_OPS; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        v = seed >> 8;
+        switch (seed & 3) {
+        case 0:
+        case 1:
+            n = 1 + (seed >> 27);
+            tng__write_upto32bits_elements(s->hdr, s->elt, v & (0xffffffffu >> (32 - n)), n);
+            break;
+        case 2:
+            tng__generate_ue(s->hdr, s->elt, v >> (seed >> 28));
+            break;
+        default:
+            tng__generate_se(s->hdr, s->elt, (int)(v & 0xffff) - 0x8000);
+            break;
+        }
+    }
+}
+
+static const unsigned char golden_u[] = {
+    0x78, 0xba, 0xd5, 0x29, 0xa5, 0x4b, 0x4b, 0xa5, 0xe9, 0x75, 0x2e, 0x52,
+    0xe2, 0x97, 0x0a, 0x5c, 0x78, 0x34, 0xb8, 0x74, 0xb8, 0x7a, 0x5c, 0x3e,
+    0x97, 0x0f, 0xd2, 0xe1, 0xf5, 0x2e, 0x1f, 0x29, 0x78, 0x70, 0xf8, 0xa5,
+    0xc3, 0xe1, 0x4b, 0x87, 0xc3, 0x4b, 0x87, 0xc3, 0xa5, 0xc3, 0xe1, 0xa9,
+    0x78, 0x70, 0xf8, 0x65, 0x2e, 0x1f, 0x0c, 0x52, 0xe1, 0xf0, 0xc2, 0x97,
+    0x0f, 0x86, 0x1a, 0x5c, 0x34, 0x3e, 0x18, 0x74, 0xb8, 0x7c, 0x30, 0xf0
+};
+
+static const unsigned char golden_ue[] = {
+    0x78, 0xa6, 0x42, 0x98, 0xe2, 0x04, 0x8a, 0x16, 0x30, 0x68, 0xe1, 0xe1,
+    0x00, 0x88, 0x48, 0x26, 0x78, 0x14, 0x0a, 0x80, 0x40, 0x00, 0x20, 0x20,
+    0x0f, 0xa4, 0x00, 0x07, 0xff, 0xf8, 0x00, 0x04, 0x78, 0x00, 0x00, 0x00,
+    0x02, 0x00, 0x02, 0x00, 0x00, 0x10, 0x00, 0x01, 0x00, 0x00, 0x00, 0x01,
+    0x78, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00,
+    0x04, 0x00, 0x00, 0x00, 0x25, 0x07, 0xff, 0xff, 0xff, 0xf8
+};
+
+static const unsigned char golden_se[] = {
+    0x78, 0x05, 0x20, 0x9c, 0x12, 0x82, 0x30, 0x42, 0x1f, 0x0e, 0x86, 0xc3,
+    0x21, 0x70, 0xa8, 0x4c, 0x78, 0x22, 0x3c, 0x68, 0xb1, 0x27, 0x2b, 0xa2,
+    0x18, 0x40, 0xa1, 0x83, 0x82, 0x01, 0x20, 0xa0, 0x78, 0x58, 0x30, 0x1a,
+    0x0e, 0x07, 0x81, 0x00, 0x22, 0x04, 0x80, 0x98, 0x14, 0x00, 0xfe, 0x00,
+    0x78, 0x80, 0x80, 0x00, 0xff, 0xfe, 0x00, 0x00, 0x80, 0x00, 0x80, 0x00,
+    0x02, 0x00, 0x00, 0x00, 0x78, 0x00, 0x00, 0x40, 0x00, 0x02, 0x00, 0x00,
+    0x00, 0x07, 0xff, 0xff, 0xff, 0xe0, 0x00, 0x00, 0x2b, 0x00, 0x10, 0x00,
+    0x00, 0x00, 0x20
+};
+
+/* the mixed stream is checked by length and FNV-1a hash */
+#define GOLDEN_MIXED_LEN        12182
+#define GOLDEN_MIXED_HASH       0x92eef044u
+
+static unsigned int fnv1a(const unsigned char *p, int len)
+{
+    unsigned int h = 2166136261u;
+
+    while (len--)
+        h = (h ^ *p++) * 16777619u;
+    return h;
+}
+
+static void dump(const char *name, const unsigned char *p, int len)
+{
+    int i;
+
+    printf("%s: %d bytes", name, len);
+    for (i = 0; i < len; i++)
+        printf("%s0x%02x,", (i % 12) ? " " : "\n    ", p[i]);
+    printf("\n");
+}
+
+static unsigned char out[CHECK_BUF_WORDS * 4];
+
+static int check(const char *name, void (*build)(check_stream_t *),
+                 const unsigned char *golden, int golden_len)
+{
+    check_stream_t s;
+    int len;
+
+    stream_init(&s);
+    build(&s);
+    len = stream_serialize(&s, out, sizeof(out));
+    if (len == golden_len && memcmp(out, golden, len) == 0) {
+        printf("%-6s ok, %u elements\n", name, s.hdr->ui32Elements + 1);
+        return 0;
+    }
+
+    printf("%-6s MISMATCH\n", name);
+    dump(name, out, len);
+    return 1;
+}
+
+static double now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+int main(int argc, char *argv[])
+{
+    check_stream_t s;
+    int iterations = (argc > 1) ? atoi(argv[1]) : 2000;
+    int i, len, failed = 0;
+    unsigned int hash;
+    double start, ms;
+
+    failed += check("u", stream_u, golden_u, sizeof(golden_u));
+    failed += check("ue", stream_ue, golden_ue, sizeof(golden_ue));
+    failed += check("se", stream_se, golden_se, sizeof(golden_se));
+
+    stream_init(&s);
+    stream_mixed(&s);
+    len = stream_serialize(&s, out, sizeof(out));
+    hash = fnv1a(out, len);
+    if (len == GOLDEN_MIXED_LEN && hash == GOLDEN_MIXED_HASH) {
+        printf("%-6s ok, %u elements\n", "mixed", s.hdr->ui32Elements + 1);
+    } else {
+        printf("%-6s MISMATCH: %d bytes hash 0x%08x\n", "mixed", len, hash);
+        failed++;
+    }
+
+    if (iterations > 0) {
+        start = now_ms();
+        for (i = 0; i < iterations; i++) {
+            stream_init(&s);
+            stream_mixed(&s);
+        }
+        ms = now_ms() - start;
+        printf("%d x %d writes: %.3f ms, %.1f ns per write\n", iterations, CHECK_MIXED_OPS,
+               ms, ms * 1000000.0 / ((double)iterations * CHECK_MIXED_OPS));
+    }
+
+    return failed ? 1 : 0;
+}
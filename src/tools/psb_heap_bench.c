@@ -0,0 +1,259 @@
+/*
+ * Copyright (c) 2011 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+/*
+ * Check and time the object heap behind BUFFER()/SURFACE()/CONTEXT().
+ *
+ *   psb_heap_bench [objects] [threads]
+ *
+ * Checks that live IDs look up to their objects, that freed and stale
+ * IDs are rejected and that threads allocating, looking up and freeing
+ * on one heap never see each other's objects. Then times allocate,
+ * lookup and free, single threaded and with all threads at once.
+ * Returns nonzero when a check fails.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "../object_heap.h"
+
+#define BENCH_ID_OFFSET         0x04000000
+#define BENCH_LOOKUPS           16
+#define BENCH_ROUNDS            64
+
+struct bench_object_s {
+    struct object_base_s base;
+    int owner;
+    int serial;
+};
+
+typedef struct bench_object_s *bench_object_p;
+
+static struct object_heap_s heap;
+static int num_objects = 4096;
+static int num_threads = 4;
+
+static double now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+#define FAIL(...) do { printf("FAIL: " __VA_ARGS__); return 1; } while (0)
+
+static int check_single(void)
+{
+    int *ids = calloc(num_objects, sizeof(int));
+    int *stale = calloc(num_objects, sizeof(int));
+    object_heap_iterator iter;
+    object_base_p obj;
+    int i, live;
+
+    if (ids == NULL || stale == NULL)
+        FAIL("out of memory\n");
+
+    for (i = 0; i < num_objects; i++) {
+        ids[i] = object_heap_allocate(&heap);
+        if (ids[i] == -1)
+            FAIL("allocate %d\n", i);
+        ((bench_object_p) object_heap_lookup(&heap, ids[i]))->serial = i;
+    }
+
+    for (i = 0; i < num_objects; i++) {
+        obj = object_heap_lookup(&heap, ids[i]);
+        if (obj == NULL || obj->id != ids[i] || ((bench_object_p) obj)->serial != i)
+            FAIL("lookup of live id 0x%x\n", ids[i]);
+    }
+
+    if (object_heap_lookup(&heap, ids[0] ^ BENCH_ID_OFFSET) != NULL)
+        FAIL("lookup with a foreign offset\n");
+
+    /* free every other object, their IDs must go stale */
+    for (i = 0; i < num_objects; i += 2) {
+        object_heap_free(&heap, object_heap_lookup(&heap, ids[i]));
+        stale[i] = ids[i];
+        if (object_heap_lookup(&heap, stale[i]) != NULL)
+            FAIL("lookup of freed id 0x%x\n", stale[i]);
+    }
+
+    /* the slots are reused under new IDs, the old ones stay invalid */
+    for (i = 0; i < num_objects; i += 2) {
+        ids[i] = object_heap_allocate(&heap);
+        if (ids[i] == -1 || ids[i] == stale[i])
+            FAIL("reallocate %d\n", i);
+    }
+    for (i = 0; i < num_objects; i += 2)
+        if (object_heap_lookup(&heap, stale[i]) != NULL)
+            FAIL("lookup of stale id 0x%x\n", stale[i]);
+
+    /* suspended objects still look up, see object_heap_lookup */
+    obj = object_heap_lookup(&heap, ids[1]);
+    object_heap_suspend_object(obj, 1);
+    if (object_heap_lookup(&heap, ids[1]) != obj)
+        FAIL("lookup of suspended id 0x%x\n", ids[1]);
+    object_heap_suspend_object(obj, 0);
+
+    live = 0;
+    for (obj = object_heap_first(&heap, &iter); obj; obj = object_heap_next(&heap, &iter))
+        live++;
+    if (live != num_objects)
+        FAIL("iterated %d objects, expected %d\n", live, num_objects);
+
+    for (i = 0; i < num_objects; i++)
+        object_heap_free(&heap, object_heap_lookup(&heap, ids[i]));
+    if (object_heap_first(&heap, &iter) != NULL)
+        FAIL("heap not empty after freeing everything\n");
+
+    free(ids);
+    free(stale);
+    printf("single-thread checks ok, %d objects\n", num_objects);
+    return 0;
+}
+
+struct bench_thread_s {
+    pthread_t thread;
+    int owner;
+    int count;
+    int errors;
+    double alloc_ms, lookup_ms, free_ms;
+};
+
+/* allocate, look up in a scrambled order and free, BENCH_ROUNDS times */
+static void *bench_thread(void *arg)
+{
+    struct bench_thread_s *t = arg;
+    int *ids = calloc(t->count, sizeof(int));
+    unsigned int seed = t->owner + 1;
+    bench_object_p obj;
+    double start, t1, t2;
+    int round, i, j;
+
+    if (ids == NULL) {
+        t->errors++;
+        return NULL;
+    }
+
+    for (round = 0; round < BENCH_ROUNDS; round++) {
+        start = now_ms();
+        for (i = 0; i < t->count; i++) {
+            ids[i] = object_heap_allocate(&heap);
+            obj = (bench_object_p) object_heap_lookup(&heap, ids[i]);
+            if (obj == NULL) {
+                t->errors++;
+                continue;
+            }
+            obj->owner = t->owner;
+            obj->serial = i;
+        }
+
+        t1 = now_ms();
+        for (j = 0; j < t->count * BENCH_LOOKUPS; j++) {
+            seed = seed * 1664525u + 1013904223u;
+            i = (seed >> 8) % t->count;
+            obj = (bench_object_p) object_heap_lookup(&heap, ids[i]);
+            if (obj == NULL || obj->owner != t->owner || obj->serial != i)
+                t->errors++;
+        }
+
+        t2 = now_ms();
+        for (i = 0; i < t->count; i++)
+            object_heap_free(&heap, object_heap_lookup(&heap, ids[i]));
+
+        t->alloc_ms += t1 - start;
+        t->lookup_ms += t2 - t1;
+        t->free_ms += now_ms() - t2;
+    }
+
+    free(ids);
+    return NULL;
+}
+
+static int run_threads(int threads)
+{
+    struct bench_thread_s *t = calloc(threads, sizeof(*t));
+    double alloc_ms = 0, lookup_ms = 0, free_ms = 0, ops;
+    int i, errors = 0;
+
+    if (t == NULL)
+        FAIL("out of memory\n");
+
+    for (i = 0; i < threads; i++) {
+        t[i].owner = i;
+        t[i].count = num_objects / threads;
+        if (pthread_create(&t[i].thread, NULL, bench_thread, &t[i]))
+            FAIL("pthread_create\n");
+    }
+    for (i = 0; i < threads; i++) {
+        pthread_join(t[i].thread, NULL);
+        errors += t[i].errors;
+        alloc_ms += t[i].alloc_ms;
+        lookup_ms += t[i].lookup_ms;
+        free_ms += t[i].free_ms;
+    }
+
+    /* time per operation as seen by each thread, averaged over the threads */
+    ops = (double)BENCH_ROUNDS * (num_objects / threads) * threads;
+    printf("%d thread(s): allocate %.1f ns, lookup %.1f ns, free %.1f ns\n", threads,
+           alloc_ms * 1000000.0 / ops, lookup_ms * 1000000.0 / (ops * BENCH_LOOKUPS),
+           free_ms * 1000000.0 / ops);
+    free(t);
+
+    if (errors)
+        FAIL("%d wrong lookups with %d threads\n", errors, threads);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    int failed = 0;
+
+    if (argc > 1)
+        num_objects = atoi(argv[1]);
+    if (argc > 2)
+        num_threads = atoi(argv[2]);
+    if (num_objects < 2 || num_objects > OBJECT_HEAP_INDEX_MASK || num_threads < 1) {
+        fprintf(stderr, "usage: %s [objects] [threads]\n", argv[0]);
+        return 1;
+    }
+
+    if (object_heap_init(&heap, sizeof(struct bench_object_s), BENCH_ID_OFFSET)) {
+        fprintf(stderr, "object_heap_init failed\n");
+        return 1;
+    }
+
+    failed += check_single();
+    failed += run_threads(1);
+    if (num_threads > 1)
+        failed += run_threads(num_threads);
+
+    object_heap_destroy(&heap);
+    return failed ? 1 : 0;
+}
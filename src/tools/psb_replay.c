@@ -0,0 +1,644 @@
+/*
+ * Copyright (c) 2011 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Replay a PSB_VIDEO_RECORD file through the driver without the hardware,
+ * see psb_record.h and psb_replay_mock.h.
+ *
+ *   psb_replay [-d dev_id] [-l loops] [-o out] [-g golden [-m]] <record file>
+ *
+ * Every vaRenderPicture of the recording is issued again against the mock
+ * buffer manager and the host time spent in vaBeginPicture, vaRenderPicture
+ * and vaEndPicture is reported per profile. With -o the command buffers
+ * built during the first loop are written to "out"; with -g they are
+ * compared against a dump written by an earlier -o run, the MTX messages
+ * only with -m since they carry a per-process MMU context.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <va/va_backend.h>
+#include <va/va_backend_vpp.h>
+#include <va/va_drmcommon.h>
+
+#include "../psb_record.h"
+#include "psb_replay_mock.h"
+
+#define REPLAY_MAX_CONTEXTS     16
+#define REPLAY_MAX_BUFFERS      64
+#define REPLAY_MAX_PROFILES     32
+
+VAStatus __vaDriverInit_0_31(VADriverContextP ctx);
+
+typedef struct {
+    uint32_t rec_id;            /* context id in the recording, 0 if unused */
+    VAProfile profile;
+    VAConfigID config;
+    VAContextID context;
+    VASurfaceID render_target;
+    int num_surfaces;
+    uint32_t *rec_surfaces;
+    VASurfaceID *surfaces;
+} replay_context_t;
+
+typedef struct {
+    unsigned int frames;
+    uint64_t wall_ns;
+    uint64_t cpu_ns;
+    uint64_t max_wall_ns;
+    uint64_t frame_wall_ns;     /* of the frame in progress */
+    uint64_t frame_cpu_ns;
+} replay_stats_t;
+
+static VADriverContext drv_ctx;
+static struct VADriverVTable drv_vtable;
+static struct VADriverVTableVPP drv_vtable_vpp;
+static struct drm_state drv_drm_state;
+
+static replay_context_t contexts[REPLAY_MAX_CONTEXTS];
+static replay_stats_t stats[REPLAY_MAX_PROFILES + 1]; /* last one for unknown profiles */
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-d dev_id] [-l loops] [-o out] [-g golden [-m]] <record file>\n", prog);
+    exit(1);
+}
+
+static uint64_t replay_now(clockid_t clock)
+{
+    struct timespec ts;
+
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static replay_stats_t *profile_stats(int profile)
+{
+    if (profile < 0 || profile >= REPLAY_MAX_PROFILES)
+        return &stats[REPLAY_MAX_PROFILES];
+    return &stats[profile];
+}
+
+static const char *profile_name(int profile)
+{
+    switch (profile) {
+    case VAProfileMPEG2Simple: return "MPEG2Simple";
+    case VAProfileMPEG2Main: return "MPEG2Main";
+    case VAProfileMPEG4Simple: return "MPEG4Simple";
+    case VAProfileMPEG4AdvancedSimple: return "MPEG4AdvancedSimple";
+    case VAProfileMPEG4Main: return "MPEG4Main";
+    case VAProfileH264Baseline: return "H264Baseline";
+    case VAProfileH264Main: return "H264Main";
+    case VAProfileH264High: return "H264High";
+    case VAProfileH264ConstrainedBaseline: return "H264ConstrainedBaseline";
+    case VAProfileVC1Simple: return "VC1Simple";
+    case VAProfileVC1Main: return "VC1Main";
+    case VAProfileVC1Advanced: return "VC1Advanced";
+    case VAProfileH263Baseline: return "H263Baseline";
+    case VAProfileJPEGBaseline: return "JPEGBaseline";
+    case VAProfileVP8Version0_3: return "VP8Version0_3";
+    default: return "Unknown";
+    }
+}
+
+/*
+ * Reads one record, growing "*payload" as needed. Returns 0 at the end of
+ * the file, -1 on a truncated record
+ */
+static int read_record(FILE *fp, psb_record_header_t *header, unsigned char **payload, uint32_t *payload_size)
+{
+    if (fread(header, sizeof(*header), 1, fp) != 1)
+        return 0;
+
+    if (header->size > *payload_size) {
+        unsigned char *p = realloc(*payload, header->size);
+
+        if (p == NULL)
+            return -1;
+        *payload = p;
+        *payload_size = header->size;
+    }
+    if (header->size && fread(*payload, header->size, 1, fp) != 1)
+        return -1;
+
+    return 1;
+}
+
+static FILE *open_record(const char *fn, psb_record_file_header_t *header)
+{
+    FILE *fp = fopen(fn, "rb");
+
+    if (fp == NULL) {
+        perror(fn);
+        return NULL;
+    }
+    if (fread(header, sizeof(*header), 1, fp) != 1 || header->magic != PSB_RECORD_MAGIC ||
+        header->version != PSB_RECORD_VERSION) {
+        fprintf(stderr, "%s: not a version %d record file\n", fn, PSB_RECORD_VERSION);
+        fclose(fp);
+        return NULL;
+    }
+    return fp;
+}
+
+static replay_context_t *find_context(uint32_t rec_id)
+{
+    int i;
+
+    for (i = 0; i < REPLAY_MAX_CONTEXTS; i++)
+        if (contexts[i].rec_id == rec_id && contexts[i].surfaces)
+            return &contexts[i];
+    return NULL;
+}
+
+static VASurfaceID map_surface(replay_context_t *rc, VASurfaceID id)
+{
+    int i;
+
+    for (i = 0; i < rc->num_surfaces; i++)
+        if (rc->rec_surfaces[i] == id)
+            return rc->surfaces[i];
+    return id;
+}
+
+/* Surface ids stored inside the codec parameter buffers */
+static void remap_buffer(replay_context_t *rc, uint32_t type, unsigned char *data,
+                         uint32_t size, uint32_t num_elements)
+{
+    uint32_t n, i;
+
+    switch (rc->profile) {
+    case VAProfileH264Baseline:
+    case VAProfileH264Main:
+    case VAProfileH264High:
+    case VAProfileH264ConstrainedBaseline:
+        if (type == VAPictureParameterBufferType && size >= sizeof(VAPictureParameterBufferH264)) {
+            VAPictureParameterBufferH264 *pic = (VAPictureParameterBufferH264 *) data;
+
+            pic->CurrPic.picture_id = map_surface(rc, pic->CurrPic.picture_id);
+            for (i = 0; i < 16; i++)
+                pic->ReferenceFrames[i].picture_id = map_surface(rc, pic->ReferenceFrames[i].picture_id);
+        } else if (type == VASliceParameterBufferType && size >= sizeof(VASliceParameterBufferH264)) {
+            for (n = 0; n < num_elements; n++) {
+                VASliceParameterBufferH264 *slice = (VASliceParameterBufferH264 *)(data + n * size);
+
+                for (i = 0; i < 32; i++) {
+                    slice->RefPicList0[i].picture_id = map_surface(rc, slice->RefPicList0[i].picture_id);
+                    slice->RefPicList1[i].picture_id = map_surface(rc, slice->RefPicList1[i].picture_id);
+                }
+            }
+        }
+        break;
+    case VAProfileMPEG2Simple:
+    case VAProfileMPEG2Main:
+        if (type == VAPictureParameterBufferType && size >= sizeof(VAPictureParameterBufferMPEG2)) {
+            VAPictureParameterBufferMPEG2 *pic = (VAPictureParameterBufferMPEG2 *) data;
+
+            pic->forward_reference_picture = map_surface(rc, pic->forward_reference_picture);
+            pic->backward_reference_picture = map_surface(rc, pic->backward_reference_picture);
+        }
+        break;
+    case VAProfileMPEG4Simple:
+    case VAProfileMPEG4AdvancedSimple:
+    case VAProfileMPEG4Main:
+    case VAProfileH263Baseline:
+        if (type == VAPictureParameterBufferType && size >= sizeof(VAPictureParameterBufferMPEG4)) {
+            VAPictureParameterBufferMPEG4 *pic = (VAPictureParameterBufferMPEG4 *) data;
+
+            pic->forward_reference_picture = map_surface(rc, pic->forward_reference_picture);
+            pic->backward_reference_picture = map_surface(rc, pic->backward_reference_picture);
+        }
+        break;
+    case VAProfileVC1Simple:
+    case VAProfileVC1Main:
+    case VAProfileVC1Advanced:
+        if (type == VAPictureParameterBufferType && size >= sizeof(VAPictureParameterBufferVC1)) {
+            VAPictureParameterBufferVC1 *pic = (VAPictureParameterBufferVC1 *) data;
+
+            pic->forward_reference_picture = map_surface(rc, pic->forward_reference_picture);
+            pic->backward_reference_picture = map_surface(rc, pic->backward_reference_picture);
+            pic->inloop_decoded_picture = map_surface(rc, pic->inloop_decoded_picture);
+        }
+        break;
+    case VAProfileVP8Version0_3:
+        if (type == VAPictureParameterBufferType && size >= sizeof(VAPictureParameterBufferVP8)) {
+            VAPictureParameterBufferVP8 *pic = (VAPictureParameterBufferVP8 *) data;
+
+            pic->last_ref_frame = map_surface(rc, pic->last_ref_frame);
+            pic->golden_ref_frame = map_surface(rc, pic->golden_ref_frame);
+            pic->alt_ref_frame = map_surface(rc, pic->alt_ref_frame);
+            pic->out_of_loop_frame = map_surface(rc, pic->out_of_loop_frame);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static void destroy_context(replay_context_t *rc)
+{
+    VADriverContextP ctx = &drv_ctx;
+
+    ctx->vtable->vaDestroyContext(ctx, rc->context);
+    ctx->vtable->vaDestroySurfaces(ctx, rc->surfaces, rc->num_surfaces);
+    ctx->vtable->vaDestroyConfig(ctx, rc->config);
+    free(rc->surfaces);
+    free(rc->rec_surfaces);
+    memset(rc, 0, sizeof(*rc));
+}
+
+static int replay_context(const unsigned char *payload)
+{
+    VADriverContextP ctx = &drv_ctx;
+    const psb_record_context_t *rec = (const psb_record_context_t *) payload;
+    const psb_record_surface_t *surface = (const psb_record_surface_t *)(rec + 1);
+    replay_context_t *rc = NULL;
+    uint32_t i;
+    VAStatus status;
+
+    for (i = 0; i < REPLAY_MAX_CONTEXTS && rc == NULL; i++)
+        if (contexts[i].surfaces == NULL)
+            rc = &contexts[i];
+    if (rc == NULL) {
+        fprintf(stderr, "too many contexts\n");
+        return -1;
+    }
+
+    rc->rec_id = rec->context_id;
+    rc->profile = rec->profile;
+    rc->num_surfaces = rec->num_surfaces;
+    rc->rec_surfaces = calloc(rec->num_surfaces + 1, sizeof(uint32_t));
+    rc->surfaces = calloc(rec->num_surfaces + 1, sizeof(VASurfaceID));
+    if (rc->rec_surfaces == NULL || rc->surfaces == NULL)
+        return -1;
+
+    status = ctx->vtable->vaCreateConfig(ctx, rec->profile, rec->entrypoint, NULL, 0, &rc->config);
+    if (status != VA_STATUS_SUCCESS) {
+        fprintf(stderr, "%s: vaCreateConfig failed %d\n", profile_name(rec->profile), status);
+        return -1;
+    }
+
+    for (i = 0; i < rec->num_surfaces; i++) {
+        rc->rec_surfaces[i] = surface[i].surface_id;
+        status = ctx->vtable->vaCreateSurfaces2(ctx, VA_RT_FORMAT_YUV420, surface[i].width, surface[i].height,
+                                                &rc->surfaces[i], 1, NULL, 0);
+        if (status != VA_STATUS_SUCCESS) {
+            fprintf(stderr, "vaCreateSurfaces %ux%u failed %d\n", surface[i].width, surface[i].height, status);
+            return -1;
+        }
+    }
+
+    status = ctx->vtable->vaCreateContext(ctx, rc->config, rec->width, rec->height, rec->flag,
+                                          rc->surfaces, rc->num_surfaces, &rc->context);
+    if (status != VA_STATUS_SUCCESS) {
+        fprintf(stderr, "%s: vaCreateContext failed %d\n", profile_name(rec->profile), status);
+        return -1;
+    }
+    return 0;
+}
+
+static int replay_render(replay_context_t *rc, unsigned char *payload, uint32_t payload_size)
+{
+    VADriverContextP ctx = &drv_ctx;
+    const psb_record_render_t *rec = (const psb_record_render_t *) payload;
+    VABufferID buffers[REPLAY_MAX_BUFFERS];
+    uint32_t offset = sizeof(*rec), i, n = 0;
+    VAStatus status = VA_STATUS_SUCCESS;
+    uint64_t wall, cpu;
+
+    for (i = 0; i < rec->num_buffers && n < REPLAY_MAX_BUFFERS; i++) {
+        const psb_record_buffer_t *buffer = (const psb_record_buffer_t *)(payload + offset);
+        unsigned char *data = (unsigned char *)(buffer + 1);
+        uint32_t data_size = buffer->size * buffer->num_elements;
+
+        if (offset + sizeof(*buffer) + data_size > payload_size) {
+            fprintf(stderr, "truncated render record\n");
+            break;
+        }
+        offset += sizeof(*buffer) + data_size;
+
+        remap_buffer(rc, buffer->type, data, buffer->size, buffer->num_elements);
+        status = ctx->vtable->vaCreateBuffer(ctx, rc->context, buffer->type, buffer->size,
+                                             buffer->num_elements, data, &buffers[n]);
+        if (status != VA_STATUS_SUCCESS) {
+            fprintf(stderr, "vaCreateBuffer type %u failed %d\n", buffer->type, status);
+            break;
+        }
+        n++;
+    }
+
+    if (n) {
+        wall = replay_now(CLOCK_MONOTONIC);
+        cpu = replay_now(CLOCK_PROCESS_CPUTIME_ID);
+        status = ctx->vtable->vaRenderPicture(ctx, rc->context, buffers, n);
+        profile_stats(rc->profile)->frame_wall_ns += replay_now(CLOCK_MONOTONIC) - wall;
+        profile_stats(rc->profile)->frame_cpu_ns += replay_now(CLOCK_PROCESS_CPUTIME_ID) - cpu;
+        if (status != VA_STATUS_SUCCESS)
+            fprintf(stderr, "vaRenderPicture failed %d\n", status);
+    }
+
+    for (i = 0; i < n; i++)
+        ctx->vtable->vaDestroyBuffer(ctx, buffers[i]);
+
+    return (status == VA_STATUS_SUCCESS) ? 0 : -1;
+}
+
+static int replay(const char *fn)
+{
+    VADriverContextP ctx = &drv_ctx;
+    psb_record_file_header_t file_header;
+    psb_record_header_t header;
+    unsigned char *payload = NULL;
+    uint32_t payload_size = 0;
+    const psb_record_picture_t *pic;
+    replay_context_t *rc;
+    replay_stats_t *st;
+    uint64_t wall, cpu;
+    int ret, i, errors = 0;
+    FILE *fp;
+
+    fp = open_record(fn, &file_header);
+    if (fp == NULL)
+        return -1;
+
+    while ((ret = read_record(fp, &header, &payload, &payload_size)) > 0) {
+        pic = (const psb_record_picture_t *) payload;
+
+        switch (header.type) {
+        case PSB_RECORD_CONTEXT:
+            if (replay_context(payload))
+                errors++;
+            break;
+        case PSB_RECORD_BEGIN:
+            rc = find_context(pic->context_id);
+            if (rc == NULL)
+                break;
+            st = profile_stats(rc->profile);
+            rc->render_target = map_surface(rc, pic->render_target);
+            wall = replay_now(CLOCK_MONOTONIC);
+            cpu = replay_now(CLOCK_PROCESS_CPUTIME_ID);
+            if (ctx->vtable->vaBeginPicture(ctx, rc->context, rc->render_target) != VA_STATUS_SUCCESS)
+                errors++;
+            st->frame_wall_ns = replay_now(CLOCK_MONOTONIC) - wall;
+            st->frame_cpu_ns = replay_now(CLOCK_PROCESS_CPUTIME_ID) - cpu;
+            break;
+        case PSB_RECORD_RENDER:
+            rc = find_context(pic->context_id);
+            if (rc && replay_render(rc, payload, header.size))
+                errors++;
+            break;
+        case PSB_RECORD_END:
+            rc = find_context(pic->context_id);
+            if (rc == NULL)
+                break;
+            st = profile_stats(rc->profile);
+            wall = replay_now(CLOCK_MONOTONIC);
+            cpu = replay_now(CLOCK_PROCESS_CPUTIME_ID);
+            if (ctx->vtable->vaEndPicture(ctx, rc->context) != VA_STATUS_SUCCESS)
+                errors++;
+            st->frame_wall_ns += replay_now(CLOCK_MONOTONIC) - wall;
+            st->frame_cpu_ns += replay_now(CLOCK_PROCESS_CPUTIME_ID) - cpu;
+
+            st->frames++;
+            st->wall_ns += st->frame_wall_ns;
+            st->cpu_ns += st->frame_cpu_ns;
+            if (st->frame_wall_ns > st->max_wall_ns)
+                st->max_wall_ns = st->frame_wall_ns;
+
+            ctx->vtable->vaSyncSurface(ctx, rc->render_target);
+            break;
+        case PSB_RECORD_DESTROY:
+            rc = find_context(pic->context_id);
+            if (rc)
+                destroy_context(rc);
+            break;
+        default:
+            /* CMDBUF records are only read by compare() */
+            break;
+        }
+    }
+    if (ret < 0) {
+        fprintf(stderr, "%s: truncated record\n", fn);
+        errors++;
+    }
+
+    for (i = 0; i < REPLAY_MAX_CONTEXTS; i++)
+        if (contexts[i].surfaces)
+            destroy_context(&contexts[i]);
+
+    free(payload);
+    fclose(fp);
+    return errors ? -1 : 0;
+}
+
+/* Next CMDBUF record, 0 at the end of the file */
+static int next_cmdbuf(FILE *fp, psb_record_header_t *header, unsigned char **payload, uint32_t *payload_size)
+{
+    int ret;
+
+    while ((ret = read_record(fp, header, payload, payload_size)) > 0)
+        if (header->type == PSB_RECORD_CMDBUF)
+            break;
+    return ret;
+}
+
+static int compare_section(unsigned int index, const char *name, const unsigned char *a,
+                           const unsigned char *b, uint32_t size)
+{
+    uint32_t i;
+
+    for (i = 0; i < size; i++)
+        if (a[i] != b[i]) {
+            printf("cmdbuf %u: %s differs at 0x%04x\n", index, name, i & ~3);
+            return 1;
+        }
+    return 0;
+}
+
+static int compare(const char *out_fn, const char *golden_fn, int compare_msg)
+{
+    psb_record_file_header_t file_header;
+    psb_record_header_t out_header, golden_header;
+    unsigned char *out = NULL, *golden = NULL;
+    uint32_t out_size = 0, golden_size = 0;
+    unsigned int index = 0, diffs = 0;
+    FILE *out_fp, *golden_fp;
+    int out_ret, golden_ret;
+
+    out_fp = open_record(out_fn, &file_header);
+    golden_fp = open_record(golden_fn, &file_header);
+    if (out_fp == NULL || golden_fp == NULL) {
+        if (out_fp)
+            fclose(out_fp);
+        if (golden_fp)
+            fclose(golden_fp);
+        return -1;
+    }
+
+    for (;; index++) {
+        const psb_record_cmdbuf_t *a, *b;
+        const unsigned char *pa, *pb;
+
+        out_ret = next_cmdbuf(out_fp, &out_header, &out, &out_size);
+        golden_ret = next_cmdbuf(golden_fp, &golden_header, &golden, &golden_size);
+        if (out_ret <= 0 || golden_ret <= 0)
+            break;
+
+        a = (const psb_record_cmdbuf_t *) out;
+        b = (const psb_record_cmdbuf_t *) golden;
+        if (a->num_relocs != b->num_relocs || a->msg_size != b->msg_size ||
+            a->cmd_size != b->cmd_size || a->lldma_size != b->lldma_size) {
+            printf("cmdbuf %u (frame %u): layout differs, relocs %u/%u msg %u/%u cmd %u/%u lldma %u/%u\n",
+                   index, b->frame, a->num_relocs, b->num_relocs, a->msg_size, b->msg_size,
+                   a->cmd_size, b->cmd_size, a->lldma_size, b->lldma_size);
+            diffs++;
+            continue;
+        }
+
+        pa = (const unsigned char *)(a + 1);
+        pb = (const unsigned char *)(b + 1);
+        if (compare_section(index, "relocs", pa, pb, a->num_relocs * sizeof(psb_record_reloc_t)) ||
+            (compare_msg && compare_section(index, "msg",
+                                            pa + a->num_relocs * sizeof(psb_record_reloc_t),
+                                            pb + b->num_relocs * sizeof(psb_record_reloc_t), a->msg_size)) ||
+            compare_section(index, "cmd",
+                            pa + a->num_relocs * sizeof(psb_record_reloc_t) + a->msg_size,
+                            pb + b->num_relocs * sizeof(psb_record_reloc_t) + b->msg_size, a->cmd_size) ||
+            compare_section(index, "lldma",
+                            pa + a->num_relocs * sizeof(psb_record_reloc_t) + a->msg_size + a->cmd_size,
+                            pb + b->num_relocs * sizeof(psb_record_reloc_t) + b->msg_size + b->cmd_size,
+                            a->lldma_size))
+            diffs++;
+    }
+
+    if (out_ret != golden_ret) {
+        printf("cmdbuf count differs after %u\n", index);
+        diffs++;
+    }
+    printf("%u cmdbufs compared, %u differ\n", index, diffs);
+
+    free(out);
+    free(golden);
+    fclose(out_fp);
+    fclose(golden_fp);
+    return diffs ? 1 : 0;
+}
+
+static void report(void)
+{
+    int i;
+
+    printf("%-24s %8s %12s %12s %12s\n", "profile", "frames", "wall us/fr", "cpu us/fr", "max wall us");
+    for (i = 0; i <= REPLAY_MAX_PROFILES; i++) {
+        replay_stats_t *st = &stats[i];
+
+        if (st->frames == 0)
+            continue;
+        printf("%-24s %8u %12.1f %12.1f %12.1f\n", profile_name(i), st->frames,
+               st->wall_ns / 1000.0 / st->frames, st->cpu_ns / 1000.0 / st->frames,
+               st->max_wall_ns / 1000.0);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    VADriverContextP ctx = &drv_ctx;
+    psb_record_file_header_t file_header;
+    const char *fn = NULL, *out_fn = NULL, *golden_fn = NULL;
+    char tmp_fn[1024];
+    uint32_t dev_id = 0;
+    int loops = 1, compare_msg = 0, ret = 0, i;
+    FILE *fp;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+            dev_id = strtoul(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc)
+            loops = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            out_fn = argv[++i];
+        else if (strcmp(argv[i], "-g") == 0 && i + 1 < argc)
+            golden_fn = argv[++i];
+        else if (strcmp(argv[i], "-m") == 0)
+            compare_msg = 1;
+        else if (fn == NULL && argv[i][0] != '-')
+            fn = argv[i];
+        else
+            usage(argv[0]);
+    }
+    if (fn == NULL || loops < 1)
+        usage(argv[0]);
+
+    fp = open_record(fn, &file_header);
+    if (fp == NULL)
+        return 1;
+    fclose(fp);
+    if (dev_id == 0)
+        dev_id = file_header.dev_id;
+
+    if (golden_fn && out_fn == NULL) {
+        snprintf(tmp_fn, sizeof(tmp_fn), "%s.replay.%d", fn, getpid());
+        out_fn = tmp_fn;
+    }
+
+    /* no window system and no recording of our own calls */
+    setenv("PSB_VIDEO_PUTSURFACE_DUMMY", "1", 1);
+    unsetenv("PSB_VIDEO_RECORD");
+
+    psb_replay_mock_init(dev_id);
+    drv_drm_state.fd = PSB_REPLAY_MOCK_FD;
+    drv_drm_state.auth_type = VA_DRM_AUTH_CUSTOM;
+    ctx->drm_state = &drv_drm_state;
+    ctx->vtable = &drv_vtable;
+    ctx->vtable_vpp = &drv_vtable_vpp;
+    if (__vaDriverInit_0_31(ctx) != VA_STATUS_SUCCESS) {
+        fprintf(stderr, "driver init failed\n");
+        return 1;
+    }
+
+    for (i = 0; i < loops && ret == 0; i++) {
+        if (i == 0 && out_fn && psb_record_open(out_fn, dev_id, PSB_RECORD_MASK(PSB_RECORD_CMDBUF)))
+            ret = 1;
+        if (ret == 0 && replay(fn))
+            ret = 1;
+        if (i == 0)
+            psb_record_close();
+    }
+
+    ctx->vtable->vaTerminate(ctx);
+
+    printf("device 0x%04x, %d loop(s), %u submissions\n", dev_id, loops, psb_replay_mock_submits());
+    report();
+
+    if (ret == 0 && golden_fn)
+        ret = compare(out_fn, golden_fn, compare_msg);
+    if (out_fn == tmp_fn)
+        unlink(tmp_fn);
+
+    return ret;
+}
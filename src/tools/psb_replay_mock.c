@@ -0,0 +1,570 @@
+/*
+ * Copyright (c) 2011 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Mock buffer manager and DRM ioctls for tools/psb_replay, see
+ * psb_replay_mock.h. Only what the decode paths of the driver use is
+ * implemented; unknown ioctls succeed without touching their argument.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "../psb_drv_video.h"
+#include "../psb_ws_driver.h"
+#include "../psb_output.h"
+#include <wsbm/wsbm_manager.h>
+#include <wsbm/wsbm_fencemgr.h>
+
+#include "psb_replay_mock.h"
+
+#define MOCK_PLACEMENT_OFFSET   0x40
+#define MOCK_EXEC_OFFSET        0x41
+#define MOCK_GETPARAM_OFFSET    0x42
+
+#define MOCK_GPU_BASE           0x10000000ull
+#define MOCK_GPU_ALIGN          0x1000
+
+/* Backing store shared by all buffer objects referencing the same handle */
+struct mock_storage {
+    unsigned char *data;
+    unsigned int size;
+    int user;                   /* data belongs to the caller */
+    uint32_t handle;
+    uint64_t gpu_offset;
+    int refcount;
+};
+
+struct _WsbmBufferObject {
+    struct _WsbmKernelBuf kBuf;
+    struct mock_storage *storage;
+    uint32_t placement;
+};
+
+struct _WsbmFenceObject {
+    uint32_t fence_type;
+};
+
+static pthread_mutex_t mock_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct mock_storage **mock_handles;
+static unsigned int mock_num_handles;
+static uint64_t mock_next_offset = MOCK_GPU_BASE;
+static uint32_t mock_dev_id = 0x1180;
+static unsigned int mock_submits;
+static int mock_initialized;
+
+static struct _WsbmBufferPool mock_pool;
+
+void psb_replay_mock_init(uint32_t dev_id)
+{
+    mock_dev_id = dev_id;
+}
+
+unsigned int psb_replay_mock_submits(void)
+{
+    return mock_submits;
+}
+
+static struct mock_storage *mock__storage_create(unsigned int size, void *user_data)
+{
+    struct mock_storage *storage;
+    struct mock_storage **handles;
+    uint32_t handle;
+
+    storage = calloc(1, sizeof(*storage));
+    if (storage == NULL)
+        return NULL;
+
+    if (user_data) {
+        storage->data = user_data;
+        storage->user = 1;
+    } else {
+        storage->data = calloc(1, size ? size : 1);
+        if (storage->data == NULL) {
+            free(storage);
+            return NULL;
+        }
+    }
+    storage->size = size;
+    storage->refcount = 1;
+
+    /* handle 0 is never handed out */
+    for (handle = 1; handle < mock_num_handles; handle++)
+        if (mock_handles[handle] == NULL)
+            break;
+    if (handle >= mock_num_handles) {
+        unsigned int num = mock_num_handles ? mock_num_handles * 2 : 256;
+
+        handles = realloc(mock_handles, num * sizeof(*handles));
+        if (handles == NULL) {
+            if (!storage->user)
+                free(storage->data);
+            free(storage);
+            return NULL;
+        }
+        memset(handles + mock_num_handles, 0, (num - mock_num_handles) * sizeof(*handles));
+        mock_handles = handles;
+        handle = mock_num_handles ? mock_num_handles : 1;
+        mock_num_handles = num;
+    }
+    mock_handles[handle] = storage;
+    storage->handle = handle;
+
+    /* placement depends only on the allocation sequence */
+    storage->gpu_offset = mock_next_offset;
+    mock_next_offset += (size + MOCK_GPU_ALIGN - 1) & ~(uint64_t)(MOCK_GPU_ALIGN - 1);
+
+    return storage;
+}
+
+static void mock__storage_unref(struct mock_storage *storage)
+{
+    if (storage == NULL || --storage->refcount > 0)
+        return;
+
+    mock_handles[storage->handle] = NULL;
+    if (!storage->user)
+        free(storage->data);
+    free(storage);
+}
+
+static void mock__bo_attach(struct _WsbmBufferObject *buf, struct mock_storage *storage)
+{
+    mock__storage_unref(buf->storage);
+    buf->storage = storage;
+    buf->kBuf.handle = storage->handle;
+    buf->kBuf.gpuOffset = storage->gpu_offset;
+    buf->kBuf.placement = buf->placement;
+}
+
+/* libwsbm */
+
+int wsbmInit(struct _WsbmThreadFuncs *tf, struct _WsbmVNodeFuncs *vf)
+{
+    (void) tf;
+    (void) vf;
+    mock_initialized = 1;
+    return 0;
+}
+
+void wsbmTakedown(void)
+{
+    mock_initialized = 0;
+}
+
+int wsbmIsInitialized(void)
+{
+    return mock_initialized;
+}
+
+struct _WsbmThreadFuncs *wsbmNullThreadFuncs(void)
+{
+    return NULL;
+}
+
+static void mock__pool_takedown(struct _WsbmBufferPool *pool)
+{
+    (void) pool;
+}
+
+struct _WsbmBufferPool *wsbmTTMPoolInit(int fd, unsigned int devOffset)
+{
+    (void) devOffset;
+    mock_pool.fd = fd;
+    mock_pool.takeDown = mock__pool_takedown;
+    return &mock_pool;
+}
+
+int wsbmGenBuffers(struct _WsbmBufferPool *pool, unsigned n, struct _WsbmBufferObject *buffers[],
+                   unsigned alignment, uint32_t placement)
+{
+    unsigned int i;
+
+    (void) pool;
+    (void) alignment;
+    for (i = 0; i < n; i++) {
+        buffers[i] = calloc(1, sizeof(struct _WsbmBufferObject));
+        if (buffers[i] == NULL) {
+            while (i--) {
+                free(buffers[i]);
+                buffers[i] = NULL;
+            }
+            return -ENOMEM;
+        }
+        buffers[i]->placement = placement;
+    }
+    return 0;
+}
+
+int wsbmBOData(struct _WsbmBufferObject *buf, unsigned size, const void *data,
+               struct _WsbmBufferPool *pool, uint32_t placement)
+{
+    struct mock_storage *storage;
+    int ret = 0;
+
+    (void) pool;
+    pthread_mutex_lock(&mock_mutex);
+    if (placement)
+        buf->placement = placement;
+    if ((buf->storage == NULL) || (buf->storage->refcount > 1) || (buf->storage->size < size)) {
+        storage = mock__storage_create(size, NULL);
+        if (storage)
+            mock__bo_attach(buf, storage);
+        else
+            ret = -ENOMEM;
+    }
+    if ((ret == 0) && data)
+        memcpy(buf->storage->data, data, size);
+    pthread_mutex_unlock(&mock_mutex);
+
+    return ret;
+}
+
+int wsbmBODataUB(struct _WsbmBufferObject *buf, unsigned size, const void *data,
+                 struct _WsbmBufferPool *newPool, uint32_t placement,
+                 const unsigned long *user_ptr, int fd)
+{
+    struct mock_storage *storage;
+
+    (void) data;
+    (void) newPool;
+    (void) fd;
+    pthread_mutex_lock(&mock_mutex);
+    if (placement)
+        buf->placement = placement;
+    storage = mock__storage_create(size, (void *) user_ptr);
+    if (storage)
+        mock__bo_attach(buf, storage);
+    pthread_mutex_unlock(&mock_mutex);
+
+    return storage ? 0 : -ENOMEM;
+}
+
+int wsbmBOSetReferenced(struct _WsbmBufferObject *buf, unsigned long handle)
+{
+    struct mock_storage *storage = NULL;
+
+    pthread_mutex_lock(&mock_mutex);
+    if (handle < mock_num_handles)
+        storage = mock_handles[handle];
+    if (storage) {
+        storage->refcount++;
+        mock__bo_attach(buf, storage);
+    }
+    pthread_mutex_unlock(&mock_mutex);
+
+    return storage ? 0 : -EINVAL;
+}
+
+void wsbmBOUnreference(struct _WsbmBufferObject **p_buf)
+{
+    struct _WsbmBufferObject *buf = *p_buf;
+
+    *p_buf = NULL;
+    if (buf == NULL)
+        return;
+
+    pthread_mutex_lock(&mock_mutex);
+    mock__storage_unref(buf->storage);
+    pthread_mutex_unlock(&mock_mutex);
+    free(buf);
+}
+
+void *wsbmBOMap(struct _WsbmBufferObject *buf, unsigned mode)
+{
+    (void) mode;
+    return buf->storage ? buf->storage->data : NULL;
+}
+
+void wsbmBOUnmap(struct _WsbmBufferObject *buf)
+{
+    (void) buf;
+}
+
+int wsbmBOSyncForCpu(struct _WsbmBufferObject *buf, unsigned mode)
+{
+    (void) buf;
+    (void) mode;
+    return 0;
+}
+
+void wsbmBOReleaseFromCpu(struct _WsbmBufferObject *buf, unsigned mode)
+{
+    (void) buf;
+    (void) mode;
+}
+
+int wsbmBOWaitIdle(struct _WsbmBufferObject *buf, int lazy)
+{
+    (void) buf;
+    (void) lazy;
+    return 0;
+}
+
+unsigned long wsbmBOOffsetHint(struct _WsbmBufferObject *buf)
+{
+    return (unsigned long) buf->kBuf.gpuOffset;
+}
+
+uint32_t wsbmBOPlacementHint(struct _WsbmBufferObject *buf)
+{
+    return buf->placement;
+}
+
+int wsbmBOSetStatus(struct _WsbmBufferObject *buf, uint32_t setFlags, uint32_t clrFlags)
+{
+    buf->placement = (buf->placement & ~clrFlags) | setFlags;
+    return 0;
+}
+
+struct _WsbmKernelBuf *wsbmKBuf(const struct _WsbmBufferObject *buf)
+{
+    return (struct _WsbmKernelBuf *) &buf->kBuf;
+}
+
+uint32_t wsbmKBufHandle(const struct _WsbmKernelBuf *kBuf)
+{
+    return kBuf->handle;
+}
+
+void wsbmUpdateKBuf(struct _WsbmKernelBuf *kBuf, uint64_t gpuOffset, uint32_t placement,
+                    uint32_t fence_type_mask)
+{
+    kBuf->gpuOffset = gpuOffset;
+    kBuf->placement = placement;
+    kBuf->fence_type_mask = fence_type_mask;
+}
+
+void wsbmWriteLockKernelBO(void)
+{
+    pthread_mutex_lock(&mock_mutex);
+}
+
+void wsbmWriteUnlockKernelBO(void)
+{
+    pthread_mutex_unlock(&mock_mutex);
+}
+
+struct _WsbmFenceObject *wsbmFenceCreate(struct _WsbmFenceMgr *mgr, uint32_t fence_class,
+                                         uint32_t fence_type, void *private, size_t private_size)
+{
+    struct _WsbmFenceObject *fence;
+
+    (void) mgr;
+    (void) fence_class;
+    (void) private;
+    (void) private_size;
+    fence = calloc(1, sizeof(*fence));
+    if (fence)
+        fence->fence_type = fence_type;
+    return fence;
+}
+
+void wsbmFenceUnreference(struct _WsbmFenceObject **pFence)
+{
+    free(*pFence);
+    *pFence = NULL;
+}
+
+int wsbmFenceFinish(struct _WsbmFenceObject *fence, uint32_t fence_type, int lazy_hint)
+{
+    (void) fence;
+    (void) fence_type;
+    (void) lazy_hint;
+    return 0;
+}
+
+void wsbmFenceMgrTTMTakedown(struct _WsbmFenceMgr *mgr)
+{
+    (void) mgr;
+}
+
+/* libdrm */
+
+/* Called with mock_mutex held through wsbmWriteLockKernelBO */
+static int mock__execbuf(drm_psb_cmdbuf_arg_t *ca)
+{
+    struct psb_validate_arg *arg = (struct psb_validate_arg *)(unsigned long) ca->buffer_list;
+    struct psb_ttm_fence_rep *fence_rep = (struct psb_ttm_fence_rep *)(unsigned long) ca->fence_arg;
+
+    while (arg) {
+        struct psb_validate_req *req = &arg->d.req;
+        struct psb_validate_arg *next = (struct psb_validate_arg *)(unsigned long) req->next;
+        struct mock_storage *storage = NULL;
+        uint64_t gpu_offset = req->presumed_gpu_offset;
+
+        if (req->buffer_handle < mock_num_handles)
+            storage = mock_handles[req->buffer_handle];
+        if (storage)
+            gpu_offset = storage->gpu_offset;
+
+        /* req and rep share storage */
+        memset(&arg->d.rep, 0, sizeof(arg->d.rep));
+        arg->d.rep.gpu_offset = gpu_offset;
+        arg->d.rep.placement = req->set_flags;
+        arg->d.rep.fence_type_mask = 1;
+        arg->handled = 1;
+        arg->ret = storage ? 0 : -EINVAL;
+        arg = next;
+    }
+
+    if (fence_rep)
+        memset(fence_rep, 0, sizeof(*fence_rep));
+
+    mock_submits++;
+    return 0;
+}
+
+static int mock__getparam(struct drm_lnc_video_getparam_arg *arg)
+{
+    switch (arg->key) {
+    case LNC_VIDEO_DEVICE_INFO:
+        *(unsigned long *)(unsigned long) arg->value = (unsigned long) mock_dev_id << 16;
+        break;
+    case PNW_VIDEO_QUERY_ENTRY:
+        /* no other process is using the engines */
+        *(int *)(unsigned long) arg->value = 0;
+        break;
+    default:
+        break;
+    }
+    return 0;
+}
+
+static int mock__extension(union drm_psb_extension_arg *arg)
+{
+    unsigned long offset = 0;
+
+    if (strcmp(arg->extension, "psb_ttm_placement_alphadrop") == 0)
+        offset = MOCK_PLACEMENT_OFFSET;
+    else if (strcmp(arg->extension, "psb_ttm_execbuf_alphadrop") == 0)
+        offset = MOCK_EXEC_OFFSET;
+    else if (strcmp(arg->extension, "lnc_video_getparam") == 0)
+        offset = MOCK_GETPARAM_OFFSET;
+
+    memset(&arg->rep, 0, sizeof(arg->rep));
+    arg->rep.exists = (offset != 0);
+    arg->rep.driver_ioctl_offset = offset;
+    return 0;
+}
+
+int drmCommandWrite(int fd, unsigned long drmCommandIndex, void *data, unsigned long size)
+{
+    (void) fd;
+    (void) size;
+    if (drmCommandIndex == MOCK_EXEC_OFFSET)
+        return mock__execbuf((drm_psb_cmdbuf_arg_t *) data);
+    return 0;
+}
+
+int drmCommandWriteRead(int fd, unsigned long drmCommandIndex, void *data, unsigned long size)
+{
+    (void) fd;
+    (void) size;
+    if (drmCommandIndex == DRM_PSB_EXTENSION)
+        return mock__extension((union drm_psb_extension_arg *) data);
+    if (drmCommandIndex == MOCK_GETPARAM_OFFSET)
+        return mock__getparam((struct drm_lnc_video_getparam_arg *) data);
+    return 0;
+}
+
+int drmCommandRead(int fd, unsigned long drmCommandIndex, void *data, unsigned long size)
+{
+    (void) fd;
+    (void) drmCommandIndex;
+    memset(data, 0, size);
+    return 0;
+}
+
+int drmGetLock(int fd, drm_context_t context, drmLockFlags flags)
+{
+    (void) fd;
+    (void) context;
+    (void) flags;
+    return 0;
+}
+
+int drmUnlock(int fd, drm_context_t context)
+{
+    (void) fd;
+    (void) context;
+    return 0;
+}
+
+/*
+ * Window system entry points. psb_replay is built without the X11 and
+ * PVR2D output sources so it links on machines without them; replay runs
+ * in PSB_VIDEO_PUTSURFACE_DUMMY mode and never displays anything.
+ */
+unsigned char *psb_x11_output_init(VADriverContextP ctx)
+{
+    (void) ctx;
+    return NULL;
+}
+
+VAStatus psb_x11_output_deinit(VADriverContextP ctx)
+{
+    (void) ctx;
+    return VA_STATUS_SUCCESS;
+}
+
+VAStatus psb_PutSurface(VADriverContextP ctx, VASurfaceID surface, void *draw,
+                        short srcx, short srcy, unsigned short srcw, unsigned short srch,
+                        short destx, short desty, unsigned short destw, unsigned short desth,
+                        VARectangle *cliprects, unsigned int number_cliprects, unsigned int flags)
+{
+    (void) ctx;
+    (void) surface;
+    (void) draw;
+    (void) srcx;
+    (void) srcy;
+    (void) srcw;
+    (void) srch;
+    (void) destx;
+    (void) desty;
+    (void) destw;
+    (void) desth;
+    (void) cliprects;
+    (void) number_cliprects;
+    (void) flags;
+    return VA_STATUS_SUCCESS;
+}
+
+int psb_xrandr_single_mode()
+{
+    return 1;
+}
+
+void psb_init_surface_pvr2dbuf(psb_driver_data_p driver_data)
+{
+    (void) driver_data;
+}
+
+void psb_free_surface_pvr2dbuf(psb_driver_data_p driver_data)
+{
+    (void) driver_data;
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2011 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _PSB_REPLAY_MOCK_H_
+#define _PSB_REPLAY_MOCK_H_
+
+#include <stdint.h>
+
+/*
+ * Hardware-free stand-in for libwsbm and the libdrm command ioctls, linked
+ * into tools/psb_replay instead of the real libraries. Buffer objects live
+ * in malloc'd memory at deterministic GPU offsets, execbuf validates every
+ * buffer and all fences are signalled on creation. The X11/PVR2D output
+ * code is left out of psb_replay and replaced by no-ops as well.
+ */
+
+/* File descriptor to hand to the driver in drm_state */
+#define PSB_REPLAY_MOCK_FD      0x7073
+
+/* Device id reported by the LNC_VIDEO_DEVICE_INFO getparam */
+void psb_replay_mock_init(uint32_t dev_id);
+
+/* Number of execbuf ioctls seen so far */
+unsigned int psb_replay_mock_submits(void);
+
+#endif /* _PSB_REPLAY_MOCK_H_ */
@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2011 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Decode a PSB_VIDEO_TRACE_RING file, see psb_trace_ring.h.
+ *
+ *   psb_trace_dump [-j] <trace file>
+ *
+ * Prints one event per line, or with -j a Chrome trace JSON document
+ * that can be loaded in chrome://tracing or Perfetto.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../psb_trace_ring.h"
+
+#define PSB_TRACE_NAME(name, phase) #name,
+static const char *event_name[] = {
+    PSB_TRACE_EVENTS(PSB_TRACE_NAME)
+};
+#undef PSB_TRACE_NAME
+
+#define PSB_TRACE_PHASE(name, phase) phase,
+static const char event_phase[] = {
+    PSB_TRACE_EVENTS(PSB_TRACE_PHASE)
+};
+#undef PSB_TRACE_PHASE
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-j] <trace file>\n", prog);
+    exit(1);
+}
+
+static void dump_text(const psb_trace_file_header_t *header, const psb_trace_record_t *rec)
+{
+    unsigned int i;
+    uint64_t rel = rec->ts_ns - header->start_ns;
+
+    if (rec->id < PSB_TRACE_EV_COUNT)
+        printf("%6llu.%06llu %5u %-20s", (unsigned long long)(rel / 1000000000ull),
+               (unsigned long long)(rel % 1000000000ull / 1000), rec->tid, event_name[rec->id]);
+    else
+        printf("%6llu.%06llu %5u EVENT_%-14u", (unsigned long long)(rel / 1000000000ull),
+               (unsigned long long)(rel % 1000000000ull / 1000), rec->tid, rec->id);
+
+    for (i = 0; i < rec->nargs && i < PSB_TRACE_MAX_ARGS; i++)
+        printf(" 0x%08x", rec->args[i]);
+    printf("\n");
+}
+
+static void dump_json(const psb_trace_file_header_t *header, const psb_trace_record_t *rec, int first)
+{
+    unsigned int i;
+    uint64_t rel = rec->ts_ns - header->start_ns;
+    char phase = 'i';
+
+    if (rec->id < PSB_TRACE_EV_COUNT)
+        phase = event_phase[rec->id];
+
+    printf("%s\n{\"pid\":%u,\"tid\":%u,\"ts\":%llu.%03llu,\"ph\":\"%c\",",
+           first ? "" : ",", header->pid, rec->tid,
+           (unsigned long long)(rel / 1000), (unsigned long long)(rel % 1000), phase);
+
+    /* an 'E' record closes the most recent 'B' on its thread, the name is informative only */
+    if (rec->id < PSB_TRACE_EV_COUNT)
+        printf("\"name\":\"%s\"", event_name[rec->id]);
+    else
+        printf("\"name\":\"EVENT_%u\"", rec->id);
+    if (phase == 'i')
+        printf(",\"s\":\"t\"");
+
+    printf(",\"args\":{");
+    for (i = 0; i < rec->nargs && i < PSB_TRACE_MAX_ARGS; i++)
+        printf("%s\"arg%u\":%u", i ? "," : "", i, rec->args[i]);
+    printf("}}");
+}
+
+int main(int argc, char *argv[])
+{
+    psb_trace_file_header_t header;
+    psb_trace_record_t rec;
+    const char *fn = NULL;
+    int json = 0, first = 1, i;
+    FILE *fp;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-j") == 0)
+            json = 1;
+        else if (fn == NULL)
+            fn = argv[i];
+        else
+            usage(argv[0]);
+    }
+    if (fn == NULL)
+        usage(argv[0]);
+
+    fp = fopen(fn, "rb");
+    if (fp == NULL) {
+        perror(fn);
+        return 1;
+    }
+
+    if (fread(&header, sizeof(header), 1, fp) != 1 || header.magic != PSB_TRACE_MAGIC) {
+        fprintf(stderr, "%s: not a trace ring file\n", fn);
+        fclose(fp);
+        return 1;
+    }
+    if (header.version != PSB_TRACE_VERSION || header.record_size != sizeof(rec)) {
+        fprintf(stderr, "%s: unsupported version %u record size %u\n",
+                fn, header.version, header.record_size);
+        fclose(fp);
+        return 1;
+    }
+
+    if (json)
+        printf("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    else
+        printf("# pid %u, time in s.us since trace start\n", header.pid);
+
+    /* records of different threads are interleaved per drain, not sorted */
+    while (fread(&rec, sizeof(rec), 1, fp) == 1) {
+        if (json)
+            dump_json(&header, &rec, first);
+        else
+            dump_text(&header, &rec);
+        first = 0;
+    }
+
+    if (json)
+        printf("\n]}\n");
+
+    fclose(fp);
+    return 0;
+}
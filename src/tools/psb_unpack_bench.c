@@ -0,0 +1,274 @@
+/*
+ * Copyright (c) 2011 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+/*
+ * Check and time the reconstructed frame unpack used by psb_GetImage.
+ *
+ *   psb_unpack_bench [iterations]
+ *
+ * Fills synthetic TopazHP and VSP tiled frames, unpacks them with
+ * psb_unpack_topaz_rec()/psb_unpack_vsp_rec(), single threaded and on a
+ * row pool, and compares the result with the per pixel code those
+ * replaced. Then times all three at 1080p. Returns nonzero on a mismatch.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../psb_unpack.h"
+
+/* reference: tng_unpack_vsp_rec() as it was in psb_output.c */
+static void ref_unpack_vsp_rec(int src_width, int src_height,
+                               unsigned char *p_srcY, unsigned char *p_srcUV,
+                               unsigned char *p_dstY, unsigned char *p_dstU,
+                               int dstY_stride, int dstU_stride)
+{
+    unsigned char *tmp_dstY = p_dstY;
+    unsigned char *tmp_dstU = p_dstU;
+    int x, y;
+
+    for (y = 32; y < src_height + 32; y++) {
+        for (x = 32; x < src_width + 32; x++)
+            *tmp_dstY++ = *(p_srcY + (((src_height + 64 + 63) / 64) * (x / 64) + (y / 64)) * 4096 + (y % 64) * 64 + (x % 64));
+        tmp_dstY += dstY_stride - src_width;
+    }
+
+    for (y = 16; y < 16 + ((src_height + 1) >> 1); y++) {
+        for (x = 16; x < 16 + ((src_width + 1) >> 1); x++) {
+            *tmp_dstU++ = *(p_srcUV + ((((src_height + 1) / 2 + 32 + 63) / 64) * (x / 32) + (y / 64)) * 4096 + (y % 64) * 64 + (x % 32) * 2);
+            *tmp_dstU++ = *(p_srcUV + ((((src_height + 1) / 2 + 32 + 63) / 64) * (x / 32) + (y / 64)) * 4096 + (y % 64) * 64 + (x % 32) * 2 + 1);
+        }
+        tmp_dstU += dstU_stride - src_width;
+    }
+}
+
+/* reference: tng_unpack_topaz_rec() as it was in psb_output.c */
+static void ref_unpack_topaz_rec(int src_width, int src_height,
+                                 unsigned char *p_srcY, unsigned char *p_srcUV,
+                                 unsigned char *p_dstY, unsigned char *p_dstU,
+                                 int dstY_stride)
+{
+    unsigned char *tmp_dstY, *tmp_dstU;
+    unsigned char *tmp_srcY = p_srcY;
+    unsigned char *tmp_srcX = p_srcUV;
+    int i, j, n, t;
+    int mb_src_y_w = src_width >> 4;
+    int mb_src_y_h = src_height >> 5;
+    int mb_src_y_p = src_height - (mb_src_y_h << 5);
+
+    for (j = 0; j < mb_src_y_h; j++) {
+        tmp_dstY = p_dstY + j * dstY_stride * 32;
+        for (i = 0; i < mb_src_y_w; i++) {
+            for (n = 0; n < 32; n++) {
+                memcpy(tmp_dstY + dstY_stride * n, tmp_srcY, 16);
+                tmp_srcY += 16;
+            }
+            tmp_dstY += 16;
+        }
+    }
+
+    if (mb_src_y_p != 0) {
+        tmp_dstY = p_dstY + j * dstY_stride * 32;
+        for (i = 0; i < mb_src_y_w; i++) {
+            for (n = 0; n < mb_src_y_p; n++) {
+                memcpy(tmp_dstY + dstY_stride * n, tmp_srcY, 16);
+                tmp_srcY += 16;
+            }
+            tmp_srcY += (32 - n) * 16;
+            tmp_dstY += 16;
+        }
+    }
+
+    for (j = 0; j < mb_src_y_h; j++) {
+        tmp_dstU = p_dstU + j * dstY_stride * 16;
+        for (i = 0; i < mb_src_y_w; i++) {
+            for (n = 0; n < 16; n++) {
+                for (t = 0; t < 16; t++)
+                    tmp_dstU[(n * dstY_stride) + t] = tmp_srcX[t];
+                tmp_srcX += 16;
+            }
+            tmp_dstU += 16;
+        }
+    }
+
+    mb_src_y_p >>= 1;
+    if (mb_src_y_p != 0) {
+        tmp_dstU = p_dstU + j * dstY_stride * 16;
+        for (i = 0; i < mb_src_y_w; i++) {
+            for (n = 0; n < mb_src_y_p; n++) {
+                for (t = 0; t < 16; t++)
+                    tmp_dstU[(n * dstY_stride) + t] = tmp_srcX[t];
+                tmp_srcX += 16;
+            }
+            tmp_srcX += (16 - n) * 16;
+            tmp_dstU += 16;
+        }
+    }
+}
+
+typedef struct {
+    int width, height, stride;
+    unsigned char *src_y, *src_uv;
+    unsigned char *ref, *dst;
+    size_t src_size, dst_size;
+} bench_frame_t;
+
+static int frame_alloc(bench_frame_t *f, int width, int height)
+{
+    unsigned int seed = width * 65536 + height;
+    size_t i;
+
+    f->width = width;
+    f->height = height;
+    f->stride = (width + 64 + 63) & ~63;
+    /* enough for the VSP border and either tile layout */
+    f->src_size = (size_t)(width + 128) * (height + 128);
+    f->dst_size = (size_t)f->stride * height * 2;
+    f->src_y = malloc(f->src_size);
+    f->src_uv = malloc(f->src_size);
+    f->ref = malloc(f->dst_size);
+    f->dst = malloc(f->dst_size);
+    if (!f->src_y || !f->src_uv || !f->ref || !f->dst)
+        return -1;
+
+    for (i = 0; i < f->src_size; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        f->src_y[i] = seed >> 24;
+        f->src_uv[i] = seed >> 16;
+    }
+    return 0;
+}
+
+static void frame_free(bench_frame_t *f)
+{
+    free(f->src_y);
+    free(f->src_uv);
+    free(f->ref);
+    free(f->dst);
+}
+
+static void run_ref(bench_frame_t *f, int vsp)
+{
+    unsigned char *uv = f->ref + (size_t)f->stride * f->height;
+
+    if (vsp)
+        ref_unpack_vsp_rec(f->width, f->height, f->src_y, f->src_uv, f->ref, uv, f->stride, f->stride);
+    else
+        ref_unpack_topaz_rec(f->width, f->height, f->src_y, f->src_uv, f->ref, uv, f->stride);
+}
+
+static void run_new(bench_frame_t *f, int vsp, psb_row_pool_p pool)
+{
+    unsigned char *uv = f->dst + (size_t)f->stride * f->height;
+
+    if (vsp)
+        psb_unpack_vsp_rec(pool, f->width, f->height, f->src_y, f->src_uv, f->dst, uv, f->stride, f->stride);
+    else
+        psb_unpack_topaz_rec(pool, f->width, f->height, f->src_y, f->src_uv, f->dst, uv, f->stride, f->stride);
+}
+
+static int check_frame(bench_frame_t *f, int vsp, psb_row_pool_p pool)
+{
+    memset(f->ref, 0, f->dst_size);
+    memset(f->dst, 0, f->dst_size);
+    run_ref(f, vsp);
+    run_new(f, vsp, pool);
+    if (memcmp(f->ref, f->dst, f->dst_size)) {
+        printf("%-5s %4dx%-4d %s MISMATCH\n", vsp ? "vsp" : "topaz", f->width, f->height,
+               pool ? "pool" : "single");
+        return 1;
+    }
+    return 0;
+}
+
+static double now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static void time_frame(bench_frame_t *f, int vsp, psb_row_pool_p pool, int iterations)
+{
+    double start, ref_ms, single_ms, pool_ms;
+    int i;
+
+    start = now_ms();
+    for (i = 0; i < iterations; i++)
+        run_ref(f, vsp);
+    ref_ms = (now_ms() - start) / iterations;
+
+    start = now_ms();
+    for (i = 0; i < iterations; i++)
+        run_new(f, vsp, NULL);
+    single_ms = (now_ms() - start) / iterations;
+
+    start = now_ms();
+    for (i = 0; i < iterations; i++)
+        run_new(f, vsp, pool);
+    pool_ms = (now_ms() - start) / iterations;
+
+    printf("%-5s %dx%d: reference %.3f ms, single %.3f ms, pool %.3f ms per frame\n",
+           vsp ? "vsp" : "topaz", f->width, f->height, ref_ms, single_ms, pool_ms);
+}
+
+int main(int argc, char *argv[])
+{
+    static const int sizes[][2] = {
+        { 1920, 1080 }, { 1280, 720 }, { 720, 480 }, { 320, 250 }, { 176, 144 }, { 64, 40 }
+    };
+    int iterations = (argc > 1) ? atoi(argv[1]) : 50;
+    psb_row_pool_p pool = psb_row_pool_create();
+    bench_frame_t f;
+    unsigned int i;
+    int vsp, failed = 0;
+
+    printf("SSE2 %s, %s\n", psb_cpu_has_sse2() ? "yes" : "no",
+           pool ? "row pool" : "no row pool, single CPU");
+
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        if (frame_alloc(&f, sizes[i][0], sizes[i][1])) {
+            fprintf(stderr, "out of memory\n");
+            return 1;
+        }
+        for (vsp = 0; vsp <= 1; vsp++) {
+            failed += check_frame(&f, vsp, NULL);
+            failed += check_frame(&f, vsp, pool);
+        }
+        if (i == 0 && iterations > 0) {
+            time_frame(&f, 0, pool, iterations);
+            time_frame(&f, 1, pool, iterations);
+        }
+        frame_free(&f);
+    }
+    printf("%s\n", failed ? "FAILED" : "all frames match");
+
+    if (pool)
+        psb_row_pool_destroy(pool);
+    return failed ? 1 : 0;
+}
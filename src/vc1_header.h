@@ -273,6 +273,8 @@ struct context_VC1_s {
     /* VLC table information */
     IMG_UINT32                          ui32NumTables;                  /* VLC table accumulator */
     sTableData                          sTableInfo[MAX_VLC_TABLES];     /* structure of VLC table information */
+    uint64_t                            vlc_selection_key;              /* picture parameters sTableInfo was built for */
+    IMG_BOOL                            vlc_selection_valid;
 
     /* Split buffers */
     int split_buffer_pending;
@@ -283,7 +285,7 @@ struct context_VC1_s {
     int slice_param_list_idx;
 
     /* VLC packed data */
-    struct psb_buffer_s vlc_packed_table;
+    psb_buffer_p vlc_packed_table; /* shared, see psb_vlc_cache.c */
     uint32_t vlc_packed_index_table[VLC_INDEX_TABLE_SIZE];
 
     /* Preload buffer */
@@ -212,6 +212,7 @@ struct filter_strength vpp_strength[STRENGTH_NUM] = {
 static void vsp_VPP_DestroyContext(object_context_p obj_context);
 static VAStatus vsp_set_pipeline(context_VPP_p ctx);
 static VAStatus vsp_set_filter_param(context_VPP_p ctx);
+static VAStatus vsp__VPP_update_filters(context_VPP_p ctx);
 static VAStatus vsp__VPP_check_legal_picture(object_context_p obj_context, object_config_p obj_config);
 static int check_resolution(int width, int height);
 static int check_vpp_strength(int value);
@@ -292,6 +293,10 @@ static VAStatus vsp_VPP_CreateContext(
 
 	ctx->frc_buf = NULL;
 
+	ctx->pipeline_valid = 0;
+	ctx->filter_cache = NULL;
+	ctx->filter_cache_sz = 0;
+
 	/* set size */
 	ctx->param_sz = 0;
 	ctx->pic_param_sz = ALIGN_TO_128(sizeof(struct VssProcPictureParameterBuffer));
@@ -320,8 +325,10 @@ static VAStatus vsp_VPP_CreateContext(
 	ctx->enhancer_param_offset = ctx->denoise_param_offset + ctx->denoise_param_sz;
 	ctx->sharpen_param_offset = ctx->enhancer_param_offset + ctx->enhancer_param_sz;
 	ctx->frc_param_offset = ctx->sharpen_param_offset + ctx->sharpen_param_sz;
-	/* For composer, it'll start on 0 */
+	/* For composer, it'll start on 0, one block per layer */
 	ctx->compose_param_offset = 0;
+	if (ctx->param_sz < PSB_COMPOSE_MAX_LAYERS * ctx->compose_param_sz)
+		ctx->param_sz = PSB_COMPOSE_MAX_LAYERS * ctx->compose_param_sz;
 
 	/* create intermediate buffer */
 	ctx->intermediate_buf = (psb_buffer_p) calloc(1, sizeof(struct psb_buffer_s));
@@ -384,11 +391,19 @@ static void vsp_VPP_DestroyContext(
 		ctx->intermediate_buf = NULL;
 	}
 
+	vsp_compose_destroy(ctx);
+
 	if (ctx->filters) {
 		free(ctx->filters);
 		ctx->num_filters = 0;
 	}
 
+	if (ctx->filter_cache) {
+		free(ctx->filter_cache);
+		ctx->filter_cache = NULL;
+		ctx->filter_cache_sz = 0;
+	}
+
 	free(obj_context->format_data);
 	obj_context->format_data = NULL;
 }
@@ -497,35 +512,17 @@ static VAStatus vsp__VPP_process_pipeline_param(context_VPP_p ctx, object_contex
 				}
 				memcpy(ctx->filters, pipeline_param->filters, ctx->num_filters * sizeof(*ctx->filters));
 			}
-
-			/* set pipeline command to FW */
-			vaStatus = vsp_set_pipeline(ctx);
-			if (vaStatus) {
-				drv_debug_msg(VIDEO_DEBUG_ERROR, "failed to set pipeline\n");
-				goto out;
-			}
-
-			/* set filter parameter to FW, record frc parameter buffer */
-			vaStatus = vsp_set_filter_param(ctx);
-			if (vaStatus) {
-				drv_debug_msg(VIDEO_DEBUG_ERROR, "failed to set filter parameter\n");
-				goto out;
-			}
 		}
 	} else {
-		/* else ignore pipeline/filter setting  */
-#if 0
-		/* FIXME: we can save these check for PnP */
-		for (i = 0; i < pipeline_param->num_filters; i++) {
-			if (pipeline_param->filters[i] != ctx->filters[i]) {
-				drv_debug_msg(VIDEO_DEBUG_ERROR, "can not reset pipeline in the mid of post-processing or without create a new context\n");
-				vaStatus = VA_STATUS_ERROR_UNKNOWN;
-				goto out;
-			}
-		}
-#endif
+		/* the filter buffers may be recreated for every frame */
+		memcpy(ctx->filters, pipeline_param->filters, ctx->num_filters * sizeof(*ctx->filters));
 	}
 
+	/* set pipeline and filter parameters to FW if they changed */
+	vaStatus = vsp__VPP_update_filters(ctx);
+	if (vaStatus)
+		goto out;
+
 	/* fill picture command to FW */
 	if (ctx->frc_buf != NULL)
 		frc_param = (VAProcFilterParameterBufferFrameRateConversion *)ctx->frc_buf->buffer_data;
@@ -1312,11 +1309,13 @@ static VAStatus vsp_set_pipeline(context_VPP_p ctx)
 {
 	VAStatus vaStatus = VA_STATUS_SUCCESS;
 	vsp_cmdbuf_p cmdbuf = ctx->obj_context->vsp_cmdbuf;
-	struct VssProcPipelineParameterBuffer *cell_pipeline_param = (struct VssProcPipelineParameterBuffer *)cmdbuf->pipeline_param_p;
+	struct VssProcPipelineParameterBuffer pipeline;
+	struct VssProcPipelineParameterBuffer *cell_pipeline_param = &pipeline;
 	unsigned int i, j, filter_count, check_filter = 0;
 	VAProcFilterParameterBufferBase *cur_param;
 	enum VssProcFilterType tmp;
-	psb_driver_data_p driver_data = ctx->obj_context->driver_data;
+
+	memset(&pipeline, 0, sizeof(pipeline));
 
 	/* set intermediate buffer */
 	cell_pipeline_param->intermediate_buffer_size = VSP_INTERMEDIATE_BUF_SIZE;
@@ -1329,13 +1328,9 @@ static VAStatus vsp_set_pipeline(context_VPP_p ctx)
 
 	filter_count = 0;
 
-	/* store filter buffer object */
-	if (ctx->num_filters != 0) {
-		for (i = 0; i < ctx->num_filters; ++i)
-			ctx->filter_buf[i] = BUFFER(ctx->filters[i]);
-	} else {
+	/* filter buffer objects are resolved by vsp__VPP_update_filters */
+	if (ctx->num_filters == 0)
 		goto finished;
-	}
 
 	/* loop the filter, set correct pipeline param for FW */
 	for (i = 0; i < ctx->num_filters; ++i) {
@@ -1386,6 +1381,20 @@ finished:
 				cell_pipeline_param->filter_pipeline[j - 1] = tmp;
 			}
 
+	/* FW keeps the pipeline, only send it when it changes */
+	if (ctx->pipeline_valid) {
+		if (!memcmp(&ctx->pipeline_cache, &pipeline, sizeof(pipeline)))
+			goto out;
+
+		drv_debug_msg(VIDEO_DEBUG_ERROR, "can not reset pipeline in the mid of post-processing or without create a new context\n");
+		vaStatus = VA_STATUS_ERROR_UNKNOWN;
+		goto out;
+	}
+
+	memcpy(cmdbuf->pipeline_param_p, &pipeline, sizeof(pipeline));
+	memcpy(&ctx->pipeline_cache, &pipeline, sizeof(pipeline));
+	ctx->pipeline_valid = 1;
+
 	vsp_cmdbuf_insert_command(cmdbuf, CONTEXT_VPP_ID, &cmdbuf->param_mem, VssProcPipelineParameterCommand,
 				  ctx->pipeline_param_offset, sizeof(struct VssProcPipelineParameterBuffer));
 out:
@@ -1504,6 +1513,90 @@ out:
 	return vaStatus;
 }
 
+/*
+ * Resolves the filter buffers of the current frame and sends the pipeline
+ * and filter parameters to FW only when the filter contents differ from
+ * the ones the FW state was built from
+ */
+static VAStatus vsp__VPP_update_filters(context_VPP_p ctx)
+{
+	VAStatus vaStatus = VA_STATUS_SUCCESS;
+	psb_driver_data_p driver_data = ctx->obj_context->driver_data;
+	const void *seg[3 + VssProcPipelineMaxNumFilters];
+	unsigned int seg_sz[3 + VssProcPipelineMaxNumFilters];
+	unsigned int i, num_seg = 0, cache_sz = 0;
+	unsigned char *p;
+	int changed;
+
+	if (ctx->num_filters > VssProcPipelineMaxNumFilters) {
+		drv_debug_msg(VIDEO_DEBUG_ERROR, "invalid filter number = %d\n", ctx->num_filters);
+		return VA_STATUS_ERROR_UNKNOWN;
+	}
+
+	/* the derived strength tables are part of the filter state */
+	seg[num_seg] = &ctx->denoise_deblock_param;
+	seg_sz[num_seg++] = sizeof(ctx->denoise_deblock_param);
+	seg[num_seg] = &ctx->enhancer_param;
+	seg_sz[num_seg++] = sizeof(ctx->enhancer_param);
+	seg[num_seg] = &ctx->sharpen_param;
+	seg_sz[num_seg++] = sizeof(ctx->sharpen_param);
+
+	ctx->frc_buf = NULL;
+	for (i = 0; i < ctx->num_filters; ++i) {
+		ctx->filter_buf[i] = BUFFER(ctx->filters[i]);
+		if (ctx->filter_buf[i] == NULL || ctx->filter_buf[i]->buffer_data == NULL) {
+			drv_debug_msg(VIDEO_DEBUG_ERROR, "invalid filter buffer %x\n", ctx->filters[i]);
+			return VA_STATUS_ERROR_INVALID_BUFFER;
+		}
+		if (((VAProcFilterParameterBufferBase *)ctx->filter_buf[i]->buffer_data)->type == VAProcFilterFrameRateConversion)
+			ctx->frc_buf = ctx->filter_buf[i];
+
+		seg[num_seg] = ctx->filter_buf[i]->buffer_data;
+		seg_sz[num_seg++] = ctx->filter_buf[i]->size * ctx->filter_buf[i]->num_elements;
+	}
+
+	for (i = 0; i < num_seg; ++i)
+		cache_sz += seg_sz[i];
+
+	changed = !ctx->pipeline_valid || cache_sz != ctx->filter_cache_sz;
+	for (i = 0, p = ctx->filter_cache; !changed && i < num_seg; p += seg_sz[i++])
+		changed = memcmp(p, seg[i], seg_sz[i]);
+
+	if (!changed)
+		return VA_STATUS_SUCCESS;
+
+	/* set pipeline command to FW */
+	vaStatus = vsp_set_pipeline(ctx);
+	if (vaStatus) {
+		drv_debug_msg(VIDEO_DEBUG_ERROR, "failed to set pipeline\n");
+		goto err;
+	}
+
+	/* set filter parameter to FW, record frc parameter buffer */
+	vaStatus = vsp_set_filter_param(ctx);
+	if (vaStatus) {
+		drv_debug_msg(VIDEO_DEBUG_ERROR, "failed to set filter parameter\n");
+		goto err;
+	}
+
+	if (cache_sz != ctx->filter_cache_sz) {
+		free(ctx->filter_cache);
+		ctx->filter_cache_sz = 0;
+		ctx->filter_cache = (unsigned char *) malloc(cache_sz);
+		if (ctx->filter_cache == NULL)
+			return VA_STATUS_SUCCESS;
+		ctx->filter_cache_sz = cache_sz;
+	}
+	for (i = 0, p = ctx->filter_cache; i < num_seg; p += seg_sz[i++])
+		memcpy(p, seg[i], seg_sz[i]);
+
+	return VA_STATUS_SUCCESS;
+err:
+	/* compare against nothing next frame so the parameters are resent */
+	ctx->filter_cache_sz = 0;
+	return vaStatus;
+}
+
 static int check_resolution(int width, int height)
 {
 	int ret;
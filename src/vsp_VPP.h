@@ -31,6 +31,7 @@
 
 #include "psb_drv_video.h"
 #include "vsp_fw.h"
+#include "psb_compose.h"
 
 #define CONTEXT_VPP_ID 0
 #define CONTEXT_VP8_ID 1
@@ -77,6 +78,21 @@ struct context_VPP_s {
 	struct VssProcDenoiseParameterBuffer denoise_deblock_param;
 	struct VssProcColorEnhancementParameterBuffer enhancer_param;
 	struct VssProcSharpenParameterBuffer sharpen_param;
+
+	/* last pipeline sent to FW and the filter contents it was built from */
+	struct VssProcPipelineParameterBuffer pipeline_cache;
+	int pipeline_valid;
+	unsigned char *filter_cache;
+	unsigned int filter_cache_sz;
+
+	/* compose layers from psb_SetComposeLayers, and the sequence parameters last sent to FW */
+	psb_compose_layer_t compose_layers[PSB_COMPOSE_MAX_LAYERS];
+	unsigned int num_compose_layers;
+	struct VssWiDi_ComposeSequenceParameterBuffer compose_cache;
+	int compose_cache_valid;
+	int compose_initialized;
+	/* intermediate NV12 target for multi-layer compose */
+	psb_surface_p compose_scratch;
 	//used for vp8 only
        unsigned int max_frame_size;
        unsigned int vp8_seq_cmd_send;
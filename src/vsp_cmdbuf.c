@@ -405,6 +405,7 @@ int vsp_context_flush_cmdbuf(object_context_p obj_context)
 	struct psb_ttm_fence_rep fence_rep;
 	unsigned int reloc_offset;
 	unsigned int num_relocs;
+	uint64_t submit_start_us;
 	int ret;
 	unsigned int cmdbuffer_size = (unsigned char *)cmdbuf->cmd_idx - cmdbuf->cmd_start; /* In bytes */
 
@@ -435,6 +436,7 @@ int vsp_context_flush_cmdbuf(object_context_p obj_context)
 #ifndef VSP_ENGINE_VPP
 #define VSP_ENGINE_VPP  6
 #endif
+	submit_start_us = psb_stats_now_us();
 	wsbmWriteLockKernelBO();
 	ret = vspDRMCmdBuf(driver_data->drm_fd, driver_data->execIoctlOffset,
 			   cmdbuf->buffer_refs, cmdbuf->buffer_refs_count, wsbmKBufHandle(wsbmKBuf(cmdbuf->buf.drm_buf)),
@@ -443,6 +445,7 @@ int vsp_context_flush_cmdbuf(object_context_p obj_context)
 			   0, VSP_ENGINE_VPP, fence_flags, &fence_rep);
 	wsbmWriteUnlockKernelBO();
 	UNLOCK_HARDWARE(driver_data);
+	psb_stats_submit(obj_context, submit_start_us);
 
 	if (ret) {
 		obj_context->vsp_cmdbuf = NULL;
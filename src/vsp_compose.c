@@ -45,56 +45,28 @@
 #define ALIGN_TO_128(value) ((value + 128 - 1) & ~(128 - 1))
 #define ALIGN_TO_16(value) ((value + 16 - 1) & ~(16 - 1))
 
-VAStatus vsp_compose_process_pipeline_param(context_VPP_p ctx, object_context_p __maybe_unused obj_context, object_buffer_p obj_buffer)
-{
+struct vsp_compose_pass {
+	object_surface_p rgb_surface;
+	psb_compose_layer_t layer;
+	int placed;	/* layer has a descriptor from psb_SetComposeLayers */
+};
 
-	VAStatus vaStatus = VA_STATUS_SUCCESS;
-	vsp_cmdbuf_p cmdbuf = ctx->obj_context->vsp_cmdbuf;
-	VAProcPipelineParameterBuffer *pipeline_param = (VAProcPipelineParameterBuffer *)obj_buffer->buffer_data;
-	struct VssWiDi_ComposeSequenceParameterBuffer *cell_compose_param = NULL;
-	object_surface_p yuv_surface = NULL;
-	object_surface_p rgb_surface = NULL;
-	object_surface_p output_surface = NULL;
+/*
+ * Fills the parameters blending one RGBA layer over a picture shaped like
+ * "yuv_surface" into one shaped like "output_surface". The buffer addresses
+ * are left to the caller.
+ */
+static void vsp__compose_fill_param(struct VssWiDi_ComposeSequenceParameterBuffer *cell_compose_param,
+				    object_surface_p yuv_surface,
+				    object_surface_p output_surface,
+				    struct vsp_compose_pass *pass)
+{
+	object_surface_p rgb_surface = pass->rgb_surface;
 	int yuv_width = 0, yuv_height = 0, yuv_stride = 0;
 	int rgb_width = 0, rgb_height = 0, rgb_stride = 0;
 	int out_width = 0, out_height = 0, out_stride = 0;
 
-	cell_compose_param = (struct VssWiDi_ComposeSequenceParameterBuffer *)cmdbuf->compose_param_p;
-
-	/* The END command */
-	if (pipeline_param->pipeline_flags & VA_PIPELINE_FLAG_END) {
-		vsp_cmdbuf_compose_end(cmdbuf);
-		/* Destory the VSP context */
-		vsp_cmdbuf_vpp_context(cmdbuf, VssGenDestroyContext, CONTEXT_COMPOSE_ID, 0);
-		goto out;
-	}
-
-	if (pipeline_param->num_additional_outputs <= 0 || !pipeline_param->additional_outputs) {
-		drv_debug_msg(VIDEO_DEBUG_ERROR, "there isn't RGB surface!\n");
-		vaStatus = VA_STATUS_ERROR_UNKNOWN;
-		goto out;
-	}
-
-	/* Init the VSP context */
-	if (ctx->obj_context->frame_count == 0)
-		vsp_cmdbuf_vpp_context(cmdbuf, VssGenInitializeContext, CONTEXT_COMPOSE_ID, VSP_APP_ID_WIDI_ENC);
-
-	yuv_surface = SURFACE(pipeline_param->surface);
-	if (yuv_surface == NULL) {
-		drv_debug_msg(VIDEO_DEBUG_ERROR, "invalid yuv surface %x\n", pipeline_param->surface);
-		vaStatus = VA_STATUS_ERROR_UNKNOWN;
-		goto out;
-	}
-
-	/* The RGB surface will be the first element */
-	rgb_surface = SURFACE(pipeline_param->additional_outputs[0]);
-	if (rgb_surface == NULL) {
-		drv_debug_msg(VIDEO_DEBUG_ERROR, "invalid RGB surface %x\n", pipeline_param->additional_outputs[0]);
-		vaStatus = VA_STATUS_ERROR_UNKNOWN;
-		goto out;
-	}
-
-	output_surface = ctx->obj_context->current_render_target;
+	memset(cell_compose_param, 0, sizeof(*cell_compose_param));
 
 	yuv_width = ALIGN_TO_16(yuv_surface->width);
 	yuv_height = yuv_surface->height_origin;
@@ -115,45 +87,18 @@ VAStatus vsp_compose_process_pipeline_param(context_VPP_p ctx, object_context_p
 	cell_compose_param->ProcessedHeight = cell_compose_param->ActualHeight;
 	cell_compose_param->TotalMBCount = ((cell_compose_param->ProcessedWidth >> 4) * (cell_compose_param->ProcessedHeight >> 4));
 	cell_compose_param->Stride = rgb_stride;
-	vsp_cmdbuf_reloc_pic_param(
-				&(cell_compose_param->RGBA_Buffer),
-				ctx->compose_param_offset,
-				&(rgb_surface->psb_surface->buf),
-				cmdbuf->param_mem_loc,
-				cell_compose_param);
-
 
 	/* Input YUV Video related */
 	cell_compose_param->Video_IN_xsize = yuv_width;
 	cell_compose_param->Video_IN_ysize = yuv_height;
 	cell_compose_param->Video_IN_stride = yuv_stride;
 	cell_compose_param->Video_IN_yuv_format = YUV_4_2_0_NV12;
-	vsp_cmdbuf_reloc_pic_param(
-				&(cell_compose_param->Video_IN_Y_Buffer),
-				ctx->compose_param_offset,
-				&(yuv_surface->psb_surface->buf),
-				cmdbuf->param_mem_loc,
-				cell_compose_param);
-
-	cell_compose_param->Video_IN_UV_Buffer =
-				cell_compose_param->Video_IN_Y_Buffer +
-				cell_compose_param->Video_IN_ysize * cell_compose_param->Video_IN_stride;
 
 	/* Output Video related */
 	cell_compose_param->Video_OUT_xsize = out_width;
 	cell_compose_param->Video_OUT_ysize = out_height;
 	cell_compose_param->Video_OUT_stride = out_stride;
 	cell_compose_param->Video_OUT_yuv_format = cell_compose_param->Video_IN_yuv_format;
-	vsp_cmdbuf_reloc_pic_param(
-				&(cell_compose_param->Video_OUT_Y_Buffer),
-				ctx->compose_param_offset,
-				&(output_surface->psb_surface->buf),
-				cmdbuf->param_mem_loc,
-				cell_compose_param);
-
-	cell_compose_param->Video_OUT_UV_Buffer =
-				cell_compose_param->Video_OUT_Y_Buffer +
-				cell_compose_param->Video_OUT_ysize * cell_compose_param->Video_OUT_stride;
 
 	/* Blending related params */
 	cell_compose_param->Is_video_the_back_ground = 1;
@@ -184,32 +129,284 @@ VAStatus vsp_compose_process_pipeline_param(context_VPP_p ctx, object_context_p
 	cell_compose_param->ROI_width = cell_compose_param->scaled_width;
 	cell_compose_param->ROI_height = cell_compose_param->scaled_height;
 
+	/*
+	 * a placed layer covers its own rectangle of the output, ROI_x1/y1 is
+	 * in the video. The caller rejects layers starting outside the output,
+	 * the rest are clipped to its visible size.
+	 */
+	if (pass->placed) {
+		cell_compose_param->ROI_x1 = pass->layer.x;
+		cell_compose_param->ROI_y1 = pass->layer.y;
+		cell_compose_param->ROI_width = rgb_width;
+		cell_compose_param->ROI_height = rgb_height;
+		if (pass->layer.x + rgb_width > output_surface->width)
+			cell_compose_param->ROI_width = output_surface->width - pass->layer.x;
+		if (pass->layer.y + rgb_height > output_surface->height_origin)
+			cell_compose_param->ROI_height = output_surface->height_origin - pass->layer.y;
+	}
+
 	cell_compose_param->Is_Blending_Enabled = 1;
 	cell_compose_param->alpha1 = 128;
-	cell_compose_param->alpha2 = 255;
+	cell_compose_param->alpha2 = pass->layer.alpha;
 	cell_compose_param->Is_source_1_image_available = 1;
 	cell_compose_param->Is_source_2_image_available = 1;
 	cell_compose_param->Is_alpha_channel_available = 1; /* 0: RGB Planar; 1: RGBA Interleaved */
 	cell_compose_param->CSC_FormatSelect = 0; /* 0: YUV420NV12; 1: YUV444; */
 	cell_compose_param->CSC_InputFormatSelect = 1; /* 0: RGB Planar; 1: RGBA Interleaved */
+}
+
+VAStatus vsp_compose_set_layers(context_VPP_p ctx, const psb_compose_layer_t *layers, unsigned int num_layers)
+{
+	unsigned int i;
+
+	if (num_layers > PSB_COMPOSE_MAX_LAYERS)
+		return VA_STATUS_ERROR_MAX_NUM_EXCEEDED;
+
+	for (i = 0; i < num_layers; ++i) {
+		if (layers[i].x < 0 || layers[i].y < 0 || layers[i].alpha > 255) {
+			drv_debug_msg(VIDEO_DEBUG_ERROR, "invalid compose layer %d: %d,%d alpha %d\n",
+				      i, layers[i].x, layers[i].y, layers[i].alpha);
+			return VA_STATUS_ERROR_INVALID_PARAMETER;
+		}
+	}
+
+	memcpy(ctx->compose_layers, layers, num_layers * sizeof(*layers));
+	ctx->num_compose_layers = num_layers;
+
+	return VA_STATUS_SUCCESS;
+}
+
+/*
+ * The VSP reads and writes the video in the same pass, so a layer can't be
+ * blended over output_surface in place. Passes after the first ping-pong
+ * between output_surface and this scratch surface of the same layout.
+ */
+static VAStatus vsp__compose_get_scratch(context_VPP_p ctx, object_surface_p output_surface, psb_surface_p *scratch)
+{
+	VAStatus vaStatus;
+	psb_surface_p out = output_surface->psb_surface;
+
+	if (ctx->compose_scratch &&
+	    (ctx->compose_scratch->stride != out->stride ||
+	     ctx->compose_scratch->size < out->size))
+		vsp_compose_destroy(ctx);
+
+	if (ctx->compose_scratch == NULL) {
+		ctx->compose_scratch = (psb_surface_p) calloc(1, sizeof(struct psb_surface_s));
+		if (ctx->compose_scratch == NULL)
+			return VA_STATUS_ERROR_ALLOCATION_FAILED;
+
+		vaStatus = psb_surface_create(ctx->obj_context->driver_data,
+					      output_surface->width, output_surface->height,
+					      VA_FOURCC_NV12, 0, ctx->compose_scratch);
+		if (vaStatus != VA_STATUS_SUCCESS) {
+			free(ctx->compose_scratch);
+			ctx->compose_scratch = NULL;
+			return vaStatus;
+		}
+
+		if (ctx->compose_scratch->stride != out->stride) {
+			drv_debug_msg(VIDEO_DEBUG_ERROR, "compose scratch stride %d doesn't match output %d\n",
+				      ctx->compose_scratch->stride, out->stride);
+			vsp_compose_destroy(ctx);
+			return VA_STATUS_ERROR_ALLOCATION_FAILED;
+		}
+	}
+
+	*scratch = ctx->compose_scratch;
+	return VA_STATUS_SUCCESS;
+}
+
+void vsp_compose_destroy(context_VPP_p ctx)
+{
+	if (ctx->compose_scratch) {
+		psb_surface_destroy(ctx->compose_scratch);
+		free(ctx->compose_scratch);
+		ctx->compose_scratch = NULL;
+	}
+}
+
+VAStatus vsp_compose_process_pipeline_param(context_VPP_p ctx, object_context_p __maybe_unused obj_context, object_buffer_p obj_buffer)
+{
+
+	VAStatus vaStatus = VA_STATUS_SUCCESS;
+	vsp_cmdbuf_p cmdbuf = ctx->obj_context->vsp_cmdbuf;
+	VAProcPipelineParameterBuffer *pipeline_param = (VAProcPipelineParameterBuffer *)obj_buffer->buffer_data;
+	struct VssWiDi_ComposeSequenceParameterBuffer *cell_compose_param = NULL;
+	struct vsp_compose_pass pass[PSB_COMPOSE_MAX_LAYERS], tmp;
+	object_surface_p yuv_surface = NULL;
+	object_surface_p in_surface = NULL;
+	object_surface_p output_surface = NULL;
+	psb_surface_p scratch = NULL;
+	psb_buffer_p in_buf, out_buf;
+	unsigned int i, j, num_passes;
+	int changed[PSB_COMPOSE_MAX_LAYERS];
+
+	/* The END command */
+	if (pipeline_param->pipeline_flags & VA_PIPELINE_FLAG_END) {
+		vsp_cmdbuf_compose_end(cmdbuf);
+		/* Destory the VSP context */
+		vsp_cmdbuf_vpp_context(cmdbuf, VssGenDestroyContext, CONTEXT_COMPOSE_ID, 0);
+		ctx->compose_initialized = 0;
+		ctx->compose_cache_valid = 0;
+		goto out;
+	}
+
+	if (pipeline_param->num_additional_outputs <= 0 || !pipeline_param->additional_outputs) {
+		drv_debug_msg(VIDEO_DEBUG_ERROR, "there isn't RGB surface!\n");
+		vaStatus = VA_STATUS_ERROR_UNKNOWN;
+		goto out;
+	}
+
+	if (pipeline_param->num_additional_outputs > PSB_COMPOSE_MAX_LAYERS) {
+		drv_debug_msg(VIDEO_DEBUG_ERROR, "too many RGB surfaces %d, max %d\n",
+			      pipeline_param->num_additional_outputs, PSB_COMPOSE_MAX_LAYERS);
+		vaStatus = VA_STATUS_ERROR_MAX_NUM_EXCEEDED;
+		goto out;
+	}
+
+	yuv_surface = SURFACE(pipeline_param->surface);
+	if (yuv_surface == NULL) {
+		drv_debug_msg(VIDEO_DEBUG_ERROR, "invalid yuv surface %x\n", pipeline_param->surface);
+		vaStatus = VA_STATUS_ERROR_UNKNOWN;
+		goto out;
+	}
+
+	/* Every RGB surface is one layer, matched with its descriptor if any */
+	num_passes = pipeline_param->num_additional_outputs;
+	for (i = 0; i < num_passes; ++i) {
+		pass[i].rgb_surface = SURFACE(pipeline_param->additional_outputs[i]);
+		if (pass[i].rgb_surface == NULL) {
+			drv_debug_msg(VIDEO_DEBUG_ERROR, "invalid RGB surface %x\n", pipeline_param->additional_outputs[i]);
+			vaStatus = VA_STATUS_ERROR_UNKNOWN;
+			goto out;
+		}
+
+		pass[i].placed = 0;
+		pass[i].layer.surface = pipeline_param->additional_outputs[i];
+		pass[i].layer.x = 0;
+		pass[i].layer.y = 0;
+		pass[i].layer.alpha = 255;
+		pass[i].layer.z_order = i;
+		for (j = 0; j < ctx->num_compose_layers; ++j) {
+			if (ctx->compose_layers[j].surface == pass[i].layer.surface) {
+				pass[i].layer = ctx->compose_layers[j];
+				pass[i].placed = 1;
+				break;
+			}
+		}
+	}
+
+	/* blend bottom-up, keeping the additional_outputs order for equal z */
+	for (i = 1; i < num_passes; ++i)
+		for (j = i; j > 0 && pass[j].layer.z_order < pass[j - 1].layer.z_order; --j) {
+			tmp = pass[j];
+			pass[j] = pass[j - 1];
+			pass[j - 1] = tmp;
+		}
+
+	output_surface = ctx->obj_context->current_render_target;
+
+	for (i = 0; i < num_passes; ++i) {
+		if (pass[i].placed &&
+		    (pass[i].layer.x >= output_surface->width ||
+		     pass[i].layer.y >= output_surface->height_origin)) {
+			drv_debug_msg(VIDEO_DEBUG_ERROR, "compose layer %x at %d,%d is outside the %dx%d output\n",
+				      pass[i].layer.surface, pass[i].layer.x, pass[i].layer.y,
+				      output_surface->width, output_surface->height_origin);
+			vaStatus = VA_STATUS_ERROR_INVALID_PARAMETER;
+			goto out;
+		}
+	}
+
+	if (num_passes > 1) {
+		vaStatus = vsp__compose_get_scratch(ctx, output_surface, &scratch);
+		if (vaStatus != VA_STATUS_SUCCESS) {
+			drv_debug_msg(VIDEO_DEBUG_ERROR, "failed to get the compose scratch surface\n");
+			goto out;
+		}
+	}
+
+	/* Init the VSP context */
+	if (!ctx->compose_initialized) {
+		vsp_cmdbuf_vpp_context(cmdbuf, VssGenInitializeContext, CONTEXT_COMPOSE_ID, VSP_APP_ID_WIDI_ENC);
+		ctx->compose_initialized = 1;
+		ctx->compose_cache_valid = 0;
+	}
+
+	/*
+	 * One compose frame per layer: the first blends over the input video,
+	 * the next ones over the output of the previous pass. Targets alternate
+	 * so that the last pass lands in output_surface. The context holds one
+	 * sequence state, so it is resent whenever a pass differs from the
+	 * block the FW saw last.
+	 */
+	in_buf = &yuv_surface->psb_surface->buf;
+	for (i = 0; i < num_passes; ++i) {
+		cell_compose_param = (struct VssWiDi_ComposeSequenceParameterBuffer *)
+			(cmdbuf->compose_param_p + i * ctx->compose_param_sz);
+		in_surface = (i == 0) ? yuv_surface : output_surface;
+		out_buf = ((num_passes - 1 - i) & 1) ? &scratch->buf : &output_surface->psb_surface->buf;
+
+		vsp__compose_fill_param(cell_compose_param, in_surface, output_surface, &pass[i]);
+
+		changed[i] = !ctx->compose_cache_valid ||
+			memcmp(&ctx->compose_cache, cell_compose_param, sizeof(*cell_compose_param));
+		if (changed[i]) {
+			memcpy(&ctx->compose_cache, cell_compose_param, sizeof(*cell_compose_param));
+			ctx->compose_cache_valid = 1;
+		}
+
+		vsp_cmdbuf_reloc_pic_param(
+					&(cell_compose_param->RGBA_Buffer),
+					0,
+					&(pass[i].rgb_surface->psb_surface->buf),
+					cmdbuf->param_mem_loc,
+					cmdbuf->param_mem_p);
+
+		vsp_cmdbuf_reloc_pic_param(
+					&(cell_compose_param->Video_IN_Y_Buffer),
+					0,
+					in_buf,
+					cmdbuf->param_mem_loc,
+					cmdbuf->param_mem_p);
+
+		cell_compose_param->Video_IN_UV_Buffer =
+					cell_compose_param->Video_IN_Y_Buffer +
+					cell_compose_param->Video_IN_ysize * cell_compose_param->Video_IN_stride;
+
+		vsp_cmdbuf_reloc_pic_param(
+					&(cell_compose_param->Video_OUT_Y_Buffer),
+					0,
+					out_buf,
+					cmdbuf->param_mem_loc,
+					cmdbuf->param_mem_p);
+
+		cell_compose_param->Video_OUT_UV_Buffer =
+					cell_compose_param->Video_OUT_Y_Buffer +
+					cell_compose_param->Video_OUT_ysize * cell_compose_param->Video_OUT_stride;
+
+		in_buf = out_buf;
+	}
+
+	for (i = 0; i < num_passes; ++i) {
+		if (changed[i]) {
+			vsp_cmdbuf_insert_command(cmdbuf,
+						CONTEXT_COMPOSE_ID,
+						&cmdbuf->param_mem,
+						VssWiDi_ComposeSetSequenceParametersCommand,
+						ctx->compose_param_offset + i * ctx->compose_param_sz,
+						sizeof(struct VssWiDi_ComposeSequenceParameterBuffer));
+		}
 
-	/* The first frame */
-	if (obj_context->frame_count == 0) {
 		vsp_cmdbuf_insert_command(cmdbuf,
 					CONTEXT_COMPOSE_ID,
 					&cmdbuf->param_mem,
-					VssWiDi_ComposeSetSequenceParametersCommand,
-					ctx->compose_param_offset,
+					VssWiDi_ComposeFrameCommand,
+					ctx->compose_param_offset + i * ctx->compose_param_sz,
 					sizeof(struct VssWiDi_ComposeSequenceParameterBuffer));
 	}
 
-	vsp_cmdbuf_insert_command(cmdbuf,
-				CONTEXT_COMPOSE_ID,
-				&cmdbuf->param_mem,
-				VssWiDi_ComposeFrameCommand,
-				ctx->compose_param_offset,
-				sizeof(struct VssWiDi_ComposeSequenceParameterBuffer));
-
 	/* Insert Fence Command */
 	vsp_cmdbuf_fence_compose_param(cmdbuf, wsbmKBufHandle(wsbmKBuf(cmdbuf->param_mem.drm_buf)));
 
@@ -35,4 +35,8 @@
 
 VAStatus vsp_compose_process_pipeline_param(context_VPP_p ctx, object_context_p obj_context, object_buffer_p obj_buffer);
 
+VAStatus vsp_compose_set_layers(context_VPP_p ctx, const psb_compose_layer_t *layers, unsigned int num_layers);
+
+void vsp_compose_destroy(context_VPP_p ctx);
+
 #endif /* _VSS_VPP_H_ */
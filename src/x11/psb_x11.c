@@ -44,6 +44,9 @@
 #include <stdarg.h>
 #include "psb_surface_ext.h"
 #include <wsbm/wsbm_manager.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include "psb_image_convert.h"
 
 #define INIT_DRIVER_DATA    psb_driver_data_p driver_data = (psb_driver_data_p) ctx->pDriverData
 #define INIT_OUTPUT_PRIV    psb_x11_output_p output = (psb_x11_output_p)(((psb_driver_data_p)ctx->pDriverData)->ws_priv)
@@ -101,6 +104,142 @@ static uint32_t mask2shift(uint32_t mask)
     return shift;
 }
 
+static void x11_trap_errors(void);
+static int x11_untrap_errors(void);
+
+static void psb__x11_swr_free_image(Display *dpy, psb_x11_output_p output)
+{
+    if (output->swr_ximage == NULL)
+        return;
+
+    if (output->swr_shm) {
+        XShmDetach(dpy, &output->swr_shminfo);
+        XSync(dpy, False);
+        output->swr_ximage->data = NULL;
+        XDestroyImage(output->swr_ximage);
+        shmdt(output->swr_shminfo.shmaddr);
+    } else {
+        XDestroyImage(output->swr_ximage);
+    }
+
+    output->swr_ximage = NULL;
+    output->swr_shm = 0;
+    output->swr_shm_busy = 0;
+}
+
+static void psb__x11_swr_free(Display *dpy, psb_x11_output_p output)
+{
+    psb__x11_swr_free_image(dpy, output);
+
+    if (output->swr_gc) {
+        XFreeGC(dpy, output->swr_gc);
+        output->swr_gc = NULL;
+    }
+    output->swr_drawable = 0;
+}
+
+static XImage *psb__x11_swr_create_shm_image(Display *dpy, psb_x11_output_p output,
+                                             Visual *visual, int depth, int width, int height)
+{
+    XShmSegmentInfo *shminfo = &output->swr_shminfo;
+    XImage *ximg;
+
+    ximg = XShmCreateImage(dpy, visual, depth, ZPixmap, NULL, shminfo, width, height);
+    if (ximg == NULL)
+        return NULL;
+
+    shminfo->shmid = shmget(IPC_PRIVATE, ximg->bytes_per_line * height, IPC_CREAT | 0600);
+    if (shminfo->shmid < 0)
+        goto fail_destroy;
+
+    shminfo->shmaddr = ximg->data = shmat(shminfo->shmid, NULL, 0);
+    shminfo->readOnly = False;
+    if (shminfo->shmaddr == (char *) -1)
+        goto fail_rmid;
+
+    /* attaching fails on remote displays even when the extension is listed */
+    x11_trap_errors();
+    XShmAttach(dpy, shminfo);
+    XSync(dpy, False);
+    if (x11_untrap_errors()) {
+        shmdt(shminfo->shmaddr);
+        goto fail_rmid;
+    }
+
+    /* the segment goes away once both sides have detached */
+    shmctl(shminfo->shmid, IPC_RMID, NULL);
+    return ximg;
+
+fail_rmid:
+    shmctl(shminfo->shmid, IPC_RMID, NULL);
+fail_destroy:
+    ximg->data = NULL;
+    XDestroyImage(ximg);
+    return NULL;
+}
+
+/*
+ * Returns the 32 bpp image for draw, reusing the GC and image of the
+ * previous frame when the drawable and size are unchanged
+ */
+static XImage *psb__x11_swr_get_image(Display *dpy, psb_x11_output_p output, Drawable draw,
+                                      Visual *visual, int depth, int width, int height)
+{
+    XImage *ximg;
+
+    if (output->swr_drawable != draw) {
+        psb__x11_swr_free(dpy, output);
+        output->swr_gc = XCreateGC(dpy, draw, 0, NULL);
+        output->swr_drawable = draw;
+    }
+
+    ximg = output->swr_ximage;
+    if (ximg && ((ximg->width != width) || (ximg->height != height))) {
+        psb__x11_swr_free_image(dpy, output);
+        ximg = NULL;
+    }
+
+    if (ximg) {
+        /* don't overwrite pixels the server hasn't copied out yet */
+        if (output->swr_shm_busy) {
+            XSync(dpy, False);
+            output->swr_shm_busy = 0;
+        }
+        return ximg;
+    }
+
+    if (XShmQueryExtension(dpy))
+        ximg = psb__x11_swr_create_shm_image(dpy, output, visual, depth, width, height);
+    if (ximg) {
+        output->swr_shm = 1;
+    } else {
+        ximg = XCreateImage(dpy, visual, depth, ZPixmap, 0, NULL, width, height, 32, 0);
+        if (ximg == NULL)
+            return NULL;
+        ximg->data = (char *) malloc(ximg->bytes_per_line * height);
+        if (ximg->data == NULL) {
+            XDestroyImage(ximg);
+            return NULL;
+        }
+        output->swr_shm = 0;
+    }
+
+    if (ximg->bits_per_pixel != 32) {
+        drv_debug_msg(VIDEO_DEBUG_ERROR, "PutSurface: Display uses %d bits/pixel which is not supported\n",
+                      ximg->bits_per_pixel);
+        output->swr_ximage = ximg;
+        psb__x11_swr_free_image(dpy, output);
+        return NULL;
+    }
+
+    drv_debug_msg(VIDEO_DEBUG_GENERAL, "PutSurface: %dx%d %s XImage, %s\n", width, height,
+                  output->swr_shm ? "MIT-SHM" : "client side",
+                  (ximg->byte_order == MSBFirst) ? "MSBFirst" : "LSBFirst");
+
+    output->swr_ximage = ximg;
+    return ximg;
+}
+
 static VAStatus psb_putsurface_x11(
     VADriverContextP ctx,
     VASurfaceID surface,
@@ -117,35 +256,16 @@ static VAStatus psb_putsurface_x11(
 )
 {
     INIT_DRIVER_DATA;
-    GC gc;
-    XImage *ximg = NULL;
+    INIT_OUTPUT_PRIV;
+    Display *dpy = (Display *)ctx->native_dpy;
+    XImage *ximg;
     Visual *visual;
-    unsigned short width, height;
     int depth;
-    int x = 0, y = 0;
     VAStatus vaStatus = VA_STATUS_SUCCESS;
-    void *surface_data = NULL;
+    unsigned char *surface_data = NULL;
+    unsigned char *src_y, *src_uv;
     int ret;
 
-    uint32_t rmask = 0;
-    uint32_t gmask = 0;
-    uint32_t bmask = 0;
-
-    uint32_t rshift = 0;
-    uint32_t gshift = 0;
-    uint32_t bshift = 0;
-
-
-    if (srcw <= destw)
-        width = srcw;
-    else
-        width = destw;
-
-    if (srch <= desth)
-        height = srch;
-    else
-        height = desth;
-
     object_surface_p obj_surface = SURFACE(surface);
     if (NULL == obj_surface) {
         vaStatus = VA_STATUS_ERROR_INVALID_SURFACE;
@@ -155,110 +275,53 @@ static VAStatus psb_putsurface_x11(
 
     psb_surface_p psb_surface = obj_surface->psb_surface;
 
+    /* keep the source rectangle inside the surface */
+    if ((srcx < 0) || (srcy < 0) || (srcx >= obj_surface->width) || (srcy >= obj_surface->height))
+        return VA_STATUS_ERROR_INVALID_PARAMETER;
+    if (srcx + srcw > obj_surface->width)
+        srcw = obj_surface->width - srcx;
+    if (srcy + srch > obj_surface->height)
+        srch = obj_surface->height - srcy;
+    if ((srcw == 0) || (srch == 0) || (destw == 0) || (desth == 0))
+        return VA_STATUS_SUCCESS;
+
     drv_debug_msg(VIDEO_DEBUG_GENERAL, "PutSurface: src	  w x h = %d x %d\n", srcw, srch);
     drv_debug_msg(VIDEO_DEBUG_GENERAL, "PutSurface: dest 	  w x h = %d x %d\n", destw, desth);
-    drv_debug_msg(VIDEO_DEBUG_GENERAL, "PutSurface: clipped w x h = %d x %d\n", width, height);
 
-    visual = DefaultVisual((Display *)ctx->native_dpy, ctx->x11_screen);
-    gc = XCreateGC((Display *)ctx->native_dpy, draw, 0, NULL);
-    depth = DefaultDepth((Display *)ctx->native_dpy, ctx->x11_screen);
+    visual = DefaultVisual(dpy, ctx->x11_screen);
+    depth = DefaultDepth(dpy, ctx->x11_screen);
 
     if (TrueColor != visual->class) {
         drv_debug_msg(VIDEO_DEBUG_ERROR, "PutSurface: Default visual of X display must be TrueColor.\n");
-        vaStatus = VA_STATUS_ERROR_UNKNOWN;
-        goto out;
+        return VA_STATUS_ERROR_UNKNOWN;
     }
 
-    ret = psb_buffer_map(&psb_surface->buf, &surface_data);
-    if (ret) {
-        vaStatus = VA_STATUS_ERROR_UNKNOWN;
-        goto out;
-    }
-
-    rmask = visual->red_mask;
-    gmask = visual->green_mask;
-    bmask = visual->blue_mask;
-
-    rshift = mask2shift(rmask);
-    gshift = mask2shift(gmask);
-    bshift = mask2shift(bmask);
-
-    drv_debug_msg(VIDEO_DEBUG_GENERAL, "PutSurface: Pixel masks: R = %08x G = %08x B = %08x\n", rmask, gmask, bmask);
-    drv_debug_msg(VIDEO_DEBUG_GENERAL, "PutSurface: Pixel shifts: R = %d G = %d B = %d\n", rshift, gshift, bshift);
+    ximg = psb__x11_swr_get_image(dpy, output, draw, visual, depth, destw, desth);
+    if (ximg == NULL)
+        return VA_STATUS_ERROR_ALLOCATION_FAILED;
 
-    ximg = XCreateImage((Display *)ctx->native_dpy, visual, depth, ZPixmap, 0, NULL, width, height, 32, 0);
-
-    if (ximg->byte_order == MSBFirst)
-        drv_debug_msg(VIDEO_DEBUG_GENERAL, "PutSurface: XImage pixels has MSBFirst, %d bits / pixel\n", ximg->bits_per_pixel);
-    else
-        drv_debug_msg(VIDEO_DEBUG_GENERAL, "PutSurface: XImage pixels has LSBFirst, %d bits / pixel\n", ximg->bits_per_pixel);
+    ret = psb_buffer_map(&psb_surface->buf, &surface_data);
+    if (ret)
+        return VA_STATUS_ERROR_UNKNOWN;
+
+    src_y = surface_data + psb_surface->stride * srcy + srcx;
+    src_uv = surface_data + psb_surface->stride * (obj_surface->height + srcy / 2) + (srcx & ~1);
+
+    vaStatus = psb_nv12_to_rgb32(driver_data->row_pool, src_y, src_uv, psb_surface->stride, srcw, srch,
+                                 (unsigned char *)ximg->data, ximg->bytes_per_line, destw, desth,
+                                 mask2shift(visual->red_mask), mask2shift(visual->green_mask),
+                                 mask2shift(visual->blue_mask), (flags & VA_SRC_BT709) != 0);
+    psb_buffer_unmap(&psb_surface->buf);
+    if (vaStatus != VA_STATUS_SUCCESS)
+        return vaStatus;
 
-    if (ximg->bits_per_pixel != 32) {
-        drv_debug_msg(VIDEO_DEBUG_ERROR, "PutSurface: Display uses %d bits/pixel which is not supported\n");
-        vaStatus = VA_STATUS_ERROR_UNKNOWN;
-        goto out;
-    }
-
-    void yuv2pixel(uint32_t * pixel, int y, int u, int v) {
-        int r, g, b;
-        /* Warning, magic values ahead */
-        r = y + ((351 * (v - 128)) >> 8);
-        g = y - (((179 * (v - 128)) + (86 * (u - 128))) >> 8);
-        b = y + ((444 * (u - 128)) >> 8);
-
-        if (r > 255) r = 255;
-        if (g > 255) g = 255;
-        if (b > 255) b = 255;
-        if (r < 0) r = 0;
-        if (g < 0) g = 0;
-        if (b < 0) b = 0;
-
-        *pixel = ((r << rshift) & rmask) | ((g << gshift) & gmask) | ((b << bshift) & bmask);
-    }
-    ximg->data = (char *) malloc(ximg->bytes_per_line * height);
-    if (NULL == ximg->data) {
-        vaStatus = VA_STATUS_ERROR_ALLOCATION_FAILED;
-        goto out;
-    }
-
-    uint8_t *src_y = surface_data + psb_surface->stride * srcy;
-    uint8_t *src_uv = surface_data + psb_surface->stride * (obj_surface->height + srcy / 2);
-
-    for (y = srcy; y < (srcy + height); y += 2) {
-        uint32_t *dest_even = (uint32_t *)(ximg->data + y * ximg->bytes_per_line);
-        uint32_t *dest_odd = (uint32_t *)(ximg->data + (y + 1) * ximg->bytes_per_line);
-        for (x = srcx; x < (srcx + width); x += 2) {
-            /* Y1 Y2 */
-            /* Y3 Y4 */
-            int y1 = *(src_y + x);
-            int y2 = *(src_y + x + 1);
-            int y3 = *(src_y + x + psb_surface->stride);
-            int y4 = *(src_y + x + psb_surface->stride + 1);
-
-            /* U V */
-            int u = *(src_uv + x);
-            int v = *(src_uv + x + 1);
-
-            yuv2pixel(dest_even++, y1, u, v);
-            yuv2pixel(dest_even++, y2, u, v);
-
-            yuv2pixel(dest_odd++, y3, u, v);
-            yuv2pixel(dest_odd++, y4, u, v);
-        }
-        src_y += psb_surface->stride * 2;
-        src_uv += psb_surface->stride;
+    if (output->swr_shm) {
+        XShmPutImage(dpy, draw, output->swr_gc, ximg, 0, 0, destx, desty, destw, desth, False);
+        output->swr_shm_busy = 1;
+    } else {
+        XPutImage(dpy, draw, output->swr_gc, ximg, 0, 0, destx, desty, destw, desth);
     }
-
-    XPutImage((Display *)ctx->native_dpy, draw, gc, ximg, 0, 0, destx, desty, width, height);
-    XFlush((Display *)ctx->native_dpy);
-
-out:
-    if (NULL != ximg)
-        XDestroyImage(ximg);
-    if (NULL != surface_data)
-        psb_buffer_unmap(&psb_surface->buf);
-
-    XFreeGC((Display *)ctx->native_dpy, gc);
+    XFlush(dpy);
 
     return vaStatus;
 }
@@ -354,6 +417,11 @@ error_handler(Display *dpy, XErrorEvent *error)
 
 void psb_x11_output_deinit(VADriverContextP ctx)
 {
+    psb_x11_output_p swr_output = (psb_x11_output_p)(((psb_driver_data_p)ctx->pDriverData)->ws_priv);
+
+    if (swr_output)
+        psb__x11_swr_free((Display *)ctx->native_dpy, swr_output);
+
 #ifdef _FOR_FPGA_
     if (getenv("PSB_VIDEO_PUTSURFACE_X11"))
         return;
@@ -487,9 +555,11 @@ VAStatus psb_PutSurface(
     }
 
     if (driver_data->output_method == PSB_PUTSURFACE_X11) {
-        psb_putsurface_x11(ctx, surface, draw, srcx, srcy, srcw, srch,
-                           destx, desty, destw, desth, flags);
-        return VA_STATUS_SUCCESS;
+        pthread_mutex_lock(&driver_data->output_mutex);
+        vaStatus = psb_putsurface_x11(ctx, surface, draw, srcx, srcy, srcw, srch,
+                                      destx, desty, destw, desth, flags);
+        pthread_mutex_unlock(&driver_data->output_mutex);
+        return vaStatus;
     }
 
     if (driver_data->fixed_fps > 0) {
@@ -33,6 +33,7 @@
 #define _PSB_X11_H_
 
 #include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
 
 #include <inttypes.h>
 #include "psb_drv_video.h"
@@ -104,6 +105,13 @@ typedef struct _psb_x11_output_s {
     int rotate;
     unsigned int sprite_enabled;
 
+    /* software putsurface state, kept across frames for one drawable */
+    Drawable swr_drawable;
+    GC swr_gc;
+    XImage *swr_ximage;
+    XShmSegmentInfo swr_shminfo;
+    int swr_shm;        /* swr_ximage lives in a MIT-SHM segment */
+    int swr_shm_busy;   /* the server may still be reading swr_ximage */
 } psb_x11_output_s, *psb_x11_output_p;
 
 VAStatus psb_putsurface_coverlay(
@@ -823,6 +823,7 @@ VAStatus psb_putsurface_xvideo(
         driver_data->last_displaying_surface = VA_INVALID_SURFACE;
         obj_surface->display_timestamp = 0;
     }
+    pthread_cond_broadcast(&driver_data->display_cond);
 
 
     return vaStatus;